@@ -0,0 +1,185 @@
+#if defined(_WIN32)
+#pragma comment(lib, "Registry.lib")
+#pragma comment(lib, "psapi.lib")
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <filesystem>
+#include <exception>
+
+#include <HiveFile.hpp>
+#include <HiveWriter.hpp>
+
+#if defined(_WIN32)
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace m4x1m1l14n;
+
+// Lookups made in each hive when counting page faults
+static constexpr size_t MaxLookups = 100000;
+
+/// <summary>
+///		Page faults of whole process so far, both soft and hard ones
+/// </summary>
+static unsigned long long PageFaults()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters = {};
+
+	::GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters));
+
+	return counters.PageFaultCount;
+#else
+	struct rusage usage = {};
+
+	::getrusage(RUSAGE_SELF, &usage);
+
+	return static_cast<unsigned long long>(usage.ru_minflt) + static_cast<unsigned long long>(usage.ru_majflt);
+#endif
+}
+
+/// <summary>
+///		Drops file from page cache, so lookups start cold as they do after reboot. Done on Linux only,
+///		on Windows cached pages are counted as soft faults anyway.
+/// </summary>
+static void Evict(const std::wstring& file)
+{
+#if !defined(_WIN32)
+	const int fd = ::open(std::filesystem::path(file).c_str(), O_RDONLY);
+	if (fd != -1)
+	{
+		// Dirty pages cannot be dropped
+		::fsync(fd);
+		::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		::close(fd);
+	}
+#else
+	static_cast<void>(file);
+#endif
+}
+
+static void CollectPaths(const Registry::HiveKey& key, const std::wstring& path, std::vector<std::wstring>& paths)
+{
+	paths.push_back(path);
+
+	key.EnumerateSubKeys([&](const std::wstring& name) -> bool
+	{
+		CollectPaths(key.Open(name), path.empty() ? name : path + L"\\" + name, paths);
+
+		return true;
+	});
+}
+
+/// <summary>
+///		Maps hive anew, opens every key by its path from root and reads all its values.
+///		Returns number of page faults taken meanwhile.
+/// </summary>
+static unsigned long long MeasureLookups(const std::wstring& file, const std::vector<std::wstring>& paths)
+{
+	Evict(file);
+
+	Registry::HiveFile hive(file);
+
+	size_t cbRead = 0;
+
+	const auto faults = PageFaults();
+
+	for (const auto& path : paths)
+	{
+		const auto key = path.empty() ? hive.Root() : hive.Open(path);
+
+		key.EnumerateValues([&cbRead](std::wstring_view, DWORD, const BYTE*, DWORD cbData) -> bool
+		{
+			cbRead += cbData;
+
+			return true;
+		});
+	}
+
+	const auto result = PageFaults() - faults;
+
+	// Keep reads from being optimized out
+	if (cbRead == static_cast<size_t>(-1))
+	{
+		std::cout << cbRead << std::endl;
+	}
+
+	return result;
+}
+
+template <typename T>
+static void PrintRow(const char* name, T before, T after)
+{
+	std::cout << std::left << std::setw(28) << name << std::right << std::setw(16) << before << std::setw(16) << after << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 3)
+	{
+		std::cerr << "Usage: " << argv[0] << " <source hive> <compacted hive>" << std::endl;
+
+		return 1;
+	}
+
+	const auto source = std::filesystem::path(argv[1]).wstring();
+	const auto target = std::filesystem::path(argv[2]).wstring();
+
+	try
+	{
+		const auto compaction = Registry::CompactHive(source, target);
+
+		std::vector<std::wstring> paths;
+
+		{
+			Registry::HiveFile hive(target);
+
+			CollectPaths(hive.Root(), L"", paths);
+		}
+
+		// Keys are looked up in random order, same in both hives
+		std::shuffle(paths.begin(), paths.end(), std::mt19937(1));
+
+		if (paths.size() > MaxLookups)
+		{
+			paths.resize(MaxLookups);
+		}
+
+		const auto faultsBefore = MeasureLookups(source, paths);
+		const auto faultsAfter = MeasureLookups(target, paths);
+
+		const auto& before = compaction.before;
+		const auto& after = compaction.after;
+
+		std::cout << std::fixed << std::setprecision(2);
+
+		PrintRow("", "source", "compacted");
+		PrintRow("File size", before.fileSize, after.fileSize);
+		PrintRow("Free bytes", before.freeBytes, after.freeBytes);
+		PrintRow("Unreferenced bytes", before.unusedBytes, after.unusedBytes);
+		PrintRow("Keys", before.keys, after.keys);
+		PrintRow("Values", before.values, after.values);
+		PrintRow("Pages per lookup", before.pagesPerLookup, after.pagesPerLookup);
+		PrintRow("Page faults", faultsBefore, faultsAfter);
+		PrintRow("Page faults per lookup", static_cast<double>(faultsBefore) / paths.size(), static_cast<double>(faultsAfter) / paths.size());
+		std::cout << "(" << paths.size() << " lookups)" << std::endl;
+	}
+	catch (const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <Registry.hpp>
+#include <ChangeNotifier.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <cstring>
+#include <cwchar>
+#include <utility>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		class CachedRegistryKey;
+
+		typedef std::shared_ptr<CachedRegistryKey> CachedRegistryKey_ptr;
+
+		/// <summary>
+		///		Read-only view of registry key values, which remembers values once read
+		///		and forgets them when change notification for key arrives.
+		///		Values are returned and errors are thrown same as by RegistryKey methods with same name.
+		/// </summary>
+		class CachedRegistryKey
+		{
+		public:
+			/// <summary>
+			///		Creates cache over specified key, using change notifier matching key backend.
+			///		Key must be opened with DesiredAccess::Notify and DesiredAccess::QueryValue rights.
+			/// </summary>
+			explicit CachedRegistryKey(const RegistryKey_ptr& key)
+				: CachedRegistryKey(key, CreateChangeNotifier(key, false, NotifyFilter::ChangeLastSet))
+			{
+			}
+
+			CachedRegistryKey(const RegistryKey_ptr& key, ChangeNotifier_ptr notifier)
+				: m_key(key)
+				, m_notifier(std::move(notifier))
+				, m_epoch(1)
+				, m_armed(true)
+			{
+				if (m_key == nullptr)
+				{
+					throw std::invalid_argument("Registry key cannot be nullptr");
+				}
+
+				if (m_notifier == nullptr)
+				{
+					throw std::invalid_argument("Change notifier cannot be nullptr");
+				}
+
+				// Notifier must be armed before first value is read, otherwise change made in between would be missed
+				m_notifier->Start([this](bool rearmed)
+				{
+					if (!rearmed)
+					{
+						m_armed.store(false, std::memory_order_release);
+					}
+
+					m_epoch.fetch_add(1, std::memory_order_acq_rel);
+				});
+			}
+
+			// Disable copy ctor & copy assignment operator
+			CachedRegistryKey(const CachedRegistryKey& other) = delete;
+			CachedRegistryKey& operator=(const CachedRegistryKey& other) = delete;
+
+			~CachedRegistryKey()
+			{
+				m_notifier->Stop();
+			}
+
+			/// <summary>
+			///		Registry key values are read from
+			/// </summary>
+			const RegistryKey_ptr& GetKey() const
+			{
+				return m_key;
+			}
+
+			/// <summary>
+			///		Forgets all cached values
+			/// </summary>
+			void Invalidate()
+			{
+				m_epoch.fetch_add(1, std::memory_order_acq_rel);
+
+				std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+				m_values.clear();
+			}
+
+			bool HasValue(const std::wstring& name)
+			{
+				if (name.empty())
+				{
+					throw std::invalid_argument("Value name cannot be empty");
+				}
+
+				return Read(name, [](const Entry& entry) -> bool
+				{
+					return entry.status == ERROR_SUCCESS;
+				});
+			}
+
+			bool GetBoolean(const std::wstring& name)
+			{
+				return Read(name, [](const Entry& entry) -> bool
+				{
+					ThrowIfFailed(entry, sizeof(DWORD));
+
+					if (entry.type != REG_DWORD && entry.type != REG_QWORD)
+					{
+						throw std::runtime_error("Wrong registry value type " + std::to_string(entry.type) + " for boolean value.");
+					}
+
+					return static_cast<DWORD>(entry.number) != 0;
+				});
+			}
+
+			LONG GetInt32(const std::wstring& name)
+			{
+				return Read(name, [](const Entry& entry) -> LONG
+				{
+					ThrowIfFailed(entry, sizeof(LONG));
+
+					return static_cast<LONG>(static_cast<DWORD>(entry.number));
+				});
+			}
+
+			DWORD GetUInt32(const std::wstring& name)
+			{
+				return static_cast<DWORD>(GetInt32(name));
+			}
+
+			long long GetInt64(const std::wstring& name)
+			{
+				return Read(name, [](const Entry& entry) -> long long
+				{
+					ThrowIfFailed(entry, sizeof(long long));
+
+					return static_cast<long long>(entry.number);
+				});
+			}
+
+			unsigned long long GetUInt64(const std::wstring& name)
+			{
+				return static_cast<unsigned long long>(GetInt64(name));
+			}
+
+			std::wstring GetString(const std::wstring& name)
+			{
+				return Read(name, [](const Entry& entry) -> std::wstring
+				{
+					if (entry.status != ERROR_SUCCESS)
+					{
+						auto ec = std::error_code(entry.status, std::system_category());
+
+						throw std::system_error(ec, "RegQueryValueEx() failed");
+					}
+
+					if (entry.type != REG_SZ && entry.type != REG_EXPAND_SZ)
+					{
+						throw std::runtime_error("Wrong registry value type " + std::to_string(entry.type) + " for string value.");
+					}
+
+					return entry.text;
+				});
+			}
+
+		private:
+			/// <summary>
+			///		Decoded registry value, or status of failed query
+			/// </summary>
+			struct Entry
+			{
+				// Notification epoch value was read in
+				ULONGLONG epoch = 0;
+				LSTATUS status = ERROR_SUCCESS;
+				DWORD type = REG_NONE;
+				DWORD cbData = 0;
+				// Data of values up to 8 bytes long
+				ULONGLONG number = 0;
+				// Data of REG_SZ and REG_EXPAND_SZ values up to first null character
+				std::wstring text;
+			};
+
+			/// <summary>
+			///		Throws same error RegQueryValueEx() would report when reading entry to buffer of specified size
+			/// </summary>
+			static void ThrowIfFailed(const Entry& entry, DWORD cbBuffer)
+			{
+				LSTATUS lStatus = entry.status;
+
+				if (lStatus == ERROR_SUCCESS && entry.cbData > cbBuffer)
+				{
+					lStatus = ERROR_MORE_DATA;
+				}
+
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegQueryValueEx() failed");
+				}
+			}
+
+			template <typename __Function>
+			auto Read(const std::wstring& name, const __Function& decode) -> decltype(decode(std::declval<const Entry&>()))
+			{
+				// Epoch is sampled before value is queried, so value read after notification
+				// arrived is stored with old epoch and never served
+				const auto epoch = m_epoch.load(std::memory_order_acquire);
+				const auto armed = m_armed.load(std::memory_order_acquire);
+
+				if (armed)
+				{
+					std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+					auto it = m_values.find(name);
+					if (it != m_values.end() && it->second.epoch == epoch)
+					{
+						return decode(it->second);
+					}
+				}
+
+				Entry entry;
+				entry.epoch = epoch;
+
+				Load(name, entry);
+
+				if (armed && (entry.status == ERROR_SUCCESS || entry.status == ERROR_FILE_NOT_FOUND))
+				{
+					std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+					auto& cached = m_values[name];
+					if (cached.epoch <= entry.epoch)
+					{
+						cached = entry;
+					}
+				}
+
+				return decode(entry);
+			}
+
+			void Load(const std::wstring& name, Entry& entry)
+			{
+				const auto& backend = m_key->GetBackend();
+
+				// Small values are read directly into number, larger ones are only sized
+				DWORD cbData = sizeof(entry.number);
+
+				entry.status = backend->QueryValue(*m_key, name.c_str(), &entry.type, reinterpret_cast<LPBYTE>(&entry.number), &cbData);
+				entry.cbData = cbData;
+
+				if (entry.status == ERROR_SUCCESS)
+				{
+					if (entry.type == REG_SZ || entry.type == REG_EXPAND_SZ)
+					{
+						AssignText(entry, reinterpret_cast<const wchar_t*>(&entry.number), cbData);
+					}
+				}
+				else if (entry.status == ERROR_MORE_DATA)
+				{
+					// Only strings are decoded, for other types size is enough to report ERROR_MORE_DATA
+					entry.status = ERROR_SUCCESS;
+
+					if (entry.type == REG_SZ || entry.type == REG_EXPAND_SZ)
+					{
+						std::wstring data;
+
+						do
+						{
+							data.resize(cbData / sizeof(wchar_t) + 1);
+							cbData = static_cast<DWORD>(data.size() * sizeof(wchar_t));
+
+							entry.status = backend->QueryValue(*m_key, name.c_str(), &entry.type, reinterpret_cast<LPBYTE>(&data[0]), &cbData);
+						} while (entry.status == ERROR_MORE_DATA);
+
+						entry.cbData = cbData;
+
+						if (entry.status == ERROR_SUCCESS)
+						{
+							AssignText(entry, data.c_str(), cbData);
+
+							if (entry.type != REG_SZ && entry.type != REG_EXPAND_SZ && cbData <= sizeof(entry.number))
+							{
+								// Value was replaced by value of different type in between queries
+								std::memcpy(&entry.number, data.c_str(), cbData);
+							}
+						}
+					}
+				}
+			}
+
+			static void AssignText(Entry& entry, const wchar_t* data, DWORD cbData)
+			{
+				const size_t cchData = cbData / sizeof(wchar_t);
+
+				auto terminator = std::wmemchr(data, L'\0', cchData);
+
+				entry.text.assign(data, (terminator != nullptr) ? static_cast<size_t>(terminator - data) : cchData);
+			}
+
+		private:
+			RegistryKey_ptr m_key;
+			ChangeNotifier_ptr m_notifier;
+			std::atomic<ULONGLONG> m_epoch;
+			std::atomic<bool> m_armed;
+			std::shared_mutex m_mutex;
+			std::unordered_map<std::wstring, Entry> m_values;
+		};
+	}
+}
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <Registry.hpp>
+#include <MemoryBackend.hpp>
+
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Source of change notifications for single registry key.
+		///		Notifier re-arms itself before reporting change, so change made while callback runs is reported again.
+		/// </summary>
+		class ChangeNotifier
+		{
+		public:
+			/// <summary>
+			///		Callback invoked after change was applied.
+			///		Argument is false when notifier could not re-arm itself and no further changes will be reported.
+			/// </summary>
+			typedef std::function<void(bool)> Callback;
+
+			virtual ~ChangeNotifier() = default;
+
+			/// <summary>
+			///		Arms notifier. Every change made after this method returns is reported via callback.
+			/// </summary>
+			virtual void Start(const Callback& callback) = 0;
+
+			/// <summary>
+			///		Disarms notifier. Once this method returns, callback is not running and will not be invoked anymore.
+			/// </summary>
+			virtual void Stop() = 0;
+		};
+
+		typedef std::unique_ptr<ChangeNotifier> ChangeNotifier_ptr;
+
+#if defined(_WIN32)
+		/// <summary>
+		///		Notifier built on RegistryKey::NotifyAsync(). Event is waited for on thread pool,
+		///		notification is re-armed from wait callback.
+		/// </summary>
+		class EventChangeNotifier final : public ChangeNotifier
+		{
+		public:
+			EventChangeNotifier(const RegistryKey_ptr& key, bool watchSubtree, NotifyFilter notifyFilter)
+				: m_key(key)
+				, m_watchSubtree(watchSubtree)
+				// Wait callbacks run on thread pool threads, which may exit while notification is still pending
+				, m_notifyFilter(notifyFilter | NotifyFilter::ThreadAgnostic)
+				, m_hEvent(nullptr)
+				, m_hWait(nullptr)
+			{
+				if (m_key == nullptr)
+				{
+					throw std::invalid_argument("Registry key cannot be nullptr");
+				}
+			}
+
+			// Disable copy ctor & copy assignment operator
+			EventChangeNotifier(const EventChangeNotifier& other) = delete;
+			EventChangeNotifier& operator=(const EventChangeNotifier& other) = delete;
+
+			~EventChangeNotifier()
+			{
+				Stop();
+			}
+
+			void Start(const Callback& callback) override
+			{
+				if (m_hEvent != nullptr)
+				{
+					throw std::logic_error("Notifier is already started");
+				}
+
+				m_callback = callback;
+
+				m_hEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+				if (m_hEvent == nullptr)
+				{
+					auto ec = std::error_code(GetLastError(), std::system_category());
+
+					throw std::system_error(ec, "CreateEvent() failed");
+				}
+
+				try
+				{
+					m_key->NotifyAsync(m_hEvent, m_watchSubtree, m_notifyFilter);
+				}
+				catch (const std::exception&)
+				{
+					CloseHandle(m_hEvent);
+					m_hEvent = nullptr;
+
+					throw;
+				}
+
+				if (!RegisterWaitForSingleObject(&m_hWait, m_hEvent, &EventChangeNotifier::OnEvent, this, INFINITE, WT_EXECUTEDEFAULT))
+				{
+					auto ec = std::error_code(GetLastError(), std::system_category());
+
+					CloseHandle(m_hEvent);
+					m_hEvent = nullptr;
+
+					throw std::system_error(ec, "RegisterWaitForSingleObject() failed");
+				}
+			}
+
+			void Stop() override
+			{
+				if (m_hWait != nullptr)
+				{
+					// Blocks until running callbacks finish
+					UnregisterWaitEx(m_hWait, INVALID_HANDLE_VALUE);
+					m_hWait = nullptr;
+				}
+
+				if (m_hEvent != nullptr)
+				{
+					CloseHandle(m_hEvent);
+					m_hEvent = nullptr;
+				}
+			}
+
+		private:
+			static VOID CALLBACK OnEvent(PVOID lpParameter, BOOLEAN timerOrWaitFired)
+			{
+				static_cast<void>(timerOrWaitFired);
+
+				auto self = reinterpret_cast<EventChangeNotifier*>(lpParameter);
+
+				auto rearmed = true;
+
+				try
+				{
+					self->m_key->NotifyAsync(self->m_hEvent, self->m_watchSubtree, self->m_notifyFilter);
+				}
+				catch (const std::exception&)
+				{
+					rearmed = false;
+				}
+
+				self->m_callback(rearmed);
+			}
+
+		private:
+			RegistryKey_ptr m_key;
+			bool m_watchSubtree;
+			NotifyFilter m_notifyFilter;
+			HANDLE m_hEvent;
+			HANDLE m_hWait;
+			Callback m_callback;
+		};
+#endif
+
+		/// <summary>
+		///		Notifier driven directly by MemoryBackend, callback runs on thread which made the change
+		/// </summary>
+		class MemoryChangeNotifier final : public ChangeNotifier
+		{
+		public:
+			MemoryChangeNotifier(const RegistryKey_ptr& key, bool watchSubtree, NotifyFilter notifyFilter)
+				: m_key(key)
+				, m_watchSubtree(watchSubtree)
+				, m_notifyFilter(notifyFilter)
+				, m_dwCookie(0)
+			{
+				if (m_key == nullptr)
+				{
+					throw std::invalid_argument("Registry key cannot be nullptr");
+				}
+
+				m_backend = std::dynamic_pointer_cast<MemoryBackend>(m_key->GetBackend());
+				if (m_backend == nullptr)
+				{
+					throw std::invalid_argument("Registry key is not stored in MemoryBackend");
+				}
+			}
+
+			// Disable copy ctor & copy assignment operator
+			MemoryChangeNotifier(const MemoryChangeNotifier& other) = delete;
+			MemoryChangeNotifier& operator=(const MemoryChangeNotifier& other) = delete;
+
+			~MemoryChangeNotifier()
+			{
+				Stop();
+			}
+
+			void Start(const Callback& callback) override
+			{
+				if (m_dwCookie != 0)
+				{
+					throw std::logic_error("Notifier is already started");
+				}
+
+				LSTATUS lStatus = m_backend->Subscribe
+				(
+					*m_key,
+					m_watchSubtree,
+					static_cast<DWORD>(m_notifyFilter),
+					[callback]() { callback(true); },
+					&m_dwCookie
+				);
+
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegNotifyChangeKeyValue() failed");
+				}
+			}
+
+			void Stop() override
+			{
+				if (m_dwCookie != 0)
+				{
+					m_backend->Unsubscribe(m_dwCookie);
+					m_dwCookie = 0;
+				}
+			}
+
+		private:
+			RegistryKey_ptr m_key;
+			std::shared_ptr<MemoryBackend> m_backend;
+			bool m_watchSubtree;
+			NotifyFilter m_notifyFilter;
+			DWORD m_dwCookie;
+		};
+
+		/// <summary>
+		///		Creates notifier suitable for backend registry key is stored in
+		/// </summary>
+		inline ChangeNotifier_ptr CreateChangeNotifier(const RegistryKey_ptr& key, bool watchSubtree = false, NotifyFilter notifyFilter = NotifyFilter::ChangeLastSet)
+		{
+			if (key == nullptr)
+			{
+				throw std::invalid_argument("Registry key cannot be nullptr");
+			}
+
+#if defined(_WIN32)
+			if (std::dynamic_pointer_cast<MemoryBackend>(key->GetBackend()) == nullptr)
+			{
+				return ChangeNotifier_ptr(new EventChangeNotifier(key, watchSubtree, notifyFilter));
+			}
+#endif
+
+			return ChangeNotifier_ptr(new MemoryChangeNotifier(key, watchSubtree, notifyFilter));
+		}
+	}
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <Registry.hpp>
+#include <ChangeNotifier.hpp>
+#include <Executor.hpp>
+
+#include <coroutine>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Awaitable watch of registry key changes. Coroutine awaiting Changed() is suspended without blocking
+		///		any thread and is resumed on executor once change is reported, so any number of keys can be watched
+		///		by coroutines sharing few executor threads.
+		/// </summary>
+		/// <remarks>
+		///		Watch is armed when constructed and stays armed, so change made while coroutine is not awaiting
+		///		is not missed, next co_await completes immediately instead. Multiple changes reported before
+		///		coroutine resumes are reported as single one.
+		/// </remarks>
+		/// <example>
+		///		for (;;)
+		///		{
+		///			bool changed = co_await watch.Changed();
+		///			if (!changed)
+		///			{
+		///				break;
+		///			}
+		///
+		///			Reload();
+		///		}
+		/// </example>
+		class ChangeWatch
+		{
+		private:
+			struct State
+			{
+				std::mutex mutex;
+				// Number of changes reported and not awaited yet
+				size_t pending = 0;
+				bool stopped = false;
+				std::coroutine_handle<> waiter;
+				Executor_ptr executor;
+			};
+
+			typedef std::shared_ptr<State> State_ptr;
+
+		public:
+			/// <summary>
+			///		Awaiter returned by Changed(). Result of co_await is true when change was reported,
+			///		false when watch was stopped and no further changes will be reported.
+			/// </summary>
+			/// <remarks>
+			///		Awaiter is destroyed together with frame of coroutine suspended on it, so destroyed coroutine
+			///		is not resumed by changes reported later. Coroutine must not be destroyed once its resumption was posted.
+			/// </remarks>
+			class Awaiter
+			{
+			public:
+				explicit Awaiter(const State_ptr& state)
+					: m_state(state)
+				{
+				}
+
+				Awaiter(Awaiter&& other) noexcept
+					: m_state(std::move(other.m_state))
+					, m_handle(std::exchange(other.m_handle, std::coroutine_handle<>()))
+				{
+				}
+
+				// Disable copy ctor & copy assignment operator
+				Awaiter(const Awaiter& other) = delete;
+				Awaiter& operator=(const Awaiter& other) = delete;
+
+				~Awaiter()
+				{
+					if (m_state == nullptr || !m_handle)
+					{
+						return;
+					}
+
+					std::lock_guard<std::mutex> lock(m_state->mutex);
+
+					// Resumption of coroutine was not posted yet, coroutine is being destroyed while suspended
+					if (m_state->waiter == m_handle)
+					{
+						m_state->waiter = std::coroutine_handle<>();
+					}
+				}
+
+				bool await_ready() const
+				{
+					std::lock_guard<std::mutex> lock(m_state->mutex);
+
+					return m_state->pending != 0 || m_state->stopped;
+				}
+
+				bool await_suspend(std::coroutine_handle<> handle)
+				{
+					std::lock_guard<std::mutex> lock(m_state->mutex);
+
+					// Change could be reported since await_ready() was called
+					if (m_state->pending != 0 || m_state->stopped)
+					{
+						return false;
+					}
+
+					if (m_state->waiter)
+					{
+						throw std::logic_error("Watch is already awaited by other coroutine");
+					}
+
+					m_state->waiter = handle;
+					m_handle = handle;
+
+					return true;
+				}
+
+				bool await_resume()
+				{
+					std::lock_guard<std::mutex> lock(m_state->mutex);
+
+					m_handle = std::coroutine_handle<>();
+
+					if (m_state->pending == 0)
+					{
+						return false;
+					}
+
+					m_state->pending = 0;
+
+					return true;
+				}
+
+			private:
+				// Shared, so resumed coroutine can read result even when watch was destroyed in between
+				State_ptr m_state;
+				// Coroutine suspended on this awaiter
+				std::coroutine_handle<> m_handle;
+			};
+
+			/// <summary>
+			///		Watches key using change notifier matching key backend.
+			///		Key must be opened with DesiredAccess::Notify rights.
+			/// </summary>
+			ChangeWatch(const RegistryKey_ptr& key, bool watchSubtree = false, NotifyFilter notifyFilter = NotifyFilter::ChangeName | NotifyFilter::ChangeLastSet, const Executor_ptr& executor = DefaultExecutor())
+				: ChangeWatch(CreateChangeNotifier(key, watchSubtree, notifyFilter), executor)
+			{
+			}
+
+			ChangeWatch(ChangeNotifier_ptr notifier, const Executor_ptr& executor = DefaultExecutor())
+				: m_notifier(std::move(notifier))
+				, m_state(std::make_shared<State>())
+			{
+				if (m_notifier == nullptr)
+				{
+					throw std::invalid_argument("Change notifier cannot be nullptr");
+				}
+
+				if (executor == nullptr)
+				{
+					throw std::invalid_argument("Executor cannot be nullptr");
+				}
+
+				m_state->executor = executor;
+
+				auto state = m_state;
+
+				m_notifier->Start([state](bool rearmed)
+				{
+					std::unique_lock<std::mutex> lock(state->mutex);
+
+					if (rearmed)
+					{
+						++state->pending;
+					}
+					else
+					{
+						state->stopped = true;
+					}
+
+					Resume(state, lock);
+				});
+			}
+
+			// Disable copy ctor & copy assignment operator
+			ChangeWatch(const ChangeWatch& other) = delete;
+			ChangeWatch& operator=(const ChangeWatch& other) = delete;
+
+			~ChangeWatch()
+			{
+				Stop();
+			}
+
+			/// <summary>
+			///		Returns awaiter completing once change is reported. Only one coroutine can await watch at a time.
+			/// </summary>
+			Awaiter Changed() const
+			{
+				return Awaiter(m_state);
+			}
+
+			/// <summary>
+			///		Stops watching, awaiting coroutine is resumed with false result
+			/// </summary>
+			void Stop()
+			{
+				m_notifier->Stop();
+
+				std::unique_lock<std::mutex> lock(m_state->mutex);
+
+				if (!m_state->stopped)
+				{
+					m_state->stopped = true;
+
+					Resume(m_state, lock);
+				}
+			}
+
+		private:
+			/// <summary>
+			///		Posts resumption of awaiting coroutine to executor, never resumes it inline,
+			///		as notifier callbacks run on threads which must not be blocked
+			/// </summary>
+			static void Resume(const State_ptr& state, std::unique_lock<std::mutex>& lock)
+			{
+				auto waiter = std::exchange(state->waiter, std::coroutine_handle<>());
+				auto executor = state->executor;
+
+				lock.unlock();
+
+				if (waiter)
+				{
+					executor->Post([waiter]() { waiter.resume(); });
+				}
+			}
+
+		private:
+			ChangeNotifier_ptr m_notifier;
+			State_ptr m_state;
+		};
+
+		/// <summary>
+		///		Awaitable single change of registry key, returned by Changed()
+		/// </summary>
+		class ChangeAwaitable
+		{
+		public:
+			explicit ChangeAwaitable(std::unique_ptr<ChangeWatch> watch)
+				: m_watch(std::move(watch))
+				, m_awaiter(m_watch->Changed())
+			{
+			}
+
+			bool await_ready() const
+			{
+				return m_awaiter.await_ready();
+			}
+
+			bool await_suspend(std::coroutine_handle<> handle)
+			{
+				return m_awaiter.await_suspend(handle);
+			}
+
+			bool await_resume()
+			{
+				return m_awaiter.await_resume();
+			}
+
+		private:
+			std::unique_ptr<ChangeWatch> m_watch;
+			// Declared after watch, so it is destroyed first and forgets destroyed coroutine before stopped watch resumes it
+			ChangeWatch::Awaiter m_awaiter;
+		};
+
+		/// <summary>
+		///		Waits for single change of registry key without blocking thread, e.g. co_await Changed(key).
+		///		Key is watched since this function is called, to watch key repeatedly use ChangeWatch.
+		/// </summary>
+		inline ChangeAwaitable Changed(const RegistryKey_ptr& key, bool watchSubtree = false, NotifyFilter notifyFilter = NotifyFilter::ChangeName | NotifyFilter::ChangeLastSet, const Executor_ptr& executor = DefaultExecutor())
+		{
+			return ChangeAwaitable(std::make_unique<ChangeWatch>(key, watchSubtree, notifyFilter, executor));
+		}
+	}
+}
@@ -0,0 +1,434 @@
+#pragma once
+
+#include <Registry.hpp>
+#include <WriteBatch.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <tuple>
+#include <array>
+#include <type_traits>
+#include <utility>
+#include <stdexcept>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Maps type of struct member to registry value. Supported are bool, signed and unsigned integers
+		///		and std::wstring, other types including character types are rejected at compile time.
+		/// </summary>
+		template <typename T, typename = void>
+		struct FieldTraits
+		{
+			static_assert(!std::is_same_v<T, T>, "Unsupported type of schema field, use bool, integer or std::wstring");
+		};
+
+		template <>
+		struct FieldTraits<bool>
+		{
+			typedef bool Default;
+
+			static bool Read(const RegistryValues& values, size_t index)
+			{
+				return values.GetBoolean(index);
+			}
+
+			static void Write(WriteBatch& batch, std::wstring_view path, std::wstring_view name, bool value)
+			{
+				batch.SetBoolean(path, name, value);
+			}
+
+			static bool FromDefault(bool value)
+			{
+				return value;
+			}
+		};
+
+		/// <summary>
+		///		Stores integer as REG_DWORD or REG_QWORD, chosen for each type explicitly rather than by its size,
+		///		so struct is stored in same registry types on all platforms
+		/// </summary>
+		template <typename T, DWORD dwType>
+		struct IntegerFieldTraits
+		{
+			static_assert(dwType == REG_DWORD || dwType == REG_QWORD, "Integers are stored as REG_DWORD or REG_QWORD");
+
+			typedef T Default;
+
+			static T Read(const RegistryValues& values, size_t index)
+			{
+				if constexpr (dwType == REG_DWORD)
+				{
+					if constexpr (std::is_signed_v<T>)
+					{
+						return static_cast<T>(values.GetInt32(index));
+					}
+					else
+					{
+						return static_cast<T>(values.GetUInt32(index));
+					}
+				}
+				else
+				{
+					if constexpr (std::is_signed_v<T>)
+					{
+						return static_cast<T>(values.GetInt64(index));
+					}
+					else
+					{
+						return static_cast<T>(values.GetUInt64(index));
+					}
+				}
+			}
+
+			static void Write(WriteBatch& batch, std::wstring_view path, std::wstring_view name, T value)
+			{
+				if constexpr (dwType == REG_DWORD)
+				{
+					if constexpr (std::is_signed_v<T>)
+					{
+						if (!std::in_range<LONG>(value))
+						{
+							throw std::out_of_range("Value does not fit into REG_DWORD");
+						}
+
+						batch.SetInt32(path, name, static_cast<LONG>(value));
+					}
+					else
+					{
+						if (!std::in_range<DWORD>(value))
+						{
+							throw std::out_of_range("Value does not fit into REG_DWORD");
+						}
+
+						batch.SetUInt32(path, name, static_cast<DWORD>(value));
+					}
+				}
+				else
+				{
+					if constexpr (std::is_signed_v<T>)
+					{
+						batch.SetInt64(path, name, static_cast<long long>(value));
+					}
+					else
+					{
+						batch.SetUInt64(path, name, static_cast<unsigned long long>(value));
+					}
+				}
+			}
+
+			static T FromDefault(T value)
+			{
+				return value;
+			}
+		};
+
+		template <> struct FieldTraits<signed char> : IntegerFieldTraits<signed char, REG_DWORD> {};
+		template <> struct FieldTraits<unsigned char> : IntegerFieldTraits<unsigned char, REG_DWORD> {};
+		template <> struct FieldTraits<short> : IntegerFieldTraits<short, REG_DWORD> {};
+		template <> struct FieldTraits<unsigned short> : IntegerFieldTraits<unsigned short, REG_DWORD> {};
+		template <> struct FieldTraits<int> : IntegerFieldTraits<int, REG_DWORD> {};
+		template <> struct FieldTraits<unsigned int> : IntegerFieldTraits<unsigned int, REG_DWORD> {};
+
+		/// <summary>
+		///		long is 32 bits on Windows, where LONG and DWORD are defined by it, so it is REG_DWORD everywhere.
+		///		Where long is 64 bits, storing value not fitting into 32 bits throws std::out_of_range.
+		/// </summary>
+		template <> struct FieldTraits<long> : IntegerFieldTraits<long, REG_DWORD> {};
+		template <> struct FieldTraits<unsigned long> : IntegerFieldTraits<unsigned long, REG_DWORD> {};
+
+		template <> struct FieldTraits<long long> : IntegerFieldTraits<long long, REG_QWORD> {};
+		template <> struct FieldTraits<unsigned long long> : IntegerFieldTraits<unsigned long long, REG_QWORD> {};
+
+		template <>
+		struct FieldTraits<std::wstring>
+		{
+			// Literal, so schema with string defaults can be constexpr
+			typedef const wchar_t* Default;
+
+			static std::wstring Read(const RegistryValues& values, size_t index)
+			{
+				return values.GetString(index);
+			}
+
+			static void Write(WriteBatch& batch, std::wstring_view path, std::wstring_view name, const std::wstring& value)
+			{
+				batch.SetString(path, name, value);
+			}
+
+			static std::wstring FromDefault(const wchar_t* value)
+			{
+				return (value != nullptr) ? value : L"";
+			}
+		};
+
+		/// <summary>
+		///		Binds registry value to member of struct, created by Field()
+		/// </summary>
+		template <typename __Class, typename __Member>
+		struct SchemaField
+		{
+			typedef __Class Class;
+			typedef __Member Member;
+			typedef FieldTraits<__Member> Traits;
+
+			const wchar_t* name;
+			__Member __Class::* member;
+			typename Traits::Default defaultValue;
+		};
+
+		/// <summary>
+		///		Declares value of schema. Member is set to default value when value does not exist.
+		/// </summary>
+		template <typename __Class, typename __Member>
+		constexpr SchemaField<__Class, __Member> Field(const wchar_t* name, __Member __Class::* member, typename FieldTraits<__Member>::Default defaultValue = {})
+		{
+			return SchemaField<__Class, __Member>{ name, member, defaultValue };
+		}
+
+		/// <summary>
+		///		Describes how struct is stored in registry, as values of single key. Schema is built at compile time,
+		///		so reading struct involves no name lookups and types of values are checked by compiler.
+		/// </summary>
+		/// <example>
+		///		template <>
+		///		struct Registry::ConfigSchema<Settings>
+		///		{
+		///			static constexpr auto schema = Registry::Schema
+		///			(
+		///				L"SOFTWARE\\Company\\Product",
+		///				Registry::Field(L"Timeout", &Settings::timeout, 30),
+		///				Registry::Field(L"Server", &Settings::server, L"localhost")
+		///			);
+		///		};
+		/// </example>
+		template <typename... __Fields>
+		class Schema
+		{
+		public:
+			static_assert(sizeof...(__Fields) > 0, "Schema must have at least one field");
+
+			typedef typename std::tuple_element_t<0, std::tuple<__Fields...>>::Class Class;
+
+			static_assert((std::is_same_v<typename __Fields::Class, Class> && ...), "All fields of schema must be members of same struct");
+
+			/// <param name="path">Path of key relative to key struct is loaded from, empty for that key itself</param>
+			constexpr Schema(const wchar_t* path, __Fields... fields)
+				: m_path(path)
+				, m_fields(fields...)
+			{
+			}
+
+			constexpr const wchar_t* GetPath() const
+			{
+				return m_path;
+			}
+
+			static constexpr size_t Size()
+			{
+				return sizeof...(__Fields);
+			}
+
+			/// <summary>
+			///		Whether value names are non empty and unique, compared case insensitively as registry does
+			/// </summary>
+			constexpr bool IsValid() const
+			{
+				if (m_path == nullptr)
+				{
+					return false;
+				}
+
+				const auto names = std::apply([](const auto&... field)
+				{
+					return std::array<const wchar_t*, sizeof...(__Fields)>{ field.name... };
+				}, m_fields);
+
+				for (size_t i = 0; i < Size(); ++i)
+				{
+					if (names[i] == nullptr || names[i][0] == L'\0')
+					{
+						return false;
+					}
+
+					for (size_t j = 0; j < i; ++j)
+					{
+						if (Equals(names[i], names[j]))
+						{
+							return false;
+						}
+					}
+				}
+
+				return true;
+			}
+
+			constexpr std::array<std::wstring_view, sizeof...(__Fields)> GetNames() const
+			{
+				return std::apply([](const auto&... field)
+				{
+					return std::array<std::wstring_view, sizeof...(__Fields)>{ std::wstring_view(field.name)... };
+				}, m_fields);
+			}
+
+			void SetDefaults(Class& value) const
+			{
+				std::apply([&value](const auto&... field)
+				{
+					((value.*field.member = std::decay_t<decltype(field)>::Traits::FromDefault(field.defaultValue)), ...);
+				}, m_fields);
+			}
+
+			/// <summary>
+			///		Reads members from values in same order as GetNames(), missing values are set to their defaults
+			/// </summary>
+			void Read(const RegistryValues& values, Class& value) const
+			{
+				size_t index = 0;
+
+				std::apply([&values, &value, &index](const auto&... field)
+				{
+					(ReadField(values, index++, field, value), ...);
+				}, m_fields);
+			}
+
+			void Write(WriteBatch& batch, const Class& value) const
+			{
+				const std::wstring_view path(m_path);
+
+				std::apply([&batch, &value, &path](const auto&... field)
+				{
+					(std::decay_t<decltype(field)>::Traits::Write(batch, path, field.name, value.*field.member), ...);
+				}, m_fields);
+			}
+
+		private:
+			template <typename __Field>
+			static void ReadField(const RegistryValues& values, size_t index, const __Field& field, Class& value)
+			{
+				if (values.GetStatus(index) == ERROR_FILE_NOT_FOUND)
+				{
+					value.*field.member = __Field::Traits::FromDefault(field.defaultValue);
+				}
+				else
+				{
+					// Throws when value could not be read or has wrong type
+					value.*field.member = __Field::Traits::Read(values, index);
+				}
+			}
+
+			static constexpr bool Equals(const wchar_t* a, const wchar_t* b)
+			{
+				for (; *a != L'\0' && *b != L'\0'; ++a, ++b)
+				{
+					if (Upcase(*a) != Upcase(*b))
+					{
+						return false;
+					}
+				}
+
+				return *a == *b;
+			}
+
+			static constexpr wchar_t Upcase(wchar_t ch)
+			{
+				return (ch >= L'a' && ch <= L'z') ? static_cast<wchar_t>(ch - (L'a' - L'A')) : ch;
+			}
+
+		private:
+			const wchar_t* m_path;
+			std::tuple<__Fields...> m_fields;
+		};
+
+		/// <summary>
+		///		Specialize with static constexpr member named schema to enable Load() and Store() of struct
+		/// </summary>
+		template <typename T>
+		struct ConfigSchema;
+
+		/// <summary>
+		///		Reads struct from subkey of specified key by single query of all its values.
+		///		When subkey or any of values does not exist, default values are used.
+		/// </summary>
+		template <typename T>
+		void Load(const RegistryKey_ptr& key, T& value)
+		{
+			constexpr const auto& schema = ConfigSchema<T>::schema;
+
+			static_assert(std::is_same_v<typename std::decay_t<decltype(schema)>::Class, T>, "Schema describes different struct");
+			static_assert(schema.IsValid(), "Value names of schema must be non empty and unique");
+
+			if (key == nullptr)
+			{
+				throw std::invalid_argument("Registry key cannot be nullptr");
+			}
+
+			RegistryKey_ptr source = key;
+
+			if (schema.GetPath()[0] != L'\0')
+			{
+				std::error_code ec;
+
+				source = key->TryOpen(schema.GetPath(), DesiredAccess::Read, ec);
+				if (source == nullptr)
+				{
+					if (ec.value() == ERROR_FILE_NOT_FOUND)
+					{
+						schema.SetDefaults(value);
+
+						return;
+					}
+
+					throw std::system_error(ec, "RegOpenKeyEx() failed");
+				}
+			}
+
+			// Names are views of literals of schema, computed at compile time
+			static constexpr auto names = schema.GetNames();
+
+			// Reused by subsequent loads on same thread, so buffer is not allocated again
+			thread_local RegistryValues values;
+
+			source->GetValues(names, values);
+
+			schema.Read(values, value);
+		}
+
+		template <typename T>
+		T Load(const RegistryKey_ptr& key)
+		{
+			T value{};
+
+			Load(key, value);
+
+			return value;
+		}
+
+		/// <summary>
+		///		Writes all members of struct atomically, creating subkey when it does not exist
+		/// </summary>
+		template <typename T>
+		void Store(const RegistryKey_ptr& key, const T& value)
+		{
+			constexpr const auto& schema = ConfigSchema<T>::schema;
+
+			static_assert(std::is_same_v<typename std::decay_t<decltype(schema)>::Class, T>, "Schema describes different struct");
+			static_assert(schema.IsValid(), "Value names of schema must be non empty and unique");
+
+			thread_local WriteBatch batch;
+
+			batch.Clear();
+
+			if (schema.GetPath()[0] != L'\0')
+			{
+				batch.CreateKey(schema.GetPath());
+			}
+
+			schema.Write(batch, value);
+			batch.Commit(key);
+		}
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Runs tasks asynchronously, e.g. resumes coroutines waiting for registry changes
+		/// </summary>
+		class Executor
+		{
+		public:
+			typedef std::function<void()> Task;
+
+			virtual ~Executor() = default;
+
+			/// <summary>
+			///		Queues task to be run later on executor thread. Must not block and must not run task inline.
+			///		Tasks may run concurrently and complete in any order, so callers which need ordering must not
+			///		post next task before previous one finished.
+			/// </summary>
+			virtual void Post(Task task) = 0;
+		};
+
+		typedef std::shared_ptr<Executor> Executor_ptr;
+
+		/// <summary>
+		///		Executor running tasks on fixed number of threads. Tasks are started in order they were posted,
+		///		but with more than one thread they run concurrently, so they are not guaranteed to complete in that order.
+		/// </summary>
+		class ThreadPoolExecutor final : public Executor
+		{
+		public:
+			/// <param name="threads">Number of threads, zero uses one thread per core</param>
+			explicit ThreadPoolExecutor(size_t threads = 0)
+				: m_stopped(false)
+			{
+				if (threads == 0)
+				{
+					threads = std::thread::hardware_concurrency();
+				}
+
+				if (threads == 0)
+				{
+					// Number of cores is not known
+					threads = 1;
+				}
+
+				for (size_t i = 0; i < threads; ++i)
+				{
+					m_threads.emplace_back(&ThreadPoolExecutor::Run, this);
+				}
+			}
+
+			// Disable copy ctor & copy assignment operator
+			ThreadPoolExecutor(const ThreadPoolExecutor& other) = delete;
+			ThreadPoolExecutor& operator=(const ThreadPoolExecutor& other) = delete;
+
+			/// <summary>
+			///		Runs all tasks posted so far and joins threads
+			/// </summary>
+			~ThreadPoolExecutor()
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+
+					m_stopped = true;
+				}
+
+				m_wakeup.notify_all();
+
+				for (auto& thread : m_threads)
+				{
+					thread.join();
+				}
+			}
+
+			void Post(Task task) override
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+
+					m_tasks.push_back(std::move(task));
+				}
+
+				m_wakeup.notify_one();
+			}
+
+		private:
+			void Run()
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+
+				for (;;)
+				{
+					m_wakeup.wait(lock, [this]()
+					{
+						return !m_tasks.empty() || m_stopped;
+					});
+
+					if (m_tasks.empty())
+					{
+						break;
+					}
+
+					auto task = std::move(m_tasks.front());
+					m_tasks.pop_front();
+
+					lock.unlock();
+
+					task();
+
+					lock.lock();
+				}
+			}
+
+		private:
+			std::vector<std::thread> m_threads;
+			std::deque<Task> m_tasks;
+			std::mutex m_mutex;
+			std::condition_variable m_wakeup;
+			bool m_stopped;
+		};
+
+		/// <summary>
+		///		Process wide executor shared by all users which do not provide their own
+		/// </summary>
+		inline Executor_ptr DefaultExecutor()
+		{
+			static Executor_ptr executor = std::make_shared<ThreadPoolExecutor>();
+
+			return executor;
+		}
+	}
+}
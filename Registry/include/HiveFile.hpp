@@ -0,0 +1,1388 @@
+#pragma once
+
+#include <RegistryPlatform.hpp>
+#include <MappedFile.hpp>
+
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <stdexcept>
+#include <system_error>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		class HiveFile;
+
+		/// <summary>
+		///		Space usage and locality of hive file, as reported by HiveFile::GetStatistics()
+		/// </summary>
+		struct HiveStatistics
+		{
+			ULONGLONG fileSize = 0;
+			// Bytes in free cells, including unused tails of hive bins
+			ULONGLONG freeBytes = 0;
+			// Bytes in allocated cells, which are not referenced from any key reachable from root
+			ULONGLONG unusedBytes = 0;
+			ULONGLONG keys = 0;
+			ULONGLONG values = 0;
+			// Average number of distinct 4 KB pages of file touched when key is opened by its path
+			// from root and all its values are read
+			double pagesPerLookup = 0.0;
+		};
+
+		/// <summary>
+		///		Read-only view of registry key stored within memory mapped hive file.
+		///		View is just pointer to hive and offset of key cell, so it is cheap to copy,
+		///		but it is valid only as long as HiveFile it was obtained from exists.
+		/// </summary>
+		class HiveKey
+		{
+		public:
+			/// <summary>
+			///		Opens subkey on specified path relative to this key
+			/// </summary>
+			/// <param name="path">Relative path to subkey of this key</param>
+			HiveKey Open(const std::wstring& path) const;
+
+			/// <summary>
+			///		Checks whether specified subkey exists or not
+			/// </summary>
+			/// <param name="path">Subkey relative path to be checked for existence</param>
+			bool HasKey(const std::wstring& path) const;
+
+			// For backward compatibility only
+			bool Exists(const std::wstring& path) const
+			{
+				return HasKey(path);
+			}
+
+			bool HasValue(const std::wstring& name) const;
+
+			bool GetBoolean(const std::wstring& name) const;
+
+			bool GetBoolean() const
+			{
+				return GetBoolean(L"");
+			}
+
+			LONG GetInt32(const std::wstring& name) const;
+
+			LONG GetInt32() const
+			{
+				return GetInt32(L"");
+			}
+
+			DWORD GetUInt32(const std::wstring& name) const
+			{
+				return static_cast<DWORD>(GetInt32(name));
+			}
+
+			DWORD GetUInt32() const
+			{
+				return GetUInt32(L"");
+			}
+
+			long long GetInt64(const std::wstring& name) const;
+
+			long long GetInt64() const
+			{
+				return GetInt64(L"");
+			}
+
+			unsigned long long GetUInt64(const std::wstring& name) const
+			{
+				return static_cast<unsigned long long>(GetInt64(name));
+			}
+
+			unsigned long long GetUInt64() const
+			{
+				return GetUInt64(L"");
+			}
+
+			std::wstring GetString(const std::wstring& name) const;
+
+			std::wstring GetString() const
+			{
+				return GetString(L"");
+			}
+
+			/// <summary>
+			///		Name of this key as stored in hive
+			/// </summary>
+			std::wstring GetName() const;
+
+			/// <summary>
+			///		Number of direct subkeys of this key
+			/// </summary>
+			DWORD GetSubKeyCount() const;
+
+			/// <summary>
+			///		Number of values of this key
+			/// </summary>
+			DWORD GetValueCount() const;
+
+			/// <summary>
+			///		Time this key or any of its values was last modified, as stored in hive
+			/// </summary>
+			FILETIME GetLastWriteTime() const;
+
+			/// <summary>
+			///		Self-relative security descriptor of this key, empty when key has none.
+			///		Data points directly into mapped hive.
+			/// </summary>
+			std::span<const BYTE> GetSecurityDescriptor() const;
+
+			/// <summary>
+			///		Class name of key, empty if key has none. Some system keys keep data in class names,
+			///		e.g. parts of boot key are stored in class names of SYSTEM\...\Lsa subkeys.
+			/// </summary>
+			std::wstring GetClass() const;
+
+			/// <summary>
+			///		Enumerates direct subkeys of this key. Callback receives subkey name
+			///		and returns true to continue enumeration, false otherwise.
+			/// </summary>
+			template <typename __Function>
+			void EnumerateSubKeys(const __Function& callback) const;
+
+			/// <summary>
+			///		Enumerates values of this key, same as RegistryKey::EnumerateValues().
+			///		Data is passed as stored in hive, so string data is UTF-16LE encoded.
+			/// </summary>
+			template <typename __Function>
+			void EnumerateValues(const __Function& callback) const;
+
+		private:
+			friend class HiveFile;
+
+			HiveKey(const HiveFile* hive, DWORD cell)
+				: m_hive(hive)
+				, m_cell(cell)
+			{
+			}
+
+		private:
+			const HiveFile* m_hive;
+			DWORD m_cell;
+		};
+
+		/// <summary>
+		///		Read-only access to offline registry hive file (regf format, as written by RegSaveKey()).
+		///		Hive is memory mapped and all lookups are done directly over mapped cells,
+		///		so no per key heap allocations are made.
+		/// </summary>
+		class HiveFile
+		{
+		public:
+			/// <summary>
+			///		Maps specified hive file into memory
+			/// </summary>
+			/// <param name="file">Path to hive file</param>
+			explicit HiveFile(const std::wstring& file)
+				: m_file(file)
+				, m_bins(nullptr)
+				, m_binsSize(0)
+				, m_minorVersion(0)
+				, m_rootCell(NilCell)
+			{
+				const BYTE* data = m_file.Data();
+				const size_t size = m_file.Size();
+
+				if (size < BaseBlockSize || std::memcmp(data, "regf", 4) != 0)
+				{
+					ThrowCorrupted("File is not registry hive");
+				}
+
+				if (Read<DWORD>(data + 20) != 1)
+				{
+					ThrowCorrupted("Unsupported hive major version");
+				}
+
+				m_minorVersion = Read<DWORD>(data + 24);
+				m_rootCell = Read<DWORD>(data + 36);
+
+				// Hive bins data size stored in base block, clamped to real file size
+				size_t binsSize = Read<DWORD>(data + 40);
+				if (binsSize > size - BaseBlockSize)
+				{
+					binsSize = size - BaseBlockSize;
+				}
+
+				m_bins = data + BaseBlockSize;
+				m_binsSize = binsSize;
+
+				DWORD cbCell = 0;
+				const BYTE* root = Cell(m_rootCell, &cbCell);
+				if (cbCell < NkNameOffset || std::memcmp(root, "nk", 2) != 0)
+				{
+					ThrowCorrupted("Hive root cell is not key node");
+				}
+			}
+
+			// Keys hold pointer to hive, so it can be neither copied nor moved
+			HiveFile(const HiveFile& other) = delete;
+			HiveFile& operator=(const HiveFile& other) = delete;
+
+			/// <summary>
+			///		Root key of hive
+			/// </summary>
+			HiveKey Root() const
+			{
+				return HiveKey(this, m_rootCell);
+			}
+
+			HiveKey Open(const std::wstring& path) const
+			{
+				return Root().Open(path);
+			}
+
+			bool HasKey(const std::wstring& path) const
+			{
+				return Root().HasKey(path);
+			}
+
+			bool Exists(const std::wstring& path) const
+			{
+				return Root().HasKey(path);
+			}
+
+			/// <summary>
+			///		Walks all hive bins and all keys reachable from root, measuring how much of file
+			///		is wasted and how many pages lookups touch
+			/// </summary>
+			HiveStatistics GetStatistics() const
+			{
+				HiveStatistics statistics;
+				statistics.fileSize = m_file.Size();
+
+				ULONGLONG allocatedBytes = 0;
+				size_t binOffset = 0;
+
+				while (m_binsSize - binOffset >= BinHeaderSize)
+				{
+					const BYTE* bin = m_bins + binOffset;
+					const DWORD cbBin = Read<DWORD>(bin + 8);
+
+					if (std::memcmp(bin, "hbin", 4) != 0 || cbBin < BinHeaderSize || (cbBin % PageSize) != 0 || cbBin > m_binsSize - binOffset)
+					{
+						ThrowCorrupted("Hive bin header is not valid");
+					}
+
+					for (DWORD offset = BinHeaderSize; offset < cbBin; )
+					{
+						// Allocated cells have negative size, free cells positive
+						const auto llSize = static_cast<LONGLONG>(Read<LONG>(bin + offset));
+						const auto cbCell = static_cast<DWORD>(llSize < 0 ? -llSize : llSize);
+
+						if (cbCell < 8 || (cbCell % 8) != 0 || cbCell > cbBin - offset)
+						{
+							ThrowCorrupted("Hive cell size is not valid");
+						}
+
+						if (llSize < 0)
+						{
+							allocatedBytes += cbCell;
+						}
+						else
+						{
+							statistics.freeBytes += cbCell;
+						}
+
+						offset += cbCell;
+					}
+
+					binOffset += cbBin;
+				}
+
+				Survey survey;
+				survey.reachable.resize(m_binsSize / 8);
+
+				SurveyKey(survey, m_rootCell, 0);
+
+				statistics.unusedBytes = (allocatedBytes > survey.reachableBytes) ? (allocatedBytes - survey.reachableBytes) : 0;
+				statistics.keys = survey.keys;
+				statistics.values = survey.values;
+				statistics.pagesPerLookup = static_cast<double>(survey.pages) / static_cast<double>(survey.keys);
+
+				return statistics;
+			}
+
+		private:
+			friend class HiveKey;
+
+			static constexpr size_t BaseBlockSize = 4096;
+			static constexpr DWORD NilCell = 0xFFFFFFFF;
+			static constexpr DWORD NkNameOffset = 76;
+			static constexpr DWORD VkNameOffset = 20;
+			static constexpr DWORD BigDataSegmentSize = 16344;
+			static constexpr WORD NkCompressedName = 0x0020;
+			static constexpr WORD VkCompressedName = 0x0001;
+			static constexpr DWORD DataInline = 0x80000000;
+			// Maximal nesting of index root (ri) lists, protects against cycles in corrupted hives
+			static constexpr int MaxIndexDepth = 8;
+			// Maximal depth of key tree, same as limit of registry on Windows
+			static constexpr int MaxKeyDepth = 512;
+			static constexpr DWORD BinHeaderSize = 32;
+			static constexpr DWORD PageSize = 4096;
+
+			template <typename T>
+			static T Read(const BYTE* p)
+			{
+				T value;
+				std::memcpy(&value, p, sizeof(value));
+
+				return value;
+			}
+
+			static void ThrowCorrupted(const char* what)
+			{
+				auto ec = std::error_code(ERROR_BADDB, std::system_category());
+
+				throw std::system_error(ec, what);
+			}
+
+			static DWORD Upcase(DWORD ch)
+			{
+				if (ch < 0x80)
+				{
+					return (ch >= 'a' && ch <= 'z') ? (ch - ('a' - 'A')) : ch;
+				}
+
+				return static_cast<DWORD>(std::towupper(static_cast<wint_t>(ch)));
+			}
+
+			/// <summary>
+			///		Returns pointer to data of allocated cell on specified offset, validating cell bounds
+			/// </summary>
+			const BYTE* Cell(DWORD offset, DWORD* pcbData) const
+			{
+				if (offset == NilCell || m_binsSize < 4 || offset > m_binsSize - 4)
+				{
+					ThrowCorrupted("Hive cell offset out of range");
+				}
+
+				// Allocated cells have negative size
+				auto lSize = Read<LONG>(m_bins + offset);
+				if (lSize >= -4)
+				{
+					ThrowCorrupted("Hive cell is not allocated");
+				}
+
+				auto cbCell = static_cast<DWORD>(-static_cast<LONGLONG>(lSize));
+				if (cbCell > m_binsSize - offset)
+				{
+					ThrowCorrupted("Hive cell exceeds hive bins");
+				}
+
+				*pcbData = cbCell - 4;
+
+				return m_bins + offset + 4;
+			}
+
+			const BYTE* KeyNode(DWORD offset) const
+			{
+				DWORD cbCell = 0;
+				const BYTE* nk = Cell(offset, &cbCell);
+
+				if (cbCell < NkNameOffset || std::memcmp(nk, "nk", 2) != 0 ||
+					static_cast<DWORD>(Read<WORD>(nk + 72)) > cbCell - NkNameOffset)
+				{
+					ThrowCorrupted("Hive cell is not key node");
+				}
+
+				return nk;
+			}
+
+			const BYTE* ValueNode(DWORD offset) const
+			{
+				DWORD cbCell = 0;
+				const BYTE* vk = Cell(offset, &cbCell);
+
+				if (cbCell < VkNameOffset || std::memcmp(vk, "vk", 2) != 0 ||
+					static_cast<DWORD>(Read<WORD>(vk + 2)) > cbCell - VkNameOffset)
+				{
+					ThrowCorrupted("Hive cell is not value node");
+				}
+
+				return vk;
+			}
+
+			/// <summary>
+			///		Compares name stored in hive (ASCII compressed or UTF-16LE) case insensitively with specified name
+			/// </summary>
+			static bool NameEquals(const BYTE* stored, size_t cbStored, bool compressed, const wchar_t* name, size_t len)
+			{
+				size_t pos = 0;
+
+				// Code units of specified name are converted to UTF-16 on the fly, since
+				// wchar_t is not 16 bit wide on every platform
+				DWORD pendingLow = 0;
+
+				auto next = [&](DWORD& unit) -> bool
+				{
+					if (pendingLow != 0)
+					{
+						unit = pendingLow;
+						pendingLow = 0;
+
+						return true;
+					}
+
+					if (pos == len)
+					{
+						return false;
+					}
+
+					auto cp = static_cast<DWORD>(name[pos++]);
+					if (cp > 0xFFFF)
+					{
+						cp -= 0x10000;
+						unit = 0xD800 + (cp >> 10);
+						pendingLow = 0xDC00 + (cp & 0x3FF);
+					}
+					else
+					{
+						unit = cp;
+					}
+
+					return true;
+				};
+
+				const size_t units = compressed ? cbStored : (cbStored / 2);
+
+				for (size_t i = 0; i < units; ++i)
+				{
+					DWORD a = compressed ? stored[i] : Read<WORD>(stored + i * 2);
+					DWORD b = 0;
+
+					if (!next(b))
+					{
+						return false;
+					}
+
+					if (a != b && Upcase(a) != Upcase(b))
+					{
+						return false;
+					}
+				}
+
+				DWORD rest = 0;
+
+				return !next(rest);
+			}
+
+			/// <summary>
+			///		Computes hash used by lh subkey lists, if name consists of ASCII characters only
+			/// </summary>
+			static bool NameHash(const wchar_t* name, size_t len, DWORD* pdwHash)
+			{
+				DWORD dwHash = 0;
+
+				for (size_t i = 0; i < len; ++i)
+				{
+					auto ch = static_cast<DWORD>(name[i]);
+					if (ch >= 0x80)
+					{
+						return false;
+					}
+
+					dwHash = dwHash * 37 + Upcase(ch);
+				}
+
+				*pdwHash = dwHash;
+
+				return true;
+			}
+
+			static void AppendName(std::wstring& out, const BYTE* stored, size_t cbStored, bool compressed)
+			{
+				if (compressed)
+				{
+					for (size_t i = 0; i < cbStored; ++i)
+					{
+						out += static_cast<wchar_t>(stored[i]);
+					}
+				}
+				else
+				{
+					wchar_t pending = 0;
+
+					AppendUtf16(out, stored, cbStored / 2, pending, false);
+				}
+			}
+
+			/// <summary>
+			///		Appends UTF-16LE code units to wide string, joining surrogate pairs where wchar_t is 32 bit wide.
+			///		Returns false when terminating null character was reached.
+			/// </summary>
+			static bool AppendUtf16(std::wstring& out, const BYTE* data, size_t units, wchar_t& pending, bool stopAtNull)
+			{
+				for (size_t i = 0; i < units; ++i)
+				{
+					auto unit = Read<WORD>(data + i * 2);
+
+					if (unit == 0 && stopAtNull)
+					{
+						return false;
+					}
+
+#if WCHAR_MAX > 0xFFFF
+					if (unit >= 0xD800 && unit <= 0xDBFF)
+					{
+						pending = static_cast<wchar_t>(unit);
+
+						continue;
+					}
+
+					if (unit >= 0xDC00 && unit <= 0xDFFF && pending != 0)
+					{
+						out += static_cast<wchar_t>(0x10000 + ((static_cast<DWORD>(pending) - 0xD800) << 10) + (unit - 0xDC00));
+						pending = 0;
+
+						continue;
+					}
+
+					pending = 0;
+#else
+					static_cast<void>(pending);
+#endif
+					out += static_cast<wchar_t>(unit);
+				}
+
+				return true;
+			}
+
+			/// <summary>
+			///		Walks subkey index (lf, lh, li and ri lists) invoking callback with key node offset and
+			///		name hash (when index provides one). Returns false when callback stopped the walk.
+			/// </summary>
+			template <typename __Function>
+			bool ForEachSubKeyCell(DWORD listOffset, const __Function& callback, int depth = 0) const
+			{
+				if (depth > MaxIndexDepth)
+				{
+					ThrowCorrupted("Hive subkey index nested too deep");
+				}
+
+				DWORD cbCell = 0;
+				const BYTE* list = Cell(listOffset, &cbCell);
+
+				if (cbCell < 4)
+				{
+					ThrowCorrupted("Hive subkey index too short");
+				}
+
+				const DWORD count = Read<WORD>(list + 2);
+				const bool hashed = (list[0] == 'l' && (list[1] == 'f' || list[1] == 'h'));
+				const DWORD entrySize = hashed ? 8 : 4;
+
+				if (count > (cbCell - 4) / entrySize)
+				{
+					ThrowCorrupted("Hive subkey index exceeds cell");
+				}
+
+				const BYTE* entry = list + 4;
+
+				if (list[0] == 'r' && list[1] == 'i')
+				{
+					for (DWORD i = 0; i < count; ++i, entry += entrySize)
+					{
+						if (!ForEachSubKeyCell(Read<DWORD>(entry), callback, depth + 1))
+						{
+							return false;
+						}
+					}
+				}
+				else if (hashed || (list[0] == 'l' && list[1] == 'i'))
+				{
+					// Only lh lists carry hash of name, lf lists carry name hint
+					const bool hasHash = (list[1] == 'h');
+
+					for (DWORD i = 0; i < count; ++i, entry += entrySize)
+					{
+						DWORD dwHash = hasHash ? Read<DWORD>(entry + 4) : 0;
+
+						if (!callback(Read<DWORD>(entry), hasHash, dwHash))
+						{
+							return false;
+						}
+					}
+				}
+				else
+				{
+					ThrowCorrupted("Unknown hive subkey index type");
+				}
+
+				return true;
+			}
+
+			/// <summary>
+			///		Looks up direct subkey with specified name, returns NilCell when there is no such subkey
+			/// </summary>
+			DWORD FindSubKey(DWORD keyOffset, const wchar_t* name, size_t len) const
+			{
+				const BYTE* nk = KeyNode(keyOffset);
+
+				const DWORD dwSubKeys = Read<DWORD>(nk + 20);
+				const DWORD listOffset = Read<DWORD>(nk + 28);
+
+				if (dwSubKeys == 0 || listOffset == NilCell)
+				{
+					return NilCell;
+				}
+
+				DWORD dwHash = 0;
+				const bool canHash = NameHash(name, len, &dwHash);
+
+				DWORD result = NilCell;
+
+				ForEachSubKeyCell(listOffset, [&](DWORD offset, bool hasHash, DWORD hash) -> bool
+				{
+					if (hasHash && canHash && hash != dwHash)
+					{
+						return true;
+					}
+
+					const BYTE* child = KeyNode(offset);
+					const bool compressed = (Read<WORD>(child + 2) & NkCompressedName) != 0;
+
+					if (NameEquals(child + NkNameOffset, Read<WORD>(child + 72), compressed, name, len))
+					{
+						result = offset;
+
+						return false;
+					}
+
+					return true;
+				});
+
+				return result;
+			}
+
+			/// <summary>
+			///		Resolves path relative to specified key, returns NilCell when any path segment does not exist
+			/// </summary>
+			DWORD FindKey(DWORD keyOffset, const std::wstring& path) const
+			{
+				const wchar_t* p = path.c_str();
+				const wchar_t* end = p + path.length();
+
+				while (p < end && keyOffset != NilCell)
+				{
+					const wchar_t* sep = p;
+					while (sep < end && *sep != L'\\')
+					{
+						++sep;
+					}
+
+					// Empty segments (leading, trailing or doubled separators) are skipped
+					if (sep != p)
+					{
+						keyOffset = FindSubKey(keyOffset, p, static_cast<size_t>(sep - p));
+					}
+
+					p = sep + 1;
+				}
+
+				return keyOffset;
+			}
+
+			/// <summary>
+			///		Looks up value with specified name, returns NilCell when there is no such value
+			/// </summary>
+			DWORD FindValue(DWORD keyOffset, const std::wstring& name) const
+			{
+				const BYTE* nk = KeyNode(keyOffset);
+
+				const DWORD dwValues = Read<DWORD>(nk + 36);
+				const DWORD listOffset = Read<DWORD>(nk + 40);
+
+				if (dwValues == 0 || listOffset == NilCell)
+				{
+					return NilCell;
+				}
+
+				DWORD cbCell = 0;
+				const BYTE* list = Cell(listOffset, &cbCell);
+
+				if (dwValues > cbCell / 4)
+				{
+					ThrowCorrupted("Hive value list exceeds cell");
+				}
+
+				for (DWORD i = 0; i < dwValues; ++i)
+				{
+					const DWORD offset = Read<DWORD>(list + i * 4);
+					const BYTE* vk = ValueNode(offset);
+					const bool compressed = (Read<WORD>(vk + 16) & VkCompressedName) != 0;
+
+					if (NameEquals(vk + VkNameOffset, Read<WORD>(vk + 2), compressed, name.c_str(), name.length()))
+					{
+						return offset;
+					}
+				}
+
+				return NilCell;
+			}
+
+			/// <summary>
+			///		Invokes callback for each contiguous chunk of value data. Small values are stored
+			///		inline in value node, large values (hive version 1.4+) are split into big data segments.
+			/// </summary>
+			template <typename __Function>
+			void ForEachDataChunk(const BYTE* vk, const __Function& callback) const
+			{
+				const DWORD dwSize = Read<DWORD>(vk + 4);
+
+				if (dwSize & DataInline)
+				{
+					const DWORD cbData = dwSize & ~DataInline;
+					if (cbData > 4)
+					{
+						ThrowCorrupted("Hive inline value data too long");
+					}
+
+					if (cbData != 0)
+					{
+						callback(vk + 8, cbData);
+					}
+
+					return;
+				}
+
+				if (dwSize == 0)
+				{
+					return;
+				}
+
+				DWORD cbCell = 0;
+				const BYTE* data = Cell(Read<DWORD>(vk + 8), &cbCell);
+
+				if (dwSize > BigDataSegmentSize && m_minorVersion >= 4 && cbCell >= 8 && std::memcmp(data, "db", 2) == 0)
+				{
+					const DWORD dwSegments = Read<WORD>(data + 2);
+
+					DWORD cbList = 0;
+					const BYTE* list = Cell(Read<DWORD>(data + 4), &cbList);
+
+					if (dwSegments > cbList / 4)
+					{
+						ThrowCorrupted("Hive big data segment list exceeds cell");
+					}
+
+					DWORD cbRemaining = dwSize;
+
+					for (DWORD i = 0; i < dwSegments && cbRemaining != 0; ++i)
+					{
+						DWORD cbSegment = 0;
+						const BYTE* segment = Cell(Read<DWORD>(list + i * 4), &cbSegment);
+
+						const DWORD cbChunk = (cbRemaining < BigDataSegmentSize) ? cbRemaining : BigDataSegmentSize;
+						if (cbChunk > cbSegment)
+						{
+							ThrowCorrupted("Hive big data segment too short");
+						}
+
+						callback(segment, cbChunk);
+
+						cbRemaining -= cbChunk;
+					}
+
+					if (cbRemaining != 0)
+					{
+						ThrowCorrupted("Hive big data value truncated");
+					}
+
+					return;
+				}
+
+				if (dwSize > cbCell)
+				{
+					ThrowCorrupted("Hive value data exceeds cell");
+				}
+
+				callback(data, dwSize);
+			}
+
+			/// <summary>
+			///		Reads value data with same semantics as RegQueryValueEx()
+			/// </summary>
+			LSTATUS QueryValue(DWORD keyOffset, const std::wstring& name, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) const
+			{
+				const DWORD offset = FindValue(keyOffset, name);
+				if (offset == NilCell)
+				{
+					return ERROR_FILE_NOT_FOUND;
+				}
+
+				const BYTE* vk = ValueNode(offset);
+
+				if (lpType != nullptr)
+				{
+					*lpType = Read<DWORD>(vk + 12);
+				}
+
+				const DWORD cbData = Read<DWORD>(vk + 4) & ~DataInline;
+
+				if (lpcbData == nullptr)
+				{
+					return ERROR_SUCCESS;
+				}
+
+				if (lpData == nullptr)
+				{
+					*lpcbData = cbData;
+
+					return ERROR_SUCCESS;
+				}
+
+				if (*lpcbData < cbData)
+				{
+					*lpcbData = cbData;
+
+					return ERROR_MORE_DATA;
+				}
+
+				DWORD cbCopied = 0;
+
+				ForEachDataChunk(vk, [&](const BYTE* chunk, DWORD cbChunk)
+				{
+					std::memcpy(lpData + cbCopied, chunk, cbChunk);
+					cbCopied += cbChunk;
+				});
+
+				*lpcbData = cbCopied;
+
+				return ERROR_SUCCESS;
+			}
+
+			/// <summary>
+			///		State of walk over keys made by GetStatistics()
+			/// </summary>
+			struct Survey
+			{
+				// One flag per 8 byte aligned cell offset, marks cells reachable from root
+				std::vector<bool> reachable;
+				ULONGLONG reachableBytes = 0;
+				ULONGLONG keys = 0;
+				ULONGLONG values = 0;
+				ULONGLONG pages = 0;
+				// Pages touched by lookup of current key, pages of path to it come first
+				std::vector<DWORD> touched;
+				std::vector<DWORD> distinct;
+			};
+
+			/// <summary>
+			///		Marks cell as reachable, returns false when it has already been marked
+			/// </summary>
+			bool Mark(Survey& survey, DWORD offset) const
+			{
+				DWORD cbData = 0;
+				Cell(offset, &cbData);
+
+				if ((offset % 8) != 0)
+				{
+					ThrowCorrupted("Hive cell offset is not aligned");
+				}
+
+				if (survey.reachable[offset / 8])
+				{
+					return false;
+				}
+
+				survey.reachable[offset / 8] = true;
+				survey.reachableBytes += cbData + 4;
+
+				return true;
+			}
+
+			/// <summary>
+			///		Records all pages spanned by cell as touched by current lookup
+			/// </summary>
+			void Touch(Survey& survey, DWORD offset) const
+			{
+				DWORD cbData = 0;
+				Cell(offset, &cbData);
+
+				for (DWORD page = offset / PageSize; page <= (offset + cbData + 3) / PageSize; ++page)
+				{
+					survey.touched.push_back(page);
+				}
+			}
+
+			void Visit(Survey& survey, DWORD offset) const
+			{
+				Mark(survey, offset);
+				Touch(survey, offset);
+			}
+
+			/// <summary>
+			///		Marks cells of key and its values, counts pages touched by its lookup, then surveys its subkeys
+			/// </summary>
+			void SurveyKey(Survey& survey, DWORD keyOffset, int depth) const
+			{
+				if (depth > MaxKeyDepth)
+				{
+					ThrowCorrupted("Hive key tree nested too deep");
+				}
+
+				const BYTE* nk = KeyNode(keyOffset);
+
+				// Key reachable twice would make walk endless on cycle
+				if (!Mark(survey, keyOffset))
+				{
+					ThrowCorrupted("Hive key node referenced more than once");
+				}
+
+				const size_t path = survey.touched.size();
+
+				Touch(survey, keyOffset);
+
+				const DWORD security = Read<DWORD>(nk + 44);
+				if (security != NilCell)
+				{
+					Mark(survey, security);
+				}
+
+				const DWORD className = Read<DWORD>(nk + 48);
+				if (className != NilCell && Read<WORD>(nk + 74) != 0)
+				{
+					Mark(survey, className);
+				}
+
+				const size_t lookup = survey.touched.size();
+
+				const DWORD dwValues = Read<DWORD>(nk + 36);
+				const DWORD valueList = Read<DWORD>(nk + 40);
+
+				if (dwValues != 0 && valueList != NilCell)
+				{
+					DWORD cbList = 0;
+					const BYTE* list = Cell(valueList, &cbList);
+
+					if (dwValues > cbList / 4)
+					{
+						ThrowCorrupted("Hive value list exceeds cell");
+					}
+
+					Visit(survey, valueList);
+
+					for (DWORD i = 0; i < dwValues; ++i)
+					{
+						const DWORD offset = Read<DWORD>(list + i * 4);
+						const BYTE* vk = ValueNode(offset);
+
+						Visit(survey, offset);
+
+						const DWORD dwSize = Read<DWORD>(vk + 4);
+						if ((dwSize & DataInline) || dwSize == 0)
+						{
+							continue;
+						}
+
+						const DWORD dataOffset = Read<DWORD>(vk + 8);
+
+						DWORD cbCell = 0;
+						const BYTE* data = Cell(dataOffset, &cbCell);
+
+						Visit(survey, dataOffset);
+
+						// Same condition as in ForEachDataChunk()
+						if (dwSize > BigDataSegmentSize && m_minorVersion >= 4 && cbCell >= 8 && std::memcmp(data, "db", 2) == 0)
+						{
+							const DWORD dwSegments = Read<WORD>(data + 2);
+							const DWORD segmentList = Read<DWORD>(data + 4);
+
+							DWORD cbSegmentList = 0;
+							const BYTE* segments = Cell(segmentList, &cbSegmentList);
+
+							if (dwSegments > cbSegmentList / 4)
+							{
+								ThrowCorrupted("Hive big data segment list exceeds cell");
+							}
+
+							Visit(survey, segmentList);
+
+							for (DWORD j = 0; j < dwSegments; ++j)
+							{
+								Visit(survey, Read<DWORD>(segments + j * 4));
+							}
+						}
+					}
+
+					survey.values += dwValues;
+				}
+
+				survey.distinct.assign(survey.touched.begin(), survey.touched.end());
+				std::sort(survey.distinct.begin(), survey.distinct.end());
+
+				survey.pages += static_cast<ULONGLONG>(std::unique(survey.distinct.begin(), survey.distinct.end()) - survey.distinct.begin());
+				++survey.keys;
+
+				// Subkeys see pages of path to this key node, not of its values
+				survey.touched.resize(lookup);
+
+				const DWORD dwSubKeys = Read<DWORD>(nk + 20);
+				const DWORD subKeyList = Read<DWORD>(nk + 28);
+
+				if (dwSubKeys != 0 && subKeyList != NilCell)
+				{
+					SurveyIndex(survey, subKeyList, depth, 0);
+				}
+
+				survey.touched.resize(path);
+			}
+
+			/// <summary>
+			///		Surveys subkeys listed in subkey index. Lookup scans index lists in order, so pages of
+			///		all lists preceding list of subkey stay touched when subkey is surveyed.
+			/// </summary>
+			void SurveyIndex(Survey& survey, DWORD listOffset, int depth, int indexDepth) const
+			{
+				if (indexDepth > MaxIndexDepth)
+				{
+					ThrowCorrupted("Hive subkey index nested too deep");
+				}
+
+				DWORD cbCell = 0;
+				const BYTE* list = Cell(listOffset, &cbCell);
+
+				if (cbCell < 4)
+				{
+					ThrowCorrupted("Hive subkey index too short");
+				}
+
+				Visit(survey, listOffset);
+
+				const DWORD count = Read<WORD>(list + 2);
+				const bool isIndexRoot = (list[0] == 'r' && list[1] == 'i');
+				const bool hashed = (list[0] == 'l' && (list[1] == 'f' || list[1] == 'h'));
+				const DWORD entrySize = hashed ? 8 : 4;
+
+				if (!isIndexRoot && !hashed && !(list[0] == 'l' && list[1] == 'i'))
+				{
+					ThrowCorrupted("Unknown hive subkey index type");
+				}
+
+				if (count > (cbCell - 4) / entrySize)
+				{
+					ThrowCorrupted("Hive subkey index exceeds cell");
+				}
+
+				for (DWORD i = 0; i < count; ++i)
+				{
+					const DWORD offset = Read<DWORD>(list + 4 + i * entrySize);
+
+					if (isIndexRoot)
+					{
+						SurveyIndex(survey, offset, depth, indexDepth + 1);
+					}
+					else
+					{
+						SurveyKey(survey, offset, depth + 1);
+					}
+				}
+			}
+
+		private:
+			MappedFile m_file;
+			const BYTE* m_bins;
+			size_t m_binsSize;
+			DWORD m_minorVersion;
+			DWORD m_rootCell;
+		};
+
+		inline HiveKey HiveKey::Open(const std::wstring& path) const
+		{
+			if (path.empty())
+			{
+				throw std::invalid_argument("Specified path to registry key cannot be empty");
+			}
+
+			DWORD cell = m_hive->FindKey(m_cell, path);
+			if (cell == HiveFile::NilCell)
+			{
+				auto ec = std::error_code(ERROR_FILE_NOT_FOUND, std::system_category());
+
+				throw std::system_error(ec, "HiveKey::Open() failed");
+			}
+
+			return HiveKey(m_hive, cell);
+		}
+
+		inline bool HiveKey::HasKey(const std::wstring& path) const
+		{
+			if (path.empty())
+			{
+				throw std::invalid_argument("Specified path to registry key cannot be empty");
+			}
+
+			return m_hive->FindKey(m_cell, path) != HiveFile::NilCell;
+		}
+
+		inline bool HiveKey::HasValue(const std::wstring& name) const
+		{
+			if (name.empty())
+			{
+				throw std::invalid_argument("Value name cannot be empty");
+			}
+
+			return m_hive->FindValue(m_cell, name) != HiveFile::NilCell;
+		}
+
+		inline bool HiveKey::GetBoolean(const std::wstring& name) const
+		{
+			DWORD dwType = 0;
+			DWORD dwData = 0;
+			DWORD cbData = sizeof(dwData);
+
+			LSTATUS lStatus = m_hive->QueryValue(m_cell, name, &dwType, reinterpret_cast<LPBYTE>(&dwData), &cbData);
+			if (lStatus != ERROR_SUCCESS)
+			{
+				auto ec = std::error_code(lStatus, std::system_category());
+
+				throw std::system_error(ec, "HiveKey::GetBoolean() failed");
+			}
+
+			if (dwType != REG_DWORD && dwType != REG_QWORD)
+			{
+				throw std::runtime_error("Wrong registry value type " + std::to_string(dwType) + " for boolean value.");
+			}
+
+			return (dwData == 0) ? false : true;
+		}
+
+		inline LONG HiveKey::GetInt32(const std::wstring& name) const
+		{
+			LONG lData = 0;
+			DWORD cbData = sizeof(lData);
+
+			LSTATUS lStatus = m_hive->QueryValue(m_cell, name, nullptr, reinterpret_cast<LPBYTE>(&lData), &cbData);
+			if (lStatus != ERROR_SUCCESS)
+			{
+				auto ec = std::error_code(lStatus, std::system_category());
+
+				throw std::system_error(ec, "HiveKey::GetInt32() failed");
+			}
+
+			return lData;
+		}
+
+		inline long long HiveKey::GetInt64(const std::wstring& name) const
+		{
+			long long llData = 0;
+			DWORD cbData = sizeof(llData);
+
+			LSTATUS lStatus = m_hive->QueryValue(m_cell, name, nullptr, reinterpret_cast<LPBYTE>(&llData), &cbData);
+			if (lStatus != ERROR_SUCCESS)
+			{
+				auto ec = std::error_code(lStatus, std::system_category());
+
+				throw std::system_error(ec, "HiveKey::GetInt64() failed");
+			}
+
+			return llData;
+		}
+
+		inline std::wstring HiveKey::GetString(const std::wstring& name) const
+		{
+			const DWORD offset = m_hive->FindValue(m_cell, name);
+			if (offset == HiveFile::NilCell)
+			{
+				auto ec = std::error_code(ERROR_FILE_NOT_FOUND, std::system_category());
+
+				throw std::system_error(ec, "HiveKey::GetString() failed");
+			}
+
+			const BYTE* vk = m_hive->ValueNode(offset);
+
+			const DWORD dwType = HiveFile::Read<DWORD>(vk + 12);
+			if (dwType != REG_SZ && dwType != REG_EXPAND_SZ)
+			{
+				throw std::runtime_error("Wrong registry value type " + std::to_string(dwType) + " for string value.");
+			}
+
+			std::wstring value;
+			value.reserve((HiveFile::Read<DWORD>(vk + 4) & ~HiveFile::DataInline) / 2);
+
+			wchar_t pending = 0;
+			bool more = true;
+
+			m_hive->ForEachDataChunk(vk, [&](const BYTE* chunk, DWORD cbChunk)
+			{
+				// Same as RegGetValue(), string ends on first null character
+				if (more)
+				{
+					more = HiveFile::AppendUtf16(value, chunk, cbChunk / 2, pending, true);
+				}
+			});
+
+			return value;
+		}
+
+		inline std::wstring HiveKey::GetName() const
+		{
+			const BYTE* nk = m_hive->KeyNode(m_cell);
+			const bool compressed = (HiveFile::Read<WORD>(nk + 2) & HiveFile::NkCompressedName) != 0;
+
+			std::wstring name;
+			HiveFile::AppendName(name, nk + HiveFile::NkNameOffset, HiveFile::Read<WORD>(nk + 72), compressed);
+
+			return name;
+		}
+
+		inline DWORD HiveKey::GetSubKeyCount() const
+		{
+			return HiveFile::Read<DWORD>(m_hive->KeyNode(m_cell) + 20);
+		}
+
+		inline DWORD HiveKey::GetValueCount() const
+		{
+			return HiveFile::Read<DWORD>(m_hive->KeyNode(m_cell) + 36);
+		}
+
+		inline FILETIME HiveKey::GetLastWriteTime() const
+		{
+			return HiveFile::Read<FILETIME>(m_hive->KeyNode(m_cell) + 4);
+		}
+
+		inline std::span<const BYTE> HiveKey::GetSecurityDescriptor() const
+		{
+			const DWORD offset = HiveFile::Read<DWORD>(m_hive->KeyNode(m_cell) + 44);
+			if (offset == HiveFile::NilCell)
+			{
+				return {};
+			}
+
+			DWORD cbCell = 0;
+			const BYTE* sk = m_hive->Cell(offset, &cbCell);
+
+			if (cbCell < 20 || std::memcmp(sk, "sk", 2) != 0 || HiveFile::Read<DWORD>(sk + 16) > cbCell - 20)
+			{
+				HiveFile::ThrowCorrupted("Hive cell is not security descriptor");
+			}
+
+			return std::span<const BYTE>(sk + 20, HiveFile::Read<DWORD>(sk + 16));
+		}
+
+		inline std::wstring HiveKey::GetClass() const
+		{
+			const BYTE* nk = m_hive->KeyNode(m_cell);
+
+			const DWORD offset = HiveFile::Read<DWORD>(nk + 48);
+			const WORD cbClass = HiveFile::Read<WORD>(nk + 74);
+
+			std::wstring className;
+
+			if (offset == HiveFile::NilCell || cbClass == 0)
+			{
+				return className;
+			}
+
+			DWORD cbCell = 0;
+			const BYTE* data = m_hive->Cell(offset, &cbCell);
+
+			if (cbClass > cbCell)
+			{
+				HiveFile::ThrowCorrupted("Hive class name exceeds cell");
+			}
+
+			// Class names are never compressed
+			HiveFile::AppendName(className, data, cbClass, false);
+
+			return className;
+		}
+
+		template <typename __Function>
+		void HiveKey::EnumerateSubKeys(const __Function& callback) const
+		{
+			const BYTE* nk = m_hive->KeyNode(m_cell);
+
+			const DWORD dwSubKeys = HiveFile::Read<DWORD>(nk + 20);
+			const DWORD listOffset = HiveFile::Read<DWORD>(nk + 28);
+
+			if (dwSubKeys == 0 || listOffset == HiveFile::NilCell)
+			{
+				return;
+			}
+
+			// Single name buffer is reused for all subkeys
+			std::wstring subKeyName;
+
+			m_hive->ForEachSubKeyCell(listOffset, [&](DWORD offset, bool, DWORD) -> bool
+			{
+				const BYTE* child = m_hive->KeyNode(offset);
+				const bool compressed = (HiveFile::Read<WORD>(child + 2) & HiveFile::NkCompressedName) != 0;
+
+				subKeyName.clear();
+				HiveFile::AppendName(subKeyName, child + HiveFile::NkNameOffset, HiveFile::Read<WORD>(child + 72), compressed);
+
+				// Return false from callback to break enumeration
+				return callback(subKeyName) ? true : false;
+			});
+		}
+
+		template <typename __Function>
+		void HiveKey::EnumerateValues(const __Function& callback) const
+		{
+			const BYTE* nk = m_hive->KeyNode(m_cell);
+
+			const DWORD dwValues = HiveFile::Read<DWORD>(nk + 36);
+			const DWORD listOffset = HiveFile::Read<DWORD>(nk + 40);
+
+			if (dwValues == 0 || listOffset == HiveFile::NilCell)
+			{
+				return;
+			}
+
+			DWORD cbCell = 0;
+			const BYTE* list = m_hive->Cell(listOffset, &cbCell);
+
+			if (dwValues > cbCell / 4)
+			{
+				HiveFile::ThrowCorrupted("Hive value list exceeds cell");
+			}
+
+			// Name and data buffers are reused for all values
+			std::wstring name;
+			std::vector<BYTE> data;
+
+			for (DWORD i = 0; i < dwValues; ++i)
+			{
+				const BYTE* vk = m_hive->ValueNode(HiveFile::Read<DWORD>(list + i * 4));
+				const bool compressed = (HiveFile::Read<WORD>(vk + 16) & HiveFile::VkCompressedName) != 0;
+
+				name.clear();
+				HiveFile::AppendName(name, vk + HiveFile::VkNameOffset, HiveFile::Read<WORD>(vk + 2), compressed);
+
+				const DWORD cbData = HiveFile::Read<DWORD>(vk + 4) & ~HiveFile::DataInline;
+
+				if (data.size() < cbData)
+				{
+					data.resize(cbData);
+				}
+
+				DWORD cbCopied = 0;
+
+				m_hive->ForEachDataChunk(vk, [&](const BYTE* chunk, DWORD cbChunk)
+				{
+					std::memcpy(data.data() + cbCopied, chunk, cbChunk);
+					cbCopied += cbChunk;
+				});
+
+				// Return false from callback to break enumeration
+				if (!callback(std::wstring_view(name), HiveFile::Read<DWORD>(vk + 12), data.data(), cbCopied))
+				{
+					break;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,1147 @@
+#pragma once
+
+#include <Registry.hpp>
+#include <HiveFile.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <unordered_map>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <cstring>
+#include <cwctype>
+#include <stdexcept>
+#include <system_error>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Writes registry key with its whole subtree into offline hive file (regf format, as written by RegSaveKey()),
+		///		which can be read by HiveFile or loaded by RegLoadKey(). Hive can thus be built on any platform,
+		///		e.g. from key stored in MemoryBackend or imported from .reg file.
+		/// </summary>
+		/// <remarks>
+		///		Subtree is read into flat arrays and laid out once, when writer is constructed. Write() then streams
+		///		hive out bin by bin, so whole image is never held in memory.
+		///		Keys are placed in breadth first order, each key node followed by its subkey index, value list,
+		///		value nodes and their data, so subkeys of key are neighbours and lookups and enumeration touch few pages.
+		///		Cells of key are not split across bins when they fit into one. Value data larger than LocalDataSize
+		///		is placed after all keys, so it does not spread key nodes apart.
+		///		Keys read from hive file keep their security descriptors and class names, other keys share single descriptor
+		///		granting full access to SYSTEM and Administrators and read access to Users.
+		/// </remarks>
+		class HiveWriter
+		{
+		public:
+			// Value data up to this size is stored next to its value node
+			static constexpr DWORD LocalDataSize = 1024;
+			// Subkey index of up to this many subkeys is single lh list, larger index is split into lh lists of this size
+			static constexpr DWORD LeafSize = 500;
+
+			/// <summary>
+			///		Reads subtree of registry key, stored in any backend. Registry key does not know its name,
+			///		so name of hive root key is specified separately.
+			/// </summary>
+			explicit HiveWriter(const RegistryKey_ptr& key, std::wstring_view rootName = L"ROOT")
+			{
+				if (key == nullptr)
+				{
+					throw std::invalid_argument("Registry key cannot be nullptr");
+				}
+
+				m_defaultSecurity = AddSecurity(SecurityDescriptor);
+
+				AddKey(rootName, NilIndex);
+				Collect(key, 0);
+				Layout();
+			}
+
+			/// <summary>
+			///		Reads subtree of key stored in offline hive file
+			/// </summary>
+			explicit HiveWriter(const HiveKey& key)
+			{
+				AddKey(key.GetName(), NilIndex);
+				Collect(key, 0);
+				Layout();
+
+				m_sourceSecurities.clear();
+			}
+
+			// Disable copy ctor & copy assignment operator
+			HiveWriter(const HiveWriter& other) = delete;
+			HiveWriter& operator=(const HiveWriter& other) = delete;
+
+			/// <summary>
+			///		Number of keys written, including root key
+			/// </summary>
+			size_t KeyCount() const
+			{
+				return m_keys.size();
+			}
+
+			size_t ValueCount() const
+			{
+				return m_values.size();
+			}
+
+			/// <summary>
+			///		Size of hive file in bytes
+			/// </summary>
+			ULONGLONG Size() const
+			{
+				return BaseBlockSize + static_cast<ULONGLONG>(m_binsSize);
+			}
+
+			/// <summary>
+			///		Streams hive into specified stream, base block first, followed by hive bins
+			/// </summary>
+			void Write(std::ostream& out) const
+			{
+				std::vector<BYTE> base(BaseBlockSize, 0);
+
+				const ULONGLONG timestamp = m_keys[0].lastWriteTime;
+
+				std::memcpy(&base[0], "regf", 4);
+				Put<DWORD>(&base[4], 1);						// Primary sequence number
+				Put<DWORD>(&base[8], 1);						// Secondary sequence number, same as primary as hive is consistent
+				Put<ULONGLONG>(&base[12], timestamp);
+				Put<DWORD>(&base[20], 1);						// Major version
+				Put<DWORD>(&base[24], 5);						// Minor version
+				Put<DWORD>(&base[28], 0);						// Primary file
+				Put<DWORD>(&base[32], 1);						// Direct memory load
+				Put<DWORD>(&base[36], m_cells[m_keys[0].cells + NodeSlot]);
+				Put<DWORD>(&base[40], m_binsSize);
+				Put<DWORD>(&base[44], 1);						// Clustering factor
+
+				DWORD dwChecksum = 0;
+
+				for (size_t i = 0; i < 508; i += 4)
+				{
+					dwChecksum ^= Get<DWORD>(&base[i]);
+				}
+
+				if (dwChecksum == 0xFFFFFFFF)
+				{
+					dwChecksum = 0xFFFFFFFE;
+				}
+				else if (dwChecksum == 0)
+				{
+					dwChecksum = 1;
+				}
+
+				Put<DWORD>(&base[508], dwChecksum);
+
+				out.write(reinterpret_cast<const char*>(base.data()), static_cast<std::streamsize>(base.size()));
+
+				Emitter emitter(out, timestamp);
+
+				Arrange([&emitter](size_t, DWORD cbCell, DWORD cbBlock, const auto& fill)
+				{
+					emitter.Place(cbCell, cbBlock, fill);
+				});
+
+				emitter.Finish();
+			}
+
+			/// <summary>
+			///		Writes hive into specified file, replacing its content
+			/// </summary>
+			void Save(const std::wstring& file) const
+			{
+				if (file.empty())
+				{
+					throw std::invalid_argument("Specified file path cannot be empty");
+				}
+
+				std::ofstream out(std::filesystem::path(file), std::ios::binary | std::ios::trunc);
+
+				Write(out);
+
+				out.close();
+
+				if (!out)
+				{
+					throw std::runtime_error("Could not write registry hive file");
+				}
+			}
+
+		private:
+			static constexpr DWORD BaseBlockSize = 4096;
+			static constexpr DWORD BinSize = 4096;
+			static constexpr DWORD BinHeaderSize = 32;
+			static constexpr DWORD NilCell = 0xFFFFFFFF;
+			static constexpr DWORD NilIndex = 0xFFFFFFFF;
+			static constexpr DWORD NkNameOffset = 76;
+			static constexpr DWORD VkNameOffset = 20;
+			static constexpr DWORD BigDataSegmentSize = 16344;
+			static constexpr WORD NkHiveEntry = 0x0004;
+			static constexpr WORD NkNoDelete = 0x0008;
+			static constexpr WORD NkCompressedName = 0x0020;
+			static constexpr WORD VkCompressedName = 0x0001;
+			static constexpr DWORD DataInline = 0x80000000;
+
+			// Cells of key, in m_cells from Key::cells, followed by lh lists when index is split
+			static constexpr size_t NodeSlot = 0;
+			static constexpr size_t ValueListSlot = 1;
+			static constexpr size_t SubKeyListSlot = 2;
+			static constexpr size_t ClassSlot = 3;
+			static constexpr size_t KeySlots = 4;
+
+			// Cells of value, in m_cells from Value::cells, followed by big data segments list and segments
+			static constexpr size_t ValueNodeSlot = 0;
+			static constexpr size_t DataSlot = 1;
+			static constexpr size_t ValueSlots = 2;
+
+			// Security cells come first, slot of each is index of its descriptor in m_securities
+
+			struct Key
+			{
+				size_t name;
+				WORD cbName;
+				bool compressed;
+				DWORD hash;
+				DWORD parent;
+				DWORD firstSubKey;
+				DWORD subKeys;
+				DWORD firstValue;
+				DWORD values;
+				DWORD maxSubKeyName;
+				DWORD maxSubKeyClass;
+				DWORD maxValueName;
+				DWORD maxValueData;
+				ULONGLONG lastWriteTime;
+				DWORD security;
+				// Class name in m_names, UTF-16LE
+				size_t className;
+				WORD cbClassName;
+				size_t cells;
+			};
+
+			struct Value
+			{
+				size_t name;
+				WORD cbName;
+				bool compressed;
+				DWORD type;
+				size_t data;
+				DWORD cbData;
+				size_t cells;
+			};
+
+			struct Security
+			{
+				size_t data;
+				DWORD cbData;
+				DWORD references;
+			};
+
+			template <typename T>
+			static T Get(const BYTE* p)
+			{
+				T value;
+				std::memcpy(&value, p, sizeof(value));
+
+				return value;
+			}
+
+			template <typename T>
+			static void Put(BYTE* p, T value)
+			{
+				std::memcpy(p, &value, sizeof(value));
+			}
+
+			static DWORD Upcase(DWORD ch)
+			{
+				if (ch < 0x80)
+				{
+					return (ch >= 'a' && ch <= 'z') ? (ch - ('a' - 'A')) : ch;
+				}
+
+				return static_cast<DWORD>(std::towupper(static_cast<wint_t>(ch)));
+			}
+
+			/// <summary>
+			///		Converts wide string to UTF-16 code units, since wchar_t is not 16 bit wide on every platform
+			/// </summary>
+			static void ToUtf16(std::wstring_view s, std::u16string& units)
+			{
+				units.clear();
+
+				for (auto ch : s)
+				{
+					auto cp = static_cast<DWORD>(ch);
+					if (cp > 0xFFFF)
+					{
+						cp -= 0x10000;
+						units += static_cast<char16_t>(0xD800 + (cp >> 10));
+						units += static_cast<char16_t>(0xDC00 + (cp & 0x3FF));
+					}
+					else
+					{
+						units += static_cast<char16_t>(cp);
+					}
+				}
+			}
+
+			/// <summary>
+			///		Orders names as lh lists require, by their upcased UTF-16 code units
+			/// </summary>
+			static bool NameLess(const std::wstring& first, const std::wstring& second)
+			{
+				std::u16string a;
+				std::u16string b;
+
+				ToUtf16(first, a);
+				ToUtf16(second, b);
+
+				return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [](char16_t x, char16_t y)
+				{
+					return Upcase(x) < Upcase(y);
+				});
+			}
+
+			static DWORD CellSize(size_t cbPayload)
+			{
+				if (cbPayload > 0x7FFFFFF0)
+				{
+					throw std::length_error("Registry hive cell too large");
+				}
+
+				return (static_cast<DWORD>(cbPayload) + 4 + 7) & ~static_cast<DWORD>(7);
+			}
+
+			/// <summary>
+			///		Stores name as ASCII compressed, if it consists of Latin-1 characters only, as UTF-16LE otherwise
+			/// </summary>
+			void AppendName(std::wstring_view name, size_t& offset, WORD& cbName, bool& compressed, DWORD& dwLength)
+			{
+				ToUtf16(name, m_units);
+
+				compressed = std::all_of(m_units.begin(), m_units.end(), [](char16_t unit) { return unit <= 0xFF; });
+
+				const size_t cb = compressed ? m_units.length() : m_units.length() * 2;
+				if (cb > 0xFFFF)
+				{
+					throw std::invalid_argument("Registry key or value name too long");
+				}
+
+				offset = m_names.size();
+				cbName = static_cast<WORD>(cb);
+				dwLength = static_cast<DWORD>(m_units.length() * 2);
+
+				for (auto unit : m_units)
+				{
+					m_names.push_back(static_cast<BYTE>(unit & 0xFF));
+
+					if (!compressed)
+					{
+						m_names.push_back(static_cast<BYTE>(unit >> 8));
+					}
+				}
+			}
+
+			DWORD AddKey(std::wstring_view name, DWORD parent)
+			{
+				Key key = {};
+
+				DWORD dwLength = 0;
+
+				AppendName(name, key.name, key.cbName, key.compressed, dwLength);
+
+				// Hash of lh list entries
+				for (auto unit : m_units)
+				{
+					key.hash = key.hash * 37 + Upcase(unit);
+				}
+
+				key.parent = parent;
+				key.firstSubKey = NilIndex;
+
+				if (parent != NilIndex)
+				{
+					m_keys[parent].maxSubKeyName = (std::max)(m_keys[parent].maxSubKeyName, dwLength);
+				}
+
+				m_keys.push_back(key);
+
+				return static_cast<DWORD>(m_keys.size() - 1);
+			}
+
+			void AddValue(DWORD index, std::wstring_view name, DWORD dwType, const BYTE* pData, DWORD cbData, bool nativeStrings)
+			{
+				Value value = {};
+
+				DWORD dwLength = 0;
+
+				AppendName(name, value.name, value.cbName, value.compressed, dwLength);
+
+				value.type = dwType;
+				value.data = m_data.size();
+
+				const bool isString = (dwType == REG_SZ || dwType == REG_EXPAND_SZ || dwType == REG_MULTI_SZ);
+
+				if (nativeStrings && isString && sizeof(wchar_t) != sizeof(char16_t))
+				{
+					// Strings are stored as UTF-16LE, same as in registry on Windows
+					std::wstring text(cbData / sizeof(wchar_t), L'\0');
+
+					if (!text.empty())
+					{
+						std::memcpy(&text[0], pData, text.length() * sizeof(wchar_t));
+					}
+
+					ToUtf16(text, m_units);
+
+					for (auto unit : m_units)
+					{
+						m_data.push_back(static_cast<BYTE>(unit & 0xFF));
+						m_data.push_back(static_cast<BYTE>(unit >> 8));
+					}
+				}
+				else
+				{
+					m_data.insert(m_data.end(), pData, pData + cbData);
+				}
+
+				value.cbData = static_cast<DWORD>(m_data.size() - value.data);
+
+				auto& key = m_keys[index];
+
+				key.maxValueName = (std::max)(key.maxValueName, dwLength);
+				key.maxValueData = (std::max)(key.maxValueData, value.cbData);
+				++key.values;
+
+				m_values.push_back(value);
+			}
+
+			/// <summary>
+			///		Stores class name of key, always as UTF-16LE
+			/// </summary>
+			void SetClass(DWORD index, std::wstring_view className)
+			{
+				ToUtf16(className, m_units);
+
+				if (m_units.length() * 2 > 0xFFFF)
+				{
+					throw std::invalid_argument("Registry key class name too long");
+				}
+
+				auto& key = m_keys[index];
+
+				key.className = m_names.size();
+				key.cbClassName = static_cast<WORD>(m_units.length() * 2);
+
+				for (auto unit : m_units)
+				{
+					m_names.push_back(static_cast<BYTE>(unit & 0xFF));
+					m_names.push_back(static_cast<BYTE>(unit >> 8));
+				}
+
+				if (key.parent != NilIndex)
+				{
+					m_keys[key.parent].maxSubKeyClass = (std::max)(m_keys[key.parent].maxSubKeyClass, static_cast<DWORD>(key.cbClassName));
+				}
+			}
+
+			/// <summary>
+			///		Adds subkeys with specified names to key, sorted as lh lists require. Returns index of first subkey.
+			/// </summary>
+			DWORD AddSubKeys(DWORD index, std::vector<std::wstring>& names)
+			{
+				std::sort(names.begin(), names.end(), NameLess);
+
+				const auto first = static_cast<DWORD>(m_keys.size());
+
+				for (const auto& name : names)
+				{
+					AddKey(name, index);
+				}
+
+				m_keys[index].firstSubKey = first;
+				m_keys[index].subKeys = static_cast<DWORD>(names.size());
+
+				return first;
+			}
+
+			DWORD AddSecurity(std::span<const BYTE> descriptor)
+			{
+				if (descriptor.size() > 0xFFFF)
+				{
+					throw std::invalid_argument("Registry security descriptor too long");
+				}
+
+				Security security = {};
+
+				security.data = m_descriptors.size();
+				security.cbData = static_cast<DWORD>(descriptor.size());
+
+				m_descriptors.insert(m_descriptors.end(), descriptor.begin(), descriptor.end());
+				m_securities.push_back(security);
+
+				return static_cast<DWORD>(m_securities.size() - 1);
+			}
+
+			/// <summary>
+			///		Returns index of security descriptor of key read from hive. Keys sharing security cell in source
+			///		hive share it in written one too, keys without descriptor get default one.
+			/// </summary>
+			DWORD AddSecurity(const HiveKey& key)
+			{
+				const auto descriptor = key.GetSecurityDescriptor();
+
+				if (descriptor.empty())
+				{
+					if (m_defaultSecurity == NilIndex)
+					{
+						m_defaultSecurity = AddSecurity(SecurityDescriptor);
+					}
+
+					return m_defaultSecurity;
+				}
+
+				auto it = m_sourceSecurities.find(descriptor.data());
+				if (it == m_sourceSecurities.end())
+				{
+					it = m_sourceSecurities.emplace(descriptor.data(), AddSecurity(descriptor)).first;
+				}
+
+				return it->second;
+			}
+
+			void Collect(const RegistryKey_ptr& key, DWORD index)
+			{
+				FILETIME ftLastWriteTime = {};
+
+				LSTATUS lStatus = key->GetBackend()->QueryInfoKey(*key, nullptr, nullptr, nullptr, nullptr, nullptr, &ftLastWriteTime);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegQueryInfoKey() failed");
+				}
+
+				m_keys[index].lastWriteTime = (static_cast<ULONGLONG>(ftLastWriteTime.dwHighDateTime) << 32) | ftLastWriteTime.dwLowDateTime;
+				m_keys[index].security = m_defaultSecurity;
+				// Values of key are added together, subkeys are collected afterwards
+				m_keys[index].firstValue = static_cast<DWORD>(m_values.size());
+
+				key->EnumerateValues([this, index](std::wstring_view name, DWORD dwType, const BYTE* pData, DWORD cbData) -> bool
+				{
+					AddValue(index, name, dwType, pData, cbData, true);
+
+					return true;
+				});
+
+				std::vector<std::wstring> names;
+
+				key->EnumerateSubKeys([&names](const std::wstring& name) -> bool
+				{
+					names.push_back(name);
+
+					return true;
+				});
+
+				const DWORD first = AddSubKeys(index, names);
+
+				for (DWORD i = 0; i < names.size(); ++i)
+				{
+					Collect(key->Open(names[i], DesiredAccess::Read), first + i);
+				}
+			}
+
+			void Collect(const HiveKey& key, DWORD index)
+			{
+				const FILETIME ftLastWriteTime = key.GetLastWriteTime();
+
+				m_keys[index].lastWriteTime = (static_cast<ULONGLONG>(ftLastWriteTime.dwHighDateTime) << 32) | ftLastWriteTime.dwLowDateTime;
+				m_keys[index].security = AddSecurity(key);
+
+				SetClass(index, key.GetClass());
+				// Values of key are added together, subkeys are collected afterwards
+				m_keys[index].firstValue = static_cast<DWORD>(m_values.size());
+
+				key.EnumerateValues([this, index](std::wstring_view name, DWORD dwType, const BYTE* pData, DWORD cbData) -> bool
+				{
+					AddValue(index, name, dwType, pData, cbData, false);
+
+					return true;
+				});
+
+				std::vector<std::wstring> names;
+
+				key.EnumerateSubKeys([&names](const std::wstring& name) -> bool
+				{
+					names.push_back(name);
+
+					return true;
+				});
+
+				const DWORD first = AddSubKeys(index, names);
+
+				for (DWORD i = 0; i < names.size(); ++i)
+				{
+					Collect(key.Open(names[i]), first + i);
+				}
+			}
+
+			static DWORD Leaves(const Key& key)
+			{
+				return (key.subKeys > LeafSize) ? (key.subKeys + LeafSize - 1) / LeafSize : 0;
+			}
+
+			static bool IsBigData(const Value& value)
+			{
+				return value.cbData > BigDataSegmentSize;
+			}
+
+			static DWORD Segments(const Value& value)
+			{
+				return (value.cbData + BigDataSegmentSize - 1) / BigDataSegmentSize;
+			}
+
+			/// <summary>
+			///		Orders keys breadth first, assigns cell slots to keys and values, then offsets to cells
+			/// </summary>
+			void Layout()
+			{
+				m_order.reserve(m_keys.size());
+				m_order.push_back(0);
+
+				for (size_t i = 0; i < m_order.size(); ++i)
+				{
+					const auto& key = m_keys[m_order[i]];
+
+					for (DWORD j = 0; j < key.subKeys; ++j)
+					{
+						m_order.push_back(key.firstSubKey + j);
+					}
+				}
+
+				size_t slots = m_securities.size();
+
+				for (auto& key : m_keys)
+				{
+					if (Leaves(key) > 0xFFFF)
+					{
+						throw std::length_error("Registry key has too many subkeys");
+					}
+
+					key.cells = slots;
+					slots += KeySlots + Leaves(key);
+
+					++m_securities[key.security].references;
+				}
+
+				for (auto& value : m_values)
+				{
+					value.cells = slots;
+					slots += ValueSlots + (IsBigData(value) ? 1 + Segments(value) : 0);
+				}
+
+				m_cells.assign(slots, NilCell);
+
+				Packer packer;
+
+				Arrange([this, &packer](size_t slot, DWORD cbCell, DWORD cbBlock, const auto&)
+				{
+					m_cells[slot] = packer.Place(cbCell, cbBlock);
+				});
+
+				m_binsSize = packer.Size();
+			}
+
+			/// <summary>
+			///		Invokes callback for every cell of hive in order it is placed in, with its slot, size and function
+			///		filling its data. First cell of group which should not be split across bins gets size of whole group,
+			///		other cells get zero.
+			/// </summary>
+			template <typename __Function>
+			void Arrange(const __Function& callback) const
+			{
+				const size_t count = m_securities.size();
+
+				for (size_t i = 0; i < count; ++i)
+				{
+					callback(i, CellSize(20 + m_securities[i].cbData), 0, [this, i, count](BYTE* p)
+					{
+						const auto& security = m_securities[i];
+
+						std::memcpy(p, "sk", 2);
+						Put<DWORD>(p + 4, m_cells[(i + 1) % count]);					// Flink and Blink of circular
+						Put<DWORD>(p + 8, m_cells[(i + count - 1) % count]);		// list of security cells
+						Put<DWORD>(p + 12, security.references);
+						Put<DWORD>(p + 16, security.cbData);
+						std::memcpy(p + 20, m_descriptors.data() + security.data, security.cbData);
+					});
+				}
+
+				for (auto index : m_order)
+				{
+					ArrangeKey(index, callback);
+				}
+
+				// Data too large to be stored next to value nodes
+				for (const auto& value : m_values)
+				{
+					if (value.cbData <= LocalDataSize)
+					{
+						continue;
+					}
+
+					if (!IsBigData(value))
+					{
+						ArrangeData(value.cells + DataSlot, value.data, value.cbData, callback);
+
+						continue;
+					}
+
+					const DWORD dwSegments = Segments(value);
+
+					callback(value.cells + DataSlot, CellSize(8), 0, [this, &value, dwSegments](BYTE* p)
+					{
+						std::memcpy(p, "db", 2);
+						Put<WORD>(p + 2, static_cast<WORD>(dwSegments));
+						Put<DWORD>(p + 4, m_cells[value.cells + ValueSlots]);
+					});
+
+					callback(value.cells + ValueSlots, CellSize(dwSegments * 4), 0, [this, &value, dwSegments](BYTE* p)
+					{
+						for (DWORD i = 0; i < dwSegments; ++i)
+						{
+							Put<DWORD>(p + i * 4, m_cells[value.cells + ValueSlots + 1 + i]);
+						}
+					});
+
+					for (DWORD i = 0; i < dwSegments; ++i)
+					{
+						const DWORD offset = i * BigDataSegmentSize;
+						const DWORD cbSegment = (std::min)(value.cbData - offset, BigDataSegmentSize);
+
+						ArrangeData(value.cells + ValueSlots + 1 + i, value.data + offset, cbSegment, callback);
+					}
+				}
+			}
+
+			template <typename __Function>
+			void ArrangeData(size_t slot, size_t data, DWORD cbData, const __Function& callback) const
+			{
+				callback(slot, CellSize(cbData), 0, [this, data, cbData](BYTE* p)
+				{
+					std::memcpy(p, m_data.data() + data, cbData);
+				});
+			}
+
+			/// <summary>
+			///		Places key node, followed by its subkey index, value list, value nodes and their data stored next to them
+			/// </summary>
+			template <typename __Function>
+			void ArrangeKey(DWORD index, const __Function& callback) const
+			{
+				const auto& key = m_keys[index];
+				const DWORD dwLeaves = Leaves(key);
+
+				DWORD cbBlock = CellSize(NkNameOffset + key.cbName);
+
+				if (key.cbClassName != 0)
+				{
+					cbBlock += CellSize(key.cbClassName);
+				}
+
+				if (dwLeaves != 0)
+				{
+					cbBlock += CellSize(4 + dwLeaves * 4);
+
+					for (DWORD i = 0; i < dwLeaves; ++i)
+					{
+						cbBlock += CellSize(4 + (std::min)(key.subKeys - i * LeafSize, LeafSize) * 8);
+					}
+				}
+				else if (key.subKeys != 0)
+				{
+					cbBlock += CellSize(4 + key.subKeys * 8);
+				}
+
+				if (key.values != 0)
+				{
+					cbBlock += CellSize(key.values * 4);
+				}
+
+				for (DWORD i = 0; i < key.values; ++i)
+				{
+					const auto& value = m_values[key.firstValue + i];
+
+					cbBlock += CellSize(VkNameOffset + value.cbName);
+
+					if (value.cbData > 4 && value.cbData <= LocalDataSize)
+					{
+						cbBlock += CellSize(value.cbData);
+					}
+				}
+
+				callback(key.cells + NodeSlot, CellSize(NkNameOffset + key.cbName), cbBlock, [this, &key, index](BYTE* p)
+				{
+					WORD flags = key.compressed ? NkCompressedName : 0;
+
+					if (index == 0)
+					{
+						flags |= NkHiveEntry | NkNoDelete;
+					}
+
+					std::memcpy(p, "nk", 2);
+					Put<WORD>(p + 2, flags);
+					Put<ULONGLONG>(p + 4, key.lastWriteTime);
+					Put<DWORD>(p + 16, (key.parent != NilIndex) ? m_cells[m_keys[key.parent].cells + NodeSlot] : NilCell);
+					Put<DWORD>(p + 20, key.subKeys);
+					Put<DWORD>(p + 28, m_cells[key.cells + SubKeyListSlot]);
+					Put<DWORD>(p + 32, NilCell);				// Volatile subkeys
+					Put<DWORD>(p + 36, key.values);
+					Put<DWORD>(p + 40, m_cells[key.cells + ValueListSlot]);
+					Put<DWORD>(p + 44, m_cells[key.security]);
+					Put<DWORD>(p + 48, m_cells[key.cells + ClassSlot]);
+					Put<DWORD>(p + 52, key.maxSubKeyName);
+					Put<DWORD>(p + 56, key.maxSubKeyClass);
+					Put<DWORD>(p + 60, key.maxValueName);
+					Put<DWORD>(p + 64, key.maxValueData);
+					Put<WORD>(p + 72, key.cbName);
+					Put<WORD>(p + 74, key.cbClassName);
+					std::memcpy(p + NkNameOffset, m_names.data() + key.name, key.cbName);
+				});
+
+				if (key.cbClassName != 0)
+				{
+					callback(key.cells + ClassSlot, CellSize(key.cbClassName), 0, [this, &key](BYTE* p)
+					{
+						std::memcpy(p, m_names.data() + key.className, key.cbClassName);
+					});
+				}
+
+				ArrangeSubKeyIndex(key, callback);
+
+				if (key.values == 0)
+				{
+					return;
+				}
+
+				callback(key.cells + ValueListSlot, CellSize(key.values * 4), 0, [this, &key](BYTE* p)
+				{
+					for (DWORD i = 0; i < key.values; ++i)
+					{
+						Put<DWORD>(p + i * 4, m_cells[m_values[key.firstValue + i].cells + ValueNodeSlot]);
+					}
+				});
+
+				for (DWORD i = 0; i < key.values; ++i)
+				{
+					const auto& value = m_values[key.firstValue + i];
+
+					callback(value.cells + ValueNodeSlot, CellSize(VkNameOffset + value.cbName), 0, [this, &value](BYTE* p)
+					{
+						std::memcpy(p, "vk", 2);
+						Put<WORD>(p + 2, value.cbName);
+						Put<DWORD>(p + 12, value.type);
+						Put<WORD>(p + 16, value.compressed ? VkCompressedName : 0);
+						std::memcpy(p + VkNameOffset, m_names.data() + value.name, value.cbName);
+
+						if (value.cbData <= 4)
+						{
+							Put<DWORD>(p + 4, value.cbData | DataInline);
+							std::memcpy(p + 8, m_data.data() + value.data, value.cbData);
+						}
+						else
+						{
+							Put<DWORD>(p + 4, value.cbData);
+							Put<DWORD>(p + 8, m_cells[value.cells + DataSlot]);
+						}
+					});
+
+					if (value.cbData > 4 && value.cbData <= LocalDataSize)
+					{
+						ArrangeData(value.cells + DataSlot, value.data, value.cbData, callback);
+					}
+				}
+			}
+
+			/// <summary>
+			///		Places subkey index of key, single lh list or ri list followed by lh lists it refers to
+			/// </summary>
+			template <typename __Function>
+			void ArrangeSubKeyIndex(const Key& key, const __Function& callback) const
+			{
+				if (key.subKeys == 0)
+				{
+					return;
+				}
+
+				const DWORD dwLeaves = Leaves(key);
+
+				const auto leaf = [this, &key, &callback](size_t slot, DWORD first, DWORD count)
+				{
+					callback(slot, CellSize(4 + count * 8), 0, [this, &key, first, count](BYTE* p)
+					{
+						std::memcpy(p, "lh", 2);
+						Put<WORD>(p + 2, static_cast<WORD>(count));
+
+						for (DWORD i = 0; i < count; ++i)
+						{
+							const auto& subKey = m_keys[key.firstSubKey + first + i];
+
+							Put<DWORD>(p + 4 + i * 8, m_cells[subKey.cells + NodeSlot]);
+							Put<DWORD>(p + 8 + i * 8, subKey.hash);
+						}
+					});
+				};
+
+				if (dwLeaves == 0)
+				{
+					leaf(key.cells + SubKeyListSlot, 0, key.subKeys);
+
+					return;
+				}
+
+				callback(key.cells + SubKeyListSlot, CellSize(4 + dwLeaves * 4), 0, [this, &key, dwLeaves](BYTE* p)
+				{
+					std::memcpy(p, "ri", 2);
+					Put<WORD>(p + 2, static_cast<WORD>(dwLeaves));
+
+					for (DWORD i = 0; i < dwLeaves; ++i)
+					{
+						Put<DWORD>(p + 4 + i * 4, m_cells[key.cells + KeySlots + i]);
+					}
+				});
+
+				for (DWORD i = 0; i < dwLeaves; ++i)
+				{
+					const DWORD first = i * LeafSize;
+					const DWORD count = (std::min)(key.subKeys - first, LeafSize);
+
+					leaf(key.cells + KeySlots + i, first, count);
+				}
+			}
+
+			/// <summary>
+			///		Packs cells into hive bins. Cell which does not fit into current bin starts new bin, so does group
+			///		of cells which does not fit into current bin, but fits into empty one.
+			/// </summary>
+			class Packer
+			{
+			public:
+				/// <summary>
+				///		Returns offset of cell, relative to first hive bin as all cell offsets in hive are
+				/// </summary>
+				DWORD Place(DWORD cbCell, DWORD cbBlock)
+				{
+					if (cbBlock > Free() && cbBlock <= BinSize - BinHeaderSize)
+					{
+						Open(cbBlock);
+					}
+					else if (cbCell > Free())
+					{
+						Open(cbCell);
+					}
+
+					const DWORD offset = m_binStart + m_used;
+
+					m_used += cbCell;
+
+					return offset;
+				}
+
+				/// <summary>
+				///		Offset of current bin, which is always last one
+				/// </summary>
+				DWORD BinStart() const
+				{
+					return m_binStart;
+				}
+
+				/// <summary>
+				///		Size of all bins
+				/// </summary>
+				DWORD Size() const
+				{
+					return m_size;
+				}
+
+			private:
+				DWORD Free() const
+				{
+					return (m_size - m_binStart) - m_used;
+				}
+
+				void Open(DWORD cbCell)
+				{
+					const ULONGLONG cbBin = (static_cast<ULONGLONG>(BinHeaderSize) + cbCell + BinSize - 1) / BinSize * BinSize;
+
+					if (m_size + cbBin > 0x7FFFFFFF)
+					{
+						throw std::length_error("Registry hive too large");
+					}
+
+					m_binStart = m_size;
+					m_used = BinHeaderSize;
+					m_size += static_cast<DWORD>(cbBin);
+				}
+
+			private:
+				DWORD m_binStart = 0;
+				DWORD m_used = 0;
+				DWORD m_size = 0;
+			};
+
+			/// <summary>
+			///		Fills hive bins with cells, writing each bin out when next one is started
+			/// </summary>
+			class Emitter
+			{
+			public:
+				Emitter(std::ostream& out, ULONGLONG timestamp)
+					: m_out(out)
+					, m_timestamp(timestamp)
+				{
+				}
+
+				template <typename __Fill>
+				void Place(DWORD cbCell, DWORD cbBlock, const __Fill& fill)
+				{
+					const DWORD offset = m_packer.Place(cbCell, cbBlock);
+
+					if (m_bin.empty() || m_packer.BinStart() != m_binStart)
+					{
+						Flush();
+
+						m_binStart = m_packer.BinStart();
+						m_bin.assign(m_packer.Size() - m_binStart, 0);
+					}
+
+					BYTE* cell = m_bin.data() + (offset - m_binStart);
+
+					Put<LONG>(cell, -static_cast<LONG>(cbCell));
+
+					fill(cell + 4);
+
+					m_used = offset - m_binStart + cbCell;
+				}
+
+				void Finish()
+				{
+					Flush();
+				}
+
+			private:
+				void Flush()
+				{
+					if (m_bin.empty())
+					{
+						return;
+					}
+
+					std::memcpy(&m_bin[0], "hbin", 4);
+					Put<DWORD>(&m_bin[4], m_binStart);
+					Put<DWORD>(&m_bin[8], static_cast<DWORD>(m_bin.size()));
+					Put<ULONGLONG>(&m_bin[20], m_timestamp);
+
+					// Rest of bin is single free cell
+					const DWORD cbFree = static_cast<DWORD>(m_bin.size()) - m_used;
+					if (cbFree != 0)
+					{
+						Put<LONG>(&m_bin[m_used], static_cast<LONG>(cbFree));
+					}
+
+					m_out.write(reinterpret_cast<const char*>(m_bin.data()), static_cast<std::streamsize>(m_bin.size()));
+				}
+
+			private:
+				std::ostream& m_out;
+				ULONGLONG m_timestamp;
+				Packer m_packer;
+				std::vector<BYTE> m_bin;
+				DWORD m_binStart = 0;
+				DWORD m_used = 0;
+			};
+
+			// Self-relative security descriptor, owner Administrators, group SYSTEM, DACL granting
+			// KEY_ALL_ACCESS to SYSTEM and Administrators and KEY_READ to Users, inherited by subkeys
+			static constexpr BYTE SecurityDescriptor[] =
+			{
+				0x01, 0x00, 0x04, 0x90,					// Revision, control SE_SELF_RELATIVE | SE_DACL_PROTECTED | SE_DACL_PRESENT
+				0x14, 0x00, 0x00, 0x00,					// Owner
+				0x24, 0x00, 0x00, 0x00,					// Group
+				0x00, 0x00, 0x00, 0x00,					// SACL
+				0x30, 0x00, 0x00, 0x00,					// DACL
+				0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x20, 0x00, 0x00, 0x00, 0x20, 0x02, 0x00, 0x00,
+				0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x12, 0x00, 0x00, 0x00,
+				0x02, 0x00, 0x4C, 0x00, 0x03, 0x00, 0x00, 0x00,
+				0x00, 0x02, 0x14, 0x00, 0x3F, 0x00, 0x0F, 0x00,
+				0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x12, 0x00, 0x00, 0x00,
+				0x00, 0x02, 0x18, 0x00, 0x3F, 0x00, 0x0F, 0x00,
+				0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x20, 0x00, 0x00, 0x00, 0x20, 0x02, 0x00, 0x00,
+				0x00, 0x02, 0x18, 0x00, 0x19, 0x00, 0x02, 0x00,
+				0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x20, 0x00, 0x00, 0x00, 0x21, 0x02, 0x00, 0x00
+			};
+
+		private:
+			std::vector<Key> m_keys;
+			// Indices of keys in order they are placed in
+			std::vector<DWORD> m_order;
+			std::vector<Value> m_values;
+			std::vector<BYTE> m_names;
+			std::vector<BYTE> m_data;
+			// Offsets of cells, each key and value owns range of slots
+			std::vector<DWORD> m_cells;
+			std::vector<Security> m_securities;
+			std::vector<BYTE> m_descriptors;
+			DWORD m_defaultSecurity = NilIndex;
+			// Indices of descriptors by their location in source hive, used while collecting keys only
+			std::unordered_map<const BYTE*, DWORD> m_sourceSecurities;
+			DWORD m_binsSize = 0;
+			// Scratch buffer for names being converted
+			std::u16string m_units;
+		};
+
+		/// <summary>
+		///		Space usage of hive file before and after compaction
+		/// </summary>
+		struct HiveCompaction
+		{
+			HiveStatistics before;
+			HiveStatistics after;
+		};
+
+		/// <summary>
+		///		Rewrites hive file compactly. Free cells and cells not referenced from any key are dropped,
+		///		keys are laid out breadth first as HiveWriter does. Security descriptors and class names of keys are kept.
+		/// </summary>
+		/// <param name="source">Path to hive file to be compacted</param>
+		/// <param name="target">Path to compacted hive file, must differ from source as it is mapped while written</param>
+		inline HiveCompaction CompactHive(const std::wstring& source, const std::wstring& target)
+		{
+			std::error_code ec;
+
+			if (std::filesystem::equivalent(std::filesystem::path(source), std::filesystem::path(target), ec))
+			{
+				throw std::invalid_argument("Compacted hive cannot replace source hive");
+			}
+
+			HiveCompaction compaction;
+
+			{
+				HiveFile hive(source);
+
+				compaction.before = hive.GetStatistics();
+
+				HiveWriter(hive.Root()).Save(target);
+			}
+
+			compaction.after = HiveFile(target).GetStatistics();
+
+			return compaction;
+		}
+	}
+}
@@ -0,0 +1,630 @@
+#pragma once
+
+#include <RegistryBackend.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <utility>
+#include <limits>
+#include <stdexcept>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Backend operations measured by InstrumentedBackend. RegistryKey methods map to them as follows:
+		///		Open() to OpenKey, Create() to CreateKey, Get*() to QueryValue or QueryMultipleValues,
+		///		Set*() to SetValue, EnumerateSubKeys() to QueryInfoKey and EnumKey, Flush() to FlushKey.
+		/// </summary>
+		enum class BackendOperation
+		{
+			OpenKey,
+			CreateKey,
+			CloseKey,
+			DeleteTree,
+			DeleteValue,
+			FlushKey,
+			SaveKey,
+			QueryValue,
+			QueryMultipleValues,
+			SetValue,
+			QueryInfoKey,
+			EnumKey,
+			EnumValue,
+			NotifyChangeKeyValue,
+			ApplyBatch
+		};
+
+		constexpr size_t BackendOperationCount = static_cast<size_t>(BackendOperation::ApplyBatch) + 1;
+
+		/// <summary>
+		///		Histogram of latencies in nanoseconds with log-linear buckets, HDR histogram style. Each power of two
+		///		is split into 16 buckets, so recorded value is known with precision better than 6.25 %.
+		///		Recording is lock free and wait free, single relaxed atomic increment.
+		/// </summary>
+		class LatencyHistogram
+		{
+		public:
+			static constexpr unsigned SubBucketBits = 4;
+			static constexpr unsigned SubBuckets = 1u << SubBucketBits;
+			// Values up to 2^40 ns, about 18 minutes, larger values are recorded in last bucket
+			static constexpr unsigned MaxExponent = 40;
+			// Values below SubBuckets have exact buckets, each exponent from SubBucketBits up to MaxExponent has SubBuckets more
+			static constexpr size_t BucketCount = (MaxExponent - SubBucketBits + 2) * SubBuckets;
+
+			LatencyHistogram()
+			{
+				Reset();
+			}
+
+			// Disable copy ctor & copy assignment operator
+			LatencyHistogram(const LatencyHistogram& other) = delete;
+			LatencyHistogram& operator=(const LatencyHistogram& other) = delete;
+
+			void Record(ULONGLONG nanoseconds)
+			{
+				m_buckets[BucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+			}
+
+			/// <summary>
+			///		Copies counts of all buckets, each count is read atomically, but not all of them at once
+			/// </summary>
+			std::vector<ULONGLONG> GetBuckets() const
+			{
+				std::vector<ULONGLONG> buckets(BucketCount);
+
+				for (size_t i = 0; i < BucketCount; ++i)
+				{
+					buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+				}
+
+				return buckets;
+			}
+
+			void Reset()
+			{
+				for (auto& bucket : m_buckets)
+				{
+					bucket.store(0, std::memory_order_relaxed);
+				}
+			}
+
+			static size_t BucketIndex(ULONGLONG value)
+			{
+				if (value < SubBuckets)
+				{
+					return static_cast<size_t>(value);
+				}
+
+				unsigned exponent = 63;
+
+				while ((value >> exponent) == 0)
+				{
+					--exponent;
+				}
+
+				if (exponent > MaxExponent)
+				{
+					return BucketCount - 1;
+				}
+
+				// Highest bit selects range, next SubBucketBits bits select bucket within it
+				const auto subBucket = static_cast<size_t>((value >> (exponent - SubBucketBits)) & (SubBuckets - 1));
+
+				return (exponent - SubBucketBits + 1) * SubBuckets + subBucket;
+			}
+
+			/// <summary>
+			///		Highest value recorded in bucket with specified index
+			/// </summary>
+			static ULONGLONG BucketLimit(size_t index)
+			{
+				if (index < SubBuckets)
+				{
+					return index;
+				}
+
+				const auto exponent = static_cast<unsigned>(index / SubBuckets) + SubBucketBits - 1;
+				const auto subBucket = static_cast<ULONGLONG>(index % SubBuckets);
+
+				const ULONGLONG lowest = (1ull << exponent) | (subBucket << (exponent - SubBucketBits));
+
+				return lowest + (1ull << (exponent - SubBucketBits)) - 1;
+			}
+
+		private:
+			std::array<std::atomic<ULONGLONG>, BucketCount> m_buckets;
+		};
+
+		/// <summary>
+		///		Statistics of single backend operation, part of InstrumentationSnapshot
+		/// </summary>
+		struct OperationStatistics
+		{
+			ULONGLONG calls = 0;
+			// Calls which failed, ERROR_MORE_DATA and ERROR_NO_MORE_ITEMS are part of normal protocol and are not errors
+			ULONGLONG errors = 0;
+			// Bytes of value data read or written
+			ULONGLONG bytes = 0;
+			ULONGLONG totalNanoseconds = 0;
+			// Number of calls by returned status other than ERROR_SUCCESS
+			std::vector<std::pair<LSTATUS, ULONGLONG>> statuses;
+			// Calls which returned status other than ERROR_SUCCESS, when too many distinct statuses were returned to count each one
+			ULONGLONG otherStatuses = 0;
+			// Counts of LatencyHistogram buckets
+			std::vector<ULONGLONG> histogram;
+
+			/// <summary>
+			///		Number of calls which returned specified status, not including those counted in otherStatuses
+			/// </summary>
+			ULONGLONG GetStatusCount(LSTATUS lStatus) const
+			{
+				for (const auto& status : statuses)
+				{
+					if (status.first == lStatus)
+					{
+						return status.second;
+					}
+				}
+
+				return 0;
+			}
+
+			/// <summary>
+			///		Latency in nanoseconds which given fraction of calls did not exceed, e.g. 0.99 for p99.
+			///		Reported as upper bound of histogram bucket, zero when no call was made.
+			/// </summary>
+			ULONGLONG GetPercentile(double fraction) const
+			{
+				if (fraction < 0.0 || fraction > 1.0)
+				{
+					throw std::invalid_argument("Percentile must be between 0 and 1");
+				}
+
+				ULONGLONG total = 0;
+
+				for (auto count : histogram)
+				{
+					total += count;
+				}
+
+				if (total == 0)
+				{
+					return 0;
+				}
+
+				auto rank = static_cast<ULONGLONG>(fraction * static_cast<double>(total) + 0.5);
+				if (rank == 0)
+				{
+					rank = 1;
+				}
+
+				ULONGLONG seen = 0;
+
+				for (size_t i = 0; i < histogram.size(); ++i)
+				{
+					seen += histogram[i];
+
+					if (seen >= rank)
+					{
+						return LatencyHistogram::BucketLimit(i);
+					}
+				}
+
+				return LatencyHistogram::BucketLimit(histogram.size() - 1);
+			}
+		};
+
+		/// <summary>
+		///		Statistics of all operations, returned by InstrumentedBackend::GetSnapshot()
+		/// </summary>
+		struct InstrumentationSnapshot
+		{
+			std::array<OperationStatistics, BackendOperationCount> operations;
+
+			const OperationStatistics& operator[](BackendOperation operation) const
+			{
+				return operations[static_cast<size_t>(operation)];
+			}
+		};
+
+		/// <summary>
+		///		Backend forwarding all calls to another backend, recording their counts, statuses, transferred bytes
+		///		and latencies. Instrumentation is opt-in, only keys using this backend are measured, e.g.
+		///		RegistryKey(HKEY_LOCAL_MACHINE, std::make_shared&lt;InstrumentedBackend&gt;(DefaultBackend())).
+		/// </summary>
+		/// <remarks>
+		///		All counters are updated by relaxed atomic operations, so measuring does not serialize callers.
+		///		When REGISTRY_NO_INSTRUMENTATION is defined, backend only forwards calls, has no counters
+		///		and its snapshots are empty.
+		/// </remarks>
+		class InstrumentedBackend final : public RegistryBackend
+		{
+		public:
+#if defined(REGISTRY_NO_INSTRUMENTATION)
+			static constexpr bool Enabled = false;
+#else
+			static constexpr bool Enabled = true;
+#endif
+
+			explicit InstrumentedBackend(const RegistryBackend_ptr& backend)
+				: m_backend(backend)
+			{
+				if (m_backend == nullptr)
+				{
+					throw std::invalid_argument("Backend cannot be nullptr");
+				}
+			}
+
+			// Disable copy ctor & copy assignment operator
+			InstrumentedBackend(const InstrumentedBackend& other) = delete;
+			InstrumentedBackend& operator=(const InstrumentedBackend& other) = delete;
+
+			/// <summary>
+			///		Backend calls are forwarded to
+			/// </summary>
+			const RegistryBackend_ptr& GetBackend() const
+			{
+				return m_backend;
+			}
+
+			/// <summary>
+			///		Copies statistics of all operations. Each counter is read atomically,
+			///		but calls made while snapshot is taken may be reflected by some counters only.
+			/// </summary>
+			InstrumentationSnapshot GetSnapshot() const
+			{
+				InstrumentationSnapshot snapshot;
+
+#if !defined(REGISTRY_NO_INSTRUMENTATION)
+				for (size_t i = 0; i < BackendOperationCount; ++i)
+				{
+					const auto& counters = m_counters[i];
+					auto& statistics = snapshot.operations[i];
+
+					statistics.calls = counters.calls.load(std::memory_order_relaxed);
+					statistics.errors = counters.errors.load(std::memory_order_relaxed);
+					statistics.bytes = counters.bytes.load(std::memory_order_relaxed);
+					statistics.totalNanoseconds = counters.nanoseconds.load(std::memory_order_relaxed);
+					statistics.histogram = counters.histogram.GetBuckets();
+
+					for (const auto& slot : counters.statuses)
+					{
+						const auto count = slot.count.load(std::memory_order_relaxed);
+						if (count != 0)
+						{
+							statistics.statuses.emplace_back(slot.status.load(std::memory_order_relaxed), count);
+						}
+					}
+
+					statistics.otherStatuses = counters.otherStatuses.load(std::memory_order_relaxed);
+				}
+#endif
+
+				return snapshot;
+			}
+
+			/// <summary>
+			///		Zeroes all statistics. Calls made meanwhile may be partially recorded.
+			/// </summary>
+			void Reset()
+			{
+#if !defined(REGISTRY_NO_INSTRUMENTATION)
+				for (auto& counters : m_counters)
+				{
+					counters.calls.store(0, std::memory_order_relaxed);
+					counters.errors.store(0, std::memory_order_relaxed);
+					counters.bytes.store(0, std::memory_order_relaxed);
+					counters.nanoseconds.store(0, std::memory_order_relaxed);
+					counters.otherStatuses.store(0, std::memory_order_relaxed);
+					counters.histogram.Reset();
+
+					// Claimed statuses are kept, only their counts are zeroed
+					for (auto& slot : counters.statuses)
+					{
+						slot.count.store(0, std::memory_order_relaxed);
+					}
+				}
+#endif
+			}
+
+			LSTATUS OpenKey(HKEY hKey, const wchar_t* lpSubKey, REGSAM samDesired, HKEY* phkResult) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->OpenKey(hKey, lpSubKey, samDesired, phkResult);
+
+				Record(BackendOperation::OpenKey, start, lStatus, 0);
+
+				return lStatus;
+			}
+
+			LSTATUS CreateKey(HKEY hKey, const wchar_t* lpSubKey, DWORD dwOptions, REGSAM samDesired, HKEY* phkResult) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->CreateKey(hKey, lpSubKey, dwOptions, samDesired, phkResult);
+
+				Record(BackendOperation::CreateKey, start, lStatus, 0);
+
+				return lStatus;
+			}
+
+			LSTATUS CloseKey(HKEY hKey) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->CloseKey(hKey);
+
+				Record(BackendOperation::CloseKey, start, lStatus, 0);
+
+				return lStatus;
+			}
+
+			LSTATUS DeleteTree(HKEY hKey, const wchar_t* lpSubKey) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->DeleteTree(hKey, lpSubKey);
+
+				Record(BackendOperation::DeleteTree, start, lStatus, 0);
+
+				return lStatus;
+			}
+
+			LSTATUS DeleteValue(HKEY hKey, const wchar_t* lpValueName) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->DeleteValue(hKey, lpValueName);
+
+				Record(BackendOperation::DeleteValue, start, lStatus, 0);
+
+				return lStatus;
+			}
+
+			LSTATUS FlushKey(HKEY hKey) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->FlushKey(hKey);
+
+				Record(BackendOperation::FlushKey, start, lStatus, 0);
+
+				return lStatus;
+			}
+
+			LSTATUS SaveKey(HKEY hKey, const wchar_t* lpFile) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->SaveKey(hKey, lpFile);
+
+				Record(BackendOperation::SaveKey, start, lStatus, 0);
+
+				return lStatus;
+			}
+
+			LSTATUS QueryValue(HKEY hKey, const wchar_t* lpValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->QueryValue(hKey, lpValueName, lpType, lpData, lpcbData);
+
+				Record(BackendOperation::QueryValue, start, lStatus, (lStatus == ERROR_SUCCESS && lpData != nullptr) ? *lpcbData : 0);
+
+				return lStatus;
+			}
+
+			LSTATUS QueryMultipleValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->QueryMultipleValues(hKey, val_list, num_vals, lpValueBuf, ldwTotsize);
+
+				Record(BackendOperation::QueryMultipleValues, start, lStatus, (lStatus == ERROR_SUCCESS && lpValueBuf != nullptr) ? *ldwTotsize : 0);
+
+				return lStatus;
+			}
+
+			LSTATUS QueryValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize, LSTATUS* lpStatuses) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->QueryValues(hKey, val_list, num_vals, lpValueBuf, ldwTotsize, lpStatuses);
+
+				Record(BackendOperation::QueryMultipleValues, start, lStatus, (lStatus == ERROR_SUCCESS && lpValueBuf != nullptr) ? *ldwTotsize : 0);
+
+				return lStatus;
+			}
+
+			LSTATUS SetValue(HKEY hKey, const wchar_t* lpValueName, DWORD dwType, const BYTE* lpData, DWORD cbData) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->SetValue(hKey, lpValueName, dwType, lpData, cbData);
+
+				Record(BackendOperation::SetValue, start, lStatus, (lStatus == ERROR_SUCCESS) ? cbData : 0);
+
+				return lStatus;
+			}
+
+			LSTATUS QueryInfoKey(HKEY hKey, LPDWORD lpcSubKeys, LPDWORD lpcchMaxSubKeyLen, LPDWORD lpcValues, LPDWORD lpcchMaxValueNameLen, LPDWORD lpcbMaxValueLen, FILETIME* lpftLastWriteTime) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->QueryInfoKey(hKey, lpcSubKeys, lpcchMaxSubKeyLen, lpcValues, lpcchMaxValueNameLen, lpcbMaxValueLen, lpftLastWriteTime);
+
+				Record(BackendOperation::QueryInfoKey, start, lStatus, 0);
+
+				return lStatus;
+			}
+
+			LSTATUS EnumKey(HKEY hKey, DWORD dwIndex, wchar_t* lpName, LPDWORD lpcchName) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->EnumKey(hKey, dwIndex, lpName, lpcchName);
+
+				Record(BackendOperation::EnumKey, start, lStatus, 0);
+
+				return lStatus;
+			}
+
+			LSTATUS EnumValue(HKEY hKey, DWORD dwIndex, wchar_t* lpValueName, LPDWORD lpcchValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->EnumValue(hKey, dwIndex, lpValueName, lpcchValueName, lpType, lpData, lpcbData);
+
+				Record(BackendOperation::EnumValue, start, lStatus, (lStatus == ERROR_SUCCESS && lpData != nullptr) ? *lpcbData : 0);
+
+				return lStatus;
+			}
+
+			LSTATUS NotifyChangeKeyValue(HKEY hKey, bool watchSubtree, DWORD dwNotifyFilter, HANDLE hEvent, bool asynchronous) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->NotifyChangeKeyValue(hKey, watchSubtree, dwNotifyFilter, hEvent, asynchronous);
+
+				Record(BackendOperation::NotifyChangeKeyValue, start, lStatus, 0);
+
+				return lStatus;
+			}
+
+			LSTATUS ApplyBatch(HKEY hKey, const BatchOperation* pOperations, DWORD cOperations) override
+			{
+				const auto start = Start();
+
+				LSTATUS lStatus = m_backend->ApplyBatch(hKey, pOperations, cOperations);
+
+				ULONGLONG bytes = 0;
+
+				if constexpr (Enabled)
+				{
+					if (lStatus == ERROR_SUCCESS)
+					{
+						for (DWORD i = 0; i < cOperations; ++i)
+						{
+							bytes += pOperations[i].cbData;
+						}
+					}
+				}
+
+				Record(BackendOperation::ApplyBatch, start, lStatus, bytes);
+
+				return lStatus;
+			}
+
+		private:
+			// Number of distinct statuses counted separately for each operation
+			static constexpr size_t StatusSlots = 8;
+
+			struct StatusSlot
+			{
+				// ERROR_SUCCESS marks free slot
+				std::atomic<LSTATUS> status{ ERROR_SUCCESS };
+				std::atomic<ULONGLONG> count{ 0 };
+			};
+
+			struct Counters
+			{
+				std::atomic<ULONGLONG> calls{ 0 };
+				std::atomic<ULONGLONG> errors{ 0 };
+				std::atomic<ULONGLONG> bytes{ 0 };
+				std::atomic<ULONGLONG> nanoseconds{ 0 };
+				std::array<StatusSlot, StatusSlots> statuses;
+				std::atomic<ULONGLONG> otherStatuses{ 0 };
+				LatencyHistogram histogram;
+			};
+
+			typedef std::chrono::steady_clock Clock;
+
+			static Clock::time_point Start()
+			{
+				if constexpr (Enabled)
+				{
+					return Clock::now();
+				}
+				else
+				{
+					return Clock::time_point();
+				}
+			}
+
+			void Record(BackendOperation operation, Clock::time_point start, LSTATUS lStatus, ULONGLONG bytes)
+			{
+#if !defined(REGISTRY_NO_INSTRUMENTATION)
+				const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+				const auto nanoseconds = static_cast<ULONGLONG>((std::max)(elapsed.count(), static_cast<decltype(elapsed.count())>(0)));
+
+				auto& counters = m_counters[static_cast<size_t>(operation)];
+
+				counters.calls.fetch_add(1, std::memory_order_relaxed);
+				counters.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+				counters.histogram.Record(nanoseconds);
+
+				if (bytes != 0)
+				{
+					counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+				}
+
+				if (lStatus != ERROR_SUCCESS)
+				{
+					if (lStatus != ERROR_MORE_DATA && lStatus != ERROR_NO_MORE_ITEMS)
+					{
+						counters.errors.fetch_add(1, std::memory_order_relaxed);
+					}
+
+					RecordStatus(counters, lStatus);
+				}
+#else
+				static_cast<void>(operation);
+				static_cast<void>(start);
+				static_cast<void>(lStatus);
+				static_cast<void>(bytes);
+#endif
+			}
+
+			/// <summary>
+			///		Counts status in slot claimed by first call which returned it, without taking lock
+			/// </summary>
+			static void RecordStatus(Counters& counters, LSTATUS lStatus)
+			{
+				for (auto& slot : counters.statuses)
+				{
+					LSTATUS current = slot.status.load(std::memory_order_acquire);
+
+					if (current == ERROR_SUCCESS)
+					{
+						// Claim free slot, unless other thread claimed it meanwhile
+						if (slot.status.compare_exchange_strong(current, lStatus, std::memory_order_acq_rel))
+						{
+							current = lStatus;
+						}
+					}
+
+					if (current == lStatus)
+					{
+						slot.count.fetch_add(1, std::memory_order_relaxed);
+
+						return;
+					}
+				}
+
+				counters.otherStatuses.fetch_add(1, std::memory_order_relaxed);
+			}
+
+		private:
+			RegistryBackend_ptr m_backend;
+#if !defined(REGISTRY_NO_INSTRUMENTATION)
+			// About 70 KB of histograms, left out entirely when instrumentation is disabled
+			std::array<Counters, BackendOperationCount> m_counters;
+#endif
+		};
+	}
+}
@@ -0,0 +1,326 @@
+#pragma once
+
+#include <Registry.hpp>
+
+#include <string>
+#include <string_view>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cwctype>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Cache of opened registry keys, so repeated opening of same key does not open new handle each time.
+		///		Keys are identified by parent key, case insensitive path and desired access.
+		///		When cache is full, least recently used key is released.
+		/// </summary>
+		/// <remarks>
+		///		Cached handle stays bound to key it was opened for. When key is deleted and created again,
+		///		call Invalidate() or Clear() to get rid of stale handles.
+		/// </remarks>
+		class KeyCache
+		{
+		public:
+			/// <summary>
+			///		Creates cache holding up to specified number of open keys
+			/// </summary>
+			explicit KeyCache(size_t capacity)
+				: m_capacity(capacity)
+				, m_hits(0)
+				, m_misses(0)
+				, m_evictions(0)
+			{
+				if (m_capacity == 0)
+				{
+					throw std::invalid_argument("Key cache capacity cannot be zero");
+				}
+			}
+
+			// Disable copy ctor & copy assignment operator
+			KeyCache(const KeyCache& other) = delete;
+			KeyCache& operator=(const KeyCache& other) = delete;
+
+			/// <summary>
+			///		Same as parent->Open(path, access), returns cached key when available
+			/// </summary>
+			RegistryKey_ptr Open(const RegistryKey_ptr& parent, const StringRef& path, DesiredAccess access = DesiredAccess::Read)
+			{
+				return Get(parent, path, access, [&]()
+				{
+					return parent->Open(path, access);
+				});
+			}
+
+			/// <summary>
+			///		Same as parent->Create(path, access, options), returns cached key when available
+			/// </summary>
+			RegistryKey_ptr Create(const RegistryKey_ptr& parent, const StringRef& path, DesiredAccess access = DesiredAccess::Read, CreateKeyOptions options = CreateKeyOptions::NonVolatile)
+			{
+				return Get(parent, path, access, [&]()
+				{
+					return parent->Create(path, access, options);
+				});
+			}
+
+			/// <summary>
+			///		Releases cached keys opened on specified path, with any access rights
+			/// </summary>
+			void Invalidate(const RegistryKey_ptr& parent, std::wstring_view path)
+			{
+				const auto normalized = Normalize(path);
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				for (auto it = m_entries.begin(); it != m_entries.end(); )
+				{
+					if (it->key.parent == parent.get() && it->key.path == normalized)
+					{
+						m_index.erase(KeyView(it->key));
+						it = m_entries.erase(it);
+					}
+					else
+					{
+						++it;
+					}
+				}
+			}
+
+			/// <summary>
+			///		Releases all cached keys
+			/// </summary>
+			void Clear()
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				m_index.clear();
+				m_entries.clear();
+			}
+
+			size_t Size() const
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				return m_entries.size();
+			}
+
+			size_t Capacity() const
+			{
+				return m_capacity;
+			}
+
+			/// <summary>
+			///		Number of requests served from cache
+			/// </summary>
+			size_t Hits() const
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				return m_hits;
+			}
+
+			/// <summary>
+			///		Number of requests which had to open key
+			/// </summary>
+			size_t Misses() const
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				return m_misses;
+			}
+
+			/// <summary>
+			///		Number of keys released because cache was full
+			/// </summary>
+			size_t Evictions() const
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				return m_evictions;
+			}
+
+			/// <summary>
+			///		Converts path to form used as cache key. Path is upper cased,
+			///		leading, trailing and repeated backslashes are removed.
+			/// </summary>
+			static std::wstring Normalize(std::wstring_view path)
+			{
+				std::wstring normalized;
+
+				Normalize(path, normalized);
+
+				return normalized;
+			}
+
+			static void Normalize(std::wstring_view path, std::wstring& normalized)
+			{
+				normalized.clear();
+				normalized.reserve(path.length());
+
+				for (auto ch : path)
+				{
+					if (ch == L'\\')
+					{
+						if (!normalized.empty() && normalized.back() != L'\\')
+						{
+							normalized.push_back(ch);
+						}
+					}
+					else if (ch < 0x80)
+					{
+						normalized.push_back((ch >= L'a' && ch <= L'z') ? static_cast<wchar_t>(ch - (L'a' - L'A')) : ch);
+					}
+					else
+					{
+						normalized.push_back(static_cast<wchar_t>(std::towupper(static_cast<wint_t>(ch))));
+					}
+				}
+
+				if (!normalized.empty() && normalized.back() == L'\\')
+				{
+					normalized.pop_back();
+				}
+			}
+
+		private:
+			struct Key
+			{
+				const RegistryKey* parent;
+				std::wstring path;
+				DesiredAccess access;
+			};
+
+			/// <summary>
+			///		Key referencing path it does not own, used for lookups without allocating
+			/// </summary>
+			struct KeyView
+			{
+				const RegistryKey* parent;
+				std::wstring_view path;
+				DesiredAccess access;
+
+				KeyView(const RegistryKey* parent, std::wstring_view path, DesiredAccess access)
+					: parent(parent)
+					, path(path)
+					, access(access)
+				{
+				}
+
+				KeyView(const Key& key)
+					: KeyView(key.parent, key.path, key.access)
+				{
+				}
+			};
+
+			struct KeyHash
+			{
+				size_t operator()(const KeyView& key) const
+				{
+					size_t hash = std::hash<std::wstring_view>()(key.path);
+
+					hash ^= std::hash<const void*>()(key.parent) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+					hash ^= std::hash<REGSAM>()(static_cast<REGSAM>(key.access)) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+
+					return hash;
+				}
+			};
+
+			struct KeyEqual
+			{
+				bool operator()(const KeyView& a, const KeyView& b) const
+				{
+					return a.parent == b.parent && a.access == b.access && a.path == b.path;
+				}
+			};
+
+			struct Entry
+			{
+				Key key;
+				// Keeps parent alive, so its address cannot be reused by another key while entry exists
+				RegistryKey_ptr parent;
+				RegistryKey_ptr value;
+			};
+
+			template <typename __Function>
+			RegistryKey_ptr Get(const RegistryKey_ptr& parent, std::wstring_view path, DesiredAccess access, const __Function& open)
+			{
+				if (parent == nullptr)
+				{
+					throw std::invalid_argument("Parent registry key cannot be nullptr");
+				}
+
+				if (path.empty())
+				{
+					throw std::invalid_argument("Specified path to registry key cannot be empty");
+				}
+
+				// Lookup normalizes path straight from view into per thread buffer, so cache hit does not allocate
+				thread_local std::wstring normalized;
+
+				Normalize(path, normalized);
+
+				const KeyView view(parent.get(), normalized, access);
+
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+
+					auto it = m_index.find(view);
+					if (it != m_index.end())
+					{
+						++m_hits;
+
+						// Move to front of LRU list
+						m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+						return it->second->value;
+					}
+
+					++m_misses;
+				}
+
+				Key key = { parent.get(), normalized, access };
+
+				// Key is opened without lock held, so slow open does not block other lookups
+				auto value = open();
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				auto it = m_index.find(KeyView(key));
+				if (it != m_index.end())
+				{
+					// Other thread opened same key meanwhile, keep its handle
+					m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+					return it->second->value;
+				}
+
+				m_entries.push_front(Entry{ std::move(key), parent, value });
+				m_index.emplace(KeyView(m_entries.front().key), m_entries.begin());
+
+				while (m_entries.size() > m_capacity)
+				{
+					m_index.erase(KeyView(m_entries.back().key));
+					m_entries.pop_back();
+
+					++m_evictions;
+				}
+
+				return value;
+			}
+
+		private:
+			const size_t m_capacity;
+			mutable std::mutex m_mutex;
+			// Most recently used entries first
+			std::list<Entry> m_entries;
+			// Views reference keys owned by list entries
+			std::unordered_map<KeyView, std::list<Entry>::iterator, KeyHash, KeyEqual> m_index;
+			size_t m_hits;
+			size_t m_misses;
+			size_t m_evictions;
+		};
+	}
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <RegistryPlatform.hpp>
+
+#include <string>
+#include <cstddef>
+#include <stdexcept>
+#include <system_error>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Read-only memory mapping of whole file
+		/// </summary>
+		class MappedFile
+		{
+		public:
+			/// <summary>
+			///		Maps specified file into memory for reading
+			/// </summary>
+			/// <param name="file">Path to file to be mapped</param>
+			explicit MappedFile(const std::wstring& file)
+				: m_data(nullptr)
+				, m_size(0)
+			{
+				if (file.empty())
+				{
+					throw std::invalid_argument("Specified file path cannot be empty");
+				}
+
+#if defined(_WIN32)
+				HANDLE hFile = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+				if (hFile == INVALID_HANDLE_VALUE)
+				{
+					auto ec = std::error_code(GetLastError(), std::system_category());
+
+					throw std::system_error(ec, "CreateFile() failed");
+				}
+
+				LARGE_INTEGER liSize = {};
+				if (!GetFileSizeEx(hFile, &liSize))
+				{
+					auto ec = std::error_code(GetLastError(), std::system_category());
+
+					CloseHandle(hFile);
+
+					throw std::system_error(ec, "GetFileSizeEx() failed");
+				}
+
+				m_size = static_cast<size_t>(liSize.QuadPart);
+
+				if (m_size != 0)
+				{
+					HANDLE hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+					if (hMapping == nullptr)
+					{
+						auto ec = std::error_code(GetLastError(), std::system_category());
+
+						CloseHandle(hFile);
+
+						throw std::system_error(ec, "CreateFileMapping() failed");
+					}
+
+					m_data = static_cast<const BYTE*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+
+					auto dwError = GetLastError();
+
+					// View keeps mapping alive, handles are no longer needed
+					CloseHandle(hMapping);
+
+					if (m_data == nullptr)
+					{
+						CloseHandle(hFile);
+
+						throw std::system_error(std::error_code(dwError, std::system_category()), "MapViewOfFile() failed");
+					}
+				}
+
+				CloseHandle(hFile);
+#else
+				const auto& path = ToUtf8(file);
+
+				int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+				if (fd == -1)
+				{
+					auto ec = std::error_code(errno, std::system_category());
+
+					throw std::system_error(ec, "open() failed");
+				}
+
+				struct stat st = {};
+				if (::fstat(fd, &st) == -1)
+				{
+					auto ec = std::error_code(errno, std::system_category());
+
+					::close(fd);
+
+					throw std::system_error(ec, "fstat() failed");
+				}
+
+				m_size = static_cast<size_t>(st.st_size);
+
+				if (m_size != 0)
+				{
+					void* p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+					if (p == MAP_FAILED)
+					{
+						auto ec = std::error_code(errno, std::system_category());
+
+						::close(fd);
+
+						throw std::system_error(ec, "mmap() failed");
+					}
+
+					m_data = static_cast<const BYTE*>(p);
+				}
+
+				::close(fd);
+#endif
+			}
+
+			// Disable copy ctor & copy assignment operator
+			MappedFile(const MappedFile& other) = delete;
+			MappedFile& operator=(const MappedFile& other) = delete;
+
+			MappedFile(MappedFile&& other) noexcept
+				: m_data(other.m_data)
+				, m_size(other.m_size)
+			{
+				other.m_data = nullptr;
+				other.m_size = 0;
+			}
+
+			MappedFile& operator=(MappedFile&& other) noexcept
+			{
+				if (this != &other)
+				{
+					Unmap();
+
+					m_data = other.m_data;
+					m_size = other.m_size;
+
+					other.m_data = nullptr;
+					other.m_size = 0;
+				}
+
+				return *this;
+			}
+
+			~MappedFile()
+			{
+				Unmap();
+			}
+
+			const BYTE* Data() const
+			{
+				return m_data;
+			}
+
+			size_t Size() const
+			{
+				return m_size;
+			}
+
+		private:
+			void Unmap()
+			{
+				if (m_data != nullptr)
+				{
+#if defined(_WIN32)
+					UnmapViewOfFile(m_data);
+#else
+					::munmap(const_cast<BYTE*>(m_data), m_size);
+#endif
+					m_data = nullptr;
+					m_size = 0;
+				}
+			}
+
+#if !defined(_WIN32)
+			static std::string ToUtf8(const std::wstring& s)
+			{
+				std::string result;
+				result.reserve(s.length());
+
+				for (auto ch : s)
+				{
+					auto cp = static_cast<unsigned long>(ch);
+
+					if (cp < 0x80)
+					{
+						result += static_cast<char>(cp);
+					}
+					else if (cp < 0x800)
+					{
+						result += static_cast<char>(0xC0 | (cp >> 6));
+						result += static_cast<char>(0x80 | (cp & 0x3F));
+					}
+					else if (cp < 0x10000)
+					{
+						result += static_cast<char>(0xE0 | (cp >> 12));
+						result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+						result += static_cast<char>(0x80 | (cp & 0x3F));
+					}
+					else
+					{
+						result += static_cast<char>(0xF0 | (cp >> 18));
+						result += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+						result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+						result += static_cast<char>(0x80 | (cp & 0x3F));
+					}
+				}
+
+				return result;
+			}
+#endif
+
+		private:
+			const BYTE* m_data;
+			size_t m_size;
+		};
+	}
+}
@@ -0,0 +1,1704 @@
+#pragma once
+
+#include <RegistryBackend.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cwctype>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Registry backend keeping whole registry tree in process memory.
+		///		Key nodes and handles are allocated from arenas and recycled, subkeys and values are looked up
+		///		via case insensitive hash tables. Backend is thread safe, readers do not block each other.
+		/// </summary>
+		class MemoryBackend final : public RegistryBackend
+		{
+		public:
+			MemoryBackend()
+			{
+				for (auto& root : m_roots)
+				{
+					root = AllocateNode(nullptr, std::wstring_view());
+				}
+			}
+
+			// Disable copy ctor & copy assignment operator
+			MemoryBackend(const MemoryBackend& other) = delete;
+			MemoryBackend& operator=(const MemoryBackend& other) = delete;
+
+			LSTATUS OpenKey(HKEY hKey, const wchar_t* lpSubKey, REGSAM samDesired, HKEY* phkResult) override
+			{
+				if (phkResult == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+				Node* node = nullptr;
+
+				LSTATUS lStatus = Resolve(hKey, 0, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				node = Find(node, lpSubKey);
+				if (node == nullptr)
+				{
+					return ERROR_FILE_NOT_FOUND;
+				}
+
+				*phkResult = AllocateHandle(node, samDesired);
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS CreateKey(HKEY hKey, const wchar_t* lpSubKey, DWORD dwOptions, REGSAM samDesired, HKEY* phkResult) override
+			{
+				if (phkResult == nullptr || lpSubKey == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				Node* node = nullptr;
+				bool created = false;
+
+				{
+					std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+					LSTATUS lStatus = Resolve(hKey, KEY_CREATE_SUB_KEY, &node);
+					if (lStatus != ERROR_SUCCESS)
+					{
+						return lStatus;
+					}
+
+					ForEachSegment(lpSubKey, [&](std::wstring_view segment) -> bool
+					{
+						auto it = node->subKeyIndex.find(segment);
+						if (it != node->subKeyIndex.end())
+						{
+							node = it->second;
+						}
+						else
+						{
+							Node* child = AllocateNode(node, segment);
+							child->options = dwOptions;
+
+							node->subKeyIndex.emplace(child->name, child);
+							node->subKeys.push_back(child);
+
+							if (segment.length() > node->maxSubKeyLen)
+							{
+								node->maxSubKeyLen = static_cast<DWORD>(segment.length());
+							}
+
+							Touch(node, REG_NOTIFY_CHANGE_NAME);
+
+							node = child;
+							created = true;
+						}
+
+						return true;
+					});
+
+					*phkResult = AllocateHandle(node, samDesired);
+				}
+
+				if (created)
+				{
+					Changed();
+				}
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS CloseKey(HKEY hKey) override
+			{
+				if (IsPredefined(hKey))
+				{
+					return ERROR_SUCCESS;
+				}
+
+				if (hKey == nullptr)
+				{
+					return ERROR_INVALID_HANDLE;
+				}
+
+				auto handle = reinterpret_cast<Handle*>(hKey);
+
+				std::lock_guard<std::mutex> lock(m_handlesMutex);
+
+				if (handle->node == nullptr)
+				{
+					return ERROR_INVALID_HANDLE;
+				}
+
+				handle->node = nullptr;
+				m_freeHandles.push_back(handle);
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS DeleteTree(HKEY hKey, const wchar_t* lpSubKey) override
+			{
+				{
+					std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+					Node* node = nullptr;
+
+					LSTATUS lStatus = Resolve(hKey, DELETE | KEY_ENUMERATE_SUB_KEYS | KEY_QUERY_VALUE, &node);
+					if (lStatus != ERROR_SUCCESS)
+					{
+						return lStatus;
+					}
+
+					if (lpSubKey == nullptr)
+					{
+						// Delete subkeys and values, but keep key itself
+						for (auto child : node->subKeys)
+						{
+							ReleaseNode(child);
+						}
+
+						node->subKeys.clear();
+						node->subKeyIndex.clear();
+						node->values.clear();
+						node->valueIndex.clear();
+						node->maxSubKeyLen = 0;
+						node->maxValueNameLen = 0;
+						node->maxValueLen = 0;
+
+						Touch(node, REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET);
+					}
+					else
+					{
+						Node* target = Find(node, lpSubKey);
+						if (target == nullptr)
+						{
+							return ERROR_FILE_NOT_FOUND;
+						}
+
+						if (target == node)
+						{
+							return ERROR_INVALID_PARAMETER;
+						}
+
+						Node* parent = target->parent;
+
+						parent->subKeyIndex.erase(target->name);
+
+						for (auto it = parent->subKeys.begin(); it != parent->subKeys.end(); ++it)
+						{
+							if (*it == target)
+							{
+								parent->subKeys.erase(it);
+
+								break;
+							}
+						}
+
+						ReleaseNode(target);
+
+						Touch(parent, REG_NOTIFY_CHANGE_NAME);
+					}
+				}
+
+				Changed();
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS DeleteValue(HKEY hKey, const wchar_t* lpValueName) override
+			{
+				{
+					std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+					Node* node = nullptr;
+
+					LSTATUS lStatus = Resolve(hKey, KEY_SET_VALUE, &node);
+					if (lStatus != ERROR_SUCCESS)
+					{
+						return lStatus;
+					}
+
+					auto it = node->valueIndex.find(ValueName(lpValueName));
+					if (it == node->valueIndex.end())
+					{
+						return ERROR_FILE_NOT_FOUND;
+					}
+
+					// Move last value into place of deleted one
+					const size_t index = it->second;
+					node->valueIndex.erase(it);
+
+					if (index != node->values.size() - 1)
+					{
+						node->values[index] = std::move(node->values.back());
+						node->valueIndex[node->values[index].name] = index;
+					}
+
+					node->values.pop_back();
+
+					Touch(node, REG_NOTIFY_CHANGE_LAST_SET);
+				}
+
+				Changed();
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS FlushKey(HKEY hKey) override
+			{
+				std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+				Node* node = nullptr;
+
+				return Resolve(hKey, 0, &node);
+			}
+
+			LSTATUS SaveKey(HKEY hKey, const wchar_t* lpFile) override
+			{
+				static_cast<void>(hKey);
+				static_cast<void>(lpFile);
+
+				return ERROR_NOT_SUPPORTED;
+			}
+
+			LSTATUS QueryValue(HKEY hKey, const wchar_t* lpValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) override
+			{
+				if (lpData != nullptr && lpcbData == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+				Node* node = nullptr;
+
+				LSTATUS lStatus = Resolve(hKey, KEY_QUERY_VALUE, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				auto it = node->valueIndex.find(ValueName(lpValueName));
+				if (it == node->valueIndex.end())
+				{
+					return ERROR_FILE_NOT_FOUND;
+				}
+
+				const Value& value = node->values[it->second];
+
+				if (lpType != nullptr)
+				{
+					*lpType = value.type;
+				}
+
+				if (lpcbData == nullptr)
+				{
+					return ERROR_SUCCESS;
+				}
+
+				const auto cbData = static_cast<DWORD>(value.data.size());
+
+				if (lpData != nullptr)
+				{
+					if (*lpcbData < cbData)
+					{
+						*lpcbData = cbData;
+
+						return ERROR_MORE_DATA;
+					}
+
+					if (cbData != 0)
+					{
+						std::memcpy(lpData, value.data.data(), cbData);
+					}
+				}
+
+				*lpcbData = cbData;
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS QueryMultipleValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize) override
+			{
+				return ReadValues(hKey, val_list, num_vals, lpValueBuf, ldwTotsize, nullptr);
+			}
+
+			/// <summary>
+			///		Reads all values under single lock, so values read together are always consistent
+			/// </summary>
+			LSTATUS QueryValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize, LSTATUS* lpStatuses) override
+			{
+				if (lpStatuses == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				return ReadValues(hKey, val_list, num_vals, lpValueBuf, ldwTotsize, lpStatuses);
+			}
+
+			LSTATUS SetValue(HKEY hKey, const wchar_t* lpValueName, DWORD dwType, const BYTE* lpData, DWORD cbData) override
+			{
+				if (lpData == nullptr && cbData != 0)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				{
+					std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+					Node* node = nullptr;
+
+					LSTATUS lStatus = Resolve(hKey, KEY_SET_VALUE, &node);
+					if (lStatus != ERROR_SUCCESS)
+					{
+						return lStatus;
+					}
+
+					const auto name = ValueName(lpValueName);
+
+					Value* value = nullptr;
+
+					auto it = node->valueIndex.find(name);
+					if (it != node->valueIndex.end())
+					{
+						value = &node->values[it->second];
+					}
+					else
+					{
+						node->values.push_back(Value());
+
+						value = &node->values.back();
+						value->name.assign(name);
+
+						node->valueIndex.emplace(value->name, node->values.size() - 1);
+
+						if (name.length() > node->maxValueNameLen)
+						{
+							node->maxValueNameLen = static_cast<DWORD>(name.length());
+						}
+					}
+
+					value->type = dwType;
+					value->data.assign(lpData, lpData + cbData);
+
+					if (cbData > node->maxValueLen)
+					{
+						node->maxValueLen = cbData;
+					}
+
+					Touch(node, REG_NOTIFY_CHANGE_LAST_SET);
+				}
+
+				Changed();
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS QueryInfoKey(HKEY hKey, LPDWORD lpcSubKeys, LPDWORD lpcchMaxSubKeyLen, LPDWORD lpcValues, LPDWORD lpcchMaxValueNameLen, LPDWORD lpcbMaxValueLen, FILETIME* lpftLastWriteTime) override
+			{
+				std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+				Node* node = nullptr;
+
+				LSTATUS lStatus = Resolve(hKey, KEY_QUERY_VALUE, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				if (lpcSubKeys != nullptr)
+				{
+					*lpcSubKeys = static_cast<DWORD>(node->subKeys.size());
+				}
+
+				if (lpcchMaxSubKeyLen != nullptr)
+				{
+					*lpcchMaxSubKeyLen = node->maxSubKeyLen;
+				}
+
+				if (lpcValues != nullptr)
+				{
+					*lpcValues = static_cast<DWORD>(node->values.size());
+				}
+
+				if (lpcchMaxValueNameLen != nullptr)
+				{
+					*lpcchMaxValueNameLen = node->maxValueNameLen;
+				}
+
+				if (lpcbMaxValueLen != nullptr)
+				{
+					*lpcbMaxValueLen = node->maxValueLen;
+				}
+
+				if (lpftLastWriteTime != nullptr)
+				{
+					lpftLastWriteTime->dwLowDateTime = static_cast<DWORD>(node->lastWriteTime);
+					lpftLastWriteTime->dwHighDateTime = static_cast<DWORD>(node->lastWriteTime >> 32);
+				}
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS EnumKey(HKEY hKey, DWORD dwIndex, wchar_t* lpName, LPDWORD lpcchName) override
+			{
+				if (lpName == nullptr || lpcchName == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+				Node* node = nullptr;
+
+				LSTATUS lStatus = Resolve(hKey, KEY_ENUMERATE_SUB_KEYS, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				if (dwIndex >= node->subKeys.size())
+				{
+					return ERROR_NO_MORE_ITEMS;
+				}
+
+				const std::wstring& name = node->subKeys[dwIndex]->name;
+
+				if (name.length() + 1 > *lpcchName)
+				{
+					return ERROR_MORE_DATA;
+				}
+
+				std::memcpy(lpName, name.c_str(), (name.length() + 1) * sizeof(wchar_t));
+				*lpcchName = static_cast<DWORD>(name.length());
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS EnumValue(HKEY hKey, DWORD dwIndex, wchar_t* lpValueName, LPDWORD lpcchValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) override
+			{
+				if (lpValueName == nullptr || lpcchValueName == nullptr || (lpData != nullptr && lpcbData == nullptr))
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+				Node* node = nullptr;
+
+				LSTATUS lStatus = Resolve(hKey, KEY_QUERY_VALUE, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				if (dwIndex >= node->values.size())
+				{
+					return ERROR_NO_MORE_ITEMS;
+				}
+
+				const Value& value = node->values[dwIndex];
+
+				if (value.name.length() + 1 > *lpcchValueName)
+				{
+					return ERROR_MORE_DATA;
+				}
+
+				const auto cbData = static_cast<DWORD>(value.data.size());
+
+				if (lpData != nullptr && *lpcbData < cbData)
+				{
+					*lpcbData = cbData;
+
+					return ERROR_MORE_DATA;
+				}
+
+				std::memcpy(lpValueName, value.name.c_str(), (value.name.length() + 1) * sizeof(wchar_t));
+				*lpcchValueName = static_cast<DWORD>(value.name.length());
+
+				if (lpType != nullptr)
+				{
+					*lpType = value.type;
+				}
+
+				if (lpcbData != nullptr)
+				{
+					if (lpData != nullptr && cbData != 0)
+					{
+						std::memcpy(lpData, value.data.data(), cbData);
+					}
+
+					*lpcbData = cbData;
+				}
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS NotifyChangeKeyValue(HKEY hKey, bool watchSubtree, DWORD dwNotifyFilter, HANDLE hEvent, bool asynchronous) override
+			{
+				// There are no event objects to signal, only synchronous wait is supported
+				if (asynchronous || hEvent != nullptr)
+				{
+					return ERROR_NOT_SUPPORTED;
+				}
+
+				std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+				Node* node = nullptr;
+
+				LSTATUS lStatus = Resolve(hKey, KEY_NOTIFY, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				const DWORD generation = node->generation;
+				const auto changes = Changes(node, watchSubtree, dwNotifyFilter);
+
+				m_changed.wait(lock, [&]()
+				{
+					return node->generation != generation || Changes(node, watchSubtree, dwNotifyFilter) != changes;
+				});
+
+				return ERROR_SUCCESS;
+			}
+
+			/// <summary>
+			///		Applies batch under single exclusive lock, so readers observe either none or all of its changes.
+			///		Every applied operation records how to revert it, failed batch is reverted in reverse order.
+			///		Deleted subkeys are only detached until batch succeeds, notifications are sent once per batch.
+			/// </summary>
+			LSTATUS ApplyBatch(HKEY hKey, const BatchOperation* pOperations, DWORD cOperations) override
+			{
+				if (pOperations == nullptr && cOperations != 0)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				REGSAM required = 0;
+
+				for (DWORD i = 0; i < cOperations; ++i)
+				{
+					required |= RequiredAccess(pOperations[i].type);
+				}
+
+				{
+					std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+					Node* root = nullptr;
+
+					LSTATUS lStatus = Resolve(hKey, required, &root);
+					if (lStatus != ERROR_SUCCESS)
+					{
+						return lStatus;
+					}
+
+					m_undoCount = 0;
+
+					for (DWORD i = 0; i < cOperations; ++i)
+					{
+						lStatus = Apply(root, pOperations[i]);
+						if (lStatus != ERROR_SUCCESS)
+						{
+							Revert();
+
+							return lStatus;
+						}
+					}
+
+					const std::span<Undo> undos(m_undo.data(), m_undoCount);
+
+					// Release deleted subtrees first, so keys within them are not touched
+					for (auto& undo : undos)
+					{
+						if (undo.type == BatchOperationType::DeleteKey)
+						{
+							ReleaseNode(undo.child);
+						}
+					}
+
+					for (auto& undo : undos)
+					{
+						if (!undo.node->deleted)
+						{
+							const bool name = undo.type == BatchOperationType::CreateKey || undo.type == BatchOperationType::DeleteKey;
+
+							Touch(undo.node, name ? REG_NOTIFY_CHANGE_NAME : REG_NOTIFY_CHANGE_LAST_SET);
+						}
+					}
+
+					m_undoCount = 0;
+				}
+
+				if (cOperations != 0)
+				{
+					Changed();
+				}
+
+				return ERROR_SUCCESS;
+			}
+
+			/// <summary>
+			///		Registers callback invoked whenever change matching notify filter occurs on specified key.
+			///		Callback is invoked synchronously by thread which made the change, after change is applied and without
+			///		holding any lock, so it can change registry, subscribe or unsubscribe, including its own subscription.
+			///		Changes made by multiple threads at once may invoke same callback concurrently.
+			/// </summary>
+			/// <param name="pdwCookie">Receives cookie identifying subscription for Unsubscribe()</param>
+			LSTATUS Subscribe(HKEY hKey, bool watchSubtree, DWORD dwNotifyFilter, const std::function<void()>& callback, LPDWORD pdwCookie)
+			{
+				if (!callback || pdwCookie == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				std::lock_guard<std::mutex> subscriptionsLock(m_subscriptionsMutex);
+				std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+				Node* node = nullptr;
+
+				LSTATUS lStatus = Resolve(hKey, KEY_NOTIFY, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				Subscription& subscription = m_subscriptions[++m_lastCookie];
+				subscription.cookie = m_lastCookie;
+				subscription.node = node;
+				subscription.watched = node;
+				subscription.generation = node->generation;
+				subscription.watchSubtree = watchSubtree;
+				subscription.filter = dwNotifyFilter;
+				subscription.changes = Changes(node, watchSubtree, dwNotifyFilter);
+				subscription.listener = std::make_shared<Listener>();
+				subscription.listener->callback = callback;
+
+				m_watched.emplace(node, m_lastCookie);
+				m_subscriptionCount.store(m_subscriptions.size(), std::memory_order_relaxed);
+
+				*pdwCookie = m_lastCookie;
+
+				return ERROR_SUCCESS;
+			}
+
+			/// <summary>
+			///		Removes subscription. Once this method returns, its callback is not running and will not be invoked anymore,
+			///		unless it is called from that callback itself.
+			/// </summary>
+			LSTATUS Unsubscribe(DWORD dwCookie)
+			{
+				std::unique_lock<std::mutex> subscriptionsLock(m_subscriptionsMutex);
+
+				auto it = m_subscriptions.find(dwCookie);
+				if (it == m_subscriptions.end())
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				auto range = m_watched.equal_range(it->second.watched);
+
+				for (auto watched = range.first; watched != range.second; ++watched)
+				{
+					if (watched->second == dwCookie)
+					{
+						m_watched.erase(watched);
+
+						break;
+					}
+				}
+
+				auto listener = std::move(it->second.listener);
+
+				m_subscriptions.erase(it);
+				m_subscriptionCount.store(m_subscriptions.size(), std::memory_order_relaxed);
+
+				listener->removed.store(true);
+
+				// Callback unsubscribing itself would wait for itself, so only invocations on other threads are waited for
+				const size_t own = Invocation::Count(listener.get());
+
+				m_invoked.wait(subscriptionsLock, [&listener, own]()
+				{
+					return listener->running.load() == own;
+				});
+
+				return ERROR_SUCCESS;
+			}
+
+		private:
+			struct NameHash
+			{
+				using is_transparent = void;
+
+				size_t operator()(std::wstring_view name) const
+				{
+					// FNV-1a over upper cased characters
+					size_t hash = static_cast<size_t>(14695981039346656037ULL);
+
+					for (auto ch : name)
+					{
+						hash ^= static_cast<size_t>(Upcase(ch));
+						hash *= static_cast<size_t>(1099511628211ULL);
+					}
+
+					return hash;
+				}
+			};
+
+			struct NameEqual
+			{
+				using is_transparent = void;
+
+				bool operator()(std::wstring_view a, std::wstring_view b) const
+				{
+					if (a.length() != b.length())
+					{
+						return false;
+					}
+
+					for (size_t i = 0; i < a.length(); ++i)
+					{
+						if (a[i] != b[i] && Upcase(a[i]) != Upcase(b[i]))
+						{
+							return false;
+						}
+					}
+
+					return true;
+				}
+			};
+
+			struct Value
+			{
+				std::wstring name;
+				DWORD type = REG_NONE;
+				std::vector<BYTE> data;
+			};
+
+			struct Node
+			{
+				std::wstring name;
+				Node* parent = nullptr;
+				// Incremented whenever node is released, invalidates handles opened to it
+				DWORD generation = 0;
+				bool deleted = false;
+				DWORD options = REG_OPTION_NON_VOLATILE;
+				ULONGLONG lastWriteTime = 0;
+				// Change counters per notify filter class, for this key and for whole subtree
+				ULONGLONG nameChanges = 0;
+				ULONGLONG valueChanges = 0;
+				ULONGLONG subtreeNameChanges = 0;
+				ULONGLONG subtreeValueChanges = 0;
+				DWORD maxSubKeyLen = 0;
+				DWORD maxValueNameLen = 0;
+				DWORD maxValueLen = 0;
+				std::vector<Node*> subKeys;
+				std::unordered_map<std::wstring, Node*, NameHash, NameEqual> subKeyIndex;
+				std::vector<Value> values;
+				std::unordered_map<std::wstring, size_t, NameHash, NameEqual> valueIndex;
+			};
+
+			struct Handle
+			{
+				Node* node = nullptr;
+				DWORD generation = 0;
+				REGSAM access = 0;
+			};
+
+			/// <summary>
+			///		Callback of subscription, shared with Changed() calls invoking it, so it is invoked without holding any lock
+			/// </summary>
+			struct Listener
+			{
+				std::function<void()> callback;
+				// Invocations collected by Changed() calls and not finished yet, on all threads
+				std::atomic<size_t> running{ 0 };
+				std::atomic<bool> removed{ false };
+			};
+
+			/// <summary>
+			///		Invocation of callback on current thread, linked to invocation of callback whose change caused it
+			/// </summary>
+			class Invocation
+			{
+			public:
+				Invocation(MemoryBackend& backend, Listener& listener)
+					: m_backend(backend)
+					, m_listener(listener)
+					, m_outer(Current())
+				{
+					Current() = this;
+				}
+
+				~Invocation()
+				{
+					Current() = m_outer;
+
+					m_backend.Finished(m_listener);
+				}
+
+				// Disable copy ctor & copy assignment operator
+				Invocation(const Invocation& other) = delete;
+				Invocation& operator=(const Invocation& other) = delete;
+
+				/// <summary>
+				///		Number of invocations of listener running on current thread
+				/// </summary>
+				static size_t Count(const Listener* listener)
+				{
+					size_t count = 0;
+
+					for (const Invocation* p = Current(); p != nullptr; p = p->m_outer)
+					{
+						if (&p->m_listener == listener)
+						{
+							++count;
+						}
+					}
+
+					return count;
+				}
+
+			private:
+				static const Invocation*& Current()
+				{
+					thread_local const Invocation* current = nullptr;
+
+					return current;
+				}
+
+			private:
+				MemoryBackend& m_backend;
+				Listener& m_listener;
+				const Invocation* m_outer;
+			};
+
+			struct Subscription
+			{
+				DWORD cookie = 0;
+				// Watched node, nullptr once its deletion was reported
+				Node* node = nullptr;
+				// Watched node, kept for removal from index of watched nodes
+				Node* watched = nullptr;
+				// Last Changed() round subscription was checked in
+				ULONGLONG round = 0;
+				DWORD generation = 0;
+				bool watchSubtree = false;
+				DWORD filter = 0;
+				ULONGLONG changes = 0;
+				std::shared_ptr<Listener> listener;
+			};
+
+			/// <summary>
+			///		Record of operation applied by ApplyBatch(), holding everything needed to revert it
+			/// </summary>
+			struct Undo
+			{
+				BatchOperationType type = BatchOperationType::SetValue;
+				// Key whose subkeys or values were changed
+				Node* node = nullptr;
+				// Topmost created or detached subkey
+				Node* child = nullptr;
+				// Position of detached subkey or of changed value
+				size_t index = 0;
+				// Whether SetValue replaced existing value
+				bool existed = false;
+				// Replaced or deleted value
+				Value value;
+				DWORD maxSubKeyLen = 0;
+				DWORD maxValueNameLen = 0;
+				DWORD maxValueLen = 0;
+			};
+
+			static constexpr size_t PredefinedKeys = 8;
+
+			static wchar_t Upcase(wchar_t ch)
+			{
+				if (ch < 0x80)
+				{
+					return (ch >= L'a' && ch <= L'z') ? static_cast<wchar_t>(ch - (L'a' - L'A')) : ch;
+				}
+
+				return static_cast<wchar_t>(std::towupper(static_cast<wint_t>(ch)));
+			}
+
+			static bool IsPredefined(HKEY hKey)
+			{
+				return (reinterpret_cast<ULONG_PTR>(hKey) - reinterpret_cast<ULONG_PTR>(HKEY_CLASSES_ROOT)) < PredefinedKeys;
+			}
+
+			static std::wstring_view ValueName(const wchar_t* lpValueName)
+			{
+				return (lpValueName != nullptr) ? std::wstring_view(lpValueName) : std::wstring_view();
+			}
+
+			static ULONGLONG Now()
+			{
+				// FILETIME counts 100ns intervals since January 1, 1601
+				const auto since1970 = std::chrono::duration_cast<std::chrono::duration<long long, std::ratio<1, 10000000>>>(
+					std::chrono::system_clock::now().time_since_epoch()
+				);
+
+				return static_cast<ULONGLONG>(since1970.count()) + 116444736000000000ULL;
+			}
+
+			/// <summary>
+			///		Splits path on backslashes and invokes callback for each non-empty segment
+			/// </summary>
+			template <typename __Function>
+			static bool ForEachSegment(const wchar_t* lpPath, const __Function& callback)
+			{
+				if (lpPath == nullptr)
+				{
+					return true;
+				}
+
+				const wchar_t* p = lpPath;
+
+				for (;;)
+				{
+					const wchar_t* sep = p;
+					while (*sep != L'\0' && *sep != L'\\')
+					{
+						++sep;
+					}
+
+					if (sep != p && !callback(std::wstring_view(p, static_cast<size_t>(sep - p))))
+					{
+						return false;
+					}
+
+					if (*sep == L'\0')
+					{
+						return true;
+					}
+
+					p = sep + 1;
+				}
+			}
+
+			Node* Find(Node* node, const wchar_t* lpSubKey) const
+			{
+				ForEachSegment(lpSubKey, [&node](std::wstring_view segment) -> bool
+				{
+					auto it = node->subKeyIndex.find(segment);
+
+					node = (it != node->subKeyIndex.end()) ? it->second : nullptr;
+
+					return node != nullptr;
+				});
+
+				return node;
+			}
+
+			/// <summary>
+			///		Common part of QueryMultipleValues() and QueryValues(). Without statuses, missing value fails whole call.
+			/// </summary>
+			LSTATUS ReadValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize, LSTATUS* lpStatuses)
+			{
+				if (val_list == nullptr || ldwTotsize == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+				Node* node = nullptr;
+
+				LSTATUS lStatus = Resolve(hKey, KEY_QUERY_VALUE, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				// First pass looks up values and computes total size, value index is parked in ve_valueptr
+				DWORD cbTotal = 0;
+
+				for (DWORD i = 0; i < num_vals; ++i)
+				{
+					auto it = node->valueIndex.find(ValueName(val_list[i].ve_valuename));
+					if (it == node->valueIndex.end())
+					{
+						if (lpStatuses == nullptr)
+						{
+							return ERROR_FILE_NOT_FOUND;
+						}
+
+						lpStatuses[i] = ERROR_FILE_NOT_FOUND;
+
+						val_list[i].ve_valuelen = 0;
+						val_list[i].ve_valueptr = 0;
+						val_list[i].ve_type = REG_NONE;
+
+						continue;
+					}
+
+					if (lpStatuses != nullptr)
+					{
+						lpStatuses[i] = ERROR_SUCCESS;
+					}
+
+					const Value& value = node->values[it->second];
+
+					val_list[i].ve_valuelen = static_cast<DWORD>(value.data.size());
+					val_list[i].ve_valueptr = static_cast<DWORD_PTR>(it->second);
+					val_list[i].ve_type = value.type;
+
+					cbTotal += val_list[i].ve_valuelen;
+				}
+
+				if (lpValueBuf == nullptr)
+				{
+					*ldwTotsize = cbTotal;
+
+					return ERROR_SUCCESS;
+				}
+
+				if (*ldwTotsize < cbTotal)
+				{
+					*ldwTotsize = cbTotal;
+
+					return ERROR_MORE_DATA;
+				}
+
+				LPBYTE p = lpValueBuf;
+
+				for (DWORD i = 0; i < num_vals; ++i)
+				{
+					if (lpStatuses != nullptr && lpStatuses[i] != ERROR_SUCCESS)
+					{
+						continue;
+					}
+
+					const Value& value = node->values[static_cast<size_t>(val_list[i].ve_valueptr)];
+
+					if (!value.data.empty())
+					{
+						std::memcpy(p, value.data.data(), value.data.size());
+					}
+
+					val_list[i].ve_valueptr = reinterpret_cast<DWORD_PTR>(p);
+
+					p += value.data.size();
+				}
+
+				*ldwTotsize = cbTotal;
+
+				return ERROR_SUCCESS;
+			}
+
+			/// <summary>
+			///		Translates key handle to tree node, checking that handle grants required access rights
+			/// </summary>
+			LSTATUS Resolve(HKEY hKey, REGSAM required, Node** ppNode) const
+			{
+				if (IsPredefined(hKey))
+				{
+					*ppNode = m_roots[reinterpret_cast<ULONG_PTR>(hKey) - reinterpret_cast<ULONG_PTR>(HKEY_CLASSES_ROOT)];
+
+					return ERROR_SUCCESS;
+				}
+
+				if (hKey == nullptr)
+				{
+					return ERROR_INVALID_HANDLE;
+				}
+
+				auto handle = reinterpret_cast<const Handle*>(hKey);
+
+				Node* node = handle->node;
+				if (node == nullptr)
+				{
+					return ERROR_INVALID_HANDLE;
+				}
+
+				if (node->generation != handle->generation || node->deleted)
+				{
+					return ERROR_KEY_DELETED;
+				}
+
+				if ((handle->access & required) != required)
+				{
+					return ERROR_ACCESS_DENIED;
+				}
+
+				*ppNode = node;
+
+				return ERROR_SUCCESS;
+			}
+
+			Node* AllocateNode(Node* parent, std::wstring_view name)
+			{
+				Node* node = nullptr;
+
+				if (!m_freeNodes.empty())
+				{
+					node = m_freeNodes.back();
+					m_freeNodes.pop_back();
+				}
+				else
+				{
+					m_nodes.emplace_back();
+					node = &m_nodes.back();
+				}
+
+				node->name.assign(name);
+				node->parent = parent;
+				node->deleted = false;
+				node->options = REG_OPTION_NON_VOLATILE;
+				node->lastWriteTime = Now();
+
+				return node;
+			}
+
+			/// <summary>
+			///		Returns node with whole its subtree back to arena
+			/// </summary>
+			void ReleaseNode(Node* node)
+			{
+				for (auto child : node->subKeys)
+				{
+					ReleaseNode(child);
+				}
+
+				node->subKeys.clear();
+				node->subKeyIndex.clear();
+				node->values.clear();
+				node->valueIndex.clear();
+				node->maxSubKeyLen = 0;
+				node->maxValueNameLen = 0;
+				node->maxValueLen = 0;
+				node->parent = nullptr;
+				node->deleted = true;
+
+				++node->generation;
+
+				m_freeNodes.push_back(node);
+
+				if (m_subscriptionCount.load(std::memory_order_relaxed) != 0)
+				{
+					// Subscriptions of deleted key are reported by next Changed()
+					m_touched.push_back(node);
+				}
+			}
+
+			HKEY AllocateHandle(Node* node, REGSAM access)
+			{
+				std::lock_guard<std::mutex> lock(m_handlesMutex);
+
+				Handle* handle = nullptr;
+
+				if (!m_freeHandles.empty())
+				{
+					handle = m_freeHandles.back();
+					m_freeHandles.pop_back();
+				}
+				else
+				{
+					m_handles.emplace_back();
+					handle = &m_handles.back();
+				}
+
+				handle->node = node;
+				handle->generation = node->generation;
+				handle->access = access;
+
+				return reinterpret_cast<HKEY>(handle);
+			}
+
+			static REGSAM RequiredAccess(BatchOperationType type)
+			{
+				switch (type)
+				{
+					case BatchOperationType::CreateKey: return KEY_CREATE_SUB_KEY;
+					case BatchOperationType::DeleteKey: return DELETE | KEY_ENUMERATE_SUB_KEYS | KEY_QUERY_VALUE;
+					default: return KEY_SET_VALUE;
+				}
+			}
+
+			Undo& AddUndo(BatchOperationType type, Node* node)
+			{
+				// Records are reused by subsequent batches, so buffers of replaced values are not allocated again
+				if (m_undoCount == m_undo.size())
+				{
+					m_undo.emplace_back();
+				}
+
+				Undo& undo = m_undo[m_undoCount++];
+				undo.type = type;
+				undo.node = node;
+				undo.child = nullptr;
+				undo.index = 0;
+				undo.existed = false;
+				undo.value.name.clear();
+				undo.value.type = REG_NONE;
+				undo.value.data.clear();
+				undo.maxSubKeyLen = node->maxSubKeyLen;
+				undo.maxValueNameLen = node->maxValueNameLen;
+				undo.maxValueLen = node->maxValueLen;
+
+				return undo;
+			}
+
+			/// <summary>
+			///		Applies single batch operation, recording how to revert it
+			/// </summary>
+			LSTATUS Apply(Node* root, const BatchOperation& operation)
+			{
+				if (operation.type == BatchOperationType::CreateKey)
+				{
+					Node* node = root;
+					Undo* undo = nullptr;
+
+					ForEachSegment(operation.lpSubKey, [&](std::wstring_view segment) -> bool
+					{
+						auto it = node->subKeyIndex.find(segment);
+						if (it != node->subKeyIndex.end())
+						{
+							node = it->second;
+
+							return true;
+						}
+
+						if (undo == nullptr)
+						{
+							// Reverting creation of topmost created key releases whole created path
+							undo = &AddUndo(BatchOperationType::CreateKey, node);
+						}
+
+						Node* child = AllocateNode(node, segment);
+
+						node->subKeyIndex.emplace(child->name, child);
+						node->subKeys.push_back(child);
+
+						if (segment.length() > node->maxSubKeyLen)
+						{
+							node->maxSubKeyLen = static_cast<DWORD>(segment.length());
+						}
+
+						if (undo->child == nullptr)
+						{
+							undo->child = child;
+						}
+
+						node = child;
+
+						return true;
+					});
+
+					return ERROR_SUCCESS;
+				}
+
+				Node* node = Find(root, operation.lpSubKey);
+				if (node == nullptr)
+				{
+					return ERROR_FILE_NOT_FOUND;
+				}
+
+				switch (operation.type)
+				{
+					case BatchOperationType::DeleteKey:
+					{
+						if (node == root)
+						{
+							return ERROR_INVALID_PARAMETER;
+						}
+
+						Node* parent = node->parent;
+
+						auto it = std::find(parent->subKeys.begin(), parent->subKeys.end(), node);
+
+						Undo& undo = AddUndo(BatchOperationType::DeleteKey, parent);
+						undo.child = node;
+						undo.index = static_cast<size_t>(it - parent->subKeys.begin());
+
+						parent->subKeys.erase(it);
+						parent->subKeyIndex.erase(node->name);
+					}
+					break;
+
+					case BatchOperationType::SetValue:
+					{
+						if (operation.lpData == nullptr && operation.cbData != 0)
+						{
+							return ERROR_INVALID_PARAMETER;
+						}
+
+						const auto name = ValueName(operation.lpValueName);
+
+						Undo& undo = AddUndo(BatchOperationType::SetValue, node);
+
+						Value* value = nullptr;
+
+						auto it = node->valueIndex.find(name);
+						if (it != node->valueIndex.end())
+						{
+							value = &node->values[it->second];
+
+							undo.existed = true;
+							undo.index = it->second;
+							undo.value.type = value->type;
+							undo.value.data.assign(value->data.begin(), value->data.end());
+						}
+						else
+						{
+							node->values.push_back(Value());
+
+							value = &node->values.back();
+							value->name.assign(name);
+
+							node->valueIndex.emplace(value->name, node->values.size() - 1);
+
+							if (name.length() > node->maxValueNameLen)
+							{
+								node->maxValueNameLen = static_cast<DWORD>(name.length());
+							}
+						}
+
+						value->type = operation.dwType;
+						value->data.assign(operation.lpData, operation.lpData + operation.cbData);
+
+						if (operation.cbData > node->maxValueLen)
+						{
+							node->maxValueLen = operation.cbData;
+						}
+					}
+					break;
+
+					case BatchOperationType::DeleteValue:
+					{
+						auto it = node->valueIndex.find(ValueName(operation.lpValueName));
+						if (it == node->valueIndex.end())
+						{
+							return ERROR_FILE_NOT_FOUND;
+						}
+
+						const size_t index = it->second;
+
+						Undo& undo = AddUndo(BatchOperationType::DeleteValue, node);
+						undo.index = index;
+						undo.value = std::move(node->values[index]);
+
+						node->valueIndex.erase(it);
+
+						// Move last value into place of deleted one
+						if (index != node->values.size() - 1)
+						{
+							node->values[index] = std::move(node->values.back());
+							node->valueIndex[node->values[index].name] = index;
+						}
+
+						node->values.pop_back();
+					}
+					break;
+
+					default:
+					{
+						return ERROR_INVALID_PARAMETER;
+					}
+				}
+
+				return ERROR_SUCCESS;
+			}
+
+			/// <summary>
+			///		Reverts operations applied by failed batch, in reverse order
+			/// </summary>
+			void Revert()
+			{
+				for (size_t i = m_undoCount; i-- > 0; )
+				{
+					Undo& undo = m_undo[i];
+					Node* node = undo.node;
+
+					switch (undo.type)
+					{
+						case BatchOperationType::CreateKey:
+						{
+							// Created key is still last subkey, as later operations were reverted already
+							node->subKeys.pop_back();
+							node->subKeyIndex.erase(undo.child->name);
+
+							ReleaseNode(undo.child);
+						}
+						break;
+
+						case BatchOperationType::DeleteKey:
+						{
+							node->subKeys.insert(node->subKeys.begin() + static_cast<std::ptrdiff_t>(undo.index), undo.child);
+							node->subKeyIndex.emplace(undo.child->name, undo.child);
+						}
+						break;
+
+						case BatchOperationType::SetValue:
+						{
+							if (undo.existed)
+							{
+								Value& value = node->values[undo.index];
+
+								value.type = undo.value.type;
+								value.data.swap(undo.value.data);
+							}
+							else
+							{
+								node->valueIndex.erase(node->values.back().name);
+								node->values.pop_back();
+							}
+						}
+						break;
+
+						case BatchOperationType::DeleteValue:
+						{
+							node->values.push_back(std::move(undo.value));
+
+							const size_t last = node->values.size() - 1;
+
+							if (undo.index != last)
+							{
+								std::swap(node->values[undo.index], node->values[last]);
+
+								node->valueIndex[node->values[last].name] = last;
+							}
+
+							node->valueIndex[node->values[undo.index].name] = undo.index;
+						}
+						break;
+					}
+
+					node->maxSubKeyLen = undo.maxSubKeyLen;
+					node->maxValueNameLen = undo.maxValueNameLen;
+					node->maxValueLen = undo.maxValueLen;
+				}
+
+				m_undoCount = 0;
+			}
+
+			/// <summary>
+			///		Records change of specified kind on node and its ancestors
+			/// </summary>
+			void Touch(Node* node, DWORD dwNotifyFilter)
+			{
+				node->lastWriteTime = Now();
+
+				if (dwNotifyFilter & REG_NOTIFY_CHANGE_NAME)
+				{
+					++node->nameChanges;
+				}
+
+				if (dwNotifyFilter & REG_NOTIFY_CHANGE_LAST_SET)
+				{
+					++node->valueChanges;
+				}
+
+				for (Node* p = node; p != nullptr; p = p->parent)
+				{
+					if (dwNotifyFilter & REG_NOTIFY_CHANGE_NAME)
+					{
+						++p->subtreeNameChanges;
+					}
+
+					if (dwNotifyFilter & REG_NOTIFY_CHANGE_LAST_SET)
+					{
+						++p->subtreeValueChanges;
+					}
+				}
+
+				if (m_subscriptionCount.load(std::memory_order_relaxed) != 0)
+				{
+					m_touched.push_back(node);
+				}
+			}
+
+			/// <summary>
+			///		Wakes synchronous waiters and invokes callbacks of subscriptions whose keys changed
+			/// </summary>
+			void Changed()
+			{
+				m_changed.notify_all();
+
+				std::vector<std::shared_ptr<Listener>> fired;
+
+				{
+					std::lock_guard<std::mutex> subscriptionsLock(m_subscriptionsMutex);
+
+					if (m_subscriptions.empty())
+					{
+						return;
+					}
+
+					std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+					// Nodes are touched under exclusive lock only, while Changed() calls are serialized by m_subscriptionsMutex
+					std::swap(m_touched, m_changedNodes);
+					m_touched.clear();
+
+					++m_round;
+
+					// Only subscriptions of changed keys and their parents are checked, so cost of change
+					// does not grow with number of subscriptions
+					for (Node* changed : m_changedNodes)
+					{
+						for (Node* p = changed; p != nullptr; p = p->parent)
+						{
+							auto range = m_watched.equal_range(p);
+
+							for (auto watched = range.first; watched != range.second; ++watched)
+							{
+								auto& subscription = m_subscriptions.find(watched->second)->second;
+
+								if (subscription.round != m_round)
+								{
+									subscription.round = m_round;
+
+									CheckSubscription(subscription, fired);
+								}
+							}
+						}
+					}
+
+					m_changedNodes.clear();
+				}
+
+				// Counters are already updated, so change made while callback runs is reported again.
+				// Callbacks are invoked without lock, listener unsubscribed meanwhile is skipped.
+				size_t i = 0;
+
+				try
+				{
+					for (; i < fired.size(); ++i)
+					{
+						Invocation invocation(*this, *fired[i]);
+
+						if (!fired[i]->removed.load())
+						{
+							fired[i]->callback();
+						}
+					}
+				}
+				catch (...)
+				{
+					// Invocation of throwing callback is finished already, the rest is skipped
+					for (++i; i < fired.size(); ++i)
+					{
+						Finished(*fired[i]);
+					}
+
+					throw;
+				}
+			}
+
+			/// <summary>
+			///		Ends invocation of listener collected by Changed(), waking Unsubscribe() waiting for it
+			/// </summary>
+			void Finished(Listener& listener)
+			{
+				listener.running.fetch_sub(1);
+
+				if (listener.removed.load())
+				{
+					std::lock_guard<std::mutex> subscriptionsLock(m_subscriptionsMutex);
+
+					m_invoked.notify_all();
+				}
+			}
+
+			void CheckSubscription(Subscription& subscription, std::vector<std::shared_ptr<Listener>>& fired)
+			{
+				if (subscription.node == nullptr)
+				{
+					return;
+				}
+
+				if (subscription.node->generation != subscription.generation)
+				{
+					// Key was deleted, report it once and stop watching
+					subscription.node = nullptr;
+
+					fired.push_back(subscription.listener);
+
+					++subscription.listener->running;
+				}
+				else
+				{
+					const auto changes = Changes(subscription.node, subscription.watchSubtree, subscription.filter);
+					if (changes != subscription.changes)
+					{
+						subscription.changes = changes;
+
+						fired.push_back(subscription.listener);
+
+						++subscription.listener->running;
+					}
+				}
+			}
+
+			static ULONGLONG Changes(const Node* node, bool watchSubtree, DWORD dwNotifyFilter)
+			{
+				ULONGLONG changes = 0;
+
+				if (dwNotifyFilter & REG_NOTIFY_CHANGE_NAME)
+				{
+					changes += watchSubtree ? node->subtreeNameChanges : node->nameChanges;
+				}
+
+				if (dwNotifyFilter & REG_NOTIFY_CHANGE_LAST_SET)
+				{
+					changes += watchSubtree ? node->subtreeValueChanges : node->valueChanges;
+				}
+
+				return changes;
+			}
+
+		private:
+			mutable std::shared_mutex m_mutex;
+			std::condition_variable_any m_changed;
+
+			std::deque<Node> m_nodes;
+			std::vector<Node*> m_freeNodes;
+			Node* m_roots[PredefinedKeys];
+
+			std::mutex m_handlesMutex;
+			std::deque<Handle> m_handles;
+			std::vector<Handle*> m_freeHandles;
+
+			std::mutex m_subscriptionsMutex;
+			// Signaled when invocation of unsubscribed listener finishes
+			std::condition_variable m_invoked;
+			std::unordered_map<DWORD, Subscription> m_subscriptions;
+			// Subscriptions by watched node, so change is matched only against subscriptions of its key and parents
+			std::unordered_multimap<Node*, DWORD> m_watched;
+			std::atomic<size_t> m_subscriptionCount{ 0 };
+			// Nodes changed since last Changed(), guarded by exclusive lock of m_mutex
+			std::vector<Node*> m_touched;
+			std::vector<Node*> m_changedNodes;
+			ULONGLONG m_round = 0;
+			DWORD m_lastCookie = 0;
+
+			// Operations applied by batch being committed, guarded by exclusive lock of m_mutex.
+			// Only first m_undoCount records belong to current batch, the rest is kept for reuse.
+			std::vector<Undo> m_undo;
+			size_t m_undoCount = 0;
+		};
+	}
+}
@@ -0,0 +1,513 @@
+#pragma once
+
+#include <Registry.hpp>
+#include <KeyCache.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Opens keys below common root, resolving only part of path which was not opened yet. Keys are kept
+		///		in trie of case folded path segments, key is opened relative to its deepest already opened ancestor,
+		///		so opening siblings under deep prefix does not resolve that prefix again and again.
+		/// </summary>
+		/// <remarks>
+		///		Parent of each opened key is opened and kept too, as it is most likely shared by siblings.
+		///		Kept handles stay bound to keys they were opened for. When key is deleted and created again,
+		///		call Invalidate() or Clear() to get rid of stale handles.
+		///		Number of kept keys is bounded by capacity, once it is reached, all kept keys are released
+		///		before next one is kept, so trie never holds more open handles than that.
+		/// </remarks>
+		class PathTrie
+		{
+		public:
+			/// <param name="root">Key paths are relative to</param>
+			/// <param name="access">Access rights all keys are opened with</param>
+			/// <param name="capacity">Maximum number of kept keys, including parents</param>
+			explicit PathTrie(const RegistryKey_ptr& root, DesiredAccess access = DesiredAccess::Read, size_t capacity = 4096)
+				: m_root(root)
+				, m_access(access)
+				, m_capacity(capacity)
+				, m_size(0)
+				, m_hits(0)
+				, m_misses(0)
+			{
+				if (m_root == nullptr)
+				{
+					throw std::invalid_argument("Registry key cannot be nullptr");
+				}
+
+				if (m_capacity == 0)
+				{
+					throw std::invalid_argument("Path trie capacity cannot be zero");
+				}
+			}
+
+			// Disable copy ctor & copy assignment operator
+			PathTrie(const PathTrie& other) = delete;
+			PathTrie& operator=(const PathTrie& other) = delete;
+
+			/// <summary>
+			///		Same as root->Open(path, access), reusing already opened keys
+			/// </summary>
+			RegistryKey_ptr Open(std::wstring_view path)
+			{
+				if (path.empty())
+				{
+					throw std::invalid_argument("Specified path to registry key cannot be empty");
+				}
+
+				std::error_code ec;
+
+				auto key = TryOpen(path, ec);
+				if (key == nullptr)
+				{
+					throw std::system_error(ec, "RegOpenKeyEx() failed");
+				}
+
+				return key;
+			}
+
+			/// <summary>
+			///		Same as Open(), but reports failure via error code instead of throwing exception
+			/// </summary>
+			/// <returns>Opened registry key, or nullptr when key could not be opened</returns>
+			RegistryKey_ptr TryOpen(std::wstring_view path, std::error_code& ec)
+			{
+				// Path is case folded once into per thread buffer, segments are looked up as views into it
+				thread_local std::wstring normalized;
+
+				KeyCache::Normalize(path, normalized);
+
+				if (normalized.empty())
+				{
+					ec = std::error_code(ERROR_INVALID_PARAMETER, std::system_category());
+
+					return nullptr;
+				}
+
+				ec = std::error_code();
+
+				RegistryKey_ptr ancestor;
+				size_t ancestorLength = 0;
+
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+
+					auto key = Find(normalized, ancestor, ancestorLength);
+					if (key != nullptr)
+					{
+						++m_hits;
+
+						return key;
+					}
+
+					++m_misses;
+				}
+
+				// Keys are opened without lock held, so slow open does not block other lookups
+				const size_t parentLength = normalized.rfind(L'\\');
+
+				if (parentLength != std::wstring::npos && parentLength > ancestorLength)
+				{
+					auto parent = ancestor->TryOpen(Suffix(normalized, ancestorLength, parentLength), m_access, ec);
+					if (parent == nullptr)
+					{
+						return nullptr;
+					}
+
+					ancestor = Insert(std::wstring_view(normalized).substr(0, parentLength), parent);
+					ancestorLength = parentLength;
+				}
+
+				auto key = ancestor->TryOpen(Suffix(normalized, ancestorLength, normalized.length()), m_access, ec);
+				if (key == nullptr)
+				{
+					return nullptr;
+				}
+
+				return Insert(normalized, key);
+			}
+
+			/// <summary>
+			///		Opens multiple keys, sharing their common parents. Keys which could not be opened are returned as nullptr.
+			/// </summary>
+			/// <remarks>
+			///		Paths are sorted, so paths sharing prefix are next to each other. Longest prefix each path shares
+			///		with its neighbours is opened once, before path itself is opened relative to it. When prefix cannot
+			///		be opened, paths below it are not tried at all.
+			/// </remarks>
+			/// <returns>Keys in same order as their paths</returns>
+			std::vector<RegistryKey_ptr> OpenMany(const std::vector<std::wstring>& paths)
+			{
+				std::vector<std::wstring> normalized(paths.size());
+				std::vector<size_t> order(paths.size());
+
+				for (size_t i = 0; i < paths.size(); ++i)
+				{
+					KeyCache::Normalize(paths[i], normalized[i]);
+
+					order[i] = i;
+				}
+
+				std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs)
+				{
+					return normalized[lhs] < normalized[rhs];
+				});
+
+				std::vector<RegistryKey_ptr> keys(paths.size());
+
+				// Views into normalized paths, which are not modified anymore
+				std::wstring_view opened;
+				std::wstring_view failed;
+
+				std::error_code ec;
+
+				for (size_t i = 0; i < order.size(); ++i)
+				{
+					const std::wstring_view path = normalized[order[i]];
+
+					if (path.empty() || (!failed.empty() && IsBelow(path, failed)))
+					{
+						continue;
+					}
+
+					size_t shared = 0;
+
+					if (i > 0)
+					{
+						shared = SharedLength(path, normalized[order[i - 1]]);
+					}
+
+					if (i + 1 < order.size())
+					{
+						shared = (std::max)(shared, SharedLength(path, normalized[order[i + 1]]));
+					}
+
+					if (shared != 0 && shared < path.length())
+					{
+						const auto prefix = path.substr(0, shared);
+
+						if (prefix != opened)
+						{
+							if (TryOpen(prefix, ec) == nullptr)
+							{
+								failed = prefix;
+
+								continue;
+							}
+
+							opened = prefix;
+						}
+					}
+
+					keys[order[i]] = TryOpen(path, ec);
+				}
+
+				return keys;
+			}
+
+			/// <summary>
+			///		Releases key on specified path and all kept keys below it
+			/// </summary>
+			void Invalidate(std::wstring_view path)
+			{
+				const auto normalized = KeyCache::Normalize(path);
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				if (normalized.empty())
+				{
+					ReleaseAll();
+
+					return;
+				}
+
+				Node* node = &m_trie;
+				size_t start = 0;
+
+				for (;;)
+				{
+					size_t end = normalized.find(L'\\', start);
+					if (end == std::wstring::npos)
+					{
+						end = normalized.length();
+					}
+
+					auto it = node->children.find(std::wstring_view(normalized).substr(start, end - start));
+					if (it == node->children.end())
+					{
+						return;
+					}
+
+					if (end == normalized.length())
+					{
+						Release(*it->second);
+
+						node->children.erase(it);
+
+						return;
+					}
+
+					node = it->second.get();
+					start = end + 1;
+				}
+			}
+
+			/// <summary>
+			///		Releases all kept keys and interned segments
+			/// </summary>
+			void Clear()
+			{
+				Invalidate(std::wstring_view());
+			}
+
+			/// <summary>
+			///		Number of kept keys, including parents
+			/// </summary>
+			size_t Size() const
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				return m_size;
+			}
+
+			/// <summary>
+			///		Maximum number of kept keys, including parents
+			/// </summary>
+			size_t Capacity() const
+			{
+				return m_capacity;
+			}
+
+			/// <summary>
+			///		Number of requests served by already opened key
+			/// </summary>
+			size_t Hits() const
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				return m_hits;
+			}
+
+			/// <summary>
+			///		Number of requests which had to open key
+			/// </summary>
+			size_t Misses() const
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				return m_misses;
+			}
+
+		private:
+			struct Node
+			{
+				// Opened key, nullptr for keys which are only part of path to other keys
+				RegistryKey_ptr key;
+				// Keyed by interned segments
+				std::unordered_map<std::wstring_view, std::unique_ptr<Node>> children;
+			};
+
+			/// <summary>
+			///		Part of normalized path between two separators
+			/// </summary>
+			static std::wstring_view Suffix(const std::wstring& normalized, size_t start, size_t end)
+			{
+				// Path of ancestor other than root is followed by separator
+				if (start != 0)
+				{
+					++start;
+				}
+
+				return std::wstring_view(normalized).substr(start, end - start);
+			}
+
+			/// <summary>
+			///		Length of longest path both normalized paths start with, ending at segment boundary
+			/// </summary>
+			static size_t SharedLength(std::wstring_view lhs, std::wstring_view rhs)
+			{
+				const auto mismatch = std::mismatch(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+				const size_t length = static_cast<size_t>(mismatch.first - lhs.begin());
+
+				if ((length == lhs.length() || lhs[length] == L'\\') && (length == rhs.length() || rhs[length] == L'\\'))
+				{
+					return length;
+				}
+
+				const size_t separator = length != 0 ? lhs.rfind(L'\\', length - 1) : std::wstring_view::npos;
+
+				return separator != std::wstring_view::npos ? separator : 0;
+			}
+
+			/// <summary>
+			///		Returns true when normalized path is same as ancestor or lies below it
+			/// </summary>
+			static bool IsBelow(std::wstring_view path, std::wstring_view ancestor)
+			{
+				return path.starts_with(ancestor) && (path.length() == ancestor.length() || path[ancestor.length()] == L'\\');
+			}
+
+			/// <summary>
+			///		Returns key on normalized path, when it is already opened. Otherwise returns its deepest opened ancestor.
+			/// </summary>
+			RegistryKey_ptr Find(const std::wstring& normalized, RegistryKey_ptr& ancestor, size_t& ancestorLength) const
+			{
+				ancestor = m_root;
+				ancestorLength = 0;
+
+				const Node* node = &m_trie;
+				size_t start = 0;
+
+				while (start <= normalized.length())
+				{
+					size_t end = normalized.find(L'\\', start);
+					if (end == std::wstring::npos)
+					{
+						end = normalized.length();
+					}
+
+					auto it = node->children.find(std::wstring_view(normalized).substr(start, end - start));
+					if (it == node->children.end())
+					{
+						break;
+					}
+
+					node = it->second.get();
+
+					if (node->key != nullptr)
+					{
+						if (end == normalized.length())
+						{
+							return node->key;
+						}
+
+						ancestor = node->key;
+						ancestorLength = end;
+					}
+
+					start = end + 1;
+				}
+
+				return nullptr;
+			}
+
+			/// <summary>
+			///		Keeps opened key, returns key kept by other thread which opened same key meanwhile
+			/// </summary>
+			RegistryKey_ptr Insert(std::wstring_view normalized, const RegistryKey_ptr& key)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				// Segments are views into caller's path, so they stay valid after interned ones are released
+				if (m_size >= m_capacity)
+				{
+					ReleaseAll();
+				}
+
+				Node* node = &m_trie;
+				size_t start = 0;
+
+				while (start <= normalized.length())
+				{
+					size_t end = normalized.find(L'\\', start);
+					if (end == std::wstring_view::npos)
+					{
+						end = normalized.length();
+					}
+
+					const auto segment = normalized.substr(start, end - start);
+
+					auto it = node->children.find(segment);
+					if (it == node->children.end())
+					{
+						it = node->children.emplace(Intern(segment), std::make_unique<Node>()).first;
+					}
+
+					node = it->second.get();
+					start = end + 1;
+				}
+
+				if (node->key == nullptr)
+				{
+					node->key = key;
+
+					++m_size;
+				}
+
+				return node->key;
+			}
+
+			/// <summary>
+			///		Returns view of segment stored once for whole trie, so segments repeated on many paths
+			///		like "Parameters" are not stored by each node again
+			/// </summary>
+			std::wstring_view Intern(std::wstring_view segment)
+			{
+				auto it = m_segments.find(segment);
+				if (it != m_segments.end())
+				{
+					return *it;
+				}
+
+				// Deque does not move its elements, so views of stored segments stay valid
+				m_storage.emplace_back(segment);
+
+				return *m_segments.insert(m_storage.back()).first;
+			}
+
+			/// <summary>
+			///		Releases whole trie, interned segments are dropped too as no node refers to them anymore
+			/// </summary>
+			void ReleaseAll()
+			{
+				Release(m_trie);
+
+				m_segments.clear();
+				m_storage.clear();
+			}
+
+			void Release(Node& node)
+			{
+				for (auto& child : node.children)
+				{
+					Release(*child.second);
+				}
+
+				node.children.clear();
+
+				if (node.key != nullptr)
+				{
+					node.key = nullptr;
+
+					--m_size;
+				}
+			}
+
+		private:
+			RegistryKey_ptr m_root;
+			DesiredAccess m_access;
+			const size_t m_capacity;
+			mutable std::mutex m_mutex;
+			Node m_trie;
+			std::deque<std::wstring> m_storage;
+			std::unordered_set<std::wstring_view> m_segments;
+			size_t m_size;
+			size_t m_hits;
+			size_t m_misses;
+		};
+	}
+}
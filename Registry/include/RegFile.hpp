@@ -0,0 +1,1305 @@
+#pragma once
+
+#include <Registry.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		enum class RegFileFormat
+		{
+			// "REGEDIT4" header, 8 bit text
+			Regedit4,
+			// "Windows Registry Editor Version 5.00" header, UTF-16LE text
+			Regedit5
+		};
+
+		struct RegImportResult
+		{
+			// Number of keys created or opened
+			size_t keys = 0;
+			// Number of values set
+			size_t values = 0;
+			// Number of keys and values deleted
+			size_t deleted = 0;
+		};
+
+		/// <summary>
+		///		Reads lines of .reg file from stream. Stream is read in chunks of fixed size, so memory used
+		///		depends on length of longest line, not on size of file.
+		/// </summary>
+		/// <remarks>
+		///		Text is UTF-16LE when file starts with byte order mark, UTF-8 otherwise. Bytes which do not form
+		///		valid UTF-8 sequence are read as Latin-1 characters, which covers files saved in ANSI code page.
+		///		Line breaks are searched with memchr(), which C runtimes implement with vector instructions.
+		/// </remarks>
+		class RegFileReader
+		{
+		public:
+			explicit RegFileReader(std::istream& in)
+				: m_in(in)
+				, m_buffer(ChunkSize)
+				, m_begin(0)
+				, m_end(0)
+				, m_eof(false)
+				, m_wide(false)
+				, m_line(0)
+			{
+				Fill();
+
+				const auto* data = reinterpret_cast<const unsigned char*>(m_buffer.data());
+				const size_t cb = m_end - m_begin;
+
+				if (cb >= 2 && data[0] == 0xFF && data[1] == 0xFE)
+				{
+					m_wide = true;
+					m_begin += 2;
+				}
+				else if (cb >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF)
+				{
+					m_begin += 3;
+				}
+				else if (cb >= 2 && data[0] != 0 && data[1] == 0)
+				{
+					// UTF-16LE without byte order mark
+					m_wide = true;
+				}
+			}
+
+			// Disable copy ctor & copy assignment operator
+			RegFileReader(const RegFileReader& other) = delete;
+			RegFileReader& operator=(const RegFileReader& other) = delete;
+
+			/// <summary>
+			///		Reads next line without line break
+			/// </summary>
+			/// <returns>false when end of stream was reached</returns>
+			bool ReadLine(std::wstring& line)
+			{
+				line.clear();
+
+				for (;;)
+				{
+					const size_t newline = FindNewline();
+					if (newline != std::string::npos)
+					{
+						Decode(m_buffer.data() + m_begin, newline - m_begin, line);
+
+						m_begin = newline + (m_wide ? 2 : 1);
+
+						break;
+					}
+
+					if (m_eof)
+					{
+						if (m_begin == m_end)
+						{
+							return false;
+						}
+
+						Decode(m_buffer.data() + m_begin, m_end - m_begin, line);
+
+						m_begin = m_end;
+
+						break;
+					}
+
+					Fill();
+				}
+
+				if (!line.empty() && line.back() == L'\r')
+				{
+					line.pop_back();
+				}
+
+				++m_line;
+
+				return true;
+			}
+
+			/// <summary>
+			///		Number of line read last, first line has number 1
+			/// </summary>
+			size_t Line() const
+			{
+				return m_line;
+			}
+
+		private:
+			static constexpr size_t ChunkSize = 64 * 1024;
+
+			/// <summary>
+			///		Moves unread data to start of buffer and reads next chunk after it.
+			///		Buffer grows only when single line does not fit into it.
+			/// </summary>
+			void Fill()
+			{
+				if (m_begin > 0)
+				{
+					std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+
+					m_end -= m_begin;
+					m_begin = 0;
+				}
+
+				if (m_end == m_buffer.size())
+				{
+					m_buffer.resize(m_buffer.size() * 2);
+				}
+
+				m_in.read(m_buffer.data() + m_end, static_cast<std::streamsize>(m_buffer.size() - m_end));
+
+				m_end += static_cast<size_t>(m_in.gcount());
+
+				if (!m_in)
+				{
+					m_eof = true;
+				}
+			}
+
+			/// <summary>
+			///		Returns offset of line feed in unread data, or npos
+			/// </summary>
+			size_t FindNewline() const
+			{
+				const char* data = m_buffer.data();
+				const char* p = data + m_begin;
+				const char* end = data + m_end;
+
+				while (p < end)
+				{
+					auto found = static_cast<const char*>(std::memchr(p, '\n', end - p));
+					if (found == nullptr)
+					{
+						break;
+					}
+
+					if (!m_wide)
+					{
+						return found - data;
+					}
+
+					// Line feed byte must be low byte of UTF-16 code unit
+					if (((found - data - m_begin) & 1) == 0)
+					{
+						if (found + 1 == end)
+						{
+							// High byte was not read yet
+							break;
+						}
+
+						if (found[1] == 0)
+						{
+							return found - data;
+						}
+					}
+
+					p = found + 1;
+				}
+
+				return std::string::npos;
+			}
+
+			void Decode(const char* data, size_t cb, std::wstring& line) const
+			{
+				if (m_wide)
+				{
+					DecodeUtf16(reinterpret_cast<const BYTE*>(data), cb / 2, line);
+				}
+				else
+				{
+					DecodeUtf8(reinterpret_cast<const BYTE*>(data), cb, line);
+				}
+			}
+
+		public:
+			/// <summary>
+			///		Appends UTF-16LE code units to wide string, joining surrogate pairs where wchar_t is 32 bit wide
+			/// </summary>
+			static void DecodeUtf16(const BYTE* data, size_t units, std::wstring& out)
+			{
+				out.reserve(out.length() + units);
+
+				for (size_t i = 0; i < units; ++i)
+				{
+					wchar_t unit = static_cast<wchar_t>(data[i * 2] | (data[i * 2 + 1] << 8));
+
+#if WCHAR_MAX > 0xFFFF
+					if (unit >= 0xD800 && unit <= 0xDBFF && i + 1 < units)
+					{
+						wchar_t low = static_cast<wchar_t>(data[i * 2 + 2] | (data[i * 2 + 3] << 8));
+
+						if (low >= 0xDC00 && low <= 0xDFFF)
+						{
+							unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+							++i;
+						}
+					}
+#endif
+					out += unit;
+				}
+			}
+
+			/// <summary>
+			///		Appends UTF-8 text to wide string, bytes not forming valid sequence are taken as Latin-1 characters
+			/// </summary>
+			static void DecodeUtf8(const BYTE* data, size_t cb, std::wstring& out)
+			{
+				out.reserve(out.length() + cb);
+
+				for (size_t i = 0; i < cb; )
+				{
+					const BYTE lead = data[i];
+
+					if (lead < 0x80)
+					{
+						out += static_cast<wchar_t>(lead);
+						++i;
+
+						continue;
+					}
+
+					size_t length = (lead >= 0xF0 && lead <= 0xF4) ? 4 : (lead >= 0xE0 && lead <= 0xEF) ? 3 : (lead >= 0xC2 && lead <= 0xDF) ? 2 : 0;
+					DWORD cp = (length == 4) ? (lead & 0x07) : (length == 3) ? (lead & 0x0F) : (lead & 0x1F);
+
+					if (length == 0 || i + length > cb)
+					{
+						length = 0;
+					}
+
+					for (size_t j = 1; j < length; ++j)
+					{
+						if ((data[i + j] & 0xC0) != 0x80)
+						{
+							length = 0;
+
+							break;
+						}
+
+						cp = (cp << 6) | (data[i + j] & 0x3F);
+					}
+
+					if (length == 0 || (length == 3 && cp < 0x800) || (length == 4 && (cp < 0x10000 || cp > 0x10FFFF)) || (cp >= 0xD800 && cp <= 0xDFFF))
+					{
+						out += static_cast<wchar_t>(lead);
+						++i;
+
+						continue;
+					}
+
+#if WCHAR_MAX > 0xFFFF
+					out += static_cast<wchar_t>(cp);
+#else
+					if (cp > 0xFFFF)
+					{
+						cp -= 0x10000;
+
+						out += static_cast<wchar_t>(0xD800 + (cp >> 10));
+						out += static_cast<wchar_t>(0xDC00 + (cp & 0x3FF));
+					}
+					else
+					{
+						out += static_cast<wchar_t>(cp);
+					}
+#endif
+					i += length;
+				}
+			}
+
+		private:
+			std::istream& m_in;
+			std::vector<char> m_buffer;
+			// Unread data
+			size_t m_begin;
+			size_t m_end;
+			bool m_eof;
+			bool m_wide;
+			size_t m_line;
+		};
+
+		/// <summary>
+		///		Applies .reg files in REGEDIT4 and Windows Registry Editor 5.00 format to registry, same as "reg import".
+		///		File is parsed while it is read, so files of any size are imported in bounded memory.
+		/// </summary>
+		/// <remarks>
+		///		Keys are written with RegistryKey methods, values of types without dedicated setter
+		///		(e.g. REG_BINARY or REG_MULTI_SZ) are written directly through backend of key.
+		///		Syntax errors throw std::runtime_error, registry errors throw std::system_error.
+		///		Changes applied before error was found are not rolled back.
+		/// </remarks>
+		class RegFileImporter
+		{
+		public:
+			/// <summary>
+			///		Creates importer writing to registry of default backend
+			/// </summary>
+			RegFileImporter()
+				: RegFileImporter(DefaultBackend())
+			{
+			}
+
+			/// <summary>
+			///		Creates importer writing to root keys of specified backend
+			/// </summary>
+			explicit RegFileImporter(const RegistryBackend_ptr& backend)
+			{
+				if (backend == nullptr)
+				{
+					throw std::invalid_argument("Registry backend cannot be nullptr");
+				}
+
+				m_roots.push_back(Root{ L"HKEY_CLASSES_ROOT", L"HKCR", std::make_shared<RegistryKey>(HKEY_CLASSES_ROOT, backend) });
+				m_roots.push_back(Root{ L"HKEY_CURRENT_USER", L"HKCU", std::make_shared<RegistryKey>(HKEY_CURRENT_USER, backend) });
+				m_roots.push_back(Root{ L"HKEY_LOCAL_MACHINE", L"HKLM", std::make_shared<RegistryKey>(HKEY_LOCAL_MACHINE, backend) });
+				m_roots.push_back(Root{ L"HKEY_USERS", L"HKU", std::make_shared<RegistryKey>(HKEY_USERS, backend) });
+				m_roots.push_back(Root{ L"HKEY_CURRENT_CONFIG", L"HKCC", std::make_shared<RegistryKey>(HKEY_CURRENT_CONFIG, backend) });
+			}
+
+			// Disable copy ctor & copy assignment operator
+			RegFileImporter(const RegFileImporter& other) = delete;
+			RegFileImporter& operator=(const RegFileImporter& other) = delete;
+
+			/// <summary>
+			///		Imports specified .reg file
+			/// </summary>
+			RegImportResult Import(const std::wstring& file)
+			{
+				if (file.empty())
+				{
+					throw std::invalid_argument("Specified file path cannot be empty");
+				}
+
+				std::ifstream in(std::filesystem::path(file), std::ios::binary);
+				if (!in)
+				{
+					throw std::runtime_error("Could not open .reg file");
+				}
+
+				return Import(in);
+			}
+
+			/// <summary>
+			///		Imports .reg file content read from stream
+			/// </summary>
+			RegImportResult Import(std::istream& in)
+			{
+				RegFileReader reader(in);
+				RegImportResult result;
+
+				RegistryKey_ptr key;
+
+				std::wstring line;
+				std::wstring name;
+				std::wstring text;
+				std::vector<BYTE> data;
+
+				bool header = false;
+				// Values following [-key] section are ignored
+				bool deleted = false;
+
+				while (reader.ReadLine(line))
+				{
+					auto view = Trim(line);
+
+					if (view.empty() || view.front() == L';')
+					{
+						continue;
+					}
+
+					if (!header)
+					{
+						if (view == L"Windows Registry Editor Version 5.00")
+						{
+							m_format = RegFileFormat::Regedit5;
+						}
+						else if (view == L"REGEDIT4")
+						{
+							m_format = RegFileFormat::Regedit4;
+						}
+						else
+						{
+							throw std::runtime_error("Unsupported .reg file header");
+						}
+
+						header = true;
+
+						continue;
+					}
+
+					if (view.front() == L'[')
+					{
+						if (view.back() != L']' || view.length() < 3)
+						{
+							Fail(reader);
+						}
+
+						auto path = view.substr(1, view.length() - 2);
+
+						key.reset();
+						deleted = (path.front() == L'-');
+
+						if (deleted)
+						{
+							if (DeleteKey(reader, path.substr(1)))
+							{
+								++result.deleted;
+							}
+						}
+						else
+						{
+							key = CreateKey(reader, path);
+
+							++result.keys;
+						}
+
+						continue;
+					}
+
+					if (key == nullptr)
+					{
+						if (deleted)
+						{
+							continue;
+						}
+
+						Fail(reader);
+					}
+
+					size_t pos = 0;
+
+					if (view.front() == L'@')
+					{
+						name.clear();
+						pos = 1;
+					}
+					else if (view.front() == L'"')
+					{
+						pos = ParseString(view, name);
+						if (pos == std::wstring_view::npos)
+						{
+							Fail(reader);
+						}
+					}
+					else
+					{
+						Fail(reader);
+					}
+
+					view = Trim(view.substr(pos));
+					if (view.empty() || view.front() != L'=')
+					{
+						Fail(reader);
+					}
+
+					view = Trim(view.substr(1));
+
+					if (view == L"-")
+					{
+						LSTATUS lStatus = key->GetBackend()->DeleteValue(*key, name.c_str());
+						if (lStatus == ERROR_SUCCESS)
+						{
+							++result.deleted;
+						}
+						else if (lStatus != ERROR_FILE_NOT_FOUND)
+						{
+							auto ec = std::error_code(lStatus, std::system_category());
+
+							throw std::system_error(ec, "RegDeleteValue() failed");
+						}
+
+						continue;
+					}
+
+					if (!view.empty() && view.front() == L'"')
+					{
+						if (ParseString(view, text) != view.length())
+						{
+							Fail(reader);
+						}
+
+						key->SetString(name, text);
+					}
+					else if (StartsWith(view, L"dword:"))
+					{
+						DWORD dwValue = 0;
+
+						view.remove_prefix(6);
+
+						if (view.empty() || view.length() > 8)
+						{
+							Fail(reader);
+						}
+
+						for (auto ch : view)
+						{
+							const int digit = HexDigit(ch);
+							if (digit < 0)
+							{
+								Fail(reader);
+							}
+
+							dwValue = (dwValue << 4) | static_cast<DWORD>(digit);
+						}
+
+						key->SetUInt32(name, dwValue);
+					}
+					else if (StartsWith(view, L"hex"))
+					{
+						DWORD dwType = REG_BINARY;
+
+						view.remove_prefix(3);
+
+						if (!view.empty() && view.front() == L'(')
+						{
+							const size_t end = view.find(L')');
+							if (end == std::wstring_view::npos || end == 1 || end > 9)
+							{
+								Fail(reader);
+							}
+
+							dwType = 0;
+
+							for (auto ch : view.substr(1, end - 1))
+							{
+								const int digit = HexDigit(ch);
+								if (digit < 0)
+								{
+									Fail(reader);
+								}
+
+								dwType = (dwType << 4) | static_cast<DWORD>(digit);
+							}
+
+							view.remove_prefix(end + 1);
+						}
+
+						if (view.empty() || view.front() != L':')
+						{
+							Fail(reader);
+						}
+
+						view.remove_prefix(1);
+
+						ParseHex(reader, line, view, data);
+						SetValue(key, name, dwType, data, text);
+					}
+					else
+					{
+						Fail(reader);
+					}
+
+					++result.values;
+				}
+
+				if (!header)
+				{
+					throw std::runtime_error("Unsupported .reg file header");
+				}
+
+				return result;
+			}
+
+		private:
+			struct Root
+			{
+				const wchar_t* name;
+				const wchar_t* alias;
+				RegistryKey_ptr key;
+			};
+
+			[[noreturn]] static void Fail(const RegFileReader& reader)
+			{
+				throw std::runtime_error("Invalid .reg file syntax on line " + std::to_string(reader.Line()));
+			}
+
+			static std::wstring_view Trim(std::wstring_view s)
+			{
+				while (!s.empty() && (s.front() == L' ' || s.front() == L'\t'))
+				{
+					s.remove_prefix(1);
+				}
+
+				while (!s.empty() && (s.back() == L' ' || s.back() == L'\t'))
+				{
+					s.remove_suffix(1);
+				}
+
+				return s;
+			}
+
+			static wchar_t ToUpper(wchar_t ch)
+			{
+				return (ch >= L'a' && ch <= L'z') ? static_cast<wchar_t>(ch - (L'a' - L'A')) : ch;
+			}
+
+			static bool EqualsNoCase(std::wstring_view a, std::wstring_view b)
+			{
+				if (a.length() != b.length())
+				{
+					return false;
+				}
+
+				for (size_t i = 0; i < a.length(); ++i)
+				{
+					if (ToUpper(a[i]) != ToUpper(b[i]))
+					{
+						return false;
+					}
+				}
+
+				return true;
+			}
+
+			static bool StartsWith(std::wstring_view s, std::wstring_view prefix)
+			{
+				return s.length() >= prefix.length() && EqualsNoCase(s.substr(0, prefix.length()), prefix);
+			}
+
+			static int HexDigit(wchar_t ch)
+			{
+				if (ch >= L'0' && ch <= L'9')
+				{
+					return ch - L'0';
+				}
+
+				if (ch >= L'a' && ch <= L'f')
+				{
+					return ch - L'a' + 10;
+				}
+
+				if (ch >= L'A' && ch <= L'F')
+				{
+					return ch - L'A' + 10;
+				}
+
+				return -1;
+			}
+
+			/// <summary>
+			///		Parses quoted string with \\ and \" escapes at start of view
+			/// </summary>
+			/// <returns>Position after closing quote, or npos when string is not terminated</returns>
+			static size_t ParseString(std::wstring_view view, std::wstring& out)
+			{
+				out.clear();
+
+				size_t pos = 1;
+
+				for (;;)
+				{
+					// Characters up to next quote or escape are copied at once
+					const size_t special = view.find_first_of(L"\"\\", pos);
+					if (special == std::wstring_view::npos)
+					{
+						return std::wstring_view::npos;
+					}
+
+					out.append(view.data() + pos, special - pos);
+
+					if (view[special] == L'"')
+					{
+						return special + 1;
+					}
+
+					if (special + 1 == view.length())
+					{
+						return std::wstring_view::npos;
+					}
+
+					out += view[special + 1];
+					pos = special + 2;
+				}
+			}
+
+			/// <summary>
+			///		Parses comma separated hex bytes, following continuation lines ending with backslash
+			/// </summary>
+			static void ParseHex(RegFileReader& reader, std::wstring& line, std::wstring_view view, std::vector<BYTE>& data)
+			{
+				data.clear();
+
+				for (;;)
+				{
+					const size_t length = view.length();
+					const wchar_t* s = view.data();
+
+					bool continued = false;
+					size_t i = 0;
+
+					while (i < length)
+					{
+						// Canonical "xx," run is decoded without further checks
+						if (i + 2 < length && s[i + 2] == L',')
+						{
+							const int hi = HexDigit(s[i]);
+							const int lo = HexDigit(s[i + 1]);
+
+							if ((hi | lo) >= 0)
+							{
+								data.push_back(static_cast<BYTE>((hi << 4) | lo));
+								i += 3;
+
+								continue;
+							}
+						}
+
+						const wchar_t ch = s[i];
+
+						if (ch == L',' || ch == L' ' || ch == L'\t')
+						{
+							++i;
+						}
+						else if (ch == L'\\' && Trim(view.substr(i + 1)).empty())
+						{
+							continued = true;
+
+							break;
+						}
+						else
+						{
+							const int hi = HexDigit(ch);
+							const int lo = (i + 1 < length) ? HexDigit(s[i + 1]) : -1;
+
+							if ((hi | lo) < 0 || (i + 2 < length && s[i + 2] != L',' && s[i + 2] != L' ' && s[i + 2] != L'\t' && s[i + 2] != L'\\'))
+							{
+								Fail(reader);
+							}
+
+							data.push_back(static_cast<BYTE>((hi << 4) | lo));
+							i += 2;
+						}
+					}
+
+					if (!continued)
+					{
+						break;
+					}
+
+					if (!reader.ReadLine(line))
+					{
+						Fail(reader);
+					}
+
+					view = Trim(line);
+				}
+
+				if (data.size() > 0xFFFFFFFF)
+				{
+					Fail(reader);
+				}
+			}
+
+			/// <summary>
+			///		Decodes string data stored in file, which is UTF-16LE in version 5 and 8 bit text in REGEDIT4
+			/// </summary>
+			void DecodeText(const std::vector<BYTE>& data, std::wstring& text) const
+			{
+				text.clear();
+
+				if (m_format == RegFileFormat::Regedit5)
+				{
+					RegFileReader::DecodeUtf16(data.data(), data.size() / 2, text);
+				}
+				else
+				{
+					RegFileReader::DecodeUtf8(data.data(), data.size(), text);
+				}
+			}
+
+			void SetValue(const RegistryKey_ptr& key, const std::wstring& name, DWORD dwType, const std::vector<BYTE>& data, std::wstring& text) const
+			{
+				const BYTE* pData = data.data();
+				auto cbData = static_cast<DWORD>(data.size());
+
+				switch (dwType)
+				{
+					case REG_SZ:
+					case REG_EXPAND_SZ:
+					case REG_MULTI_SZ:
+					{
+						DecodeText(data, text);
+
+						if (dwType != REG_MULTI_SZ && !text.empty() && text.back() == L'\0')
+						{
+							// Regedit stores terminator, RegistryKey::SetString() does not
+							text.pop_back();
+						}
+
+						if (dwType == REG_SZ)
+						{
+							return key->SetString(name, text);
+						}
+
+						if (dwType == REG_EXPAND_SZ)
+						{
+							return key->SetExpandString(name, text);
+						}
+
+						pData = reinterpret_cast<const BYTE*>(text.data());
+						cbData = static_cast<DWORD>(text.length() * sizeof(wchar_t));
+					}
+					break;
+
+					case REG_DWORD:
+					{
+						if (cbData == sizeof(LONG))
+						{
+							LONG lValue = 0;
+							std::memcpy(&lValue, pData, sizeof(lValue));
+
+							return key->SetInt32(name, lValue);
+						}
+					}
+					break;
+
+					case REG_QWORD:
+					{
+						if (cbData == sizeof(long long))
+						{
+							long long llValue = 0;
+							std::memcpy(&llValue, pData, sizeof(llValue));
+
+							return key->SetInt64(name, llValue);
+						}
+					}
+					break;
+
+					default:
+						break;
+				}
+
+				LSTATUS lStatus = key->GetBackend()->SetValue(*key, name.c_str(), dwType, pData, cbData);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegSetValueEx() failed");
+				}
+			}
+
+			/// <summary>
+			///		Finds root key path starts with, and returns path relative to it
+			/// </summary>
+			const RegistryKey_ptr& ResolveRoot(const RegFileReader& reader, std::wstring_view path, std::wstring& subKey) const
+			{
+				const size_t sep = path.find(L'\\');
+				const auto rootName = path.substr(0, sep);
+
+				for (const auto& root : m_roots)
+				{
+					if (EqualsNoCase(rootName, root.name) || EqualsNoCase(rootName, root.alias))
+					{
+						subKey.assign((sep == std::wstring_view::npos) ? std::wstring_view() : path.substr(sep + 1));
+
+						return root.key;
+					}
+				}
+
+				Fail(reader);
+			}
+
+			RegistryKey_ptr CreateKey(const RegFileReader& reader, std::wstring_view path)
+			{
+				const auto& root = ResolveRoot(reader, path, m_subKey);
+
+				if (m_subKey.empty())
+				{
+					return root;
+				}
+
+				return root->Create(m_subKey, DesiredAccess::Write);
+			}
+
+			bool DeleteKey(const RegFileReader& reader, std::wstring_view path)
+			{
+				const auto& root = ResolveRoot(reader, path, m_subKey);
+
+				if (m_subKey.empty())
+				{
+					// Root keys cannot be deleted
+					Fail(reader);
+				}
+
+				LSTATUS lStatus = root->GetBackend()->DeleteTree(*root, m_subKey.c_str());
+				if (lStatus == ERROR_FILE_NOT_FOUND)
+				{
+					return false;
+				}
+
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegDeleteTree() failed");
+				}
+
+				return true;
+			}
+
+		private:
+			std::vector<Root> m_roots;
+			RegFileFormat m_format = RegFileFormat::Regedit5;
+			// Reused for paths relative to root keys
+			std::wstring m_subKey;
+		};
+
+		/// <summary>
+		///		Writes registry keys into stream in .reg file format, same as "reg export".
+		///		Output is buffered and written in chunks of fixed size.
+		/// </summary>
+		class RegFileExporter
+		{
+		public:
+			/// <summary>
+			///		Creates exporter writing to specified stream, writes header of .reg file
+			/// </summary>
+			explicit RegFileExporter(std::ostream& out, RegFileFormat format = RegFileFormat::Regedit5)
+				: m_out(out)
+				, m_format(format)
+				, m_column(0)
+			{
+				m_buffer.reserve(FlushSize + 1024);
+
+				if (m_format == RegFileFormat::Regedit5)
+				{
+					// Byte order mark
+					m_buffer += '\xFF';
+					m_buffer += '\xFE';
+
+					Write(L"Windows Registry Editor Version 5.00");
+				}
+				else
+				{
+					Write(L"REGEDIT4");
+				}
+
+				Write(L"\r\n\r\n");
+			}
+
+			// Disable copy ctor & copy assignment operator
+			RegFileExporter(const RegFileExporter& other) = delete;
+			RegFileExporter& operator=(const RegFileExporter& other) = delete;
+
+			/// <summary>
+			///		Writes key with its values and whole subtree
+			/// </summary>
+			/// <param name="key">Key to be exported, must be opened with DesiredAccess::Read rights</param>
+			/// <param name="path">Full path of key written to file, e.g. L"HKEY_CURRENT_USER\\Software\\MyCompany"</param>
+			void Export(const RegistryKey_ptr& key, const std::wstring& path)
+			{
+				if (key == nullptr)
+				{
+					throw std::invalid_argument("Registry key cannot be nullptr");
+				}
+
+				if (path.empty())
+				{
+					throw std::invalid_argument("Specified path to registry key cannot be empty");
+				}
+
+				std::wstring fullPath = path;
+
+				ExportKey(key, fullPath);
+				Flush();
+			}
+
+		private:
+			static constexpr size_t FlushSize = 64 * 1024;
+			// Hex data lines are wrapped to stay within 80 columns, same as in files written by regedit
+			static constexpr size_t MaxColumn = 76;
+
+			void ExportKey(const RegistryKey_ptr& key, std::wstring& path)
+			{
+				Write(L'[');
+				Write(path);
+				Write(L"]\r\n");
+
+				key->EnumerateValues([this](std::wstring_view name, DWORD dwType, const BYTE* pData, DWORD cbData) -> bool
+				{
+					WriteValue(name, dwType, pData, cbData);
+
+					return true;
+				});
+
+				Write(L"\r\n");
+
+				std::vector<std::wstring> names;
+
+				key->EnumerateSubKeys([&names](const std::wstring& name) -> bool
+				{
+					names.push_back(name);
+
+					return true;
+				});
+
+				const size_t length = path.length();
+
+				for (const auto& name : names)
+				{
+					path += L'\\';
+					path += name;
+
+					ExportKey(key->Open(name, DesiredAccess::Read), path);
+
+					path.resize(length);
+				}
+			}
+
+			void WriteValue(std::wstring_view name, DWORD dwType, const BYTE* pData, DWORD cbData)
+			{
+				if (name.empty())
+				{
+					Write(L'@');
+				}
+				else
+				{
+					WriteString(name);
+				}
+
+				Write(L'=');
+
+				if (dwType == REG_SZ || dwType == REG_EXPAND_SZ || dwType == REG_MULTI_SZ)
+				{
+					m_text.resize(cbData / sizeof(wchar_t));
+
+					if (!m_text.empty())
+					{
+						std::memcpy(&m_text[0], pData, m_text.length() * sizeof(wchar_t));
+					}
+
+					if (dwType == REG_SZ)
+					{
+						std::wstring_view text(m_text);
+
+						while (!text.empty() && text.back() == L'\0')
+						{
+							text.remove_suffix(1);
+						}
+
+						// Strings with characters which cannot be quoted are written as hex(1)
+						if (text.find_first_of(std::wstring_view(L"\0\r\n", 3)) == std::wstring_view::npos)
+						{
+							WriteString(text);
+							Write(L"\r\n");
+
+							return;
+						}
+					}
+					else if (dwType == REG_EXPAND_SZ && (m_text.empty() || m_text.back() != L'\0'))
+					{
+						// Regedit stores terminator
+						m_text += L'\0';
+					}
+
+					EncodeText(m_text, m_data);
+
+					WriteHex(dwType, reinterpret_cast<const BYTE*>(m_data.data()), m_data.size());
+				}
+				else if (dwType == REG_DWORD && cbData == sizeof(DWORD))
+				{
+					DWORD dwValue = 0;
+					std::memcpy(&dwValue, pData, sizeof(dwValue));
+
+					static const wchar_t digits[] = L"0123456789abcdef";
+
+					Write(L"dword:");
+
+					for (int shift = 28; shift >= 0; shift -= 4)
+					{
+						Write(digits[(dwValue >> shift) & 0xF]);
+					}
+				}
+				else
+				{
+					WriteHex(dwType, pData, cbData);
+				}
+
+				Write(L"\r\n");
+			}
+
+			void WriteString(std::wstring_view s)
+			{
+				Write(L'"');
+
+				for (;;)
+				{
+					const size_t special = s.find_first_of(L"\"\\");
+
+					Write(s.substr(0, special));
+
+					if (special == std::wstring_view::npos)
+					{
+						break;
+					}
+
+					Write(L'\\');
+					Write(s[special]);
+
+					s.remove_prefix(special + 1);
+				}
+
+				Write(L'"');
+			}
+
+			void WriteHex(DWORD dwType, const BYTE* pData, size_t cbData)
+			{
+				static const wchar_t digits[] = L"0123456789abcdef";
+
+				if (dwType == REG_BINARY)
+				{
+					Write(L"hex:");
+				}
+				else
+				{
+					Write(L"hex(");
+
+					bool leading = true;
+
+					for (int shift = 28; shift >= 0; shift -= 4)
+					{
+						const DWORD digit = (dwType >> shift) & 0xF;
+
+						if (digit != 0 || shift == 0 || !leading)
+						{
+							Write(digits[digit]);
+
+							leading = false;
+						}
+					}
+
+					Write(L"):");
+				}
+
+				for (size_t i = 0; i < cbData; ++i)
+				{
+					Write(digits[pData[i] >> 4]);
+					Write(digits[pData[i] & 0xF]);
+
+					if (i + 1 < cbData)
+					{
+						Write(L',');
+
+						if (m_column >= MaxColumn)
+						{
+							Write(L"\\\r\n  ");
+						}
+					}
+				}
+			}
+
+			/// <summary>
+			///		Encodes string data as stored in file, which is UTF-16LE in version 5 and UTF-8 in REGEDIT4
+			/// </summary>
+			void EncodeText(std::wstring_view text, std::string& out) const
+			{
+				out.clear();
+
+				for (auto ch : text)
+				{
+					Encode(ch, out);
+				}
+			}
+
+			void Encode(wchar_t ch, std::string& out) const
+			{
+				auto cp = static_cast<DWORD>(ch);
+
+				if (m_format == RegFileFormat::Regedit5)
+				{
+					if (cp > 0xFFFF)
+					{
+						cp -= 0x10000;
+
+						const DWORD high = 0xD800 + (cp >> 10);
+						const DWORD low = 0xDC00 + (cp & 0x3FF);
+
+						out += static_cast<char>(high & 0xFF);
+						out += static_cast<char>(high >> 8);
+						out += static_cast<char>(low & 0xFF);
+						out += static_cast<char>(low >> 8);
+					}
+					else
+					{
+						out += static_cast<char>(cp & 0xFF);
+						out += static_cast<char>(cp >> 8);
+					}
+				}
+				else if (cp < 0x80)
+				{
+					out += static_cast<char>(cp);
+				}
+				else if (cp < 0x800)
+				{
+					out += static_cast<char>(0xC0 | (cp >> 6));
+					out += static_cast<char>(0x80 | (cp & 0x3F));
+				}
+				else if (cp < 0x10000)
+				{
+					out += static_cast<char>(0xE0 | (cp >> 12));
+					out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+					out += static_cast<char>(0x80 | (cp & 0x3F));
+				}
+				else
+				{
+					out += static_cast<char>(0xF0 | (cp >> 18));
+					out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+					out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+					out += static_cast<char>(0x80 | (cp & 0x3F));
+				}
+			}
+
+			void Write(wchar_t ch)
+			{
+				Encode(ch, m_buffer);
+
+				m_column = (ch == L'\n') ? 0 : m_column + 1;
+
+				if (m_buffer.size() >= FlushSize)
+				{
+					Flush();
+				}
+			}
+
+			void Write(std::wstring_view s)
+			{
+				for (auto ch : s)
+				{
+					Write(ch);
+				}
+			}
+
+			void Flush()
+			{
+				m_out.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+
+				m_buffer.clear();
+
+				if (!m_out)
+				{
+					throw std::runtime_error("Could not write .reg file");
+				}
+			}
+
+		private:
+			std::ostream& m_out;
+			RegFileFormat m_format;
+			// Encoded output not written to stream yet
+			std::string m_buffer;
+			size_t m_column;
+			// Reused for string values
+			std::wstring m_text;
+			std::string m_data;
+		};
+	}
+}
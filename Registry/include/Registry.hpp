@@ -1,16 +1,26 @@
 #pragma once
 
-#include <Windows.h>
+#include <RegistryPlatform.hpp>
+#include <RegistryBackend.hpp>
 
 #include <string>
+#include <string_view>
 #include <memory>
 #include <exception>
 
 #include <assert.h>
-#include <tchar.h>
 #include <vector>
 #include <stdexcept>
 #include <system_error>
+#include <optional>
+#include <cstring>
+#include <cwchar>
+#include <algorithm>
+#include <span>
+#include <cstddef>
+#include <limits>
+#include <iterator>
+#include <initializer_list>
 
 namespace m4x1m1l14n
 {
@@ -141,8 +151,374 @@ namespace m4x1m1l14n
 		};
 #endif
 
+		/// <summary>
+		///		Null terminated string passed to RegistryKey methods. Converts implicitly from std::wstring,
+		///		string literal and std::wstring_view, so callers do not need to construct temporary std::wstring.
+		///		Terminated strings are referenced as they are, views are terminated in inline buffer
+		///		and only views longer than it are copied to heap.
+		/// </summary>
+		class StringRef final
+		{
+		public:
+			StringRef(const wchar_t* psz)
+				: m_psz((psz != nullptr) ? psz : L"")
+				, m_length(std::char_traits<wchar_t>::length(m_psz))
+			{
+			}
+
+			StringRef(const std::wstring& str)
+				: m_psz(str.c_str())
+				, m_length(str.length())
+			{
+			}
+
+			StringRef(std::wstring_view view)
+				: m_psz(m_buffer)
+				, m_length(view.length())
+			{
+				if (m_length < InlineLength)
+				{
+					view.copy(m_buffer, m_length);
+					m_buffer[m_length] = L'\0';
+				}
+				else
+				{
+					m_heap.assign(view);
+					m_psz = m_heap.c_str();
+				}
+			}
+
+			// Disable copy ctor & copy assignment operator, string may point to own buffer
+			StringRef(const StringRef& other) = delete;
+			StringRef& operator=(const StringRef& other) = delete;
+
+			const wchar_t* c_str() const
+			{
+				return m_psz;
+			}
+
+			size_t length() const
+			{
+				return m_length;
+			}
+
+			bool empty() const
+			{
+				return m_length == 0;
+			}
+
+			operator std::wstring_view() const
+			{
+				return std::wstring_view(m_psz, m_length);
+			}
+
+		private:
+			static constexpr size_t InlineLength = 128;
+
+			const wchar_t* m_psz;
+			size_t m_length;
+			wchar_t m_buffer[InlineLength];
+			std::wstring m_heap;
+		};
+
 		class RegistryKey;
 
+		/// <summary>
+		///		Result set of RegistryKey::GetValues(). Holds data of all requested values in single buffer,
+		///		so reusing same object for subsequent reads does not allocate memory.
+		///		Value getters return data and throw errors same as RegistryKey methods with same name.
+		/// </summary>
+		class RegistryValues
+		{
+			friend class RegistryKey;
+
+		public:
+			RegistryValues() = default;
+
+			/// <summary>
+			///		Number of values in result set, same as number of names passed to RegistryKey::GetValues()
+			/// </summary>
+			size_t Count() const
+			{
+				return m_items.size();
+			}
+
+			/// <summary>
+			///		Result of reading value at specified index, ERROR_SUCCESS or error code reported by registry
+			/// </summary>
+			LSTATUS GetStatus(size_t index) const
+			{
+				return At(index).status;
+			}
+
+			/// <summary>
+			///		Registry value type of value at specified index, REG_NONE when value could not be read
+			/// </summary>
+			DWORD GetType(size_t index) const
+			{
+				return At(index).type;
+			}
+
+			bool HasValue(size_t index) const
+			{
+				return At(index).status == ERROR_SUCCESS;
+			}
+
+			bool GetBoolean(size_t index) const
+			{
+				const auto& item = Data(index, sizeof(DWORD));
+
+				if (item.type != REG_DWORD && item.type != REG_QWORD)
+				{
+					throw std::runtime_error("Wrong registry value type " + std::to_string(item.type) + " for boolean value.");
+				}
+
+				DWORD dwData = 0;
+				CopyData(item, &dwData);
+
+				return (dwData == 0) ? false : true;
+			}
+
+			LONG GetInt32(size_t index) const
+			{
+				const auto& item = Data(index, sizeof(LONG));
+
+				LONG lData = 0;
+				CopyData(item, &lData);
+
+				return lData;
+			}
+
+			DWORD GetUInt32(size_t index) const
+			{
+				return static_cast<DWORD>(GetInt32(index));
+			}
+
+			long long GetInt64(size_t index) const
+			{
+				const auto& item = Data(index, sizeof(long long));
+
+				long long llData = 0;
+				CopyData(item, &llData);
+
+				return llData;
+			}
+
+			unsigned long long GetUInt64(size_t index) const
+			{
+				return static_cast<unsigned long long>(GetInt64(index));
+			}
+
+			std::wstring GetString(size_t index) const
+			{
+				const auto& item = Data(index, static_cast<DWORD>(-1));
+
+				if (item.type != REG_SZ && item.type != REG_EXPAND_SZ)
+				{
+					throw std::runtime_error("Wrong registry value type " + std::to_string(item.type) + " for string value.");
+				}
+
+				std::wstring value((item.cbData + sizeof(wchar_t) - 1) / sizeof(wchar_t), L'\0');
+
+				if (!value.empty())
+				{
+					CopyData(item, &value[0]);
+				}
+
+				// Stored data does not have to be null terminated, but may contain more than one terminator
+				auto pos = value.find(L'\0');
+				if (pos != std::wstring::npos)
+				{
+					value.resize(pos);
+				}
+
+				return value;
+			}
+
+		private:
+			struct Item
+			{
+				LSTATUS status = ERROR_SUCCESS;
+				DWORD type = REG_NONE;
+				size_t offset = 0;
+				DWORD cbData = 0;
+			};
+
+			const Item& At(size_t index) const
+			{
+				if (index >= m_items.size())
+				{
+					throw std::out_of_range("Value index is out of range");
+				}
+
+				return m_items[index];
+			}
+
+			/// <summary>
+			///		Returns successfully read item, whose data fits into buffer of specified size
+			/// </summary>
+			const Item& Data(size_t index, DWORD cbBuffer) const
+			{
+				const auto& item = At(index);
+
+				LSTATUS lStatus = item.status;
+
+				if (lStatus == ERROR_SUCCESS && item.cbData > cbBuffer)
+				{
+					lStatus = ERROR_MORE_DATA;
+				}
+
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegQueryValueEx() failed");
+				}
+
+				return item;
+			}
+
+			void CopyData(const Item& item, void* pData) const
+			{
+				if (item.cbData != 0)
+				{
+					std::memcpy(pData, m_buffer.data() + item.offset, item.cbData);
+				}
+			}
+
+		private:
+			std::vector<Item> m_items;
+			std::vector<VALENTW> m_entries;
+			std::vector<LSTATUS> m_statuses;
+			std::vector<wchar_t> m_names;
+			std::vector<BYTE> m_buffer;
+		};
+
+		/// <summary>
+		///		Value of REG_MULTI_SZ type read by RegistryKey::GetMultiString(). Strings are kept in single buffer
+		///		as stored in registry and iterated lazily as views into that buffer, so reading value of any number
+		///		of strings allocates at most once and reusing same object for subsequent reads usually does not allocate at all.
+		/// </summary>
+		/// <remarks>
+		///		Views are valid until object is destroyed or used for next read. Empty string ends the list, as in registry.
+		/// </remarks>
+		class MultiString
+		{
+			friend class RegistryKey;
+
+		public:
+			class Iterator
+			{
+			public:
+				typedef std::forward_iterator_tag iterator_category;
+				typedef std::wstring_view value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef const std::wstring_view* pointer;
+				typedef std::wstring_view reference;
+
+				Iterator() = default;
+
+				Iterator(const wchar_t* p, const wchar_t* end)
+					: m_end(end)
+				{
+					Load(p);
+				}
+
+				std::wstring_view operator*() const
+				{
+					return m_current;
+				}
+
+				const std::wstring_view* operator->() const
+				{
+					return &m_current;
+				}
+
+				Iterator& operator++()
+				{
+					auto next = m_current.data() + m_current.length();
+
+					// Skip terminator, last string does not have to be terminated
+					if (next < m_end)
+					{
+						++next;
+					}
+
+					Load(next);
+
+					return *this;
+				}
+
+				Iterator operator++(int)
+				{
+					Iterator result = *this;
+
+					++(*this);
+
+					return result;
+				}
+
+				bool operator==(const Iterator& other) const
+				{
+					return m_current.data() == other.m_current.data();
+				}
+
+				bool operator!=(const Iterator& other) const
+				{
+					return !(*this == other);
+				}
+
+			private:
+				void Load(const wchar_t* p)
+				{
+					if (p == nullptr || p >= m_end || *p == L'\0')
+					{
+						// End iterator
+						m_current = std::wstring_view();
+
+						return;
+					}
+
+					auto terminator = std::wmemchr(p, L'\0', static_cast<size_t>(m_end - p));
+
+					m_current = std::wstring_view(p, (terminator != nullptr) ? static_cast<size_t>(terminator - p) : static_cast<size_t>(m_end - p));
+				}
+
+			private:
+				std::wstring_view m_current;
+				const wchar_t* m_end = nullptr;
+			};
+
+			MultiString() = default;
+
+			Iterator begin() const
+			{
+				return Iterator(m_buffer.data(), m_buffer.data() + m_buffer.length());
+			}
+
+			Iterator end() const
+			{
+				return Iterator();
+			}
+
+			bool Empty() const
+			{
+				return begin() == end();
+			}
+
+			/// <summary>
+			///		Number of strings, counted by walking whole buffer
+			/// </summary>
+			size_t Count() const
+			{
+				return static_cast<size_t>(std::distance(begin(), end()));
+			}
+
+		private:
+			// Data of value as stored in registry, including terminators
+			std::wstring m_buffer;
+		};
+
 		typedef std::shared_ptr<RegistryKey> RegistryKey_ptr;
 
 		class RegistryKey
@@ -155,12 +531,28 @@ namespace m4x1m1l14n
 
 		public:
 			RegistryKey(HKEY hKey)
+				: RegistryKey(hKey, DefaultBackend())
+			{
+			}
+
+			/// <summary>
+			///		Creates registry key object over key handle obtained from specified backend
+			/// </summary>
+			/// <param name="hKey">Key handle, or one of predefined root key handles</param>
+			/// <param name="backend">Backend which owns the handle</param>
+			RegistryKey(HKEY hKey, const RegistryBackend_ptr& backend)
 				: m_hKey(hKey)
+				, m_backend(backend)
 			{
 				if (m_hKey == nullptr)
 				{
 					throw std::invalid_argument("Registry key handle cannot be nullptr");
 				}
+
+				if (m_backend == nullptr)
+				{
+					throw std::invalid_argument("Registry backend cannot be nullptr");
+				}
 			}
 
 			// Disable copy ctor & copy assignment operator
@@ -182,7 +574,7 @@ namespace m4x1m1l14n
 #endif
 					))
 				{
-					RegCloseKey(m_hKey);
+					m_backend->CloseKey(m_hKey);
 				}
 			}
 
@@ -191,6 +583,14 @@ namespace m4x1m1l14n
 				return m_hKey;
 			}
 
+			/// <summary>
+			///		Backend this registry key is stored in
+			/// </summary>
+			const RegistryBackend_ptr& GetBackend() const
+			{
+				return m_backend;
+			}
+
 			/// <summary>
 			///		Member method to open registry key on specified path, with specified access rights
 			/// </summary>
@@ -200,35 +600,65 @@ namespace m4x1m1l14n
 			///		Default only read!
 			///	</param>
 			/// <exception></exception>
-			RegistryKey_ptr Open(const std::wstring& path, DesiredAccess access = DesiredAccess::Read)
+			RegistryKey_ptr Open(const StringRef& path, DesiredAccess access = DesiredAccess::Read)
 			{
 				if (path.empty())
 				{
 					throw std::invalid_argument("Specified path to registry key cannot be empty");
 				}
 
+				std::error_code ec;
+
+				auto key = TryOpen(path, access, ec);
+				if (key == nullptr)
+				{
+					throw std::system_error(ec, "RegOpenKeyEx() failed");
+				}
+
+				return key;
+			}
+
+			/// <summary>
+			///		Same as Open(), but reports failure via error code instead of throwing exception
+			/// </summary>
+			/// <returns>Opened registry key, or nullptr when key could not be opened</returns>
+			RegistryKey_ptr TryOpen(const StringRef& path, DesiredAccess access, std::error_code& ec)
+			{
+				if (path.empty())
+				{
+					ec = std::error_code(ERROR_INVALID_PARAMETER, std::system_category());
+
+					return nullptr;
+				}
+
 				HKEY hKey = nullptr;
 
-				DWORD dwOptions = 0;
+				LSTATUS lStatus = m_backend->OpenKey(m_hKey, path.c_str(), static_cast<REGSAM>(access), &hKey);
+
+				ec = std::error_code(lStatus, std::system_category());
 
-				LSTATUS lStatus = RegOpenKeyEx(m_hKey, path.c_str(), dwOptions, static_cast<REGSAM>(access), &hKey);
 				if (lStatus != ERROR_SUCCESS)
 				{
-					auto ec = std::error_code(lStatus, std::system_category());
-
-					throw std::system_error(ec, "RegOpenKeyEx() failed");
+					return nullptr;
 				}
 
 				assert(hKey != nullptr);
 
-				return std::make_shared<RegistryKey>(hKey);
+				return std::make_shared<RegistryKey>(hKey, m_backend);
+			}
+
+			RegistryKey_ptr TryOpen(const StringRef& path, DesiredAccess access = DesiredAccess::Read)
+			{
+				std::error_code ec;
+
+				return TryOpen(path, access, ec);
 			}
 
 			/// <summary>
 			///		Creates registry key on specified path
 			/// </summary>
 			/// <param name="path">Relative path to subkey to create</param>
-			RegistryKey_ptr CreateVolatile(const std::wstring& path, DesiredAccess access = DesiredAccess::Read)
+			RegistryKey_ptr CreateVolatile(const StringRef& path, DesiredAccess access = DesiredAccess::Read)
 			{
 				return Create(path, access, CreateKeyOptions::Volatile);
 			}
@@ -239,7 +669,7 @@ namespace m4x1m1l14n
 			/// <param name="path">Relative path to subkey to create</param>
 			/// <param name="access">Relative path to subkey to create</param>
 			/// <param name="options">Relative path to subkey to create</param>
-			RegistryKey_ptr Create(const std::wstring& path, DesiredAccess access = DesiredAccess::Read, CreateKeyOptions options = CreateKeyOptions::NonVolatile)
+			RegistryKey_ptr Create(const StringRef& path, DesiredAccess access = DesiredAccess::Read, CreateKeyOptions options = CreateKeyOptions::NonVolatile)
 			{
 				if (path.empty())
 				{
@@ -248,22 +678,13 @@ namespace m4x1m1l14n
 
 				HKEY hKey = nullptr;
 
-				DWORD dwReserved = 0;
-				LPTSTR lpClass = nullptr;
-
-				LPSECURITY_ATTRIBUTES lpSecurityAttributes = nullptr;
-
 				LSTATUS lStatus =
-					RegCreateKeyEx(
+					m_backend->CreateKey(
 						m_hKey,
 						path.c_str(),
-						dwReserved,
-						lpClass,
 						static_cast<DWORD>(options),
 						static_cast<REGSAM>(access),
-						lpSecurityAttributes,
-						&hKey,
-						nullptr
+						&hKey
 					);
 
 				if (lStatus != ERROR_SUCCESS)
@@ -275,14 +696,14 @@ namespace m4x1m1l14n
 
 				assert(hKey != nullptr);
 
-				return std::make_shared<RegistryKey>(hKey);
+				return std::make_shared<RegistryKey>(hKey, m_backend);
 			}
 
 			void Delete()
 			{
-				LPTSTR lpSubKey = nullptr;
+				const wchar_t* lpSubKey = nullptr;
 
-				LSTATUS lStatus = RegDeleteTree(m_hKey, lpSubKey);
+				LSTATUS lStatus = m_backend->DeleteTree(m_hKey, lpSubKey);
 				if (lStatus != ERROR_SUCCESS)
 				{
 					auto ec = std::error_code(lStatus, std::system_category());
@@ -291,15 +712,15 @@ namespace m4x1m1l14n
 				}
 			}
 
-			void Delete(const std::wstring& name)
+			void Delete(const StringRef& name)
 			{
-				LSTATUS lStatus = RegDeleteValue(m_hKey, name.c_str());
+				LSTATUS lStatus = m_backend->DeleteValue(m_hKey, name.c_str());
 				// In case registry entry with specified name is not registry Value
 				// RegDeleteValue() returns ERROR_FILE_NOT_FOUND, so we will try to
 				// delete registry entry as if it is registry Key
 				if (lStatus == ERROR_FILE_NOT_FOUND)
 				{
-					lStatus = RegDeleteTree(m_hKey, name.c_str());
+					lStatus = m_backend->DeleteTree(m_hKey, name.c_str());
 				}
 
 				if (lStatus != ERROR_SUCCESS && lStatus != ERROR_FILE_NOT_FOUND)
@@ -312,7 +733,7 @@ namespace m4x1m1l14n
 
 			void Flush()
 			{
-				LSTATUS lStatus = RegFlushKey(m_hKey);
+				LSTATUS lStatus = m_backend->FlushKey(m_hKey);
 				if (lStatus != ERROR_SUCCESS)
 				{
 					auto ec = std::error_code(lStatus, std::system_category());
@@ -321,11 +742,9 @@ namespace m4x1m1l14n
 				}
 			}
 
-			void Save(const std::wstring& file)
+			void Save(const StringRef& file)
 			{
-				LPSECURITY_ATTRIBUTES lpSecurityAttributes = nullptr;
-
-				LSTATUS lStatus = RegSaveKey(m_hKey, file.c_str(), lpSecurityAttributes);
+				LSTATUS lStatus = m_backend->SaveKey(m_hKey, file.c_str());
 				if (lStatus != ERROR_SUCCESS)
 				{
 					auto ec = std::error_code(lStatus, std::system_category());
@@ -340,7 +759,7 @@ namespace m4x1m1l14n
 			///		Checks whether specified subkey exists or not
 			/// </summary>
 			/// <param name="path">Subkey relative path to be checked for existence</param>
-			bool HasKey(const std::wstring& path)
+			bool HasKey(const StringRef& path)
 			{
 				if (path.empty())
 				{
@@ -351,12 +770,12 @@ namespace m4x1m1l14n
 
 				HKEY hKey = nullptr;
 
-				LSTATUS lStatus = RegOpenKeyEx(m_hKey, path.c_str(), 0, KEY_READ, &hKey);
+				LSTATUS lStatus = m_backend->OpenKey(m_hKey, path.c_str(), KEY_READ, &hKey);
 
 				if (lStatus == ERROR_SUCCESS)
 				{
 					assert(hKey != nullptr);
-					RegCloseKey(hKey);
+					m_backend->CloseKey(hKey);
 
 					hasKey = true;
 				}
@@ -373,12 +792,12 @@ namespace m4x1m1l14n
 			}
 
 			// For backward compatibility only
-			bool Exists(const std::wstring& path)
+			bool Exists(const StringRef& path)
 			{
 				return HasKey(path);
 			}
 
-			bool HasValue(const std::wstring& name)
+			bool HasValue(const StringRef& name)
 			{
 				if (name.empty())
 				{
@@ -387,7 +806,7 @@ namespace m4x1m1l14n
 
 				auto hasValue = false;
 
-				LSTATUS lStatus = RegQueryValueEx(m_hKey, name.c_str(), nullptr, nullptr, nullptr, nullptr);
+				LSTATUS lStatus = m_backend->QueryValue(m_hKey, name.c_str(), nullptr, nullptr, nullptr);
 				if (lStatus == ERROR_SUCCESS)
 				{
 					hasValue = true;
@@ -402,15 +821,12 @@ namespace m4x1m1l14n
 				return hasValue;
 			}
 
-			bool GetBoolean(const std::wstring& name)
+			bool GetBoolean(const StringRef& name)
 			{
 				DWORD dwType = 0;
 				DWORD dwData = 0;
-				DWORD cbData = sizeof(dwData);
-
-				LPDWORD lpReserver = nullptr;
 
-				LSTATUS lStatus = RegQueryValueEx(m_hKey, name.c_str(), lpReserver, &dwType, reinterpret_cast<LPBYTE>(&dwData), &cbData);
+				LSTATUS lStatus = QueryData(name, &dwType, &dwData, sizeof(dwData));
 				if (lStatus != ERROR_SUCCESS)
 				{
 					auto ec = std::error_code(lStatus, std::system_category());
@@ -432,12 +848,37 @@ namespace m4x1m1l14n
 				return GetBoolean(L"");
 			}
 
-			void SetBoolean(const std::wstring& name, bool value)
+			/// <summary>
+			///		Same as GetBoolean(), but reports failure via error code instead of throwing exception.
+			///		Value of other type than REG_DWORD or REG_QWORD is reported as ERROR_UNSUPPORTED_TYPE.
+			/// </summary>
+			std::optional<bool> TryGetBoolean(const StringRef& name, std::error_code& ec)
+			{
+				DWORD dwType = 0;
+				DWORD dwData = 0;
+
+				LSTATUS lStatus = QueryData(name, &dwType, &dwData, sizeof(dwData));
+				if (lStatus == ERROR_SUCCESS && dwType != REG_DWORD && dwType != REG_QWORD)
+				{
+					lStatus = ERROR_UNSUPPORTED_TYPE;
+				}
+
+				return Result(lStatus, dwData != 0, ec);
+			}
+
+			std::optional<bool> TryGetBoolean(const StringRef& name)
+			{
+				std::error_code ec;
+
+				return TryGetBoolean(name, ec);
+			}
+
+			void SetBoolean(const StringRef& name, bool value)
 			{
 				DWORD dwValue = value ? 1 : 0;
 				DWORD cbData = sizeof(dwValue);
 
-				LSTATUS lStatus = RegSetValueEx(m_hKey, name.c_str(), 0, REG_DWORD, reinterpret_cast<const LPBYTE>(&dwValue), cbData);
+				LSTATUS lStatus = m_backend->SetValue(m_hKey, name.c_str(), REG_DWORD, reinterpret_cast<const BYTE*>(&dwValue), cbData);
 				if (lStatus != ERROR_SUCCESS)
 				{
 					auto ec = std::error_code(lStatus, std::system_category());
@@ -451,42 +892,74 @@ namespace m4x1m1l14n
 				SetBoolean(L"", value);
 			}
 
-			long GetInt32(const std::wstring& name)
+			LONG GetInt32(const StringRef& name)
 			{
-				long lData = 0;
-				DWORD cbData = sizeof(lData);
+				std::error_code ec;
 
-				LSTATUS lStatus = RegQueryValueEx(m_hKey, name.c_str(), nullptr, nullptr, reinterpret_cast<LPBYTE>(&lData), &cbData);
-				if (lStatus != ERROR_SUCCESS)
+				auto value = TryGetInt32(name, ec);
+				if (!value)
 				{
-					auto ec = std::error_code(lStatus, std::system_category());
-
 					throw std::system_error(ec, "RegQueryValueEx() failed");
 				}
 
-				return lData;
+				return *value;
 			}
 
-			long GetInt32()
+			/// <summary>
+			///		Same as GetInt32(), but reports failure via error code instead of throwing exception
+			/// </summary>
+			std::optional<LONG> TryGetInt32(const StringRef& name, std::error_code& ec)
+			{
+				LONG lData = 0;
+
+				LSTATUS lStatus = QueryData(name, nullptr, &lData, sizeof(lData));
+
+				return Result(lStatus, lData, ec);
+			}
+
+			std::optional<LONG> TryGetInt32(const StringRef& name)
+			{
+				std::error_code ec;
+
+				return TryGetInt32(name, ec);
+			}
+
+			LONG GetInt32()
 			{
 				return GetInt32(L"");
 			}
 
-			unsigned long GetUInt32(const std::wstring& name)
+			DWORD GetUInt32(const StringRef& name)
 			{
-				return static_cast<unsigned long>(GetInt32(name));
+				return static_cast<DWORD>(GetInt32(name));
 			}
 
-			unsigned long GetUInt32()
+			DWORD GetUInt32()
 			{
 				return GetUInt32(L"");
 			}
 
-			void SetInt32(const std::wstring& name, long value)
+			std::optional<DWORD> TryGetUInt32(const StringRef& name, std::error_code& ec)
+			{
+				DWORD dwData = 0;
+
+				LSTATUS lStatus = QueryData(name, nullptr, &dwData, sizeof(dwData));
+
+				return Result(lStatus, dwData, ec);
+			}
+
+			std::optional<DWORD> TryGetUInt32(const StringRef& name)
+			{
+				std::error_code ec;
+
+				return TryGetUInt32(name, ec);
+			}
+
+			void SetInt32(const StringRef& name, LONG value)
 			{
 				DWORD cbData = sizeof(value);
 
-				LSTATUS lStatus = RegSetValueEx(m_hKey, name.c_str(), 0, REG_DWORD, reinterpret_cast<const LPBYTE>(&value), cbData);
+				LSTATUS lStatus = m_backend->SetValue(m_hKey, name.c_str(), REG_DWORD, reinterpret_cast<const BYTE*>(&value), cbData);
 				if (lStatus != ERROR_SUCCESS)
 				{
 					auto ec = std::error_code(lStatus, std::system_category());
@@ -495,35 +968,51 @@ namespace m4x1m1l14n
 				}
 			}
 
-			void SetInt32(long value)
+			void SetInt32(LONG value)
 			{
 				return SetInt32(L"", value);
 			}
 
-			void SetUInt32(const std::wstring& name, unsigned long value)
+			void SetUInt32(const StringRef& name, DWORD value)
 			{
-				return SetInt32(name, static_cast<long>(value));
+				return SetInt32(name, static_cast<LONG>(value));
 			}
 
-			void SetUInt32(unsigned long value)
+			void SetUInt32(DWORD value)
 			{
 				return SetUInt32(L"", value);
 			}
 
-			long long GetInt64(const std::wstring& name) 
+			long long GetInt64(const StringRef& name) 
 			{
-				long long llData = 0;
-				DWORD cbData = sizeof(llData);
+				std::error_code ec;
 
-				LSTATUS lStatus = RegQueryValueEx(m_hKey, name.c_str(), nullptr, nullptr, reinterpret_cast<LPBYTE>(&llData), &cbData);
-				if (lStatus != ERROR_SUCCESS)
+				auto value = TryGetInt64(name, ec);
+				if (!value)
 				{
-					auto ec = std::error_code(lStatus, std::system_category());
-
 					throw std::system_error(ec, "RegQueryValueEx() failed");
 				}
 
-				return llData;
+				return *value;
+			}
+
+			/// <summary>
+			///		Same as GetInt64(), but reports failure via error code instead of throwing exception
+			/// </summary>
+			std::optional<long long> TryGetInt64(const StringRef& name, std::error_code& ec)
+			{
+				long long llData = 0;
+
+				LSTATUS lStatus = QueryData(name, nullptr, &llData, sizeof(llData));
+
+				return Result(lStatus, llData, ec);
+			}
+
+			std::optional<long long> TryGetInt64(const StringRef& name)
+			{
+				std::error_code ec;
+
+				return TryGetInt64(name, ec);
 			}
 
 			long long GetInt64()
@@ -531,7 +1020,7 @@ namespace m4x1m1l14n
 				return GetInt64(L"");
 			}
 
-			unsigned long long GetUInt64(const std::wstring& name)
+			unsigned long long GetUInt64(const StringRef& name)
 			{
 				return static_cast<unsigned long long>(GetInt64(name));
 			}
@@ -541,11 +1030,27 @@ namespace m4x1m1l14n
 				return static_cast<unsigned long long>(GetUInt64(L""));
 			}
 
-			void SetInt64(const std::wstring& name, long long value)
+			std::optional<unsigned long long> TryGetUInt64(const StringRef& name, std::error_code& ec)
+			{
+				unsigned long long ullData = 0;
+
+				LSTATUS lStatus = QueryData(name, nullptr, &ullData, sizeof(ullData));
+
+				return Result(lStatus, ullData, ec);
+			}
+
+			std::optional<unsigned long long> TryGetUInt64(const StringRef& name)
+			{
+				std::error_code ec;
+
+				return TryGetUInt64(name, ec);
+			}
+
+			void SetInt64(const StringRef& name, long long value)
 			{
 				DWORD cbData = sizeof(value);
 
-				LSTATUS lStatus = RegSetValueEx(m_hKey, name.c_str(), 0, REG_QWORD, reinterpret_cast<const LPBYTE>(&value), cbData);
+				LSTATUS lStatus = m_backend->SetValue(m_hKey, name.c_str(), REG_QWORD, reinterpret_cast<const BYTE*>(&value), cbData);
 				if (lStatus != ERROR_SUCCESS)
 				{
 					auto ec = std::error_code(lStatus, std::system_category());
@@ -559,7 +1064,7 @@ namespace m4x1m1l14n
 				return SetInt64(L"", value);
 			}
 
-			void SetUInt64(const std::wstring& name, unsigned long long value)
+			void SetUInt64(const StringRef& name, unsigned long long value)
 			{
 				SetInt64(name, static_cast<long long>(value));
 			}
@@ -569,96 +1074,300 @@ namespace m4x1m1l14n
 				SetUInt64(L"", value);
 			}
 
-			std::wstring GetString(const std::wstring& name) 
-			{
-				DWORD cbData = 0;
+			std::wstring GetString(const StringRef& name) 
+			{
+				std::wstring value;
+
+				GetString(name, value);
+
+				return value;
+			}
+
+			/// <summary>
+			///		Reads string value into provided string. Capacity of string is reused,
+			///		so reading into same string repeatedly does not allocate memory.
+			/// </summary>
+			/// <param name="name">Name of registry value (Empty string for default key value)</param>
+			/// <param name="value">String receiving value</param>
+			void GetString(const StringRef& name, std::wstring& value)
+			{
+				DWORD dwType = 0;
+
+				LSTATUS lStatus = QueryString(name, value, dwType);
+				if (lStatus == ERROR_UNSUPPORTED_TYPE)
+				{
+					throw std::runtime_error("Wrong registry value type " + std::to_string(dwType) + " for string value.");
+				}
+
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegQueryValueEx() failed");
+				}
+			}
+
+			/// <summary>
+			///		Same as GetString(), but reports failure via error code instead of throwing exception.
+			///		Value of other type than REG_SZ or REG_EXPAND_SZ is reported as ERROR_UNSUPPORTED_TYPE.
+			/// </summary>
+			std::optional<std::wstring> TryGetString(const StringRef& name, std::error_code& ec)
+			{
+				std::wstring value;
+
+				if (!TryGetString(name, value, ec))
+				{
+					return std::nullopt;
+				}
+
+				return value;
+			}
+
+			std::optional<std::wstring> TryGetString(const StringRef& name)
+			{
+				std::error_code ec;
+
+				return TryGetString(name, ec);
+			}
+
+			/// <summary>
+			///		Same as GetString(name, value), but reports failure via error code instead of throwing exception
+			/// </summary>
+			/// <returns>true when value was read</returns>
+			bool TryGetString(const StringRef& name, std::wstring& value, std::error_code& ec)
+			{
+				DWORD dwType = 0;
+
+				LSTATUS lStatus = QueryString(name, value, dwType);
+
+				ec = std::error_code(lStatus, std::system_category());
+
+				return lStatus == ERROR_SUCCESS;
+			}
+
+			std::wstring GetString()
+			{
+				return GetString(L"");
+			}
+
+			void SetString(const StringRef& name, std::wstring_view value) 
+			{
+				auto cbData = static_cast<DWORD>(value.length());
+
+				LSTATUS lStatus = m_backend->SetValue(m_hKey, name.c_str(), REG_SZ, reinterpret_cast<const BYTE*>(value.data()), cbData * sizeof(wchar_t));
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegSetValueEx() failed");
+				}
+			}
+
+			void SetString(std::wstring_view value)
+			{
+				SetString(L"", value);
+			}
+
+			/// <summary>
+			///	Create registry value with specified name of type REG_EXPAND_SZ within this registry key
+			/// </summary>
+			/// <param name="name">Name of registry value (Empty string for default key value)</param>
+			/// <param name="value">Value to be set</param>
+			void SetExpandString(const StringRef& name, std::wstring_view value)
+			{
+				auto cbData = static_cast<DWORD>(value.length());
+
+				LSTATUS lStatus = m_backend->SetValue(m_hKey, name.c_str(), REG_EXPAND_SZ, reinterpret_cast<const BYTE*>(value.data()), cbData * sizeof(wchar_t));
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegSetValueEx() failed");
+				}
+			}
+
+			/// <summary>
+			///	Create default registry value of type REG_EXPAND_SZ within this registry key
+			/// </summary>
+			/// <param name="value">Value to be set</param>
+			void SetExpandString(std::wstring_view value)
+			{
+				SetExpandString(L"", value);
+			}
+
+			/// <summary>
+			///		Reads REG_MULTI_SZ value, strings are iterated as views into single buffer
+			/// </summary>
+			MultiString GetMultiString(const StringRef& name)
+			{
+				MultiString value;
+
+				GetMultiString(name, value);
+
+				return value;
+			}
+
+			/// <summary>
+			///		Reads REG_MULTI_SZ value into existing object, whose buffer is reused
+			/// </summary>
+			void GetMultiString(const StringRef& name, MultiString& value)
+			{
+				DWORD dwType = 0;
+
+				LSTATUS lStatus = QueryMultiString(name, value.m_buffer, dwType);
+				if (lStatus == ERROR_UNSUPPORTED_TYPE)
+				{
+					throw std::runtime_error("Wrong registry value type " + std::to_string(dwType) + " for multi string value.");
+				}
+
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegQueryValueEx() failed");
+				}
+			}
+
+			/// <summary>
+			///		Creates or overwrites REG_MULTI_SZ value from any range of strings convertible to std::wstring_view.
+			///		Strings are serialized into buffer allocated once, strings cannot be empty or contain null characters.
+			/// </summary>
+			template <typename __Range>
+			void SetMultiString(const StringRef& name, const __Range& values)
+			{
+				// Terminator of list
+				size_t length = 1;
+
+				for (const auto& value : values)
+				{
+					const std::wstring_view view(value);
+
+					if (view.empty() || view.find(L'\0') != std::wstring_view::npos)
+					{
+						throw std::invalid_argument("Strings of multi string value cannot be empty or contain null characters");
+					}
+
+					length += view.length() + 1;
+				}
+
+				if (length > (std::numeric_limits<DWORD>::max)() / sizeof(wchar_t))
+				{
+					throw std::invalid_argument("Multi string value cannot be larger than 4GB");
+				}
+
+				std::wstring data;
+				data.reserve(length);
+
+				for (const auto& value : values)
+				{
+					data.append(std::wstring_view(value));
+					data.push_back(L'\0');
+				}
+
+				data.push_back(L'\0');
+
+				LSTATUS lStatus = m_backend->SetValue(m_hKey, name.c_str(), REG_MULTI_SZ, reinterpret_cast<const BYTE*>(data.data()), static_cast<DWORD>(data.length() * sizeof(wchar_t)));
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegSetValueEx() failed");
+				}
+			}
+
+			void SetMultiString(const StringRef& name, std::initializer_list<std::wstring_view> values)
+			{
+				SetMultiString<std::initializer_list<std::wstring_view>>(name, values);
+			}
+
+			/// <summary>
+			///		Reads REG_BINARY value directly into provided buffer by single query, without probing its size first.
+			///		When buffer is too small, its content is undefined and caller should retry with buffer of returned size.
+			/// </summary>
+			/// <returns>Size of value data in bytes, which may be larger than buffer</returns>
+			size_t GetBinary(const StringRef& name, std::span<std::byte> buffer)
+			{
+				if (buffer.size() > (std::numeric_limits<DWORD>::max)())
+				{
+					// Value data cannot be larger anyway
+					buffer = buffer.first((std::numeric_limits<DWORD>::max)());
+				}
+
 				DWORD dwType = 0;
+				auto cbData = static_cast<DWORD>(buffer.size());
 
-				DWORD dwFlags = RRF_RT_REG_EXPAND_SZ | RRF_NOEXPAND | RRF_RT_REG_SZ;
-				
-				LSTATUS lStatus = RegGetValue(m_hKey, nullptr, name.c_str(), dwFlags, &dwType, nullptr, &cbData);
-				if (lStatus != ERROR_SUCCESS)
+				LSTATUS lStatus = m_backend->QueryValue(m_hKey, name.c_str(), &dwType, buffer.empty() ? nullptr : reinterpret_cast<LPBYTE>(buffer.data()), &cbData);
+				if (lStatus != ERROR_SUCCESS && lStatus != ERROR_MORE_DATA)
 				{
 					auto ec = std::error_code(lStatus, std::system_category());
 
-					throw std::system_error(ec, "RegGetValue() failed");
+					throw std::system_error(ec, "RegQueryValueEx() failed");
 				}
 
-				if (dwType != REG_SZ && dwType != REG_EXPAND_SZ) // ???
+				if (dwType != REG_BINARY)
 				{
-					throw std::runtime_error("Wrong registry value type " + std::to_string(dwType) + " for string value.");
+					throw std::runtime_error("Wrong registry value type " + std::to_string(dwType) + " for binary value.");
 				}
 
-				std::wstring value;
-
-				if (cbData)
-				{
-					assert((cbData % sizeof(TCHAR)) != 1);
-
-					auto data = new TCHAR[cbData / sizeof(TCHAR)];
-					assert(data != nullptr);
+				return cbData;
+			}
 
-					lStatus = RegGetValue(m_hKey, nullptr, name.c_str(), dwFlags, &dwType, reinterpret_cast<LPBYTE>(data), &cbData);
+			/// <summary>
+			///		Reads REG_BINARY value into vector, which is resized to size of value data.
+			///		Data are read directly into vector, so reusing same vector for subsequent reads
+			///		does not allocate memory and needs single query when its capacity is large enough.
+			/// </summary>
+			void GetBinary(const StringRef& name, std::vector<std::byte>& data)
+			{
+				data.resize(data.capacity());
 
-					std::exception_ptr pex;
+				for (;;)
+				{
+					size_t cbData = 0;
 
-					if (lStatus == ERROR_SUCCESS)
+					try
 					{
-						//assert(data[cbData / sizeof(TCHAR) - 1] == _T('\0'));
-
-						value = std::wstring(data);
+						cbData = GetBinary(name, std::span<std::byte>(data));
 					}
-					else
+					catch (const std::exception&)
 					{
-						auto ec = std::error_code(lStatus, std::system_category());
+						data.clear();
 
-						pex = std::make_exception_ptr(std::system_error(ec, "RegGetValue() failed"));
+						throw;
 					}
 
-					delete[] data;
+					const bool fits = cbData <= data.size();
+
+					// Value might grow in between calls
+					data.resize(cbData);
 
-					if (pex)
+					if (fits)
 					{
-						std::rethrow_exception(pex);
+						break;
 					}
 				}
-
-				return value;
-			}
-
-			std::wstring GetString()
-			{
-				return GetString(L"");
 			}
 
-			void SetString(const std::wstring& name, const std::wstring& value) 
+			std::vector<std::byte> GetBinary(const StringRef& name)
 			{
-				auto cbData = static_cast<DWORD>(value.length());
-
-				LSTATUS lStatus = RegSetValueEx(m_hKey, name.c_str(), 0, REG_SZ, reinterpret_cast<const BYTE*>(value.c_str()), cbData * sizeof(TCHAR));
-				if (lStatus != ERROR_SUCCESS)
-				{
-					auto ec = std::error_code(lStatus, std::system_category());
+				std::vector<std::byte> data;
 
-					throw std::system_error(ec, "RegSetValueEx() failed");
-				}
-			}
+				GetBinary(name, data);
 
-			void SetString(const std::wstring& value)
-			{
-				SetString(L"", value);
+				return data;
 			}
 
 			/// <summary>
-			///	Create registry value with specified name of type REG_EXPAND_SZ within this registry key
+			///		Creates or overwrites REG_BINARY value, data are passed to registry without being copied
 			/// </summary>
-			/// <param name="name">Name of registry value (Empty string for default key value)</param>
-			/// <param name="value">Value to be set</param>
-			void SetExpandString(const std::wstring& name, const std::wstring& value)
+			void SetBinary(const StringRef& name, std::span<const std::byte> data)
 			{
-				auto cbData = static_cast<DWORD>(value.length());
+				if (data.size() > (std::numeric_limits<DWORD>::max)())
+				{
+					throw std::invalid_argument("Binary value cannot be larger than 4GB");
+				}
 
-				LSTATUS lStatus = RegSetValueEx(m_hKey, name.c_str(), 0, REG_EXPAND_SZ, reinterpret_cast<const BYTE*>(value.c_str()), cbData * sizeof(TCHAR));
+				LSTATUS lStatus = m_backend->SetValue(m_hKey, name.c_str(), REG_BINARY, reinterpret_cast<const BYTE*>(data.data()), static_cast<DWORD>(data.size()));
 				if (lStatus != ERROR_SUCCESS)
 				{
 					auto ec = std::error_code(lStatus, std::system_category());
@@ -667,34 +1376,20 @@ namespace m4x1m1l14n
 				}
 			}
 
-			/// <summary>
-			///	Create default registry value of type REG_EXPAND_SZ within this registry key
-			/// </summary>
-			/// <param name="value">Value to be set</param>
-			void SetExpandString(const std::wstring& value)
-			{
-				SetExpandString(L"", value);
-			}
-
 			template <typename __Function>
 			void EnumerateSubKeys(const __Function& callback)
 			{
 				DWORD dwSubKeys = 0;
 				DWORD dwLongestSubKeyLen = 0;
 				
-				LSTATUS lStatus = RegQueryInfoKey
+				LSTATUS lStatus = m_backend->QueryInfoKey
 				(
 					m_hKey,					// Key handle
-					nullptr,				// Buffer for registry ked class name
-					nullptr,				// Size of class string
-					nullptr,				// Reserved
 					&dwSubKeys,				// Number of key subkeys (this is what we want)
 					&dwLongestSubKeyLen,	// Longest subkey size
-					nullptr,				// Longest class string
 					nullptr,				// number of values for this key
 					nullptr,				// Longest value name
 					nullptr,				// Longest value data
-					nullptr,				// Security descriptor
 					nullptr					// Last key write time
 				);
 
@@ -710,23 +1405,20 @@ namespace m4x1m1l14n
 
 				std::exception_ptr pex;
 
-				auto pszName = reinterpret_cast<TCHAR*>(LocalAlloc(LMEM_FIXED, dwLongestSubKeyLen * sizeof(TCHAR)));
-				assert(pszName != nullptr);
+				std::vector<wchar_t> nameBuffer(dwLongestSubKeyLen);
+
+				auto pszName = nameBuffer.data();
 
 				for (DWORD i = 0; i < dwSubKeys; ++i)
 				{
 					DWORD dwLen = dwLongestSubKeyLen;
 
-					lStatus = RegEnumKeyEx
+					lStatus = m_backend->EnumKey
 					(
 						m_hKey,			// Key handle
 						i,				// Subkey index
 						pszName,		// Subkey name buffer
-						&dwLen,			// Subkey name string length
-						nullptr,		// Reserved
-						nullptr,		// Subkey class buffer
-						nullptr,		// Subkey class string length
-						nullptr			// Last subkey write time
+						&dwLen			// Subkey name string length
 					);
 
 					if (lStatus != ERROR_SUCCESS)
@@ -759,14 +1451,210 @@ namespace m4x1m1l14n
 					}
 				}
 
-				LocalFree(pszName);
-
 				if (pex)
 				{
 					std::rethrow_exception(pex);
 				}
 			}
 
+			/// <summary>
+			///		Enumerates all values of this registry key in single pass, including default value with empty name.
+			///		Callback receives name, type and raw data of each value and returns false to stop enumeration.
+			///		Name and data point to buffer reused for every value, so they are valid only until callback returns.
+			/// </summary>
+			/// <remarks>
+			///		Buffer is sized upfront to fit longest value name and data, so enumeration allocates memory once,
+			///		unless longer value is written while enumeration is in progress.
+			/// </remarks>
+			template <typename __Function>
+			void EnumerateValues(const __Function& callback)
+			{
+				DWORD dwValues = 0;
+				DWORD dwLongestValueNameLen = 0;
+				DWORD dwLongestValueLen = 0;
+
+				LSTATUS lStatus = m_backend->QueryInfoKey
+				(
+					m_hKey,					// Key handle
+					nullptr,				// Number of key subkeys
+					nullptr,				// Longest subkey size
+					&dwValues,				// Number of values for this key
+					&dwLongestValueNameLen,	// Longest value name
+					&dwLongestValueLen,		// Longest value data
+					nullptr					// Last key write time
+				);
+
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegQueryInfoKey() failed");
+				}
+
+				if (dwValues == 0)
+				{
+					return;
+				}
+
+				// Add space for terminating null character
+				size_t cchName = dwLongestValueNameLen + 1;
+				size_t cbData = dwLongestValueLen;
+
+				// Data is stored first, name follows aligned, so data can be read at any alignment callback may need
+				std::vector<ULONGLONG> buffer;
+
+				for (DWORD i = 0; ; )
+				{
+					const size_t cbNameOffset = (cbData + sizeof(ULONGLONG) - 1) & ~(sizeof(ULONGLONG) - 1);
+					const size_t cbBuffer = cbNameOffset + cchName * sizeof(wchar_t);
+
+					if (buffer.size() * sizeof(ULONGLONG) < cbBuffer)
+					{
+						buffer.resize((cbBuffer + sizeof(ULONGLONG) - 1) / sizeof(ULONGLONG));
+					}
+
+					auto pData = reinterpret_cast<LPBYTE>(buffer.data());
+					auto pszName = reinterpret_cast<wchar_t*>(pData + cbNameOffset);
+
+					DWORD dwNameLen = static_cast<DWORD>(cchName);
+					DWORD dwDataLen = static_cast<DWORD>(cbData);
+					DWORD dwType = REG_NONE;
+
+					lStatus = m_backend->EnumValue(m_hKey, i, pszName, &dwNameLen, &dwType, pData, &dwDataLen);
+					if (lStatus == ERROR_NO_MORE_ITEMS)
+					{
+						break;
+					}
+
+					if (lStatus == ERROR_MORE_DATA)
+					{
+						// Value was enlarged after buffer was sized, query new limits and retry same index
+						lStatus = m_backend->QueryInfoKey(m_hKey, nullptr, nullptr, nullptr, &dwLongestValueNameLen, &dwLongestValueLen, nullptr);
+						if (lStatus == ERROR_SUCCESS)
+						{
+							cchName = (std::max)(cchName, static_cast<size_t>(dwLongestValueNameLen) + 1);
+							cbData = (std::max)(cbData, static_cast<size_t>((std::max)(dwLongestValueLen, dwDataLen)));
+
+							continue;
+						}
+					}
+
+					if (lStatus != ERROR_SUCCESS)
+					{
+						auto ec = std::error_code(lStatus, std::system_category());
+
+						throw std::system_error(ec, "RegEnumValue() failed");
+					}
+
+					if (!callback(std::wstring_view(pszName, dwNameLen), dwType, pData, dwDataLen))
+					{
+						// Break loop when callback returns false
+						break;
+					}
+
+					++i;
+				}
+			}
+
+			/// <summary>
+			///		Reads multiple values of this registry key at once, by single backend call unless backend cannot read them together.
+			///		Errors of individual values, like missing value, are not thrown but reported by values.GetStatus()
+			/// </summary>
+			/// <param name="names">Range of value names convertible to std::wstring_view</param>
+			/// <param name="values">Result set receiving values in same order as their names</param>
+			template <typename __Range>
+			void GetValues(const __Range& names, RegistryValues& values)
+			{
+				size_t count = 0;
+				size_t length = 0;
+
+				for (const auto& name : names)
+				{
+					length += std::wstring_view(name).length() + 1;
+					++count;
+				}
+
+				values.m_items.assign(count, RegistryValues::Item());
+				values.m_entries.resize(count);
+				values.m_statuses.resize(count);
+				values.m_names.resize(length);
+
+				if (count == 0)
+				{
+					return;
+				}
+
+				// Names are terminated in buffer of result set, so views do not have to be copied to strings
+				wchar_t* p = values.m_names.data();
+				size_t i = 0;
+
+				for (const auto& name : names)
+				{
+					const std::wstring_view view(name);
+
+					view.copy(p, view.length());
+					p[view.length()] = L'\0';
+
+					values.m_entries[i] = VALENTW();
+					values.m_entries[i].ve_valuename = p;
+
+					p += view.length() + 1;
+					++i;
+				}
+
+				const auto num_vals = static_cast<DWORD>(count);
+
+				LSTATUS lStatus = ERROR_MORE_DATA;
+
+				// Values can grow in between calls, so repeat until buffer is large enough
+				while (lStatus == ERROR_MORE_DATA)
+				{
+					auto cbTotal = static_cast<DWORD>(values.m_buffer.size());
+
+					lStatus = m_backend->QueryValues(m_hKey, values.m_entries.data(), num_vals, values.m_buffer.empty() ? nullptr : values.m_buffer.data(), &cbTotal, values.m_statuses.data());
+
+					if (lStatus == ERROR_SUCCESS && values.m_buffer.empty() && cbTotal != 0)
+					{
+						// Only size was retrieved
+						lStatus = ERROR_MORE_DATA;
+					}
+
+					if (lStatus == ERROR_MORE_DATA)
+					{
+						values.m_buffer.resize(cbTotal);
+					}
+				}
+
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegQueryMultipleValues() failed");
+				}
+
+				const auto base = reinterpret_cast<DWORD_PTR>(values.m_buffer.data());
+
+				for (i = 0; i < count; ++i)
+				{
+					auto& item = values.m_items[i];
+					const auto& entry = values.m_entries[i];
+
+					item.status = values.m_statuses[i];
+
+					if (item.status == ERROR_SUCCESS)
+					{
+						item.type = entry.ve_type;
+						item.cbData = entry.ve_valuelen;
+						item.offset = (entry.ve_valuelen != 0) ? static_cast<size_t>(entry.ve_valueptr - base) : 0;
+					}
+				}
+			}
+
+			void GetValues(std::initializer_list<std::wstring_view> names, RegistryValues& values)
+			{
+				GetValues<std::initializer_list<std::wstring_view>>(names, values);
+			}
+
 			/// <summary>
 			///	Notifies the caller about changes to the attributes or contents of a specified registry key.
 			/// </summary>
@@ -782,15 +1670,15 @@ namespace m4x1m1l14n
 			void Notify(bool watchSubtree = false, NotifyFilter notifyFilter = NotifyFilter::ChangeName | NotifyFilter::ChangeAttributes)
 			{
 				HANDLE hEvent = nullptr;
-				BOOL fAsynchronous = FALSE;
+				bool asynchronous = false;
 
-				LSTATUS lStatus = RegNotifyChangeKeyValue
+				LSTATUS lStatus = m_backend->NotifyChangeKeyValue
 				(
 					m_hKey, 
-					watchSubtree ? TRUE : FALSE, 
+					watchSubtree, 
 					static_cast<DWORD>(notifyFilter), 
 					hEvent, 
-					fAsynchronous
+					asynchronous
 				);
 
 				if (lStatus != ERROR_SUCCESS)
@@ -823,15 +1711,15 @@ namespace m4x1m1l14n
 					throw std::invalid_argument("Event handle cannot be null");
 				}
 
-				BOOL fAsynchronous = TRUE;
+				bool asynchronous = true;
 
-				LSTATUS lStatus = RegNotifyChangeKeyValue
+				LSTATUS lStatus = m_backend->NotifyChangeKeyValue
 				(
 					m_hKey, 
-					watchSubtree ? TRUE : FALSE, 
+					watchSubtree, 
 					static_cast<DWORD>(notifyFilter), 
 					hEvent, 
-					fAsynchronous
+					asynchronous
 				);
 
 				if (lStatus != ERROR_SUCCESS)
@@ -843,34 +1731,7 @@ namespace m4x1m1l14n
 			}
 
 #if 0
-			std::shared_ptr<BYTE> GetBinary(const std::wstring& name, size_t len) 
-			{
-				DWORD cbData = DWORD(len);
-				BYTE *data = new BYTE[len];
-				std::shared_ptr<BYTE> ret;
-
-				if (data != nullptr) 
-				{
-					LSTATUS lStatus = RegQueryValueEx(m_hKey, name.c_str(), nullptr, nullptr, data, &cbData);
-					if (lStatus == ERROR_SUCCESS) 
-					{
-						ret = std::shared_ptr<BYTE>(data, std::default_delete<BYTE[]>());
-					}
-				}
-
-				return ret;
-			}
-
-			bool SetBinary(const std::wstring& name, const BYTE* pData, size_t len) 
-			{
-				DWORD cbData = DWORD(len);
-
-				LSTATUS lStatus = RegSetValueEx(m_hKey, name.c_str(), 0, REG_BINARY, pData, DWORD(len));
-
-				return (lStatus == ERROR_SUCCESS);
-			}
-
-			RegistryValue GetValue(const std::wstring& name) 
+			RegistryValue GetValue(const StringRef& name) 
 			{
 				assert(m_hKey != nullptr);
 				DWORD dwType = 0;
@@ -952,7 +1813,7 @@ namespace m4x1m1l14n
 				return ret;
 			}
 
-			void SetValue(const std::wstring& valueName, const RegistryValue& value) 
+			void SetValue(const StringRef& valueName, const RegistryValue& value) 
 			{
 				switch (value.GetType())
 				{
@@ -991,8 +1852,164 @@ namespace m4x1m1l14n
 			}
 #endif
 
+		private:
+			/// <summary>
+			///		Length of stack buffer GetString() tries to read value into first, in characters
+			/// </summary>
+			static constexpr size_t StringBufferLength = 256;
+
+			/// <summary>
+			///		Reads value of fixed size, same as single RegQueryValueEx() call
+			/// </summary>
+			LSTATUS QueryData(const StringRef& name, LPDWORD lpType, void* pData, DWORD cbData)
+			{
+				return m_backend->QueryValue(m_hKey, name.c_str(), lpType, reinterpret_cast<LPBYTE>(pData), &cbData);
+			}
+
+			/// <summary>
+			///		Reads string value in single query when it fits into stack buffer or provided string.
+			///		Returns ERROR_UNSUPPORTED_TYPE when value is not a string.
+			/// </summary>
+			LSTATUS QueryString(const StringRef& name, std::wstring& value, DWORD& dwType)
+			{
+				// Most of values fit into stack buffer, so single query is usually enough.
+				// When provided string is larger, data are read directly into it.
+				wchar_t stackBuffer[StringBufferLength];
+
+				const bool useValue = value.capacity() > StringBufferLength;
+				if (useValue)
+				{
+					value.resize(value.capacity());
+				}
+
+				auto data = useValue ? &value[0] : stackBuffer;
+				// Reserve space for terminating null character, stored data does not have to contain it
+				auto cbData = static_cast<DWORD>(((useValue ? value.length() : StringBufferLength) - 1) * sizeof(wchar_t));
+
+				LSTATUS lStatus = m_backend->QueryValue(m_hKey, name.c_str(), &dwType, reinterpret_cast<LPBYTE>(data), &cbData);
+
+				while (lStatus == ERROR_MORE_DATA)
+				{
+					if (dwType != REG_SZ && dwType != REG_EXPAND_SZ)
+					{
+						break;
+					}
+
+					// cbData now holds required size, value might grow in between calls
+					value.resize(cbData / sizeof(wchar_t) + 2);
+
+					data = &value[0];
+					cbData = static_cast<DWORD>((value.length() - 1) * sizeof(wchar_t));
+
+					lStatus = m_backend->QueryValue(m_hKey, name.c_str(), &dwType, reinterpret_cast<LPBYTE>(data), &cbData);
+				}
+
+				if (lStatus != ERROR_SUCCESS && lStatus != ERROR_MORE_DATA)
+				{
+					value.clear();
+
+					return lStatus;
+				}
+
+				if (dwType != REG_SZ && dwType != REG_EXPAND_SZ) // ???
+				{
+					value.clear();
+
+					return ERROR_UNSUPPORTED_TYPE;
+				}
+
+				// Value ends on first null character
+				const auto cchData = cbData / sizeof(wchar_t);
+
+				auto terminator = std::wmemchr(data, L'\0', cchData);
+				auto length = (terminator != nullptr) ? static_cast<size_t>(terminator - data) : cchData;
+
+				if (data == stackBuffer)
+				{
+					value.assign(data, length);
+				}
+				else
+				{
+					value.resize(length);
+				}
+
+				return ERROR_SUCCESS;
+			}
+
+			/// <summary>
+			///		Reads whole data of REG_MULTI_SZ value into string, including terminators
+			/// </summary>
+			LSTATUS QueryMultiString(const StringRef& name, std::wstring& value, DWORD& dwType)
+			{
+				// Same as QueryString(), small values are read into stack buffer by single query
+				wchar_t stackBuffer[StringBufferLength];
+
+				const bool useValue = value.capacity() > StringBufferLength;
+				if (useValue)
+				{
+					value.resize(value.capacity());
+				}
+
+				auto data = useValue ? &value[0] : stackBuffer;
+				auto cbData = static_cast<DWORD>((useValue ? value.length() : StringBufferLength) * sizeof(wchar_t));
+
+				LSTATUS lStatus = m_backend->QueryValue(m_hKey, name.c_str(), &dwType, reinterpret_cast<LPBYTE>(data), &cbData);
+
+				while (lStatus == ERROR_MORE_DATA && dwType == REG_MULTI_SZ)
+				{
+					// cbData now holds required size, value might grow in between calls
+					value.resize((cbData + sizeof(wchar_t) - 1) / sizeof(wchar_t));
+
+					data = &value[0];
+					cbData = static_cast<DWORD>(value.length() * sizeof(wchar_t));
+
+					lStatus = m_backend->QueryValue(m_hKey, name.c_str(), &dwType, reinterpret_cast<LPBYTE>(data), &cbData);
+				}
+
+				if (lStatus != ERROR_SUCCESS && lStatus != ERROR_MORE_DATA)
+				{
+					value.clear();
+
+					return lStatus;
+				}
+
+				if (dwType != REG_MULTI_SZ)
+				{
+					value.clear();
+
+					return ERROR_UNSUPPORTED_TYPE;
+				}
+
+				const auto cchData = cbData / sizeof(wchar_t);
+
+				if (data == stackBuffer)
+				{
+					value.assign(data, cchData);
+				}
+				else
+				{
+					value.resize(cchData);
+				}
+
+				return ERROR_SUCCESS;
+			}
+
+			template <typename T>
+			static std::optional<T> Result(LSTATUS lStatus, const T& value, std::error_code& ec)
+			{
+				ec = std::error_code(lStatus, std::system_category());
+
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return std::nullopt;
+				}
+
+				return value;
+			}
+
 		private:
 			HKEY m_hKey;
+			RegistryBackend_ptr m_backend;
 		};
 
 		extern RegistryKey_ptr ClassesRoot;
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <RegistryPlatform.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		enum class BatchOperationType
+		{
+			// Same as RegCreateKeyEx()
+			CreateKey,
+			// Same as RegDeleteTree() followed by RegDeleteKey()
+			DeleteKey,
+			// Same as RegSetValueEx()
+			SetValue,
+			// Same as RegDeleteValue()
+			DeleteValue
+		};
+
+		/// <summary>
+		///		Single operation of write batch
+		/// </summary>
+		struct BatchOperation
+		{
+			BatchOperationType type = BatchOperationType::SetValue;
+			// Path of key operation is made on, relative to key batch is applied to. Nullptr or empty for that key itself.
+			const wchar_t* lpSubKey = nullptr;
+			const wchar_t* lpValueName = nullptr;
+			DWORD dwType = REG_NONE;
+			const BYTE* lpData = nullptr;
+			DWORD cbData = 0;
+		};
+
+		/// <summary>
+		///		Storage backend RegistryKey operates on.
+		///		Every method mirrors semantics and return codes of corresponding native registry API function,
+		///		so RegistryKey behaves the same regardless of which backend stores its keys and values.
+		/// </summary>
+		class RegistryBackend
+		{
+		public:
+			virtual ~RegistryBackend() = default;
+
+			/// <summary>
+			///		Same as RegOpenKeyEx()
+			/// </summary>
+			virtual LSTATUS OpenKey(HKEY hKey, const wchar_t* lpSubKey, REGSAM samDesired, HKEY* phkResult) = 0;
+
+			/// <summary>
+			///		Same as RegCreateKeyEx()
+			/// </summary>
+			virtual LSTATUS CreateKey(HKEY hKey, const wchar_t* lpSubKey, DWORD dwOptions, REGSAM samDesired, HKEY* phkResult) = 0;
+
+			/// <summary>
+			///		Same as RegCloseKey()
+			/// </summary>
+			virtual LSTATUS CloseKey(HKEY hKey) = 0;
+
+			/// <summary>
+			///		Same as RegDeleteTree(). When lpSubKey is nullptr, subkeys and values of hKey are deleted.
+			/// </summary>
+			virtual LSTATUS DeleteTree(HKEY hKey, const wchar_t* lpSubKey) = 0;
+
+			/// <summary>
+			///		Same as RegDeleteValue()
+			/// </summary>
+			virtual LSTATUS DeleteValue(HKEY hKey, const wchar_t* lpValueName) = 0;
+
+			/// <summary>
+			///		Same as RegFlushKey()
+			/// </summary>
+			virtual LSTATUS FlushKey(HKEY hKey) = 0;
+
+			/// <summary>
+			///		Same as RegSaveKey()
+			/// </summary>
+			virtual LSTATUS SaveKey(HKEY hKey, const wchar_t* lpFile) = 0;
+
+			/// <summary>
+			///		Same as RegQueryValueEx()
+			/// </summary>
+			virtual LSTATUS QueryValue(HKEY hKey, const wchar_t* lpValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) = 0;
+
+			/// <summary>
+			///		Same as RegQueryMultipleValues()
+			/// </summary>
+			virtual LSTATUS QueryMultipleValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize) = 0;
+
+			/// <summary>
+			///		Same as RegQueryMultipleValues(), but value which cannot be read, e.g. missing one, does not fail whole call.
+			///		Status of each value is stored into lpStatuses, value which was not read gets REG_NONE type and no data.
+			///		Call fails only when key cannot be read or, with ERROR_MORE_DATA, when buffer is too small.
+			/// </summary>
+			/// <remarks>
+			///		Backends keeping registry in process override this to read all values at once. Default implementation
+			///		finds out which values cannot be read and then reads the rest by single RegQueryMultipleValues().
+			///		When that fails again, or data exceed limit of RegQueryMultipleValues(), values are read one by one.
+			/// </remarks>
+			virtual LSTATUS QueryValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize, LSTATUS* lpStatuses)
+			{
+				if (val_list == nullptr || ldwTotsize == nullptr || lpStatuses == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				for (DWORD i = 0; i < num_vals; ++i)
+				{
+					lpStatuses[i] = ERROR_SUCCESS;
+				}
+
+				LSTATUS lStatus = QueryMultipleValues(hKey, val_list, num_vals, lpValueBuf, ldwTotsize);
+
+				if (lStatus == ERROR_FILE_NOT_FOUND || lStatus == ERROR_CANT_READ)
+				{
+					std::vector<VALENTW> readable;
+					std::vector<DWORD> indices;
+
+					for (DWORD i = 0; i < num_vals; ++i)
+					{
+						lpStatuses[i] = QueryValue(hKey, val_list[i].ve_valuename, nullptr, nullptr, nullptr);
+
+						if (lpStatuses[i] == ERROR_SUCCESS)
+						{
+							readable.push_back(val_list[i]);
+							indices.push_back(i);
+						}
+						else
+						{
+							val_list[i].ve_valuelen = 0;
+							val_list[i].ve_valueptr = 0;
+							val_list[i].ve_type = REG_NONE;
+						}
+					}
+
+					DWORD cbTotal = *ldwTotsize;
+
+					lStatus = readable.empty() ? ERROR_SUCCESS : QueryMultipleValues(hKey, readable.data(), static_cast<DWORD>(readable.size()), lpValueBuf, &cbTotal);
+
+					if (lStatus == ERROR_SUCCESS || lStatus == ERROR_MORE_DATA)
+					{
+						*ldwTotsize = readable.empty() ? 0 : cbTotal;
+
+						for (size_t i = 0; i < indices.size(); ++i)
+						{
+							val_list[indices[i]] = readable[i];
+						}
+					}
+				}
+
+				// Value was deleted in between calls or data exceed 1 MB limit of RegQueryMultipleValues()
+				if (lStatus == ERROR_FILE_NOT_FOUND || lStatus == ERROR_CANT_READ || lStatus == ERROR_TRANSFER_TOO_LONG)
+				{
+					lStatus = QueryEachValue(hKey, val_list, num_vals, lpValueBuf, ldwTotsize, lpStatuses);
+				}
+
+				return lStatus;
+			}
+
+			/// <summary>
+			///		Same as RegSetValueEx()
+			/// </summary>
+			virtual LSTATUS SetValue(HKEY hKey, const wchar_t* lpValueName, DWORD dwType, const BYTE* lpData, DWORD cbData) = 0;
+
+			/// <summary>
+			///		Same as RegQueryInfoKey(), without class and security descriptor information
+			/// </summary>
+			virtual LSTATUS QueryInfoKey(HKEY hKey, LPDWORD lpcSubKeys, LPDWORD lpcchMaxSubKeyLen, LPDWORD lpcValues, LPDWORD lpcchMaxValueNameLen, LPDWORD lpcbMaxValueLen, FILETIME* lpftLastWriteTime) = 0;
+
+			/// <summary>
+			///		Same as RegEnumKeyEx(), without class and last write time information
+			/// </summary>
+			virtual LSTATUS EnumKey(HKEY hKey, DWORD dwIndex, wchar_t* lpName, LPDWORD lpcchName) = 0;
+
+			/// <summary>
+			///		Same as RegEnumValue()
+			/// </summary>
+			virtual LSTATUS EnumValue(HKEY hKey, DWORD dwIndex, wchar_t* lpValueName, LPDWORD lpcchValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) = 0;
+
+			/// <summary>
+			///		Same as RegNotifyChangeKeyValue()
+			/// </summary>
+			virtual LSTATUS NotifyChangeKeyValue(HKEY hKey, bool watchSubtree, DWORD dwNotifyFilter, HANDLE hEvent, bool asynchronous) = 0;
+
+			/// <summary>
+			///		Applies operations in order as single transaction, same as if they were made on keys opened by
+			///		RegCreateKeyTransacted() and committed by CommitTransaction(). Either all operations are applied or none,
+			///		other threads never observe partially applied batch.
+			/// </summary>
+			virtual LSTATUS ApplyBatch(HKEY hKey, const BatchOperation* pOperations, DWORD cOperations) = 0;
+
+		private:
+			/// <summary>
+			///		Reads values one by one into consecutive parts of buffer, reporting status of each one
+			/// </summary>
+			LSTATUS QueryEachValue(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize, LSTATUS* lpStatuses)
+			{
+				const DWORD cbBuffer = (lpValueBuf != nullptr) ? *ldwTotsize : 0;
+
+				DWORD cbTotal = 0;
+				bool fits = true;
+
+				for (DWORD i = 0; i < num_vals; ++i)
+				{
+					// Once buffer is exhausted, only sizes of remaining values are queried
+					LPBYTE pData = (lpValueBuf != nullptr && fits) ? lpValueBuf + cbTotal : nullptr;
+					DWORD cbData = (pData != nullptr) ? cbBuffer - cbTotal : 0;
+					DWORD dwType = REG_NONE;
+
+					LSTATUS lStatus = QueryValue(hKey, val_list[i].ve_valuename, &dwType, pData, &cbData);
+
+					if (lStatus == ERROR_MORE_DATA)
+					{
+						fits = false;
+						pData = nullptr;
+						lStatus = ERROR_SUCCESS;
+					}
+
+					lpStatuses[i] = lStatus;
+
+					if (lStatus != ERROR_SUCCESS)
+					{
+						dwType = REG_NONE;
+						cbData = 0;
+					}
+
+					val_list[i].ve_valuelen = cbData;
+					val_list[i].ve_valueptr = reinterpret_cast<DWORD_PTR>(pData);
+					val_list[i].ve_type = dwType;
+
+					cbTotal += cbData;
+				}
+
+				*ldwTotsize = cbTotal;
+
+				return (lpValueBuf != nullptr && !fits) ? ERROR_MORE_DATA : ERROR_SUCCESS;
+			}
+		};
+
+		typedef std::shared_ptr<RegistryBackend> RegistryBackend_ptr;
+
+		/// <summary>
+		///		Backend used by predefined root keys and by RegistryKey objects constructed without explicit backend.
+		///		Native registry on Windows, process wide in-memory registry elsewhere.
+		/// </summary>
+		RegistryBackend_ptr DefaultBackend();
+	}
+}
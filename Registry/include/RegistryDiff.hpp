@@ -0,0 +1,675 @@
+#pragma once
+
+#include <Registry.hpp>
+#include <HiveFile.hpp>
+#include <Snapshot.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cwctype>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		enum class DiffAction
+		{
+			// Key exists in second tree only
+			KeyAdded,
+			// Key exists in first tree only
+			KeyRemoved,
+			// Value exists in second tree only
+			ValueAdded,
+			// Value exists in first tree only
+			ValueRemoved,
+			// Value exists in both trees, with different type or data
+			ValueChanged
+		};
+
+		/// <summary>
+		///		Difference found by Diff(). Path, name and data are valid only during callback invocation, data is 8 byte aligned.
+		/// </summary>
+		struct DiffEntry
+		{
+			DiffAction action = DiffAction::ValueChanged;
+			// Path of key relative to compared keys, empty for compared keys themselves
+			std::wstring_view path;
+			// Name of value, empty for key differences and default values
+			std::wstring_view name;
+			// Value in first tree, set for ValueRemoved and ValueChanged
+			DWORD oldType = REG_NONE;
+			const BYTE* pOldData = nullptr;
+			DWORD cbOldData = 0;
+			// Value in second tree, set for ValueAdded and ValueChanged
+			DWORD newType = REG_NONE;
+			const BYTE* pNewData = nullptr;
+			DWORD cbNewData = 0;
+		};
+
+		struct DiffOptions
+		{
+			// Deepest level of subkeys compared, direct subkeys of compared keys have depth 1
+			size_t maxDepth = std::numeric_limits<size_t>::max();
+			// Values of keys with same last write time and same number of values are assumed to be same.
+			// Enable only when comparing tree with its own copy which keeps last write times, e.g. saved hive or snapshot.
+			bool trustLastWriteTime = false;
+		};
+
+		struct DiffResult
+		{
+			// Number of key pairs compared
+			size_t keys = 0;
+			// Number of key pairs whose values or whole subtrees were not compared, because they were known to be same
+			size_t skipped = 0;
+			// Number of differences reported
+			size_t differences = 0;
+			// Whether comparison was stopped by callback
+			bool stopped = false;
+		};
+
+		/// <summary>
+		///		Information about key, used to skip parts of trees which are known to be same
+		/// </summary>
+		struct DiffKeyInfo
+		{
+			DWORD subKeys = 0;
+			DWORD values = 0;
+			// Zero when not known
+			ULONGLONG lastWriteTime = 0;
+			// Digest of subtree, same as SnapshotKey::GetDigest(), valid only when hasDigest is true
+			ULONGLONG digest = 0;
+			bool hasDigest = false;
+		};
+
+		/// <summary>
+		///		Adapts key type to Diff(). Specialize it to compare trees of other key types.
+		/// </summary>
+		template <typename T>
+		struct DiffSource;
+
+		template <>
+		struct DiffSource<RegistryKey_ptr>
+		{
+			// String data is stored as wchar_t, which is not UTF-16 on every platform
+			static constexpr bool NativeStrings = true;
+
+			static void GetInfo(const RegistryKey_ptr& key, DiffKeyInfo& info)
+			{
+				if (key == nullptr)
+				{
+					throw std::invalid_argument("Registry key cannot be nullptr");
+				}
+
+				FILETIME ftLastWriteTime = {};
+
+				LSTATUS lStatus = key->GetBackend()->QueryInfoKey(*key, &info.subKeys, nullptr, &info.values, nullptr, nullptr, &ftLastWriteTime);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegQueryInfoKey() failed");
+				}
+
+				info.lastWriteTime = (static_cast<ULONGLONG>(ftLastWriteTime.dwHighDateTime) << 32) | ftLastWriteTime.dwLowDateTime;
+			}
+
+			static RegistryKey_ptr Open(const RegistryKey_ptr& key, const std::wstring& name)
+			{
+				return key->Open(name, DesiredAccess::Read);
+			}
+
+			template <typename __Function>
+			static void EnumerateSubKeys(const RegistryKey_ptr& key, const __Function& callback)
+			{
+				key->EnumerateSubKeys(callback);
+			}
+
+			template <typename __Function>
+			static void EnumerateValues(const RegistryKey_ptr& key, const __Function& callback)
+			{
+				key->EnumerateValues(callback);
+			}
+		};
+
+		template <>
+		struct DiffSource<HiveKey>
+		{
+			static constexpr bool NativeStrings = false;
+
+			static void GetInfo(const HiveKey& key, DiffKeyInfo& info)
+			{
+				const FILETIME ftLastWriteTime = key.GetLastWriteTime();
+
+				info.subKeys = key.GetSubKeyCount();
+				info.values = key.GetValueCount();
+				info.lastWriteTime = (static_cast<ULONGLONG>(ftLastWriteTime.dwHighDateTime) << 32) | ftLastWriteTime.dwLowDateTime;
+			}
+
+			static HiveKey Open(const HiveKey& key, const std::wstring& name)
+			{
+				return key.Open(name);
+			}
+
+			template <typename __Function>
+			static void EnumerateSubKeys(const HiveKey& key, const __Function& callback)
+			{
+				key.EnumerateSubKeys(callback);
+			}
+
+			template <typename __Function>
+			static void EnumerateValues(const HiveKey& key, const __Function& callback)
+			{
+				key.EnumerateValues(callback);
+			}
+		};
+
+		template <>
+		struct DiffSource<SnapshotKey>
+		{
+			static constexpr bool NativeStrings = false;
+
+			static void GetInfo(const SnapshotKey& key, DiffKeyInfo& info)
+			{
+				const FILETIME ftLastWriteTime = key.GetLastWriteTime();
+
+				info.subKeys = key.GetSubKeyCount();
+				info.values = key.GetValueCount();
+				info.lastWriteTime = (static_cast<ULONGLONG>(ftLastWriteTime.dwHighDateTime) << 32) | ftLastWriteTime.dwLowDateTime;
+				info.digest = key.GetDigest();
+				info.hasDigest = true;
+			}
+
+			static SnapshotKey Open(const SnapshotKey& key, const std::wstring& name)
+			{
+				return key.Open(name);
+			}
+
+			template <typename __Function>
+			static void EnumerateSubKeys(const SnapshotKey& key, const __Function& callback)
+			{
+				key.EnumerateSubKeys(callback);
+			}
+
+			template <typename __Function>
+			static void EnumerateValues(const SnapshotKey& key, const __Function& callback)
+			{
+				key.EnumerateValues(callback);
+			}
+		};
+
+		/// <summary>
+		///		Compares two registry trees and reports differences as they are found, so trees of any size
+		///		are compared without holding differences in memory. Trees can be of different types, e.g. live
+		///		registry key, key of offline hive and key of snapshot.
+		/// </summary>
+		/// <remarks>
+		///		Keys and values are matched by case insensitive names. Added or removed key is reported once,
+		///		its subkeys and values are not reported. String data is reported UTF-16LE encoded, same as stored
+		///		in hives and snapshots, trailing null characters of REG_SZ and REG_EXPAND_SZ values are not compared.
+		///		Subtrees of snapshot keys with same digest are skipped without being read.
+		/// </remarks>
+		template <typename __First, typename __Second>
+		class RegistryDiff
+		{
+		public:
+			explicit RegistryDiff(const DiffOptions& options = DiffOptions())
+				: m_options(options)
+			{
+			}
+
+			// Disable copy ctor & copy assignment operator
+			RegistryDiff(const RegistryDiff& other) = delete;
+			RegistryDiff& operator=(const RegistryDiff& other) = delete;
+
+			/// <summary>
+			///		Compares subtrees of specified keys. Callback receives each difference as const DiffEntry&
+			///		and returns true to continue comparison, false otherwise.
+			/// </summary>
+			template <typename __Function>
+			DiffResult Compare(const __First& first, const __Second& second, const __Function& callback)
+			{
+				m_result = DiffResult();
+				m_path.clear();
+
+				CompareKeys(first, second, 0, callback);
+
+				return m_result;
+			}
+
+		private:
+			struct Value
+			{
+				std::wstring name;
+				std::wstring upper;
+				DWORD type = REG_NONE;
+				size_t offset = 0;
+				DWORD cbData = 0;
+			};
+
+			struct SubKey
+			{
+				std::wstring name;
+				std::wstring upper;
+			};
+
+			/// <summary>
+			///		Values and subkey names of one key. Entries are reused by keys compared on same depth,
+			///		so comparing large trees does not allocate memory for every key.
+			/// </summary>
+			struct Side
+			{
+				std::vector<Value> values;
+				size_t valueCount = 0;
+				std::vector<BYTE> data;
+				std::vector<SubKey> subKeys;
+				size_t subKeyCount = 0;
+				std::vector<size_t> order;
+			};
+
+			struct Level
+			{
+				Side first;
+				Side second;
+			};
+
+			static void Upcase(std::wstring_view name, std::wstring& upper)
+			{
+				upper.assign(name);
+
+				for (auto& ch : upper)
+				{
+					if (ch < 0x80)
+					{
+						if (ch >= L'a' && ch <= L'z')
+						{
+							ch = static_cast<wchar_t>(ch - (L'a' - L'A'));
+						}
+					}
+					else
+					{
+						ch = static_cast<wchar_t>(std::towupper(static_cast<wint_t>(ch)));
+					}
+				}
+			}
+
+			static bool IsString(DWORD dwType)
+			{
+				return dwType == REG_SZ || dwType == REG_EXPAND_SZ || dwType == REG_MULTI_SZ;
+			}
+
+			/// <summary>
+			///		Size of data which is compared, without trailing null characters of strings
+			/// </summary>
+			static DWORD ComparedSize(DWORD dwType, const BYTE* pData, DWORD cbData)
+			{
+				if ((dwType == REG_SZ || dwType == REG_EXPAND_SZ) && (cbData & 1) == 0)
+				{
+					while (cbData >= 2 && pData[cbData - 1] == 0 && pData[cbData - 2] == 0)
+					{
+						cbData -= 2;
+					}
+				}
+
+				return cbData;
+			}
+
+			/// <summary>
+			///		Appends value data, converting strings stored as 32 bit wchar_t to UTF-16LE
+			/// </summary>
+			template <typename __Source>
+			static void AppendData(std::vector<BYTE>& data, DWORD dwType, const BYTE* pData, DWORD cbData)
+			{
+				if (__Source::NativeStrings && sizeof(wchar_t) != 2 && IsString(dwType))
+				{
+					for (DWORD i = 0; i + sizeof(wchar_t) <= cbData; i += sizeof(wchar_t))
+					{
+						wchar_t ch;
+						std::memcpy(&ch, pData + i, sizeof(ch));
+
+						auto cp = static_cast<DWORD>(ch);
+
+						if (cp > 0xFFFF)
+						{
+							cp -= 0x10000;
+
+							const DWORD high = 0xD800 + (cp >> 10);
+
+							data.push_back(static_cast<BYTE>(high & 0xFF));
+							data.push_back(static_cast<BYTE>(high >> 8));
+
+							cp = 0xDC00 + (cp & 0x3FF);
+						}
+
+						data.push_back(static_cast<BYTE>(cp & 0xFF));
+						data.push_back(static_cast<BYTE>(cp >> 8));
+					}
+				}
+				else
+				{
+					data.insert(data.end(), pData, pData + cbData);
+				}
+			}
+
+			template <typename __Source, typename __Key>
+			static void LoadValues(const __Key& key, Side& side)
+			{
+				side.valueCount = 0;
+				side.data.clear();
+
+				__Source::EnumerateValues(key, [&side](std::wstring_view name, DWORD dwType, const BYTE* pData, DWORD cbData) -> bool
+				{
+					if (side.valueCount == side.values.size())
+					{
+						side.values.emplace_back();
+					}
+
+					auto& value = side.values[side.valueCount++];
+
+					value.name.assign(name);
+					Upcase(name, value.upper);
+					value.type = dwType;
+
+					// Data of each value is 8 byte aligned, so it can be read in place as integers
+					side.data.resize((side.data.size() + 7) & ~static_cast<size_t>(7));
+
+					value.offset = side.data.size();
+
+					AppendData<__Source>(side.data, dwType, pData, cbData);
+
+					value.cbData = static_cast<DWORD>(side.data.size() - value.offset);
+
+					return true;
+				});
+
+				Sort(side.values, side.valueCount, side.order);
+			}
+
+			template <typename __Source, typename __Key>
+			static void LoadSubKeys(const __Key& key, Side& side)
+			{
+				side.subKeyCount = 0;
+
+				__Source::EnumerateSubKeys(key, [&side](const std::wstring& name) -> bool
+				{
+					if (side.subKeyCount == side.subKeys.size())
+					{
+						side.subKeys.emplace_back();
+					}
+
+					auto& subKey = side.subKeys[side.subKeyCount++];
+
+					subKey.name = name;
+					Upcase(name, subKey.upper);
+
+					return true;
+				});
+
+				Sort(side.subKeys, side.subKeyCount, side.order);
+			}
+
+			template <typename T>
+			static void Sort(const std::vector<T>& entries, size_t count, std::vector<size_t>& order)
+			{
+				order.resize(count);
+
+				for (size_t i = 0; i < count; ++i)
+				{
+					order[i] = i;
+				}
+
+				std::sort(order.begin(), order.end(), [&entries](size_t a, size_t b)
+				{
+					return entries[a].upper < entries[b].upper;
+				});
+			}
+
+			template <typename __Function>
+			bool Report(DiffEntry& entry, const __Function& callback)
+			{
+				++m_result.differences;
+
+				if (!callback(static_cast<const DiffEntry&>(entry)))
+				{
+					m_result.stopped = true;
+
+					return false;
+				}
+
+				return true;
+			}
+
+			template <typename __Function>
+			bool ReportKey(DiffAction action, const std::wstring& name, const __Function& callback)
+			{
+				const size_t length = m_path.length();
+
+				if (length > 0)
+				{
+					m_path += L'\\';
+				}
+
+				m_path += name;
+
+				DiffEntry entry;
+				entry.action = action;
+				entry.path = m_path;
+
+				const bool result = Report(entry, callback);
+
+				m_path.resize(length);
+
+				return result;
+			}
+
+			Level& GetLevel(size_t depth)
+			{
+				while (m_levels.size() <= depth)
+				{
+					m_levels.push_back(std::make_unique<Level>());
+				}
+
+				return *m_levels[depth];
+			}
+
+			template <typename __Function>
+			bool CompareValues(Level& level, const __Function& callback)
+			{
+				const auto& first = level.first;
+				const auto& second = level.second;
+
+				size_t i = 0;
+				size_t j = 0;
+
+				while (i < first.valueCount || j < second.valueCount)
+				{
+					const Value* a = (i < first.valueCount) ? &first.values[first.order[i]] : nullptr;
+					const Value* b = (j < second.valueCount) ? &second.values[second.order[j]] : nullptr;
+
+					int compare = (a == nullptr) ? 1 : (b == nullptr) ? -1 : a->upper.compare(b->upper);
+
+					DiffEntry entry;
+					entry.path = m_path;
+
+					if (compare < 0)
+					{
+						entry.action = DiffAction::ValueRemoved;
+					}
+					else if (compare > 0)
+					{
+						entry.action = DiffAction::ValueAdded;
+					}
+					else
+					{
+						const BYTE* pA = first.data.data() + a->offset;
+						const BYTE* pB = second.data.data() + b->offset;
+
+						const DWORD cbA = ComparedSize(a->type, pA, a->cbData);
+						const DWORD cbB = ComparedSize(b->type, pB, b->cbData);
+
+						if (a->type == b->type && cbA == cbB && (cbA == 0 || std::memcmp(pA, pB, cbA) == 0))
+						{
+							++i;
+							++j;
+
+							continue;
+						}
+
+						entry.action = DiffAction::ValueChanged;
+					}
+
+					if (compare <= 0)
+					{
+						entry.name = a->name;
+						entry.oldType = a->type;
+						entry.pOldData = first.data.data() + a->offset;
+						entry.cbOldData = a->cbData;
+
+						++i;
+					}
+
+					if (compare >= 0)
+					{
+						entry.name = b->name;
+						entry.newType = b->type;
+						entry.pNewData = second.data.data() + b->offset;
+						entry.cbNewData = b->cbData;
+
+						++j;
+					}
+
+					if (!Report(entry, callback))
+					{
+						return false;
+					}
+				}
+
+				return true;
+			}
+
+			template <typename __Function>
+			bool CompareKeys(const __First& first, const __Second& second, size_t depth, const __Function& callback)
+			{
+				++m_result.keys;
+
+				DiffKeyInfo firstInfo;
+				DiffKeyInfo secondInfo;
+
+				DiffSource<__First>::GetInfo(first, firstInfo);
+				DiffSource<__Second>::GetInfo(second, secondInfo);
+
+				if (firstInfo.hasDigest && secondInfo.hasDigest && firstInfo.digest == secondInfo.digest)
+				{
+					++m_result.skipped;
+
+					return true;
+				}
+
+				Level& level = GetLevel(depth);
+
+				if (m_options.trustLastWriteTime && firstInfo.lastWriteTime != 0 && firstInfo.lastWriteTime == secondInfo.lastWriteTime && firstInfo.values == secondInfo.values)
+				{
+					++m_result.skipped;
+				}
+				else if (firstInfo.values != 0 || secondInfo.values != 0)
+				{
+					LoadValues<DiffSource<__First>>(first, level.first);
+					LoadValues<DiffSource<__Second>>(second, level.second);
+
+					if (!CompareValues(level, callback))
+					{
+						return false;
+					}
+				}
+
+				if (depth >= m_options.maxDepth || (firstInfo.subKeys == 0 && secondInfo.subKeys == 0))
+				{
+					return true;
+				}
+
+				LoadSubKeys<DiffSource<__First>>(first, level.first);
+				LoadSubKeys<DiffSource<__Second>>(second, level.second);
+
+				const auto& a = level.first;
+				const auto& b = level.second;
+
+				size_t i = 0;
+				size_t j = 0;
+
+				while (i < a.subKeyCount || j < b.subKeyCount)
+				{
+					const SubKey* subKeyA = (i < a.subKeyCount) ? &a.subKeys[a.order[i]] : nullptr;
+					const SubKey* subKeyB = (j < b.subKeyCount) ? &b.subKeys[b.order[j]] : nullptr;
+
+					int compare = (subKeyA == nullptr) ? 1 : (subKeyB == nullptr) ? -1 : subKeyA->upper.compare(subKeyB->upper);
+
+					if (compare < 0)
+					{
+						++i;
+
+						if (!ReportKey(DiffAction::KeyRemoved, subKeyA->name, callback))
+						{
+							return false;
+						}
+					}
+					else if (compare > 0)
+					{
+						++j;
+
+						if (!ReportKey(DiffAction::KeyAdded, subKeyB->name, callback))
+						{
+							return false;
+						}
+					}
+					else
+					{
+						++i;
+						++j;
+
+						const size_t length = m_path.length();
+
+						if (length > 0)
+						{
+							m_path += L'\\';
+						}
+
+						m_path += subKeyA->name;
+
+						const bool result = CompareKeys(DiffSource<__First>::Open(first, subKeyA->name), DiffSource<__Second>::Open(second, subKeyB->name), depth + 1, callback);
+
+						m_path.resize(length);
+
+						if (!result)
+						{
+							return false;
+						}
+					}
+				}
+
+				return true;
+			}
+
+		private:
+			DiffOptions m_options;
+			DiffResult m_result;
+			// Path of compared key, relative to compared roots
+			std::wstring m_path;
+			std::vector<std::unique_ptr<Level>> m_levels;
+		};
+
+		/// <summary>
+		///		Compares subtrees of two keys, invoking callback for each difference found
+		/// </summary>
+		template <typename __First, typename __Second, typename __Function>
+		DiffResult Diff(const __First& first, const __Second& second, const __Function& callback, const DiffOptions& options = DiffOptions())
+		{
+			RegistryDiff<__First, __Second> diff(options);
+
+			return diff.Compare(first, second, callback);
+		}
+	}
+}
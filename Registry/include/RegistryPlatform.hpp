@@ -0,0 +1,120 @@
+#pragma once
+
+#if defined(_WIN32)
+
+#include <Windows.h>
+
+#else
+
+#include <cstdint>
+#include <type_traits>
+
+// Minimal subset of Win32 types and constants used by Registry namespace,
+// so library can be built off Windows on top of portable backends
+
+typedef std::uint8_t BYTE;
+typedef std::uint16_t WORD;
+typedef std::uint32_t DWORD;
+typedef std::int32_t LONG;
+typedef std::int64_t LONGLONG;
+typedef std::uint64_t ULONGLONG;
+typedef LONG LSTATUS;
+typedef BYTE* LPBYTE;
+typedef DWORD* LPDWORD;
+typedef std::uintptr_t ULONG_PTR;
+typedef std::uintptr_t DWORD_PTR;
+typedef DWORD REGSAM;
+typedef void* HANDLE;
+typedef struct HKEY__* HKEY;
+
+typedef struct _FILETIME
+{
+	DWORD dwLowDateTime;
+	DWORD dwHighDateTime;
+} FILETIME;
+
+typedef struct value_entW
+{
+	wchar_t* ve_valuename;
+	DWORD ve_valuelen;
+	DWORD_PTR ve_valueptr;
+	DWORD ve_type;
+} VALENTW, *PVALENTW;
+
+#define ERROR_SUCCESS				0L
+#define ERROR_FILE_NOT_FOUND		2L
+#define ERROR_ACCESS_DENIED			5L
+#define ERROR_INVALID_HANDLE		6L
+#define ERROR_NOT_ENOUGH_MEMORY		8L
+#define ERROR_NOT_SUPPORTED			50L
+#define ERROR_INVALID_PARAMETER		87L
+#define ERROR_TRANSFER_TOO_LONG		222L
+#define ERROR_MORE_DATA				234L
+#define ERROR_NO_MORE_ITEMS			259L
+#define ERROR_BADDB					1009L
+#define ERROR_CANT_READ				1012L
+#define ERROR_UNSUPPORTED_TYPE		1630L
+#define ERROR_KEY_DELETED			1018L
+
+#define REG_NONE						0
+#define REG_SZ							1
+#define REG_EXPAND_SZ					2
+#define REG_BINARY						3
+#define REG_DWORD						4
+#define REG_DWORD_BIG_ENDIAN			5
+#define REG_LINK						6
+#define REG_MULTI_SZ					7
+#define REG_RESOURCE_LIST				8
+#define REG_FULL_RESOURCE_DESCRIPTOR	9
+#define REG_RESOURCE_REQUIREMENTS_LIST	10
+#define REG_QWORD						11
+
+#define DELETE						0x00010000L
+#define READ_CONTROL				0x00020000L
+#define WRITE_DAC					0x00040000L
+#define WRITE_OWNER					0x00080000L
+
+#define KEY_QUERY_VALUE				0x0001
+#define KEY_SET_VALUE				0x0002
+#define KEY_CREATE_SUB_KEY			0x0004
+#define KEY_ENUMERATE_SUB_KEYS		0x0008
+#define KEY_NOTIFY					0x0010
+#define KEY_CREATE_LINK				0x0020
+#define KEY_WOW64_64KEY				0x0100
+#define KEY_WOW64_32KEY				0x0200
+#define KEY_READ					(READ_CONTROL | KEY_QUERY_VALUE | KEY_ENUMERATE_SUB_KEYS | KEY_NOTIFY)
+#define KEY_WRITE					(READ_CONTROL | KEY_SET_VALUE | KEY_CREATE_SUB_KEY)
+#define KEY_EXECUTE					KEY_READ
+#define KEY_ALL_ACCESS				(0x000F0000L | KEY_QUERY_VALUE | KEY_SET_VALUE | KEY_CREATE_SUB_KEY | KEY_ENUMERATE_SUB_KEYS | KEY_NOTIFY | KEY_CREATE_LINK)
+
+#define REG_OPTION_NON_VOLATILE		0x00000000L
+#define REG_OPTION_VOLATILE			0x00000001L
+#define REG_OPTION_BACKUP_RESTORE	0x00000004L
+
+#define REG_NOTIFY_CHANGE_NAME			0x00000001L
+#define REG_NOTIFY_CHANGE_ATTRIBUTES	0x00000002L
+#define REG_NOTIFY_CHANGE_LAST_SET		0x00000004L
+#define REG_NOTIFY_CHANGE_SECURITY		0x00000008L
+#define REG_NOTIFY_THREAD_AGNOSTIC		0x10000000L
+
+#define HKEY_CLASSES_ROOT					((HKEY)(ULONG_PTR)((LONG)0x80000000))
+#define HKEY_CURRENT_USER					((HKEY)(ULONG_PTR)((LONG)0x80000001))
+#define HKEY_LOCAL_MACHINE					((HKEY)(ULONG_PTR)((LONG)0x80000002))
+#define HKEY_USERS							((HKEY)(ULONG_PTR)((LONG)0x80000003))
+#define HKEY_PERFORMANCE_DATA				((HKEY)(ULONG_PTR)((LONG)0x80000004))
+#define HKEY_CURRENT_CONFIG					((HKEY)(ULONG_PTR)((LONG)0x80000005))
+#define HKEY_DYN_DATA						((HKEY)(ULONG_PTR)((LONG)0x80000006))
+#define HKEY_CURRENT_USER_LOCAL_SETTINGS	((HKEY)(ULONG_PTR)((LONG)0x80000007))
+
+#define WINVER	0x0A00
+
+#define DEFINE_ENUM_FLAG_OPERATORS(ENUMTYPE)																																		\
+	inline constexpr ENUMTYPE operator | (ENUMTYPE a, ENUMTYPE b) { return ENUMTYPE(static_cast<std::underlying_type_t<ENUMTYPE>>(a) | static_cast<std::underlying_type_t<ENUMTYPE>>(b)); }	\
+	inline constexpr ENUMTYPE operator & (ENUMTYPE a, ENUMTYPE b) { return ENUMTYPE(static_cast<std::underlying_type_t<ENUMTYPE>>(a) & static_cast<std::underlying_type_t<ENUMTYPE>>(b)); }	\
+	inline constexpr ENUMTYPE operator ^ (ENUMTYPE a, ENUMTYPE b) { return ENUMTYPE(static_cast<std::underlying_type_t<ENUMTYPE>>(a) ^ static_cast<std::underlying_type_t<ENUMTYPE>>(b)); }	\
+	inline constexpr ENUMTYPE operator ~ (ENUMTYPE a) { return ENUMTYPE(~static_cast<std::underlying_type_t<ENUMTYPE>>(a)); }															\
+	inline ENUMTYPE& operator |= (ENUMTYPE& a, ENUMTYPE b) { return a = a | b; }																									\
+	inline ENUMTYPE& operator &= (ENUMTYPE& a, ENUMTYPE b) { return a = a & b; }																									\
+	inline ENUMTYPE& operator ^= (ENUMTYPE& a, ENUMTYPE b) { return a = a ^ b; }
+
+#endif
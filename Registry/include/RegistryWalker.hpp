@@ -0,0 +1,399 @@
+#pragma once
+
+#include <Registry.hpp>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <limits>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Decision returned by walk visitor for visited key
+		/// </summary>
+		enum class WalkAction
+		{
+			// Walk subkeys of visited key
+			Continue,
+			// Do not walk subkeys of visited key
+			Skip,
+			// Stop whole walk as soon as possible
+			Stop
+		};
+
+		/// <summary>
+		///		Visitor invoked for every walked subkey with its path relative to root, opened key and depth.
+		///		Direct subkeys of root have depth 1. Visitor is invoked concurrently from multiple threads.
+		/// </summary>
+		typedef std::function<WalkAction(const std::wstring& path, const RegistryKey_ptr& key, size_t depth)> WalkVisitor;
+
+		struct WalkOptions
+		{
+			// Number of threads walking the tree, including calling thread. Zero uses one thread per core.
+			size_t threads = 0;
+			// Deepest level of subkeys visited, direct subkeys of root have depth 1
+			size_t maxDepth = std::numeric_limits<size_t>::max();
+			// Access rights subkeys are opened with, must include DesiredAccess::EnumerateSubKeys
+			DesiredAccess access = DesiredAccess::Read;
+		};
+
+		struct WalkResult
+		{
+			// Number of keys visitor was invoked for
+			size_t visited = 0;
+			// Number of keys which could not be opened or enumerated, e.g. due to missing access rights
+			size_t errors = 0;
+			// Whether walk was stopped by visitor
+			bool stopped = false;
+		};
+
+		/// <summary>
+		///		Walks subtree of registry key recursively on multiple threads.
+		///		Each thread keeps own queue of keys to enumerate, taking most recently found key first,
+		///		and steals oldest keys from queues of other threads when it runs out of work.
+		/// </summary>
+		/// <remarks>
+		///		Keys which cannot be opened or enumerated are skipped and counted in WalkResult::errors.
+		///		Exception thrown by visitor stops walk and is rethrown by Walk().
+		/// </remarks>
+		class RegistryWalker
+		{
+		public:
+			RegistryWalker(const WalkVisitor& visitor, const WalkOptions& options)
+				: m_visitor(visitor)
+				, m_options(options)
+				, m_queued(0)
+				, m_pending(0)
+				, m_sleeping(0)
+				, m_stopped(false)
+				, m_visited(0)
+				, m_errors(0)
+			{
+				if (!m_visitor)
+				{
+					throw std::invalid_argument("Walk visitor cannot be empty");
+				}
+
+				if (m_options.threads == 0)
+				{
+					m_options.threads = std::thread::hardware_concurrency();
+				}
+
+				if (m_options.threads == 0)
+				{
+					// Number of cores is not known
+					m_options.threads = 1;
+				}
+
+				for (size_t i = 0; i < m_options.threads; ++i)
+				{
+					m_workers.push_back(std::make_unique<Worker>());
+				}
+			}
+
+			// Disable copy ctor & copy assignment operator
+			RegistryWalker(const RegistryWalker& other) = delete;
+			RegistryWalker& operator=(const RegistryWalker& other) = delete;
+
+			WalkResult Walk(const RegistryKey_ptr& root)
+			{
+				if (root == nullptr)
+				{
+					throw std::invalid_argument("Registry key cannot be nullptr");
+				}
+
+				m_queued = 0;
+				m_pending = 0;
+				m_stopped = false;
+				m_visited = 0;
+				m_errors = 0;
+				m_exception = nullptr;
+
+				if (m_options.maxDepth > 0)
+				{
+					Push(0, Task{ std::wstring(), root, 0 });
+				}
+
+				std::vector<std::thread> threads;
+
+				for (size_t i = 1; i < m_workers.size(); ++i)
+				{
+					threads.emplace_back(&RegistryWalker::Run, this, i);
+				}
+
+				// Calling thread works too
+				Run(0);
+
+				for (auto& thread : threads)
+				{
+					thread.join();
+				}
+
+				for (auto& worker : m_workers)
+				{
+					worker->tasks.clear();
+				}
+
+				if (m_exception)
+				{
+					std::rethrow_exception(m_exception);
+				}
+
+				WalkResult result;
+
+				result.visited = m_visited.load();
+				result.errors = m_errors.load();
+				result.stopped = m_stopped.load();
+
+				return result;
+			}
+
+		private:
+			struct Task
+			{
+				std::wstring path;
+				RegistryKey_ptr key;
+				size_t depth;
+			};
+
+			struct Worker
+			{
+				std::mutex mutex;
+				std::deque<Task> tasks;
+			};
+
+			void Run(size_t index)
+			{
+				Task task;
+
+				std::vector<std::wstring> names;
+
+				while (!m_stopped.load(std::memory_order_acquire))
+				{
+					if (Pop(index, task) || Steal(index, task))
+					{
+						Process(index, task, names);
+
+						task.key.reset();
+
+						if (m_pending.fetch_sub(1) == 1)
+						{
+							// Last task finished, wake up idle threads so they can exit
+							WakeAll();
+						}
+					}
+					else if (!Wait())
+					{
+						break;
+					}
+				}
+			}
+
+			void Process(size_t index, const Task& task, std::vector<std::wstring>& names)
+			{
+				names.clear();
+
+				try
+				{
+					task.key->EnumerateSubKeys([&names](const std::wstring& name)
+					{
+						names.push_back(name);
+
+						return true;
+					});
+				}
+				catch (const std::system_error&)
+				{
+					++m_errors;
+				}
+
+				const auto depth = task.depth + 1;
+
+				for (const auto& name : names)
+				{
+					if (m_stopped.load(std::memory_order_acquire))
+					{
+						break;
+					}
+
+					std::error_code ec;
+
+					auto key = task.key->TryOpen(name, m_options.access, ec);
+					if (key == nullptr)
+					{
+						++m_errors;
+
+						continue;
+					}
+
+					auto path = task.path.empty() ? name : task.path + L"\\" + name;
+
+					auto action = WalkAction::Stop;
+
+					try
+					{
+						action = m_visitor(path, key, depth);
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(m_mutex);
+
+						if (!m_exception)
+						{
+							m_exception = std::current_exception();
+						}
+					}
+
+					++m_visited;
+
+					if (action == WalkAction::Stop)
+					{
+						Stop();
+					}
+					else if (action == WalkAction::Continue && depth < m_options.maxDepth)
+					{
+						Push(index, Task{ std::move(path), std::move(key), depth });
+					}
+				}
+			}
+
+			void Push(size_t index, Task&& task)
+			{
+				++m_pending;
+
+				{
+					std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+
+					m_workers[index]->tasks.push_back(std::move(task));
+				}
+
+				++m_queued;
+
+				if (m_sleeping.load() > 0)
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+
+					m_wakeup.notify_one();
+				}
+			}
+
+			/// <summary>
+			///		Takes most recently queued task of own queue, so tree is walked depth first and queues stay short
+			/// </summary>
+			bool Pop(size_t index, Task& task)
+			{
+				auto& worker = *m_workers[index];
+
+				std::lock_guard<std::mutex> lock(worker.mutex);
+
+				if (worker.tasks.empty())
+				{
+					return false;
+				}
+
+				task = std::move(worker.tasks.back());
+				worker.tasks.pop_back();
+
+				--m_queued;
+
+				return true;
+			}
+
+			/// <summary>
+			///		Takes oldest task of other thread queue, which tends to be root of largest unwalked subtree
+			/// </summary>
+			bool Steal(size_t index, Task& task)
+			{
+				for (size_t i = 1; i < m_workers.size(); ++i)
+				{
+					auto& worker = *m_workers[(index + i) % m_workers.size()];
+
+					std::lock_guard<std::mutex> lock(worker.mutex);
+
+					if (!worker.tasks.empty())
+					{
+						task = std::move(worker.tasks.front());
+						worker.tasks.pop_front();
+
+						--m_queued;
+
+						return true;
+					}
+				}
+
+				return false;
+			}
+
+			/// <summary>
+			///		Waits until any task is queued, or until walk is finished. Task thread was woken for
+			///		may be taken by other thread first, so caller searches queues again while walk is not finished.
+			/// </summary>
+			/// <returns>false when walk is finished or stopped, true while any task is queued or being processed</returns>
+			bool Wait()
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+
+				++m_sleeping;
+
+				m_wakeup.wait(lock, [this]()
+				{
+					return m_queued.load() > 0 || m_pending.load() == 0 || m_stopped.load();
+				});
+
+				--m_sleeping;
+
+				return m_pending.load() != 0 && !m_stopped.load();
+			}
+
+			void Stop()
+			{
+				m_stopped.store(true, std::memory_order_release);
+
+				WakeAll();
+			}
+
+			void WakeAll()
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				m_wakeup.notify_all();
+			}
+
+		private:
+			WalkVisitor m_visitor;
+			WalkOptions m_options;
+			std::vector<std::unique_ptr<Worker>> m_workers;
+			// Tasks waiting in queues
+			std::atomic<size_t> m_queued;
+			// Tasks queued or being processed
+			std::atomic<size_t> m_pending;
+			std::atomic<size_t> m_sleeping;
+			std::atomic<bool> m_stopped;
+			std::atomic<size_t> m_visited;
+			std::atomic<size_t> m_errors;
+			std::mutex m_mutex;
+			std::condition_variable m_wakeup;
+			std::exception_ptr m_exception;
+		};
+
+		/// <summary>
+		///		Walks all subkeys of root recursively, invoking visitor for each of them
+		/// </summary>
+		inline WalkResult Walk(const RegistryKey_ptr& root, const WalkVisitor& visitor, const WalkOptions& options = WalkOptions())
+		{
+			RegistryWalker walker(visitor, options);
+
+			return walker.Walk(root);
+		}
+	}
+}
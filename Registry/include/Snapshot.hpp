@@ -0,0 +1,1470 @@
+#pragma once
+
+#include <Registry.hpp>
+#include <HiveFile.hpp>
+#include <MappedFile.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <cwctype>
+#include <stdexcept>
+#include <system_error>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		class SnapshotFile;
+
+		/// <summary>
+		///		Read-only view of registry key stored within memory mapped snapshot file.
+		///		View is just pointer to snapshot and offset of key record, so it is cheap to copy,
+		///		but it is valid only as long as SnapshotFile it was obtained from exists.
+		/// </summary>
+		class SnapshotKey
+		{
+		public:
+			/// <summary>
+			///		Opens subkey on specified path relative to this key
+			/// </summary>
+			/// <param name="path">Relative path to subkey of this key</param>
+			SnapshotKey Open(std::wstring_view path) const;
+
+			/// <summary>
+			///		Checks whether specified subkey exists or not
+			/// </summary>
+			/// <param name="path">Subkey relative path to be checked for existence</param>
+			bool HasKey(std::wstring_view path) const;
+
+			bool HasValue(std::wstring_view name) const;
+
+			bool GetBoolean(std::wstring_view name) const;
+
+			bool GetBoolean() const
+			{
+				return GetBoolean(L"");
+			}
+
+			LONG GetInt32(std::wstring_view name) const;
+
+			LONG GetInt32() const
+			{
+				return GetInt32(L"");
+			}
+
+			DWORD GetUInt32(std::wstring_view name) const
+			{
+				return static_cast<DWORD>(GetInt32(name));
+			}
+
+			DWORD GetUInt32() const
+			{
+				return GetUInt32(L"");
+			}
+
+			long long GetInt64(std::wstring_view name) const;
+
+			long long GetInt64() const
+			{
+				return GetInt64(L"");
+			}
+
+			unsigned long long GetUInt64(std::wstring_view name) const
+			{
+				return static_cast<unsigned long long>(GetInt64(name));
+			}
+
+			unsigned long long GetUInt64() const
+			{
+				return GetUInt64(L"");
+			}
+
+			std::wstring GetString(std::wstring_view name) const;
+
+			std::wstring GetString() const
+			{
+				return GetString(L"");
+			}
+
+			/// <summary>
+			///		Name of this key, as it was named in exported registry
+			/// </summary>
+			std::wstring GetName() const;
+
+			/// <summary>
+			///		Number of direct subkeys of this key
+			/// </summary>
+			DWORD GetSubKeyCount() const;
+
+			/// <summary>
+			///		Number of values of this key
+			/// </summary>
+			DWORD GetValueCount() const;
+
+			/// <summary>
+			///		Time key or any of its values was last modified, as reported by exported registry
+			/// </summary>
+			FILETIME GetLastWriteTime() const;
+
+			/// <summary>
+			///		64 bit hash of case insensitive names, types and data of all values and subkeys in subtree of this key.
+			///		Name of key itself is not hashed, so subtrees of keys with different names can be compared.
+			///		Trailing null characters of REG_SZ and REG_EXPAND_SZ values are not hashed.
+			/// </summary>
+			ULONGLONG GetDigest() const;
+
+			/// <summary>
+			///		Enumerates direct subkeys of this key. Callback receives subkey name
+			///		and returns true to continue enumeration, false otherwise.
+			/// </summary>
+			template <typename __Function>
+			void EnumerateSubKeys(const __Function& callback) const;
+
+			/// <summary>
+			///		Enumerates values of this key, same as RegistryKey::EnumerateValues().
+			///		Data points directly into mapped file, string data is UTF-16LE encoded.
+			/// </summary>
+			template <typename __Function>
+			void EnumerateValues(const __Function& callback) const;
+
+		private:
+			friend class SnapshotFile;
+
+			SnapshotKey(const SnapshotFile* snapshot, DWORD offset)
+				: m_snapshot(snapshot)
+				, m_offset(offset)
+			{
+			}
+
+		private:
+			const SnapshotFile* m_snapshot;
+			DWORD m_offset;
+		};
+
+		/// <summary>
+		///		Read-only access to registry snapshot file written by SnapshotWriter.
+		///		Snapshot is memory mapped, every key holds minimal perfect hash index of its subkeys and values,
+		///		so lookups take constant time and neither allocate memory nor call registry.
+		/// </summary>
+		/// <remarks>
+		///		File starts with header (magic "RGSN", format version, root key offset, counts and file size),
+		///		followed by interned UTF-16LE names, key records, value records and value data.
+		///		Key record holds besides indexes also last write time of key and digest of its subtree.
+		///		All numbers are little endian, offsets are relative to start of file.
+		/// </remarks>
+		class SnapshotFile
+		{
+		public:
+			/// <summary>
+			///		Version of snapshot format written by SnapshotWriter
+			/// </summary>
+			static constexpr DWORD Version = 2;
+
+			/// <summary>
+			///		Maps specified snapshot file into memory
+			/// </summary>
+			/// <param name="file">Path to snapshot file</param>
+			explicit SnapshotFile(const std::wstring& file)
+				: m_file(file)
+				, m_data(m_file.Data())
+				, m_size(m_file.Size())
+				, m_rootKey(0)
+			{
+				if (m_size < HeaderSize || std::memcmp(m_data, "RGSN", 4) != 0)
+				{
+					ThrowCorrupted("File is not registry snapshot");
+				}
+
+				if (Read<DWORD>(m_data + 4) != Version)
+				{
+					ThrowCorrupted("Unsupported registry snapshot version");
+				}
+
+				if (Read<DWORD>(m_data + 24) > m_size)
+				{
+					ThrowCorrupted("Registry snapshot is truncated");
+				}
+
+				m_size = Read<DWORD>(m_data + 24);
+				m_rootKey = Read<DWORD>(m_data + 8);
+
+				KeyRecord(m_rootKey);
+			}
+
+			// Keys hold pointer to snapshot, so it can be neither copied nor moved
+			SnapshotFile(const SnapshotFile& other) = delete;
+			SnapshotFile& operator=(const SnapshotFile& other) = delete;
+
+			/// <summary>
+			///		Key snapshot was exported from
+			/// </summary>
+			SnapshotKey Root() const
+			{
+				return SnapshotKey(this, m_rootKey);
+			}
+
+			SnapshotKey Open(std::wstring_view path) const
+			{
+				return Root().Open(path);
+			}
+
+			bool HasKey(std::wstring_view path) const
+			{
+				return Root().HasKey(path);
+			}
+
+			/// <summary>
+			///		Number of keys in snapshot, including root key
+			/// </summary>
+			DWORD KeyCount() const
+			{
+				return Read<DWORD>(m_data + 12);
+			}
+
+			/// <summary>
+			///		Number of values in snapshot
+			/// </summary>
+			DWORD ValueCount() const
+			{
+				return Read<DWORD>(m_data + 16);
+			}
+
+		private:
+			friend class SnapshotKey;
+			friend class SnapshotWriter;
+
+			static constexpr DWORD HeaderSize = 32;
+			static constexpr DWORD KeyRecordSize = 48;
+			static constexpr DWORD ValueRecordSize = 16;
+			static constexpr DWORD NilOffset = 0;
+
+			template <typename T>
+			static T Read(const BYTE* p)
+			{
+				T value;
+				std::memcpy(&value, p, sizeof(value));
+
+				return value;
+			}
+
+			static void ThrowCorrupted(const char* what)
+			{
+				auto ec = std::error_code(ERROR_BADDB, std::system_category());
+
+				throw std::system_error(ec, what);
+			}
+
+			static DWORD Upcase(DWORD ch)
+			{
+				if (ch < 0x80)
+				{
+					return (ch >= 'a' && ch <= 'z') ? (ch - ('a' - 'A')) : ch;
+				}
+
+				return static_cast<DWORD>(std::towupper(static_cast<wint_t>(ch)));
+			}
+
+			/// <summary>
+			///		Reads wide string as UTF-16 code units, since wchar_t is not 16 bit wide on every platform
+			/// </summary>
+			class Utf16Reader
+			{
+			public:
+				explicit Utf16Reader(std::wstring_view s)
+					: m_s(s)
+					, m_pos(0)
+					, m_pendingLow(0)
+				{
+				}
+
+				bool Next(DWORD& unit)
+				{
+					if (m_pendingLow != 0)
+					{
+						unit = m_pendingLow;
+						m_pendingLow = 0;
+
+						return true;
+					}
+
+					if (m_pos == m_s.length())
+					{
+						return false;
+					}
+
+					auto cp = static_cast<DWORD>(m_s[m_pos++]);
+					if (cp > 0xFFFF)
+					{
+						cp -= 0x10000;
+						unit = 0xD800 + (cp >> 10);
+						m_pendingLow = 0xDC00 + (cp & 0x3FF);
+					}
+					else
+					{
+						unit = cp;
+					}
+
+					return true;
+				}
+
+			private:
+				std::wstring_view m_s;
+				size_t m_pos;
+				DWORD m_pendingLow;
+			};
+
+			/// <summary>
+			///		Hash of name used by lookup index. Only ASCII letters are folded, so hash does not depend
+			///		on locale. Names differing in case of other letters are found by linear scan.
+			/// </summary>
+			static ULONGLONG HashUnit(ULONGLONG hash, DWORD unit)
+			{
+				if (unit >= 'a' && unit <= 'z')
+				{
+					unit -= 'a' - 'A';
+				}
+
+				return (hash ^ unit) * 0x100000001B3ULL;
+			}
+
+			static constexpr ULONGLONG HashSeed = 0xCBF29CE484222325ULL;
+
+			/// <summary>
+			///		Maps name hash to bucket of index
+			/// </summary>
+			static DWORD Bucket(ULONGLONG hash, DWORD dwBuckets)
+			{
+				return static_cast<DWORD>((hash >> 32) % dwBuckets);
+			}
+
+			/// <summary>
+			///		Maps name hash to slot of index using displacement seed of its bucket
+			/// </summary>
+			static DWORD Slot(ULONGLONG hash, DWORD dwSeed, DWORD dwSlots)
+			{
+				hash ^= dwSeed * 0x9E3779B97F4A7C15ULL;
+				hash ^= hash >> 33;
+				hash *= 0xFF51AFD7ED558CCDULL;
+				hash ^= hash >> 33;
+				hash *= 0xC4CEB9FE1A85EC53ULL;
+				hash ^= hash >> 33;
+
+				return static_cast<DWORD>(hash % dwSlots);
+			}
+
+			/// <summary>
+			///		Returns pointer to specified number of bytes on specified offset, validating bounds
+			/// </summary>
+			const BYTE* At(DWORD offset, size_t cb) const
+			{
+				if (offset < HeaderSize || offset > m_size || cb > m_size - offset)
+				{
+					ThrowCorrupted("Registry snapshot offset out of range");
+				}
+
+				return m_data + offset;
+			}
+
+			const BYTE* KeyRecord(DWORD offset) const
+			{
+				return At(offset, KeyRecordSize);
+			}
+
+			/// <summary>
+			///		Returns stored name and its length in UTF-16 code units
+			/// </summary>
+			const BYTE* Name(DWORD offset, DWORD* pcchName) const
+			{
+				const DWORD cchName = Read<DWORD>(At(offset, 4));
+
+				*pcchName = cchName;
+
+				return At(offset + 4, static_cast<size_t>(cchName) * 2);
+			}
+
+			/// <summary>
+			///		Compares stored name case insensitively with specified name
+			/// </summary>
+			bool NameEquals(DWORD nameOffset, std::wstring_view name) const
+			{
+				DWORD cchStored = 0;
+				const BYTE* stored = Name(nameOffset, &cchStored);
+
+				Utf16Reader reader(name);
+
+				for (DWORD i = 0; i < cchStored; ++i)
+				{
+					DWORD a = Read<WORD>(stored + i * 2);
+					DWORD b = 0;
+
+					if (!reader.Next(b))
+					{
+						return false;
+					}
+
+					if (a != b && Upcase(a) != Upcase(b))
+					{
+						return false;
+					}
+				}
+
+				DWORD rest = 0;
+
+				return !reader.Next(rest);
+			}
+
+			static void AppendName(std::wstring& out, const BYTE* stored, DWORD cchStored)
+			{
+				wchar_t pending = 0;
+
+				AppendUtf16(out, stored, cchStored, pending, false);
+			}
+
+			/// <summary>
+			///		Appends UTF-16LE code units to wide string, joining surrogate pairs where wchar_t is 32 bit wide.
+			///		Returns false when terminating null character was reached.
+			/// </summary>
+			static bool AppendUtf16(std::wstring& out, const BYTE* data, size_t units, wchar_t& pending, bool stopAtNull)
+			{
+				for (size_t i = 0; i < units; ++i)
+				{
+					auto unit = Read<WORD>(data + i * 2);
+
+					if (unit == 0 && stopAtNull)
+					{
+						return false;
+					}
+
+#if WCHAR_MAX > 0xFFFF
+					if (unit >= 0xD800 && unit <= 0xDBFF)
+					{
+						pending = static_cast<wchar_t>(unit);
+
+						continue;
+					}
+
+					if (unit >= 0xDC00 && unit <= 0xDFFF && pending != 0)
+					{
+						out += static_cast<wchar_t>(0x10000 + ((static_cast<DWORD>(pending) - 0xD800) << 10) + (unit - 0xDC00));
+						pending = 0;
+
+						continue;
+					}
+
+					pending = 0;
+#else
+					static_cast<void>(pending);
+#endif
+					out += static_cast<wchar_t>(unit);
+				}
+
+				return true;
+			}
+
+			/// <summary>
+			///		Looks up entry with specified name in array of records of specified size, using its index.
+			///		Name of each record is stored in its first DWORD. Returns NilOffset when there is no such entry.
+			/// </summary>
+			DWORD Find(DWORD dwCount, DWORD arrayOffset, DWORD recordSize, DWORD indexOffset, std::wstring_view name) const
+			{
+				if (dwCount == 0)
+				{
+					return NilOffset;
+				}
+
+				ULONGLONG hash = HashSeed;
+				bool ascii = true;
+
+				Utf16Reader reader(name);
+
+				for (DWORD unit = 0; reader.Next(unit); )
+				{
+					hash = HashUnit(hash, unit);
+					ascii = ascii && unit < 0x80;
+				}
+
+				const DWORD dwBuckets = Read<DWORD>(At(indexOffset, 4));
+				if (dwBuckets == 0)
+				{
+					ThrowCorrupted("Registry snapshot index is empty");
+				}
+
+				const BYTE* seeds = At(indexOffset + 4, static_cast<size_t>(dwBuckets) * 4);
+				const BYTE* slots = At(indexOffset + 4 + dwBuckets * 4, static_cast<size_t>(dwCount) * 4);
+
+				const DWORD dwSeed = Read<DWORD>(seeds + Bucket(hash, dwBuckets) * 4);
+				const DWORD dwIndex = Read<DWORD>(slots + Slot(hash, dwSeed, dwCount) * 4);
+
+				if (dwIndex >= dwCount)
+				{
+					ThrowCorrupted("Registry snapshot index entry out of range");
+				}
+
+				const DWORD offset = arrayOffset + dwIndex * recordSize;
+
+				if (NameEquals(Read<DWORD>(At(offset, recordSize)), name))
+				{
+					return offset;
+				}
+
+				if (!ascii)
+				{
+					// Hash folds ASCII letters only, other letters may differ in case
+					for (DWORD i = 0; i < dwCount; ++i)
+					{
+						const DWORD entry = arrayOffset + i * recordSize;
+
+						if (NameEquals(Read<DWORD>(At(entry, recordSize)), name))
+						{
+							return entry;
+						}
+					}
+				}
+
+				return NilOffset;
+			}
+
+			/// <summary>
+			///		Looks up direct subkey with specified name, returns NilOffset when there is no such subkey
+			/// </summary>
+			DWORD FindSubKey(DWORD keyOffset, std::wstring_view name) const
+			{
+				const BYTE* key = KeyRecord(keyOffset);
+
+				// Subkey array holds offsets of key records, its first DWORD is not a name, so it is searched via
+				// index over array of subkey name offsets stored right after it
+				const DWORD dwSubKeys = Read<DWORD>(key + 4);
+				const DWORD arrayOffset = Read<DWORD>(key + 8);
+
+				const DWORD entry = Find(dwSubKeys, arrayOffset + dwSubKeys * 4, 4, Read<DWORD>(key + 12), name);
+				if (entry == NilOffset)
+				{
+					return NilOffset;
+				}
+
+				return Read<DWORD>(At(entry - dwSubKeys * 4, 4));
+			}
+
+			/// <summary>
+			///		Resolves path relative to specified key, returns NilOffset when any path segment does not exist
+			/// </summary>
+			DWORD FindKey(DWORD keyOffset, std::wstring_view path) const
+			{
+				size_t pos = 0;
+
+				while (pos < path.length() && keyOffset != NilOffset)
+				{
+					size_t sep = path.find(L'\\', pos);
+					if (sep == std::wstring_view::npos)
+					{
+						sep = path.length();
+					}
+
+					// Empty segments (leading, trailing or doubled separators) are skipped
+					if (sep != pos)
+					{
+						keyOffset = FindSubKey(keyOffset, path.substr(pos, sep - pos));
+					}
+
+					pos = sep + 1;
+				}
+
+				return keyOffset;
+			}
+
+			/// <summary>
+			///		Looks up value record with specified name, returns NilOffset when there is no such value
+			/// </summary>
+			DWORD FindValue(DWORD keyOffset, std::wstring_view name) const
+			{
+				const BYTE* key = KeyRecord(keyOffset);
+
+				return Find(Read<DWORD>(key + 16), Read<DWORD>(key + 20), ValueRecordSize, Read<DWORD>(key + 24), name);
+			}
+
+			/// <summary>
+			///		Returns data of value record, validating its bounds
+			/// </summary>
+			const BYTE* ValueData(const BYTE* value, DWORD* pcbData) const
+			{
+				const DWORD cbData = Read<DWORD>(value + 8);
+
+				*pcbData = cbData;
+
+				return (cbData != 0) ? At(Read<DWORD>(value + 12), cbData) : nullptr;
+			}
+
+			/// <summary>
+			///		Reads value data with same semantics as RegQueryValueEx()
+			/// </summary>
+			LSTATUS QueryValue(DWORD keyOffset, std::wstring_view name, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) const
+			{
+				const DWORD offset = FindValue(keyOffset, name);
+				if (offset == NilOffset)
+				{
+					return ERROR_FILE_NOT_FOUND;
+				}
+
+				const BYTE* value = At(offset, ValueRecordSize);
+
+				if (lpType != nullptr)
+				{
+					*lpType = Read<DWORD>(value + 4);
+				}
+
+				if (lpcbData == nullptr)
+				{
+					return ERROR_SUCCESS;
+				}
+
+				DWORD cbData = 0;
+				const BYTE* data = ValueData(value, &cbData);
+
+				if (lpData == nullptr)
+				{
+					*lpcbData = cbData;
+
+					return ERROR_SUCCESS;
+				}
+
+				if (*lpcbData < cbData)
+				{
+					*lpcbData = cbData;
+
+					return ERROR_MORE_DATA;
+				}
+
+				if (cbData != 0)
+				{
+					std::memcpy(lpData, data, cbData);
+				}
+
+				*lpcbData = cbData;
+
+				return ERROR_SUCCESS;
+			}
+
+		private:
+			MappedFile m_file;
+			const BYTE* m_data;
+			size_t m_size;
+			DWORD m_rootKey;
+		};
+
+		/// <summary>
+		///		Exports registry key with its whole subtree into snapshot, which can be mapped by SnapshotFile.
+		///		Names are stored once however many keys and values use them.
+		/// </summary>
+		class SnapshotWriter
+		{
+		public:
+			/// <summary>
+			///		Reads subtree of registry key, stored in any backend. Registry key does not know its name,
+			///		so root key of snapshot has empty name.
+			/// </summary>
+			explicit SnapshotWriter(const RegistryKey_ptr& key)
+			{
+				if (key == nullptr)
+				{
+					throw std::invalid_argument("Registry key cannot be nullptr");
+				}
+
+				Node root;
+
+				Collect(key, root);
+				Serialize(root);
+			}
+
+			/// <summary>
+			///		Reads subtree of key stored in offline hive file
+			/// </summary>
+			explicit SnapshotWriter(const HiveKey& key)
+			{
+				Node root;
+				root.name = ToUtf16(key.GetName());
+
+				Collect(key, root);
+				Serialize(root);
+			}
+
+			/// <summary>
+			///		Serialized snapshot
+			/// </summary>
+			const std::vector<BYTE>& Data() const
+			{
+				return m_data;
+			}
+
+			/// <summary>
+			///		Writes snapshot into specified file, replacing its content
+			/// </summary>
+			void Save(const std::wstring& file) const
+			{
+				if (file.empty())
+				{
+					throw std::invalid_argument("Specified file path cannot be empty");
+				}
+
+				std::ofstream out(std::filesystem::path(file), std::ios::binary | std::ios::trunc);
+
+				out.write(reinterpret_cast<const char*>(m_data.data()), static_cast<std::streamsize>(m_data.size()));
+				out.close();
+
+				if (!out)
+				{
+					throw std::runtime_error("Could not write registry snapshot file");
+				}
+			}
+
+		private:
+			struct Value
+			{
+				std::u16string name;
+				DWORD type = REG_NONE;
+				std::vector<BYTE> data;
+			};
+
+			struct Node
+			{
+				std::u16string name;
+				ULONGLONG lastWriteTime = 0;
+				std::vector<Value> values;
+				std::vector<Node> subKeys;
+			};
+
+			static std::u16string ToUtf16(std::wstring_view s)
+			{
+				std::u16string result;
+				result.reserve(s.length());
+
+				SnapshotFile::Utf16Reader reader(s);
+
+				for (DWORD unit = 0; reader.Next(unit); )
+				{
+					result += static_cast<char16_t>(unit);
+				}
+
+				return result;
+			}
+
+			static bool IsString(DWORD dwType)
+			{
+				return dwType == REG_SZ || dwType == REG_EXPAND_SZ || dwType == REG_MULTI_SZ;
+			}
+
+			void Collect(const RegistryKey_ptr& key, Node& node)
+			{
+				FILETIME ftLastWriteTime = {};
+
+				LSTATUS lStatus = key->GetBackend()->QueryInfoKey(*key, nullptr, nullptr, nullptr, nullptr, nullptr, &ftLastWriteTime);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "RegQueryInfoKey() failed");
+				}
+
+				node.lastWriteTime = (static_cast<ULONGLONG>(ftLastWriteTime.dwHighDateTime) << 32) | ftLastWriteTime.dwLowDateTime;
+
+				key->EnumerateValues([&node](std::wstring_view name, DWORD dwType, const BYTE* pData, DWORD cbData) -> bool
+				{
+					Value value;
+					value.name = ToUtf16(name);
+					value.type = dwType;
+
+					if (IsString(dwType) && sizeof(wchar_t) != sizeof(char16_t))
+					{
+						// Strings are stored as UTF-16LE, same as in registry on Windows
+						std::wstring text(cbData / sizeof(wchar_t), L'\0');
+
+						if (!text.empty())
+						{
+							std::memcpy(&text[0], pData, text.length() * sizeof(wchar_t));
+						}
+
+						const auto& units = ToUtf16(text);
+
+						value.data.resize(units.length() * sizeof(char16_t));
+
+						for (size_t i = 0; i < units.length(); ++i)
+						{
+							value.data[i * 2] = static_cast<BYTE>(units[i] & 0xFF);
+							value.data[i * 2 + 1] = static_cast<BYTE>(units[i] >> 8);
+						}
+					}
+					else
+					{
+						value.data.assign(pData, pData + cbData);
+					}
+
+					node.values.push_back(std::move(value));
+
+					return true;
+				});
+
+				std::vector<std::wstring> names;
+
+				key->EnumerateSubKeys([&names](const std::wstring& name) -> bool
+				{
+					names.push_back(name);
+
+					return true;
+				});
+
+				node.subKeys.resize(names.size());
+
+				for (size_t i = 0; i < names.size(); ++i)
+				{
+					node.subKeys[i].name = ToUtf16(names[i]);
+
+					Collect(key->Open(names[i], DesiredAccess::Read), node.subKeys[i]);
+				}
+			}
+
+			void Collect(const HiveKey& key, Node& node)
+			{
+				const FILETIME ftLastWriteTime = key.GetLastWriteTime();
+
+				node.lastWriteTime = (static_cast<ULONGLONG>(ftLastWriteTime.dwHighDateTime) << 32) | ftLastWriteTime.dwLowDateTime;
+
+				key.EnumerateValues([&node](std::wstring_view name, DWORD dwType, const BYTE* pData, DWORD cbData) -> bool
+				{
+					Value value;
+					value.name = ToUtf16(name);
+					value.type = dwType;
+					value.data.assign(pData, pData + cbData);
+
+					node.values.push_back(std::move(value));
+
+					return true;
+				});
+
+				std::vector<std::wstring> names;
+
+				key.EnumerateSubKeys([&names](const std::wstring& name) -> bool
+				{
+					names.push_back(name);
+
+					return true;
+				});
+
+				node.subKeys.resize(names.size());
+
+				for (size_t i = 0; i < names.size(); ++i)
+				{
+					node.subKeys[i].name = ToUtf16(names[i]);
+
+					Collect(key.Open(names[i]), node.subKeys[i]);
+				}
+			}
+
+			void Serialize(const Node& root)
+			{
+				m_data.assign(SnapshotFile::HeaderSize, 0);
+				m_names.clear();
+				m_keys = 0;
+				m_values = 0;
+
+				ULONGLONG digest = 0;
+
+				const DWORD rootKey = Emit(root, digest);
+
+				std::memcpy(&m_data[0], "RGSN", 4);
+				Put<DWORD>(4, SnapshotFile::Version);
+				Put<DWORD>(8, rootKey);
+				Put<DWORD>(12, m_keys);
+				Put<DWORD>(16, m_values);
+				Put<DWORD>(20, static_cast<DWORD>(m_names.size()));
+				Put<DWORD>(24, static_cast<DWORD>(m_data.size()));
+			}
+
+			/// <summary>
+			///		Emits records of key and its subtree, subkeys are emitted before their parent.
+			///		Returns offset of key record and digest of subtree.
+			/// </summary>
+			DWORD Emit(const Node& node, ULONGLONG& digest)
+			{
+				std::vector<DWORD> subKeys;
+				std::vector<ULONGLONG> digests(node.subKeys.size());
+
+				subKeys.reserve(node.subKeys.size());
+
+				for (size_t i = 0; i < node.subKeys.size(); ++i)
+				{
+					subKeys.push_back(Emit(node.subKeys[i], digests[i]));
+				}
+
+				digest = Digest(node, digests);
+
+				// Subkey array holds key record offsets followed by their name offsets, index covers names
+				std::vector<DWORD> subKeyNames;
+				std::vector<const std::u16string*> names;
+
+				for (const auto& subKey : node.subKeys)
+				{
+					subKeyNames.push_back(Intern(subKey.name));
+					names.push_back(&subKey.name);
+				}
+
+				const DWORD subKeysOffset = subKeys.empty() ? SnapshotFile::NilOffset : Append(subKeys.data(), subKeys.size() * 4);
+				Append(subKeyNames.data(), subKeyNames.size() * 4);
+
+				const DWORD subKeyIndex = EmitIndex(names);
+
+				// Value records
+				std::vector<DWORD> records;
+				names.clear();
+
+				for (const auto& value : node.values)
+				{
+					DWORD dataOffset = SnapshotFile::NilOffset;
+
+					if (!value.data.empty())
+					{
+						Align(8);
+						dataOffset = Append(value.data.data(), value.data.size());
+					}
+
+					records.push_back(Intern(value.name));
+					records.push_back(value.type);
+					records.push_back(static_cast<DWORD>(value.data.size()));
+					records.push_back(dataOffset);
+
+					names.push_back(&value.name);
+				}
+
+				const DWORD valuesOffset = records.empty() ? SnapshotFile::NilOffset : Append(records.data(), records.size() * 4);
+				const DWORD valueIndex = EmitIndex(names);
+
+				const DWORD record[] =
+				{
+					Intern(node.name),
+					static_cast<DWORD>(node.subKeys.size()),
+					subKeysOffset,
+					subKeyIndex,
+					static_cast<DWORD>(node.values.size()),
+					valuesOffset,
+					valueIndex,
+					0,
+					static_cast<DWORD>(node.lastWriteTime),
+					static_cast<DWORD>(node.lastWriteTime >> 32),
+					static_cast<DWORD>(digest),
+					static_cast<DWORD>(digest >> 32)
+				};
+
+				++m_keys;
+				m_values += static_cast<DWORD>(node.values.size());
+
+				return Append(record, sizeof(record));
+			}
+
+			static ULONGLONG Hash(ULONGLONG hash, const void* p, size_t cb)
+			{
+				const auto* bytes = static_cast<const BYTE*>(p);
+
+				for (size_t i = 0; i < cb; ++i)
+				{
+					hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+				}
+
+				return hash;
+			}
+
+			static std::u16string Upcase(const std::u16string& name)
+			{
+				std::u16string upper(name);
+
+				for (auto& unit : upper)
+				{
+					unit = static_cast<char16_t>(SnapshotFile::Upcase(unit));
+				}
+
+				return upper;
+			}
+
+			/// <summary>
+			///		Computes digest of key from its values and digests of its subkeys. Entries are hashed ordered
+			///		by upper cased names, so digest does not depend on order they were enumerated in.
+			/// </summary>
+			static ULONGLONG Digest(const Node& node, const std::vector<ULONGLONG>& digests)
+			{
+				std::vector<std::pair<std::u16string, size_t>> order;
+
+				ULONGLONG hash = SnapshotFile::HashSeed;
+
+				for (size_t i = 0; i < node.values.size(); ++i)
+				{
+					order.emplace_back(Upcase(node.values[i].name), i);
+				}
+
+				std::sort(order.begin(), order.end());
+
+				for (const auto& entry : order)
+				{
+					const auto& value = node.values[entry.second];
+
+					size_t cbData = value.data.size();
+
+					if ((value.type == REG_SZ || value.type == REG_EXPAND_SZ) && (cbData & 1) == 0)
+					{
+						while (cbData >= 2 && value.data[cbData - 1] == 0 && value.data[cbData - 2] == 0)
+						{
+							cbData -= 2;
+						}
+					}
+
+					const ULONGLONG header[] = { entry.first.length(), value.type, cbData };
+
+					hash = Hash(hash, header, sizeof(header));
+					hash = Hash(hash, entry.first.data(), entry.first.length() * sizeof(char16_t));
+					hash = Hash(hash, value.data.data(), cbData);
+				}
+
+				order.clear();
+
+				for (size_t i = 0; i < node.subKeys.size(); ++i)
+				{
+					order.emplace_back(Upcase(node.subKeys[i].name), i);
+				}
+
+				std::sort(order.begin(), order.end());
+
+				for (const auto& entry : order)
+				{
+					const ULONGLONG header[] = { entry.first.length(), digests[entry.second] };
+
+					hash = Hash(hash, header, sizeof(header));
+					hash = Hash(hash, entry.first.data(), entry.first.length() * sizeof(char16_t));
+				}
+
+				return hash;
+			}
+
+			/// <summary>
+			///		Builds minimal perfect hash index of names (hash and displace). Names are hashed into buckets,
+			///		for each bucket, largest first, seed is searched which places all its names into free slots.
+			/// </summary>
+			DWORD EmitIndex(const std::vector<const std::u16string*>& names)
+			{
+				if (names.empty())
+				{
+					return SnapshotFile::NilOffset;
+				}
+
+				const auto dwCount = static_cast<DWORD>(names.size());
+				const DWORD dwBuckets = (dwCount + 1) / 2;
+
+				std::vector<ULONGLONG> hashes(dwCount);
+				std::vector<std::vector<DWORD>> buckets(dwBuckets);
+
+				for (DWORD i = 0; i < dwCount; ++i)
+				{
+					ULONGLONG hash = SnapshotFile::HashSeed;
+
+					for (auto unit : *names[i])
+					{
+						hash = SnapshotFile::HashUnit(hash, unit);
+					}
+
+					hashes[i] = hash;
+					buckets[SnapshotFile::Bucket(hash, dwBuckets)].push_back(i);
+				}
+
+				std::vector<DWORD> order(dwBuckets);
+
+				for (DWORD i = 0; i < dwBuckets; ++i)
+				{
+					order[i] = i;
+				}
+
+				// Largest buckets are placed first, while most slots are still free
+				std::sort(order.begin(), order.end(), [&buckets](DWORD a, DWORD b)
+				{
+					return (buckets[a].size() != buckets[b].size()) ? buckets[a].size() > buckets[b].size() : a < b;
+				});
+
+				const DWORD Unused = 0xFFFFFFFF;
+
+				std::vector<DWORD> seeds(dwBuckets, 0);
+				std::vector<DWORD> slots(dwCount, Unused);
+				std::vector<DWORD> placed;
+
+				for (auto bucket : order)
+				{
+					const auto& entries = buckets[bucket];
+					if (entries.empty())
+					{
+						break;
+					}
+
+					for (DWORD dwSeed = 0; ; ++dwSeed)
+					{
+						if (dwSeed == MaxSeed)
+						{
+							throw std::runtime_error("Could not build registry snapshot index");
+						}
+
+						placed.clear();
+
+						for (auto entry : entries)
+						{
+							const DWORD slot = SnapshotFile::Slot(hashes[entry], dwSeed, dwCount);
+							if (slots[slot] != Unused)
+							{
+								break;
+							}
+
+							slots[slot] = entry;
+							placed.push_back(slot);
+						}
+
+						if (placed.size() == entries.size())
+						{
+							seeds[bucket] = dwSeed;
+
+							break;
+						}
+
+						for (auto slot : placed)
+						{
+							slots[slot] = Unused;
+						}
+					}
+				}
+
+				const DWORD offset = Append(&dwBuckets, 4);
+				Append(seeds.data(), seeds.size() * 4);
+				Append(slots.data(), slots.size() * 4);
+
+				return offset;
+			}
+
+			/// <summary>
+			///		Stores name unless same name was stored already, returns its offset
+			/// </summary>
+			DWORD Intern(const std::u16string& name)
+			{
+				auto it = m_names.find(name);
+				if (it != m_names.end())
+				{
+					return it->second;
+				}
+
+				const auto cchName = static_cast<DWORD>(name.length());
+
+				const DWORD offset = Append(&cchName, 4);
+
+				// Units directly follow length, Append() would align each of them
+				m_data.resize(m_data.size() + name.length() * 2);
+
+				for (size_t i = 0; i < name.length(); ++i)
+				{
+					Put<WORD>(offset + 4 + i * 2, static_cast<WORD>(name[i]));
+				}
+
+				m_names.emplace(name, offset);
+
+				return offset;
+			}
+
+			/// <summary>
+			///		Appends data aligned to 4 bytes, returns its offset
+			/// </summary>
+			DWORD Append(const void* p, size_t cb)
+			{
+				Align(4);
+
+				const size_t offset = m_data.size();
+
+				if (offset + cb > 0xFFFFFFFF)
+				{
+					throw std::length_error("Registry snapshot exceeds 4 GB");
+				}
+
+				if (cb != 0)
+				{
+					m_data.resize(offset + cb);
+					std::memcpy(&m_data[offset], p, cb);
+				}
+
+				return static_cast<DWORD>(offset);
+			}
+
+			void Align(size_t alignment)
+			{
+				m_data.resize((m_data.size() + alignment - 1) & ~(alignment - 1), 0);
+			}
+
+			template <typename T>
+			void Put(size_t offset, T value)
+			{
+				std::memcpy(&m_data[offset], &value, sizeof(value));
+			}
+
+		private:
+			// Limits search for bucket seed, reached only when two names have same 64 bit hash
+			static constexpr DWORD MaxSeed = 1 << 24;
+
+			std::vector<BYTE> m_data;
+			std::unordered_map<std::u16string, DWORD> m_names;
+			DWORD m_keys = 0;
+			DWORD m_values = 0;
+		};
+
+		inline SnapshotKey SnapshotKey::Open(std::wstring_view path) const
+		{
+			if (path.empty())
+			{
+				throw std::invalid_argument("Specified path to registry key cannot be empty");
+			}
+
+			DWORD offset = m_snapshot->FindKey(m_offset, path);
+			if (offset == SnapshotFile::NilOffset)
+			{
+				auto ec = std::error_code(ERROR_FILE_NOT_FOUND, std::system_category());
+
+				throw std::system_error(ec, "SnapshotKey::Open() failed");
+			}
+
+			return SnapshotKey(m_snapshot, offset);
+		}
+
+		inline bool SnapshotKey::HasKey(std::wstring_view path) const
+		{
+			if (path.empty())
+			{
+				throw std::invalid_argument("Specified path to registry key cannot be empty");
+			}
+
+			return m_snapshot->FindKey(m_offset, path) != SnapshotFile::NilOffset;
+		}
+
+		inline bool SnapshotKey::HasValue(std::wstring_view name) const
+		{
+			if (name.empty())
+			{
+				throw std::invalid_argument("Value name cannot be empty");
+			}
+
+			return m_snapshot->FindValue(m_offset, name) != SnapshotFile::NilOffset;
+		}
+
+		inline bool SnapshotKey::GetBoolean(std::wstring_view name) const
+		{
+			DWORD dwType = 0;
+			DWORD dwData = 0;
+			DWORD cbData = sizeof(dwData);
+
+			LSTATUS lStatus = m_snapshot->QueryValue(m_offset, name, &dwType, reinterpret_cast<LPBYTE>(&dwData), &cbData);
+			if (lStatus != ERROR_SUCCESS)
+			{
+				auto ec = std::error_code(lStatus, std::system_category());
+
+				throw std::system_error(ec, "SnapshotKey::GetBoolean() failed");
+			}
+
+			if (dwType != REG_DWORD && dwType != REG_QWORD)
+			{
+				throw std::runtime_error("Wrong registry value type " + std::to_string(dwType) + " for boolean value.");
+			}
+
+			return (dwData == 0) ? false : true;
+		}
+
+		inline LONG SnapshotKey::GetInt32(std::wstring_view name) const
+		{
+			const DWORD offset = m_snapshot->FindValue(m_offset, name);
+			if (offset == SnapshotFile::NilOffset)
+			{
+				auto ec = std::error_code(ERROR_FILE_NOT_FOUND, std::system_category());
+
+				throw std::system_error(ec, "SnapshotKey::GetInt32() failed");
+			}
+
+			const BYTE* value = m_snapshot->At(offset, SnapshotFile::ValueRecordSize);
+
+			const DWORD dwType = SnapshotFile::Read<DWORD>(value + 4);
+			if (dwType != REG_DWORD)
+			{
+				throw std::runtime_error("Wrong registry value type " + std::to_string(dwType) + " for 32-bit integer value.");
+			}
+
+			DWORD cbData = 0;
+			const BYTE* data = m_snapshot->ValueData(value, &cbData);
+
+			LONG lData = 0;
+
+			std::memcpy(&lData, data, (std::min)(static_cast<size_t>(cbData), sizeof(lData)));
+
+			return lData;
+		}
+
+		inline long long SnapshotKey::GetInt64(std::wstring_view name) const
+		{
+			const DWORD offset = m_snapshot->FindValue(m_offset, name);
+			if (offset == SnapshotFile::NilOffset)
+			{
+				auto ec = std::error_code(ERROR_FILE_NOT_FOUND, std::system_category());
+
+				throw std::system_error(ec, "SnapshotKey::GetInt64() failed");
+			}
+
+			const BYTE* value = m_snapshot->At(offset, SnapshotFile::ValueRecordSize);
+
+			const DWORD dwType = SnapshotFile::Read<DWORD>(value + 4);
+			if (dwType != REG_QWORD)
+			{
+				throw std::runtime_error("Wrong registry value type " + std::to_string(dwType) + " for 64-bit integer value.");
+			}
+
+			DWORD cbData = 0;
+			const BYTE* data = m_snapshot->ValueData(value, &cbData);
+
+			long long llData = 0;
+
+			std::memcpy(&llData, data, (std::min)(static_cast<size_t>(cbData), sizeof(llData)));
+
+			return llData;
+		}
+
+		inline std::wstring SnapshotKey::GetString(std::wstring_view name) const
+		{
+			const DWORD offset = m_snapshot->FindValue(m_offset, name);
+			if (offset == SnapshotFile::NilOffset)
+			{
+				auto ec = std::error_code(ERROR_FILE_NOT_FOUND, std::system_category());
+
+				throw std::system_error(ec, "SnapshotKey::GetString() failed");
+			}
+
+			const BYTE* value = m_snapshot->At(offset, SnapshotFile::ValueRecordSize);
+
+			const DWORD dwType = SnapshotFile::Read<DWORD>(value + 4);
+			if (dwType != REG_SZ && dwType != REG_EXPAND_SZ)
+			{
+				throw std::runtime_error("Wrong registry value type " + std::to_string(dwType) + " for string value.");
+			}
+
+			DWORD cbData = 0;
+			const BYTE* data = m_snapshot->ValueData(value, &cbData);
+
+			std::wstring result;
+			result.reserve(cbData / 2);
+
+			// Same as RegGetValue(), string ends on first null character
+			wchar_t pending = 0;
+
+			SnapshotFile::AppendUtf16(result, data, cbData / 2, pending, true);
+
+			return result;
+		}
+
+		inline std::wstring SnapshotKey::GetName() const
+		{
+			const BYTE* key = m_snapshot->KeyRecord(m_offset);
+
+			DWORD cchName = 0;
+			const BYTE* stored = m_snapshot->Name(SnapshotFile::Read<DWORD>(key), &cchName);
+
+			std::wstring name;
+			SnapshotFile::AppendName(name, stored, cchName);
+
+			return name;
+		}
+
+		inline DWORD SnapshotKey::GetSubKeyCount() const
+		{
+			return SnapshotFile::Read<DWORD>(m_snapshot->KeyRecord(m_offset) + 4);
+		}
+
+		inline DWORD SnapshotKey::GetValueCount() const
+		{
+			return SnapshotFile::Read<DWORD>(m_snapshot->KeyRecord(m_offset) + 16);
+		}
+
+		inline FILETIME SnapshotKey::GetLastWriteTime() const
+		{
+			return SnapshotFile::Read<FILETIME>(m_snapshot->KeyRecord(m_offset) + 32);
+		}
+
+		inline ULONGLONG SnapshotKey::GetDigest() const
+		{
+			return SnapshotFile::Read<ULONGLONG>(m_snapshot->KeyRecord(m_offset) + 40);
+		}
+
+		template <typename __Function>
+		void SnapshotKey::EnumerateSubKeys(const __Function& callback) const
+		{
+			const BYTE* key = m_snapshot->KeyRecord(m_offset);
+
+			const DWORD dwSubKeys = SnapshotFile::Read<DWORD>(key + 4);
+			if (dwSubKeys == 0)
+			{
+				return;
+			}
+
+			const BYTE* subKeys = m_snapshot->At(SnapshotFile::Read<DWORD>(key + 8), static_cast<size_t>(dwSubKeys) * 8);
+
+			// Single name buffer is reused for all subkeys
+			std::wstring subKeyName;
+
+			for (DWORD i = 0; i < dwSubKeys; ++i)
+			{
+				DWORD cchName = 0;
+				const BYTE* stored = m_snapshot->Name(SnapshotFile::Read<DWORD>(subKeys + (dwSubKeys + i) * 4), &cchName);
+
+				subKeyName.clear();
+				SnapshotFile::AppendName(subKeyName, stored, cchName);
+
+				// Return false from callback to break enumeration
+				if (!callback(subKeyName))
+				{
+					break;
+				}
+			}
+		}
+
+		template <typename __Function>
+		void SnapshotKey::EnumerateValues(const __Function& callback) const
+		{
+			const BYTE* key = m_snapshot->KeyRecord(m_offset);
+
+			const DWORD dwValues = SnapshotFile::Read<DWORD>(key + 16);
+			if (dwValues == 0)
+			{
+				return;
+			}
+
+			const BYTE* values = m_snapshot->At(SnapshotFile::Read<DWORD>(key + 20), static_cast<size_t>(dwValues) * SnapshotFile::ValueRecordSize);
+
+			// Single name buffer is reused for all values
+			std::wstring name;
+
+			for (DWORD i = 0; i < dwValues; ++i)
+			{
+				const BYTE* value = values + i * SnapshotFile::ValueRecordSize;
+
+				DWORD cchName = 0;
+				const BYTE* stored = m_snapshot->Name(SnapshotFile::Read<DWORD>(value), &cchName);
+
+				name.clear();
+				SnapshotFile::AppendName(name, stored, cchName);
+
+				DWORD cbData = 0;
+				const BYTE* data = m_snapshot->ValueData(value, &cbData);
+
+				// Return false from callback to break enumeration
+				if (!callback(std::wstring_view(name), SnapshotFile::Read<DWORD>(value + 4), data, cbData))
+				{
+					break;
+				}
+			}
+		}
+	}
+}
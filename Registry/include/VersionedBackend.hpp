@@ -0,0 +1,1512 @@
+#pragma once
+
+#include <RegistryBackend.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <cstring>
+#include <cwctype>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Registry backend keeping whole registry tree in process memory as persistent copy-on-write tree.
+		///		Readers take no locks, so reads scale with number of cores. Suited for configuration which is read
+		///		by many threads and changed rarely.
+		/// </summary>
+		/// <remarks>
+		///		Published key nodes are never modified. Write copies changed key and all its ancestors, shares the rest
+		///		of tree with previous version and publishes new version by single atomic store, so readers observe
+		///		either none or all of its changes. Writers are serialized by mutex.
+		///		Reader pins current version by incrementing counter of current epoch in slot of its thread, slots
+		///		occupy separate cache lines. Replaced version is released once epoch advanced twice, as no reader
+		///		can hold it anymore. Epoch is advanced by writers, when all readers of previous epoch are done.
+		///		Handles refer to keys by path and identity, so handle sees data written after it was opened, and handle
+		///		of deleted key fails with ERROR_KEY_DELETED even when key with same path was created again.
+		///		Handle must not be used after it was closed.
+		/// </remarks>
+		class VersionedBackend final : public RegistryBackend
+		{
+		public:
+			VersionedBackend()
+			{
+				auto version = std::make_unique<Version>();
+
+				version->serial = NextSerial();
+
+				for (auto& root : version->roots)
+				{
+					root = NewNode(std::wstring_view(), REG_OPTION_NON_VOLATILE);
+				}
+
+				m_version.store(version.release());
+			}
+
+			~VersionedBackend() override
+			{
+				delete m_version.load();
+
+				for (auto& retired : m_retired)
+				{
+					delete retired.second;
+				}
+			}
+
+			// Disable copy ctor & copy assignment operator
+			VersionedBackend(const VersionedBackend& other) = delete;
+			VersionedBackend& operator=(const VersionedBackend& other) = delete;
+
+			LSTATUS OpenKey(HKEY hKey, const wchar_t* lpSubKey, REGSAM samDesired, HKEY* phkResult) override
+			{
+				if (phkResult == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				ULONGLONG id = 0;
+
+				{
+					Pin version(*this);
+
+					const Node* node = nullptr;
+
+					LSTATUS lStatus = Lookup(*version, hKey, 0, &node);
+					if (lStatus != ERROR_SUCCESS)
+					{
+						return lStatus;
+					}
+
+					node = Find(node, lpSubKey);
+					if (node == nullptr)
+					{
+						return ERROR_FILE_NOT_FOUND;
+					}
+
+					id = node->id;
+				}
+
+				*phkResult = NewHandle(hKey, lpSubKey, id, samDesired);
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS CreateKey(HKEY hKey, const wchar_t* lpSubKey, DWORD dwOptions, REGSAM samDesired, HKEY* phkResult) override
+			{
+				if (phkResult == nullptr || lpSubKey == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				ULONGLONG id = 0;
+
+				LSTATUS lStatus = Write([&](Version& version) -> LSTATUS
+				{
+					Path path;
+					const Node* node = nullptr;
+
+					LSTATUS lStatus = Resolve(version, hKey, KEY_CREATE_SUB_KEY, &node, &path);
+					if (lStatus != ERROR_SUCCESS)
+					{
+						return lStatus;
+					}
+
+					id = Create(version, path, lpSubKey, dwOptions);
+
+					return ERROR_SUCCESS;
+				});
+
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				*phkResult = NewHandle(hKey, lpSubKey, id, samDesired);
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS CloseKey(HKEY hKey) override
+			{
+				if (IsPredefined(hKey))
+				{
+					return ERROR_SUCCESS;
+				}
+
+				if (hKey == nullptr)
+				{
+					return ERROR_INVALID_HANDLE;
+				}
+
+				delete reinterpret_cast<Handle*>(hKey);
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS DeleteTree(HKEY hKey, const wchar_t* lpSubKey) override
+			{
+				return Write([&](Version& version) -> LSTATUS
+				{
+					Path path;
+					const Node* node = nullptr;
+
+					LSTATUS lStatus = Resolve(version, hKey, DELETE | KEY_ENUMERATE_SUB_KEYS | KEY_QUERY_VALUE, &node, &path);
+					if (lStatus != ERROR_SUCCESS)
+					{
+						return lStatus;
+					}
+
+					if (lpSubKey == nullptr)
+					{
+						// Delete subkeys and values, but keep key itself
+						auto copy = std::make_shared<Node>(*node);
+
+						copy->subKeys.clear();
+						copy->subKeyOrder.clear();
+						copy->values.clear();
+						copy->valueOrder.clear();
+						copy->maxSubKeyLen = 0;
+						copy->maxValueNameLen = 0;
+						copy->maxValueLen = 0;
+
+						Replace(version, path, path.nodes.size() - 1, std::move(copy), REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET);
+
+						return ERROR_SUCCESS;
+					}
+
+					const size_t depth = path.nodes.size() - 1;
+
+					if (Find(node, lpSubKey, &path) == nullptr)
+					{
+						return ERROR_FILE_NOT_FOUND;
+					}
+
+					if (path.nodes.size() - 1 == depth)
+					{
+						return ERROR_INVALID_PARAMETER;
+					}
+
+					RemoveKey(version, path);
+
+					return ERROR_SUCCESS;
+				});
+			}
+
+			LSTATUS DeleteValue(HKEY hKey, const wchar_t* lpValueName) override
+			{
+				return Write([&](Version& version) -> LSTATUS
+				{
+					Path path;
+					const Node* node = nullptr;
+
+					LSTATUS lStatus = Resolve(version, hKey, KEY_SET_VALUE, &node, &path);
+					if (lStatus != ERROR_SUCCESS)
+					{
+						return lStatus;
+					}
+
+					return RemoveValue(version, path, ValueName(lpValueName));
+				});
+			}
+
+			LSTATUS FlushKey(HKEY hKey) override
+			{
+				Pin version(*this);
+
+				const Node* node = nullptr;
+
+				return Lookup(*version, hKey, 0, &node);
+			}
+
+			LSTATUS SaveKey(HKEY hKey, const wchar_t* lpFile) override
+			{
+				static_cast<void>(hKey);
+				static_cast<void>(lpFile);
+
+				return ERROR_NOT_SUPPORTED;
+			}
+
+			LSTATUS QueryValue(HKEY hKey, const wchar_t* lpValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) override
+			{
+				if (lpData != nullptr && lpcbData == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				Pin version(*this);
+
+				const Node* node = nullptr;
+
+				LSTATUS lStatus = Lookup(*version, hKey, KEY_QUERY_VALUE, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				const Value* value = FindValue(node, ValueName(lpValueName));
+				if (value == nullptr)
+				{
+					return ERROR_FILE_NOT_FOUND;
+				}
+
+				if (lpType != nullptr)
+				{
+					*lpType = value->type;
+				}
+
+				if (lpcbData == nullptr)
+				{
+					return ERROR_SUCCESS;
+				}
+
+				const auto cbData = static_cast<DWORD>(value->data.size());
+
+				if (lpData != nullptr)
+				{
+					if (*lpcbData < cbData)
+					{
+						*lpcbData = cbData;
+
+						return ERROR_MORE_DATA;
+					}
+
+					if (cbData != 0)
+					{
+						std::memcpy(lpData, value->data.data(), cbData);
+					}
+				}
+
+				*lpcbData = cbData;
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS QueryMultipleValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize) override
+			{
+				return ReadValues(hKey, val_list, num_vals, lpValueBuf, ldwTotsize, nullptr);
+			}
+
+			/// <summary>
+			///		Reads all values from single pinned version, so values read together are always consistent
+			/// </summary>
+			LSTATUS QueryValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize, LSTATUS* lpStatuses) override
+			{
+				if (lpStatuses == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				return ReadValues(hKey, val_list, num_vals, lpValueBuf, ldwTotsize, lpStatuses);
+			}
+
+			LSTATUS SetValue(HKEY hKey, const wchar_t* lpValueName, DWORD dwType, const BYTE* lpData, DWORD cbData) override
+			{
+				if (lpData == nullptr && cbData != 0)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				return Write([&](Version& version) -> LSTATUS
+				{
+					Path path;
+					const Node* node = nullptr;
+
+					LSTATUS lStatus = Resolve(version, hKey, KEY_SET_VALUE, &node, &path);
+					if (lStatus != ERROR_SUCCESS)
+					{
+						return lStatus;
+					}
+
+					StoreValue(version, path, ValueName(lpValueName), dwType, lpData, cbData);
+
+					return ERROR_SUCCESS;
+				});
+			}
+
+			LSTATUS QueryInfoKey(HKEY hKey, LPDWORD lpcSubKeys, LPDWORD lpcchMaxSubKeyLen, LPDWORD lpcValues, LPDWORD lpcchMaxValueNameLen, LPDWORD lpcbMaxValueLen, FILETIME* lpftLastWriteTime) override
+			{
+				Pin version(*this);
+
+				const Node* node = nullptr;
+
+				LSTATUS lStatus = Lookup(*version, hKey, KEY_QUERY_VALUE, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				if (lpcSubKeys != nullptr)
+				{
+					*lpcSubKeys = static_cast<DWORD>(node->subKeys.size());
+				}
+
+				if (lpcchMaxSubKeyLen != nullptr)
+				{
+					*lpcchMaxSubKeyLen = node->maxSubKeyLen;
+				}
+
+				if (lpcValues != nullptr)
+				{
+					*lpcValues = static_cast<DWORD>(node->values.size());
+				}
+
+				if (lpcchMaxValueNameLen != nullptr)
+				{
+					*lpcchMaxValueNameLen = node->maxValueNameLen;
+				}
+
+				if (lpcbMaxValueLen != nullptr)
+				{
+					*lpcbMaxValueLen = node->maxValueLen;
+				}
+
+				if (lpftLastWriteTime != nullptr)
+				{
+					lpftLastWriteTime->dwLowDateTime = static_cast<DWORD>(node->lastWriteTime);
+					lpftLastWriteTime->dwHighDateTime = static_cast<DWORD>(node->lastWriteTime >> 32);
+				}
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS EnumKey(HKEY hKey, DWORD dwIndex, wchar_t* lpName, LPDWORD lpcchName) override
+			{
+				if (lpName == nullptr || lpcchName == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				Pin version(*this);
+
+				const Node* node = nullptr;
+
+				LSTATUS lStatus = Lookup(*version, hKey, KEY_ENUMERATE_SUB_KEYS, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				if (dwIndex >= node->subKeys.size())
+				{
+					return ERROR_NO_MORE_ITEMS;
+				}
+
+				const std::wstring& name = node->subKeys[dwIndex]->name;
+
+				if (name.length() + 1 > *lpcchName)
+				{
+					return ERROR_MORE_DATA;
+				}
+
+				std::memcpy(lpName, name.c_str(), (name.length() + 1) * sizeof(wchar_t));
+				*lpcchName = static_cast<DWORD>(name.length());
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS EnumValue(HKEY hKey, DWORD dwIndex, wchar_t* lpValueName, LPDWORD lpcchValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) override
+			{
+				if (lpValueName == nullptr || lpcchValueName == nullptr || (lpData != nullptr && lpcbData == nullptr))
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				Pin version(*this);
+
+				const Node* node = nullptr;
+
+				LSTATUS lStatus = Lookup(*version, hKey, KEY_QUERY_VALUE, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				if (dwIndex >= node->values.size())
+				{
+					return ERROR_NO_MORE_ITEMS;
+				}
+
+				const Value& value = *node->values[dwIndex];
+
+				if (value.name.length() + 1 > *lpcchValueName)
+				{
+					return ERROR_MORE_DATA;
+				}
+
+				const auto cbData = static_cast<DWORD>(value.data.size());
+
+				if (lpData != nullptr && *lpcbData < cbData)
+				{
+					*lpcbData = cbData;
+
+					return ERROR_MORE_DATA;
+				}
+
+				std::memcpy(lpValueName, value.name.c_str(), (value.name.length() + 1) * sizeof(wchar_t));
+				*lpcchValueName = static_cast<DWORD>(value.name.length());
+
+				if (lpType != nullptr)
+				{
+					*lpType = value.type;
+				}
+
+				if (lpcbData != nullptr)
+				{
+					if (lpData != nullptr && cbData != 0)
+					{
+						std::memcpy(lpData, value.data.data(), cbData);
+					}
+
+					*lpcbData = cbData;
+				}
+
+				return ERROR_SUCCESS;
+			}
+
+			LSTATUS NotifyChangeKeyValue(HKEY hKey, bool watchSubtree, DWORD dwNotifyFilter, HANDLE hEvent, bool asynchronous) override
+			{
+				// There are no event objects to signal, only synchronous wait is supported
+				if (asynchronous || hEvent != nullptr)
+				{
+					return ERROR_NOT_SUPPORTED;
+				}
+
+				// Versions are released by writers only, so holding writer mutex keeps current version alive
+				std::unique_lock<std::mutex> lock(m_writerMutex);
+
+				const Node* node = nullptr;
+
+				LSTATUS lStatus = Resolve(*m_version.load(), hKey, KEY_NOTIFY, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				const auto changes = Changes(node, watchSubtree, dwNotifyFilter);
+
+				m_changed.wait(lock, [&]()
+				{
+					// Deleted key is reported as change
+					return Resolve(*m_version.load(), hKey, KEY_NOTIFY, &node) != ERROR_SUCCESS || Changes(node, watchSubtree, dwNotifyFilter) != changes;
+				});
+
+				return ERROR_SUCCESS;
+			}
+
+			/// <summary>
+			///		Applies operations to private copy of tree, which is published only when all of them succeeded,
+			///		so failed batch leaves nothing to revert.
+			/// </summary>
+			LSTATUS ApplyBatch(HKEY hKey, const BatchOperation* pOperations, DWORD cOperations) override
+			{
+				if (pOperations == nullptr && cOperations != 0)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				REGSAM required = 0;
+
+				for (DWORD i = 0; i < cOperations; ++i)
+				{
+					required |= RequiredAccess(pOperations[i].type);
+				}
+
+				return Write([&](Version& version) -> LSTATUS
+				{
+					const Node* node = nullptr;
+
+					LSTATUS lStatus = Resolve(version, hKey, required, &node);
+					if (lStatus != ERROR_SUCCESS)
+					{
+						return lStatus;
+					}
+
+					for (DWORD i = 0; i < cOperations; ++i)
+					{
+						lStatus = Apply(version, hKey, pOperations[i]);
+						if (lStatus != ERROR_SUCCESS)
+						{
+							return lStatus;
+						}
+					}
+
+					return ERROR_SUCCESS;
+				});
+			}
+
+		private:
+			static constexpr size_t PredefinedKeys = 8;
+			// Slots readers announce themselves in, threads beyond this count share slots
+			static constexpr size_t ReaderSlots = 64;
+			// Recent resolutions of handles remembered by each thread
+			static constexpr size_t ResolutionCacheSize = 16;
+
+			struct Value
+			{
+				std::wstring name;
+				// Upper cased name, values are ordered and looked up by it
+				std::wstring folded;
+				DWORD type = REG_NONE;
+				std::vector<BYTE> data;
+			};
+
+			struct Node
+			{
+				// Identity of key, shared by all copies of its node
+				ULONGLONG id = 0;
+				std::wstring name;
+				// Upper cased name, subkeys are ordered and looked up by it
+				std::wstring folded;
+				DWORD options = REG_OPTION_NON_VOLATILE;
+				ULONGLONG lastWriteTime = 0;
+				// Change counters per notify filter class, for this key and for whole subtree
+				ULONGLONG nameChanges = 0;
+				ULONGLONG valueChanges = 0;
+				ULONGLONG subtreeNameChanges = 0;
+				ULONGLONG subtreeValueChanges = 0;
+				DWORD maxSubKeyLen = 0;
+				DWORD maxValueNameLen = 0;
+				DWORD maxValueLen = 0;
+				// Subkeys and values in order they were created in, as they are enumerated
+				std::vector<std::shared_ptr<const Node>> subKeys;
+				std::vector<std::shared_ptr<const Value>> values;
+				// Positions of subkeys and values sorted by folded name
+				std::vector<DWORD> subKeyOrder;
+				std::vector<DWORD> valueOrder;
+			};
+
+			/// <summary>
+			///		Immutable state of whole registry, roots of predefined keys
+			/// </summary>
+			struct Version
+			{
+				// Unique among all versions of all backends
+				ULONGLONG serial = 0;
+				std::shared_ptr<const Node> roots[PredefinedKeys];
+			};
+
+			struct Handle
+			{
+				// Unique among all handles of all backends
+				ULONGLONG serial = 0;
+				size_t root = 0;
+				// Path relative to predefined key
+				std::wstring path;
+				ULONGLONG id = 0;
+				REGSAM access = 0;
+			};
+
+			/// <summary>
+			///		Number of readers in each of two most recent epochs, one cache line per slot
+			/// </summary>
+			struct alignas(64) ReaderSlot
+			{
+				std::atomic<ULONGLONG> readers[2] = {};
+			};
+
+			/// <summary>
+			///		Node handle was resolved to within version, remembered by thread which resolved it
+			/// </summary>
+			struct Resolution
+			{
+				ULONGLONG handle = 0;
+				ULONGLONG version = 0;
+				const Node* node = nullptr;
+			};
+
+			/// <summary>
+			///		Nodes from predefined key to resolved key, which writer copies
+			/// </summary>
+			struct Path
+			{
+				size_t root = 0;
+				std::vector<const Node*> nodes;
+				// Position of each node but last within subkeys of its parent
+				std::vector<DWORD> positions;
+			};
+
+			/// <summary>
+			///		Keeps version which was current when reader started alive until reader is done
+			/// </summary>
+			class Pin
+			{
+			public:
+				explicit Pin(VersionedBackend& backend)
+					: m_slot(backend.m_slots[ThreadSlot()])
+				{
+					// Sequentially consistent operations order announcement of reader before its load of version,
+					// and writer's store of new version before its check of readers
+					for (;;)
+					{
+						m_epoch = backend.m_epoch.load();
+						m_slot.readers[m_epoch & 1].fetch_add(1);
+
+						if (backend.m_epoch.load() == m_epoch)
+						{
+							break;
+						}
+
+						// Epoch advanced meanwhile, writer could have missed this reader
+						m_slot.readers[m_epoch & 1].fetch_sub(1, std::memory_order_release);
+					}
+
+					m_version = backend.m_version.load();
+				}
+
+				~Pin()
+				{
+					m_slot.readers[m_epoch & 1].fetch_sub(1, std::memory_order_release);
+				}
+
+				Pin(const Pin& other) = delete;
+				Pin& operator=(const Pin& other) = delete;
+
+				const Version& operator*() const
+				{
+					return *m_version;
+				}
+
+			private:
+				ReaderSlot& m_slot;
+				ULONGLONG m_epoch = 0;
+				const Version* m_version = nullptr;
+			};
+
+			static size_t ThreadSlot()
+			{
+				static std::atomic<size_t> s_threads(0);
+				thread_local const size_t slot = s_threads.fetch_add(1, std::memory_order_relaxed) % ReaderSlots;
+
+				return slot;
+			}
+
+			static wchar_t Upcase(wchar_t ch)
+			{
+				if (ch < 0x80)
+				{
+					return (ch >= L'a' && ch <= L'z') ? static_cast<wchar_t>(ch - (L'a' - L'A')) : ch;
+				}
+
+				return static_cast<wchar_t>(std::towupper(static_cast<wint_t>(ch)));
+			}
+
+			static std::wstring Fold(std::wstring_view name)
+			{
+				std::wstring folded(name);
+
+				for (auto& ch : folded)
+				{
+					ch = Upcase(ch);
+				}
+
+				return folded;
+			}
+
+			/// <summary>
+			///		Compares folded name with name being looked up, which is upper cased on the fly. Names are ordered
+			///		by length first, as similar names like Value1, Value2 ... mostly differ in length or at their end.
+			/// </summary>
+			static int Compare(const std::wstring& folded, std::wstring_view name)
+			{
+				if (folded.length() != name.length())
+				{
+					return (folded.length() < name.length()) ? -1 : 1;
+				}
+
+				for (size_t i = 0; i < folded.length(); ++i)
+				{
+					const wchar_t ch = Upcase(name[i]);
+
+					if (folded[i] != ch)
+					{
+						return (folded[i] < ch) ? -1 : 1;
+					}
+				}
+
+				return 0;
+			}
+
+			/// <summary>
+			///		Returns position within order where item with specified name is or would be inserted
+			/// </summary>
+			template <typename T>
+			static size_t Search(const std::vector<std::shared_ptr<const T>>& items, const std::vector<DWORD>& order, std::wstring_view name, bool* pFound)
+			{
+				auto it = std::lower_bound(order.begin(), order.end(), name, [&items](DWORD index, std::wstring_view n)
+				{
+					return Compare(items[index]->folded, n) < 0;
+				});
+
+				*pFound = (it != order.end() && Compare(items[*it]->folded, name) == 0);
+
+				return static_cast<size_t>(it - order.begin());
+			}
+
+			static bool IsPredefined(HKEY hKey)
+			{
+				return (reinterpret_cast<ULONG_PTR>(hKey) - reinterpret_cast<ULONG_PTR>(HKEY_CLASSES_ROOT)) < PredefinedKeys;
+			}
+
+			static std::wstring_view ValueName(const wchar_t* lpValueName)
+			{
+				return (lpValueName != nullptr) ? std::wstring_view(lpValueName) : std::wstring_view();
+			}
+
+			static ULONGLONG Now()
+			{
+				// FILETIME counts 100ns intervals since January 1, 1601
+				const auto since1970 = std::chrono::duration_cast<std::chrono::duration<long long, std::ratio<1, 10000000>>>(
+					std::chrono::system_clock::now().time_since_epoch()
+				);
+
+				return static_cast<ULONGLONG>(since1970.count()) + 116444736000000000ULL;
+			}
+
+			/// <summary>
+			///		Splits path on backslashes and invokes callback for each non-empty segment
+			/// </summary>
+			template <typename __Function>
+			static void ForEachSegment(const wchar_t* lpPath, const __Function& callback)
+			{
+				if (lpPath == nullptr)
+				{
+					return;
+				}
+
+				const wchar_t* p = lpPath;
+
+				for (;;)
+				{
+					const wchar_t* sep = p;
+					while (*sep != L'\0' && *sep != L'\\')
+					{
+						++sep;
+					}
+
+					if (sep != p && !callback(std::wstring_view(p, static_cast<size_t>(sep - p))))
+					{
+						return;
+					}
+
+					if (*sep == L'\0')
+					{
+						return;
+					}
+
+					p = sep + 1;
+				}
+			}
+
+			/// <summary>
+			///		Looks up subkey on specified path, appending nodes walked through to path when specified
+			/// </summary>
+			static const Node* Find(const Node* node, const wchar_t* lpSubKey, Path* pPath = nullptr)
+			{
+				ForEachSegment(lpSubKey, [&node, pPath](std::wstring_view segment) -> bool
+				{
+					bool found = false;
+
+					const size_t position = Search(node->subKeys, node->subKeyOrder, segment, &found);
+					if (!found)
+					{
+						node = nullptr;
+
+						return false;
+					}
+
+					const DWORD index = node->subKeyOrder[position];
+
+					node = node->subKeys[index].get();
+
+					if (pPath != nullptr)
+					{
+						pPath->positions.push_back(index);
+						pPath->nodes.push_back(node);
+					}
+
+					return true;
+				});
+
+				return node;
+			}
+
+			static const Value* FindValue(const Node* node, std::wstring_view name)
+			{
+				bool found = false;
+
+				const size_t position = Search(node->values, node->valueOrder, name, &found);
+
+				return found ? node->values[node->valueOrder[position]].get() : nullptr;
+			}
+
+			/// <summary>
+			///		Translates key handle to node within specified version, checking that handle grants required access rights
+			/// </summary>
+			static LSTATUS Resolve(const Version& version, HKEY hKey, REGSAM required, const Node** ppNode, Path* pPath = nullptr)
+			{
+				if (IsPredefined(hKey))
+				{
+					const size_t root = reinterpret_cast<ULONG_PTR>(hKey) - reinterpret_cast<ULONG_PTR>(HKEY_CLASSES_ROOT);
+
+					*ppNode = version.roots[root].get();
+
+					if (pPath != nullptr)
+					{
+						pPath->root = root;
+						pPath->nodes.push_back(*ppNode);
+					}
+
+					return ERROR_SUCCESS;
+				}
+
+				if (hKey == nullptr)
+				{
+					return ERROR_INVALID_HANDLE;
+				}
+
+				auto handle = reinterpret_cast<const Handle*>(hKey);
+
+				const Node* root = version.roots[handle->root].get();
+
+				if (pPath != nullptr)
+				{
+					pPath->root = handle->root;
+					pPath->nodes.push_back(root);
+				}
+
+				// Key deleted and created again on same path has different identity
+				const Node* node = Find(root, handle->path.c_str(), pPath);
+				if (node == nullptr || node->id != handle->id)
+				{
+					return ERROR_KEY_DELETED;
+				}
+
+				if ((handle->access & required) != required)
+				{
+					return ERROR_ACCESS_DENIED;
+				}
+
+				*ppNode = node;
+
+				return ERROR_SUCCESS;
+			}
+
+			/// <summary>
+			///		Same as Resolve(), but skips walking path of handle resolved by this thread within same version before.
+			///		Serials of handles and versions are never reused, so remembered node is valid as long as its version is.
+			/// </summary>
+			static LSTATUS Lookup(const Version& version, HKEY hKey, REGSAM required, const Node** ppNode)
+			{
+				if (IsPredefined(hKey) || hKey == nullptr)
+				{
+					return Resolve(version, hKey, required, ppNode);
+				}
+
+				thread_local Resolution cache[ResolutionCacheSize];
+
+				auto handle = reinterpret_cast<const Handle*>(hKey);
+
+				Resolution& resolution = cache[handle->serial % ResolutionCacheSize];
+
+				if (resolution.handle != handle->serial || resolution.version != version.serial)
+				{
+					LSTATUS lStatus = Resolve(version, hKey, 0, &resolution.node);
+					if (lStatus != ERROR_SUCCESS)
+					{
+						return lStatus;
+					}
+
+					resolution.handle = handle->serial;
+					resolution.version = version.serial;
+				}
+
+				if ((handle->access & required) != required)
+				{
+					return ERROR_ACCESS_DENIED;
+				}
+
+				*ppNode = resolution.node;
+
+				return ERROR_SUCCESS;
+			}
+
+			/// <summary>
+			///		Common part of QueryMultipleValues() and QueryValues(). Without statuses, missing value fails whole call.
+			/// </summary>
+			LSTATUS ReadValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize, LSTATUS* lpStatuses)
+			{
+				if (val_list == nullptr || ldwTotsize == nullptr)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				Pin version(*this);
+
+				const Node* node = nullptr;
+
+				LSTATUS lStatus = Lookup(*version, hKey, KEY_QUERY_VALUE, &node);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				// First pass looks up values and computes total size, value is parked in ve_valueptr
+				DWORD cbTotal = 0;
+
+				for (DWORD i = 0; i < num_vals; ++i)
+				{
+					const Value* value = FindValue(node, ValueName(val_list[i].ve_valuename));
+					if (value == nullptr)
+					{
+						if (lpStatuses == nullptr)
+						{
+							return ERROR_FILE_NOT_FOUND;
+						}
+
+						lpStatuses[i] = ERROR_FILE_NOT_FOUND;
+
+						val_list[i].ve_valuelen = 0;
+						val_list[i].ve_valueptr = 0;
+						val_list[i].ve_type = REG_NONE;
+
+						continue;
+					}
+
+					if (lpStatuses != nullptr)
+					{
+						lpStatuses[i] = ERROR_SUCCESS;
+					}
+
+					val_list[i].ve_valuelen = static_cast<DWORD>(value->data.size());
+					val_list[i].ve_valueptr = reinterpret_cast<DWORD_PTR>(value);
+					val_list[i].ve_type = value->type;
+
+					cbTotal += val_list[i].ve_valuelen;
+				}
+
+				if (lpValueBuf == nullptr)
+				{
+					*ldwTotsize = cbTotal;
+
+					return ERROR_SUCCESS;
+				}
+
+				if (*ldwTotsize < cbTotal)
+				{
+					*ldwTotsize = cbTotal;
+
+					return ERROR_MORE_DATA;
+				}
+
+				LPBYTE p = lpValueBuf;
+
+				for (DWORD i = 0; i < num_vals; ++i)
+				{
+					const Value* value = reinterpret_cast<const Value*>(val_list[i].ve_valueptr);
+					if (value == nullptr)
+					{
+						continue;
+					}
+
+					if (!value->data.empty())
+					{
+						std::memcpy(p, value->data.data(), value->data.size());
+					}
+
+					val_list[i].ve_valueptr = reinterpret_cast<DWORD_PTR>(p);
+
+					p += value->data.size();
+				}
+
+				*ldwTotsize = cbTotal;
+
+				return ERROR_SUCCESS;
+			}
+
+			static ULONGLONG NextSerial()
+			{
+				static std::atomic<ULONGLONG> s_serial(0);
+
+				return ++s_serial;
+			}
+
+			static HKEY NewHandle(HKEY hKey, const wchar_t* lpSubKey, ULONGLONG id, REGSAM access)
+			{
+				auto handle = std::make_unique<Handle>();
+
+				if (IsPredefined(hKey))
+				{
+					handle->root = reinterpret_cast<ULONG_PTR>(hKey) - reinterpret_cast<ULONG_PTR>(HKEY_CLASSES_ROOT);
+				}
+				else
+				{
+					auto parent = reinterpret_cast<const Handle*>(hKey);
+
+					handle->root = parent->root;
+					handle->path = parent->path;
+				}
+
+				if (lpSubKey != nullptr && *lpSubKey != L'\0')
+				{
+					handle->path += L'\\';
+					handle->path += lpSubKey;
+				}
+
+				handle->serial = NextSerial();
+				handle->id = id;
+				handle->access = access;
+
+				return reinterpret_cast<HKEY>(handle.release());
+			}
+
+			std::shared_ptr<Node> NewNode(std::wstring_view name, DWORD dwOptions)
+			{
+				auto node = std::make_shared<Node>();
+
+				node->id = ++m_lastId;
+				node->name.assign(name);
+				node->folded = Fold(name);
+				node->options = dwOptions;
+				node->lastWriteTime = Now();
+
+				return node;
+			}
+
+			/// <summary>
+			///		Runs writer over copy of current version under writer mutex and publishes the copy,
+			///		if writer succeeded and changed anything
+			/// </summary>
+			template <typename __Function>
+			LSTATUS Write(const __Function& writer)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_writerMutex);
+
+					const Version* current = m_version.load(std::memory_order_relaxed);
+
+					auto next = std::make_unique<Version>(*current);
+
+					next->serial = NextSerial();
+
+					LSTATUS lStatus = writer(*next);
+					if (lStatus != ERROR_SUCCESS)
+					{
+						return lStatus;
+					}
+
+					if (std::equal(std::begin(next->roots), std::end(next->roots), std::begin(current->roots)))
+					{
+						return ERROR_SUCCESS;
+					}
+
+					Publish(next.release());
+				}
+
+				m_changed.notify_all();
+
+				return ERROR_SUCCESS;
+			}
+
+			void Publish(const Version* version)
+			{
+				const Version* previous = m_version.exchange(version);
+
+				m_retired.emplace_back(m_epoch.load(std::memory_order_relaxed), previous);
+
+				// Both advances succeed, unless some reader is in the middle of read right now
+				for (int i = 0; i < 2 && TryAdvance(); ++i)
+				{
+				}
+
+				const ULONGLONG epoch = m_epoch.load(std::memory_order_relaxed);
+
+				// Readers which could have pinned version retired in epoch E announced themselves in E at latest
+				auto released = std::partition(m_retired.begin(), m_retired.end(), [epoch](const std::pair<ULONGLONG, const Version*>& retired)
+				{
+					return retired.first + 2 > epoch;
+				});
+
+				for (auto it = released; it != m_retired.end(); ++it)
+				{
+					delete it->second;
+				}
+
+				m_retired.erase(released, m_retired.end());
+			}
+
+			/// <summary>
+			///		Advances epoch when no reader of previous epoch is left, as its slots are reused by next epoch
+			/// </summary>
+			bool TryAdvance()
+			{
+				const ULONGLONG epoch = m_epoch.load(std::memory_order_relaxed);
+
+				for (const auto& slot : m_slots)
+				{
+					if (slot.readers[(epoch + 1) & 1].load() != 0)
+					{
+						return false;
+					}
+				}
+
+				m_epoch.store(epoch + 1);
+
+				return true;
+			}
+
+			/// <summary>
+			///		Records change of specified kind on copied node, or on its subtree only
+			/// </summary>
+			static void Touch(Node& node, DWORD dwNotifyFilter, bool self)
+			{
+				if (self)
+				{
+					node.lastWriteTime = Now();
+
+					if (dwNotifyFilter & REG_NOTIFY_CHANGE_NAME)
+					{
+						++node.nameChanges;
+					}
+
+					if (dwNotifyFilter & REG_NOTIFY_CHANGE_LAST_SET)
+					{
+						++node.valueChanges;
+					}
+				}
+
+				if (dwNotifyFilter & REG_NOTIFY_CHANGE_NAME)
+				{
+					++node.subtreeNameChanges;
+				}
+
+				if (dwNotifyFilter & REG_NOTIFY_CHANGE_LAST_SET)
+				{
+					++node.subtreeValueChanges;
+				}
+			}
+
+			/// <summary>
+			///		Replaces node on specified depth of path with its changed copy, copying all its ancestors
+			/// </summary>
+			static void Replace(Version& version, const Path& path, size_t depth, std::shared_ptr<Node> node, DWORD dwNotifyFilter)
+			{
+				Touch(*node, dwNotifyFilter, true);
+
+				std::shared_ptr<const Node> child = std::move(node);
+
+				while (depth-- > 0)
+				{
+					auto parent = std::make_shared<Node>(*path.nodes[depth]);
+
+					parent->subKeys[path.positions[depth]] = std::move(child);
+
+					Touch(*parent, dwNotifyFilter, false);
+
+					child = std::move(parent);
+				}
+
+				version.roots[path.root] = std::move(child);
+			}
+
+			/// <summary>
+			///		Creates missing keys on path relative to last node of path, returns identity of key on its end
+			/// </summary>
+			ULONGLONG Create(Version& version, Path& path, const wchar_t* lpSubKey, DWORD dwOptions)
+			{
+				const Node* node = path.nodes.back();
+
+				std::vector<std::wstring_view> missing;
+
+				ForEachSegment(lpSubKey, [&](std::wstring_view segment) -> bool
+				{
+					if (missing.empty())
+					{
+						bool found = false;
+
+						const size_t position = Search(node->subKeys, node->subKeyOrder, segment, &found);
+						if (found)
+						{
+							const DWORD index = node->subKeyOrder[position];
+
+							node = node->subKeys[index].get();
+
+							path.positions.push_back(index);
+							path.nodes.push_back(node);
+
+							return true;
+						}
+					}
+
+					missing.push_back(segment);
+
+					return true;
+				});
+
+				if (missing.empty())
+				{
+					return node->id;
+				}
+
+				// Created keys are built bottom up, then attached to deepest existing key
+				std::shared_ptr<Node> created;
+				ULONGLONG id = 0;
+
+				for (auto it = missing.rbegin(); it != missing.rend(); ++it)
+				{
+					auto child = NewNode(*it, dwOptions);
+
+					if (created != nullptr)
+					{
+						AddSubKey(*child, std::move(created));
+					}
+					else
+					{
+						id = child->id;
+					}
+
+					created = std::move(child);
+				}
+
+				auto parent = std::make_shared<Node>(*node);
+
+				AddSubKey(*parent, std::move(created));
+
+				Replace(version, path, path.nodes.size() - 1, std::move(parent), REG_NOTIFY_CHANGE_NAME);
+
+				return id;
+			}
+
+			static void AddSubKey(Node& parent, std::shared_ptr<const Node> child)
+			{
+				bool found = false;
+
+				const size_t position = Search(parent.subKeys, parent.subKeyOrder, child->name, &found);
+
+				if (child->name.length() > parent.maxSubKeyLen)
+				{
+					parent.maxSubKeyLen = static_cast<DWORD>(child->name.length());
+				}
+
+				parent.subKeyOrder.insert(parent.subKeyOrder.begin() + static_cast<std::ptrdiff_t>(position), static_cast<DWORD>(parent.subKeys.size()));
+				parent.subKeys.push_back(std::move(child));
+			}
+
+			/// <summary>
+			///		Detaches last node of path from its parent, whole its subtree is released with last version referring to it
+			/// </summary>
+			static void RemoveKey(Version& version, const Path& path)
+			{
+				const size_t depth = path.nodes.size() - 2;
+				const DWORD index = path.positions[depth];
+
+				auto parent = std::make_shared<Node>(*path.nodes[depth]);
+
+				parent->subKeys.erase(parent->subKeys.begin() + static_cast<std::ptrdiff_t>(index));
+				parent->subKeyOrder.erase(std::find(parent->subKeyOrder.begin(), parent->subKeyOrder.end(), index));
+
+				for (auto& position : parent->subKeyOrder)
+				{
+					if (position > index)
+					{
+						--position;
+					}
+				}
+
+				Replace(version, path, depth, std::move(parent), REG_NOTIFY_CHANGE_NAME);
+			}
+
+			static void StoreValue(Version& version, const Path& path, std::wstring_view name, DWORD dwType, const BYTE* lpData, DWORD cbData)
+			{
+				auto node = std::make_shared<Node>(*path.nodes.back());
+				auto value = std::make_shared<Value>();
+
+				value->type = dwType;
+				value->data.assign(lpData, lpData + cbData);
+
+				bool found = false;
+
+				const size_t position = Search(node->values, node->valueOrder, name, &found);
+
+				if (found)
+				{
+					const DWORD index = node->valueOrder[position];
+
+					// Existing value keeps its name and position
+					value->name = node->values[index]->name;
+					value->folded = node->values[index]->folded;
+
+					node->values[index] = std::move(value);
+				}
+				else
+				{
+					value->name.assign(name);
+					value->folded = Fold(name);
+
+					if (name.length() > node->maxValueNameLen)
+					{
+						node->maxValueNameLen = static_cast<DWORD>(name.length());
+					}
+
+					node->valueOrder.insert(node->valueOrder.begin() + static_cast<std::ptrdiff_t>(position), static_cast<DWORD>(node->values.size()));
+					node->values.push_back(std::move(value));
+				}
+
+				if (cbData > node->maxValueLen)
+				{
+					node->maxValueLen = cbData;
+				}
+
+				Replace(version, path, path.nodes.size() - 1, std::move(node), REG_NOTIFY_CHANGE_LAST_SET);
+			}
+
+			static LSTATUS RemoveValue(Version& version, const Path& path, std::wstring_view name)
+			{
+				const Node* node = path.nodes.back();
+
+				bool found = false;
+
+				const size_t position = Search(node->values, node->valueOrder, name, &found);
+				if (!found)
+				{
+					return ERROR_FILE_NOT_FOUND;
+				}
+
+				auto copy = std::make_shared<Node>(*node);
+
+				const DWORD index = copy->valueOrder[position];
+				const auto last = static_cast<DWORD>(copy->values.size() - 1);
+
+				// Move last value into place of deleted one
+				copy->values[index] = std::move(copy->values[last]);
+				copy->values.pop_back();
+				copy->valueOrder.erase(copy->valueOrder.begin() + static_cast<std::ptrdiff_t>(position));
+
+				for (auto& other : copy->valueOrder)
+				{
+					if (other == last)
+					{
+						other = index;
+					}
+				}
+
+				Replace(version, path, path.nodes.size() - 1, std::move(copy), REG_NOTIFY_CHANGE_LAST_SET);
+
+				return ERROR_SUCCESS;
+			}
+
+			static REGSAM RequiredAccess(BatchOperationType type)
+			{
+				switch (type)
+				{
+					case BatchOperationType::CreateKey: return KEY_CREATE_SUB_KEY;
+					case BatchOperationType::DeleteKey: return DELETE | KEY_ENUMERATE_SUB_KEYS | KEY_QUERY_VALUE;
+					default: return KEY_SET_VALUE;
+				}
+			}
+
+			/// <summary>
+			///		Applies single batch operation to private copy of tree
+			/// </summary>
+			LSTATUS Apply(Version& version, HKEY hKey, const BatchOperation& operation)
+			{
+				Path path;
+				const Node* node = nullptr;
+
+				LSTATUS lStatus = Resolve(version, hKey, 0, &node, &path);
+				if (lStatus != ERROR_SUCCESS)
+				{
+					return lStatus;
+				}
+
+				if (operation.type == BatchOperationType::CreateKey)
+				{
+					Create(version, path, operation.lpSubKey, REG_OPTION_NON_VOLATILE);
+
+					return ERROR_SUCCESS;
+				}
+
+				const size_t depth = path.nodes.size() - 1;
+
+				if (Find(node, operation.lpSubKey, &path) == nullptr)
+				{
+					return ERROR_FILE_NOT_FOUND;
+				}
+
+				switch (operation.type)
+				{
+					case BatchOperationType::DeleteKey:
+					{
+						if (path.nodes.size() - 1 == depth)
+						{
+							return ERROR_INVALID_PARAMETER;
+						}
+
+						RemoveKey(version, path);
+					}
+					break;
+
+					case BatchOperationType::SetValue:
+					{
+						if (operation.lpData == nullptr && operation.cbData != 0)
+						{
+							return ERROR_INVALID_PARAMETER;
+						}
+
+						StoreValue(version, path, ValueName(operation.lpValueName), operation.dwType, operation.lpData, operation.cbData);
+					}
+					break;
+
+					case BatchOperationType::DeleteValue:
+					{
+						return RemoveValue(version, path, ValueName(operation.lpValueName));
+					}
+
+					default:
+					{
+						return ERROR_INVALID_PARAMETER;
+					}
+				}
+
+				return ERROR_SUCCESS;
+			}
+
+			static ULONGLONG Changes(const Node* node, bool watchSubtree, DWORD dwNotifyFilter)
+			{
+				ULONGLONG changes = 0;
+
+				if (dwNotifyFilter & REG_NOTIFY_CHANGE_NAME)
+				{
+					changes += watchSubtree ? node->subtreeNameChanges : node->nameChanges;
+				}
+
+				if (dwNotifyFilter & REG_NOTIFY_CHANGE_LAST_SET)
+				{
+					changes += watchSubtree ? node->subtreeValueChanges : node->valueChanges;
+				}
+
+				return changes;
+			}
+
+		private:
+			ReaderSlot m_slots[ReaderSlots];
+			std::atomic<ULONGLONG> m_epoch{ 0 };
+			std::atomic<const Version*> m_version{ nullptr };
+
+			// Writer state, guarded by m_writerMutex
+			std::mutex m_writerMutex;
+			std::condition_variable m_changed;
+			// Replaced versions with epoch they were replaced in, released once no reader can hold them
+			std::vector<std::pair<ULONGLONG, const Version*>> m_retired;
+			ULONGLONG m_lastId = 0;
+		};
+	}
+}
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <Registry.hpp>
+#include <ChangeNotifier.hpp>
+#include <Executor.hpp>
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <utility>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Watches any number of registry keys and dispatches their changes on shared executor, so thousands
+		///		of keys are watched without dedicating thread to any of them. Notifiers are re-armed as soon as
+		///		change is reported, changes reported while callback is scheduled or running are coalesced into
+		///		single invocation which follows.
+		/// </summary>
+		/// <remarks>
+		///		Callback of single watch never runs concurrently with itself, callbacks of different watches may.
+		///		Callback receives false once notifier could not re-arm itself, e.g. because key was deleted,
+		///		after that watch reports no further changes and only waits for Remove(). Callback must not throw.
+		/// </remarks>
+		class WatchHub
+		{
+		public:
+			typedef ChangeNotifier::Callback Callback;
+			// Identifies watch within hub, zero is never used
+			typedef ULONGLONG WatchId;
+
+		private:
+			struct Watch
+			{
+				std::mutex mutex;
+				std::condition_variable idle;
+				Callback callback;
+				Executor_ptr executor;
+				ChangeNotifier_ptr notifier;
+				// Change was reported and not dispatched yet
+				bool pending = false;
+				// Notifier could not re-arm itself
+				bool stopped = false;
+				// Failure of notifier was already dispatched
+				bool stopReported = false;
+				// Dispatch is posted to executor
+				bool scheduled = false;
+				// Callback is running on thread
+				bool running = false;
+				std::thread::id thread;
+				bool removed = false;
+			};
+
+			typedef std::shared_ptr<Watch> Watch_ptr;
+
+		public:
+			explicit WatchHub(const Executor_ptr& executor = DefaultExecutor())
+				: m_executor(executor)
+				, m_lastId(0)
+			{
+				if (m_executor == nullptr)
+				{
+					throw std::invalid_argument("Executor cannot be nullptr");
+				}
+			}
+
+			// Disable copy ctor & copy assignment operator
+			WatchHub(const WatchHub& other) = delete;
+			WatchHub& operator=(const WatchHub& other) = delete;
+
+			~WatchHub()
+			{
+				Clear();
+			}
+
+			/// <summary>
+			///		Watches key using change notifier matching key backend.
+			///		Key must be opened with DesiredAccess::Notify rights.
+			/// </summary>
+			WatchId Add(const RegistryKey_ptr& key, const Callback& callback, bool watchSubtree = false, NotifyFilter notifyFilter = NotifyFilter::ChangeName | NotifyFilter::ChangeLastSet)
+			{
+				if (!callback)
+				{
+					throw std::invalid_argument("Callback cannot be empty");
+				}
+
+				return Add(CreateChangeNotifier(key, watchSubtree, notifyFilter), callback);
+			}
+
+			WatchId Add(ChangeNotifier_ptr notifier, const Callback& callback)
+			{
+				if (notifier == nullptr)
+				{
+					throw std::invalid_argument("Change notifier cannot be nullptr");
+				}
+
+				if (!callback)
+				{
+					throw std::invalid_argument("Callback cannot be empty");
+				}
+
+				auto watch = std::make_shared<Watch>();
+				watch->callback = callback;
+				watch->executor = m_executor;
+				watch->notifier = std::move(notifier);
+
+				// Notifier is owned by watch, so its callback must not keep watch alive
+				std::weak_ptr<Watch> weak = watch;
+
+				watch->notifier->Start([weak](bool rearmed)
+				{
+					auto watch = weak.lock();
+					if (watch != nullptr)
+					{
+						Notify(watch, rearmed);
+					}
+				});
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				const WatchId id = ++m_lastId;
+
+				m_watches.emplace(id, std::move(watch));
+
+				return id;
+			}
+
+			/// <summary>
+			///		Stops watch. Once this method returns, its callback is not running and will not be invoked anymore,
+			///		unless it is called from that callback itself.
+			/// </summary>
+			/// <returns>false when watch does not exist</returns>
+			bool Remove(WatchId id)
+			{
+				Watch_ptr watch;
+
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+
+					auto it = m_watches.find(id);
+					if (it == m_watches.end())
+					{
+						return false;
+					}
+
+					watch = std::move(it->second);
+
+					m_watches.erase(it);
+				}
+
+				Stop(watch);
+
+				return true;
+			}
+
+			/// <summary>
+			///		Removes all watches
+			/// </summary>
+			void Clear()
+			{
+				std::unordered_map<WatchId, Watch_ptr> watches;
+
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+
+					watches.swap(m_watches);
+				}
+
+				for (auto& watch : watches)
+				{
+					Stop(watch.second);
+				}
+			}
+
+			/// <summary>
+			///		Number of watches
+			/// </summary>
+			size_t Size() const
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				return m_watches.size();
+			}
+
+		private:
+			/// <summary>
+			///		Invoked by notifier, only marks change and posts dispatch, so notifier thread is not blocked by callback
+			/// </summary>
+			static void Notify(const Watch_ptr& watch, bool rearmed)
+			{
+				{
+					std::lock_guard<std::mutex> lock(watch->mutex);
+
+					if (watch->removed)
+					{
+						return;
+					}
+
+					if (rearmed)
+					{
+						watch->pending = true;
+					}
+					else
+					{
+						watch->stopped = true;
+					}
+
+					// Running callback posts dispatch itself once it returns
+					if (watch->scheduled || watch->running)
+					{
+						return;
+					}
+
+					watch->scheduled = true;
+				}
+
+				watch->executor->Post([watch]() { Dispatch(watch); });
+			}
+
+			static void Dispatch(const Watch_ptr& watch)
+			{
+				std::unique_lock<std::mutex> lock(watch->mutex);
+
+				watch->scheduled = false;
+
+				if (watch->removed)
+				{
+					return;
+				}
+
+				const bool changed = std::exchange(watch->pending, false);
+				const bool stopped = watch->stopped && !watch->stopReported;
+
+				if (stopped)
+				{
+					watch->stopReported = true;
+				}
+
+				watch->running = true;
+				watch->thread = std::this_thread::get_id();
+
+				lock.unlock();
+
+				if (changed)
+				{
+					watch->callback(true);
+				}
+
+				if (stopped)
+				{
+					watch->callback(false);
+				}
+
+				lock.lock();
+
+				watch->running = false;
+				watch->thread = std::thread::id();
+
+				// Changes reported while callback was running are dispatched by next task,
+				// so busy key does not hold executor thread from other watches
+				const bool repost = !watch->removed && (watch->pending || (watch->stopped && !watch->stopReported));
+
+				if (repost)
+				{
+					watch->scheduled = true;
+				}
+
+				lock.unlock();
+
+				watch->idle.notify_all();
+
+				if (repost)
+				{
+					watch->executor->Post([watch]() { Dispatch(watch); });
+				}
+			}
+
+			static void Stop(const Watch_ptr& watch)
+			{
+				// No notifier callback runs once Stop() returns
+				watch->notifier->Stop();
+
+				std::unique_lock<std::mutex> lock(watch->mutex);
+
+				watch->removed = true;
+
+				// Callback removing its own watch would wait for itself
+				if (watch->thread != std::this_thread::get_id())
+				{
+					watch->idle.wait(lock, [&watch]()
+					{
+						return !watch->running;
+					});
+				}
+			}
+
+		private:
+			Executor_ptr m_executor;
+			mutable std::mutex m_mutex;
+			std::unordered_map<WatchId, Watch_ptr> m_watches;
+			WatchId m_lastId;
+		};
+	}
+}
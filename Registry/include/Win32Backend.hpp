@@ -0,0 +1,238 @@
+#pragma once
+
+#include <RegistryBackend.hpp>
+
+#if defined(_WIN32)
+
+#include <ktmw32.h>
+
+#include <cwchar>
+
+#pragma comment(lib, "KtmW32.lib")
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Backend forwarding all calls to native Windows registry API
+		/// </summary>
+		class Win32Backend final : public RegistryBackend
+		{
+		public:
+			LSTATUS OpenKey(HKEY hKey, const wchar_t* lpSubKey, REGSAM samDesired, HKEY* phkResult) override
+			{
+				return RegOpenKeyExW(hKey, lpSubKey, 0, samDesired, phkResult);
+			}
+
+			LSTATUS CreateKey(HKEY hKey, const wchar_t* lpSubKey, DWORD dwOptions, REGSAM samDesired, HKEY* phkResult) override
+			{
+				return RegCreateKeyExW(hKey, lpSubKey, 0, nullptr, dwOptions, samDesired, nullptr, phkResult, nullptr);
+			}
+
+			LSTATUS CloseKey(HKEY hKey) override
+			{
+				return RegCloseKey(hKey);
+			}
+
+			LSTATUS DeleteTree(HKEY hKey, const wchar_t* lpSubKey) override
+			{
+				return RegDeleteTreeW(hKey, lpSubKey);
+			}
+
+			LSTATUS DeleteValue(HKEY hKey, const wchar_t* lpValueName) override
+			{
+				return RegDeleteValueW(hKey, lpValueName);
+			}
+
+			LSTATUS FlushKey(HKEY hKey) override
+			{
+				return RegFlushKey(hKey);
+			}
+
+			LSTATUS SaveKey(HKEY hKey, const wchar_t* lpFile) override
+			{
+				return RegSaveKeyW(hKey, lpFile, nullptr);
+			}
+
+			LSTATUS QueryValue(HKEY hKey, const wchar_t* lpValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) override
+			{
+				return RegQueryValueExW(hKey, lpValueName, nullptr, lpType, lpData, lpcbData);
+			}
+
+			LSTATUS QueryMultipleValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize) override
+			{
+				return RegQueryMultipleValuesW(hKey, val_list, num_vals, reinterpret_cast<LPWSTR>(lpValueBuf), ldwTotsize);
+			}
+
+			LSTATUS SetValue(HKEY hKey, const wchar_t* lpValueName, DWORD dwType, const BYTE* lpData, DWORD cbData) override
+			{
+				return RegSetValueExW(hKey, lpValueName, 0, dwType, lpData, cbData);
+			}
+
+			LSTATUS QueryInfoKey(HKEY hKey, LPDWORD lpcSubKeys, LPDWORD lpcchMaxSubKeyLen, LPDWORD lpcValues, LPDWORD lpcchMaxValueNameLen, LPDWORD lpcbMaxValueLen, FILETIME* lpftLastWriteTime) override
+			{
+				return RegQueryInfoKeyW
+				(
+					hKey,					// Key handle
+					nullptr,				// Buffer for registry key class name
+					nullptr,				// Size of class string
+					nullptr,				// Reserved
+					lpcSubKeys,				// Number of subkeys
+					lpcchMaxSubKeyLen,		// Longest subkey name
+					nullptr,				// Longest class string
+					lpcValues,				// Number of values
+					lpcchMaxValueNameLen,	// Longest value name
+					lpcbMaxValueLen,		// Longest value data
+					nullptr,				// Security descriptor
+					lpftLastWriteTime		// Last key write time
+				);
+			}
+
+			LSTATUS EnumKey(HKEY hKey, DWORD dwIndex, wchar_t* lpName, LPDWORD lpcchName) override
+			{
+				return RegEnumKeyExW(hKey, dwIndex, lpName, lpcchName, nullptr, nullptr, nullptr, nullptr);
+			}
+
+			LSTATUS EnumValue(HKEY hKey, DWORD dwIndex, wchar_t* lpValueName, LPDWORD lpcchValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) override
+			{
+				return RegEnumValueW(hKey, dwIndex, lpValueName, lpcchValueName, nullptr, lpType, lpData, lpcbData);
+			}
+
+			LSTATUS NotifyChangeKeyValue(HKEY hKey, bool watchSubtree, DWORD dwNotifyFilter, HANDLE hEvent, bool asynchronous) override
+			{
+				return RegNotifyChangeKeyValue(hKey, watchSubtree ? TRUE : FALSE, dwNotifyFilter, hEvent, asynchronous ? TRUE : FALSE);
+			}
+
+			LSTATUS ApplyBatch(HKEY hKey, const BatchOperation* pOperations, DWORD cOperations) override
+			{
+				if (pOperations == nullptr && cOperations != 0)
+				{
+					return ERROR_INVALID_PARAMETER;
+				}
+
+				HANDLE hTransaction = CreateTransaction(nullptr, nullptr, 0, 0, 0, 0, nullptr);
+				if (hTransaction == INVALID_HANDLE_VALUE)
+				{
+					return static_cast<LSTATUS>(GetLastError());
+				}
+
+				LSTATUS lStatus = ERROR_SUCCESS;
+
+				// Consecutive operations on same key share its transacted handle
+				HKEY hSubKey = nullptr;
+				const wchar_t* lpOpenedSubKey = nullptr;
+
+				for (DWORD i = 0; i < cOperations && lStatus == ERROR_SUCCESS; ++i)
+				{
+					const auto& operation = pOperations[i];
+					const wchar_t* lpSubKey = (operation.lpSubKey != nullptr) ? operation.lpSubKey : L"";
+
+					if (operation.type == BatchOperationType::DeleteKey)
+					{
+						if (hSubKey != nullptr)
+						{
+							RegCloseKey(hSubKey);
+							hSubKey = nullptr;
+						}
+
+						if (*lpSubKey == L'\0')
+						{
+							lStatus = ERROR_INVALID_PARAMETER;
+
+							break;
+						}
+
+						HKEY hTarget = nullptr;
+
+						lStatus = RegOpenKeyTransactedW(hKey, lpSubKey, 0, DELETE | KEY_ENUMERATE_SUB_KEYS | KEY_QUERY_VALUE | KEY_SET_VALUE, &hTarget, hTransaction, nullptr);
+						if (lStatus == ERROR_SUCCESS)
+						{
+							lStatus = RegDeleteTreeW(hTarget, nullptr);
+
+							RegCloseKey(hTarget);
+						}
+
+						if (lStatus == ERROR_SUCCESS)
+						{
+							lStatus = RegDeleteKeyTransactedW(hKey, lpSubKey, 0, 0, hTransaction, nullptr);
+						}
+
+						continue;
+					}
+
+					if (hSubKey == nullptr || std::wcscmp(lpOpenedSubKey, lpSubKey) != 0)
+					{
+						if (hSubKey != nullptr)
+						{
+							RegCloseKey(hSubKey);
+							hSubKey = nullptr;
+						}
+
+						if (operation.type == BatchOperationType::CreateKey)
+						{
+							lStatus = RegCreateKeyTransactedW(hKey, lpSubKey, 0, nullptr, REG_OPTION_NON_VOLATILE, KEY_SET_VALUE, nullptr, &hSubKey, nullptr, hTransaction, nullptr);
+						}
+						else
+						{
+							lStatus = RegOpenKeyTransactedW(hKey, lpSubKey, 0, KEY_SET_VALUE, &hSubKey, hTransaction, nullptr);
+						}
+
+						if (lStatus != ERROR_SUCCESS)
+						{
+							hSubKey = nullptr;
+
+							break;
+						}
+
+						lpOpenedSubKey = lpSubKey;
+					}
+
+					switch (operation.type)
+					{
+						case BatchOperationType::SetValue:
+						{
+							lStatus = RegSetValueExW(hSubKey, operation.lpValueName, 0, operation.dwType, operation.lpData, operation.cbData);
+						}
+						break;
+
+						case BatchOperationType::DeleteValue:
+						{
+							lStatus = RegDeleteValueW(hSubKey, operation.lpValueName);
+						}
+						break;
+
+						default:
+						{
+							// Key was created by opening it
+						}
+						break;
+					}
+				}
+
+				if (hSubKey != nullptr)
+				{
+					RegCloseKey(hSubKey);
+				}
+
+				if (lStatus == ERROR_SUCCESS)
+				{
+					if (!CommitTransaction(hTransaction))
+					{
+						lStatus = static_cast<LSTATUS>(GetLastError());
+					}
+				}
+				else
+				{
+					RollbackTransaction(hTransaction);
+				}
+
+				CloseHandle(hTransaction);
+
+				return lStatus;
+			}
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <Registry.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <limits>
+
+namespace m4x1m1l14n
+{
+	namespace Registry
+	{
+		/// <summary>
+		///		Collects changes of registry keys and values and commits them atomically, so other threads and processes
+		///		observe either all changes or none of them. Native registry commits batch via kernel transaction,
+		///		in-memory backend applies it under single lock. Whole batch is handed to backend by single call,
+		///		which also saves per-call overhead of making many changes one by one.
+		/// </summary>
+		/// <remarks>
+		///		Paths of keys are relative to key batch is committed to, empty path stands for that key itself.
+		///		Operations are applied in order they were added, so value can be set in key created by same batch.
+		///		Batch is not cleared by Commit(), so same changes can be committed to multiple keys.
+		/// </remarks>
+		class WriteBatch
+		{
+		public:
+			WriteBatch() = default;
+
+			/// <summary>
+			///		Creates key including all missing parent keys, existing key is left as is
+			/// </summary>
+			WriteBatch& CreateKey(std::wstring_view path)
+			{
+				return Add(BatchOperationType::CreateKey, path, std::wstring_view(), REG_NONE, nullptr, 0);
+			}
+
+			/// <summary>
+			///		Deletes key with all its subkeys and values. Commit fails when key does not exist.
+			/// </summary>
+			WriteBatch& DeleteKey(std::wstring_view path)
+			{
+				return Add(BatchOperationType::DeleteKey, path, std::wstring_view(), REG_NONE, nullptr, 0);
+			}
+
+			/// <summary>
+			///		Deletes value. Commit fails when value does not exist.
+			/// </summary>
+			WriteBatch& DeleteValue(std::wstring_view path, std::wstring_view name)
+			{
+				return Add(BatchOperationType::DeleteValue, path, name, REG_NONE, nullptr, 0);
+			}
+
+			/// <summary>
+			///		Sets value of any type. Commit fails when key does not exist and is not created by batch before.
+			/// </summary>
+			WriteBatch& SetValue(std::wstring_view path, std::wstring_view name, DWORD dwType, const BYTE* pData, DWORD cbData)
+			{
+				if (pData == nullptr && cbData != 0)
+				{
+					throw std::invalid_argument("Value data cannot be nullptr");
+				}
+
+				return Add(BatchOperationType::SetValue, path, name, dwType, pData, cbData);
+			}
+
+			WriteBatch& SetBoolean(std::wstring_view path, std::wstring_view name, bool value)
+			{
+				DWORD dwValue = value ? 1 : 0;
+
+				return SetValue(path, name, REG_DWORD, reinterpret_cast<const BYTE*>(&dwValue), sizeof(dwValue));
+			}
+
+			WriteBatch& SetInt32(std::wstring_view path, std::wstring_view name, LONG value)
+			{
+				return SetValue(path, name, REG_DWORD, reinterpret_cast<const BYTE*>(&value), sizeof(value));
+			}
+
+			WriteBatch& SetUInt32(std::wstring_view path, std::wstring_view name, DWORD value)
+			{
+				return SetValue(path, name, REG_DWORD, reinterpret_cast<const BYTE*>(&value), sizeof(value));
+			}
+
+			WriteBatch& SetInt64(std::wstring_view path, std::wstring_view name, long long value)
+			{
+				return SetValue(path, name, REG_QWORD, reinterpret_cast<const BYTE*>(&value), sizeof(value));
+			}
+
+			WriteBatch& SetUInt64(std::wstring_view path, std::wstring_view name, unsigned long long value)
+			{
+				return SetValue(path, name, REG_QWORD, reinterpret_cast<const BYTE*>(&value), sizeof(value));
+			}
+
+			WriteBatch& SetString(std::wstring_view path, std::wstring_view name, std::wstring_view value)
+			{
+				return SetValue(path, name, REG_SZ, reinterpret_cast<const BYTE*>(value.data()), static_cast<DWORD>(value.length() * sizeof(wchar_t)));
+			}
+
+			WriteBatch& SetExpandString(std::wstring_view path, std::wstring_view name, std::wstring_view value)
+			{
+				return SetValue(path, name, REG_EXPAND_SZ, reinterpret_cast<const BYTE*>(value.data()), static_cast<DWORD>(value.length() * sizeof(wchar_t)));
+			}
+
+			WriteBatch& SetBinary(std::wstring_view path, std::wstring_view name, std::span<const std::byte> value)
+			{
+				if (value.size() > (std::numeric_limits<DWORD>::max)())
+				{
+					throw std::invalid_argument("Binary value cannot be larger than 4GB");
+				}
+
+				return SetValue(path, name, REG_BINARY, reinterpret_cast<const BYTE*>(value.data()), static_cast<DWORD>(value.size()));
+			}
+
+			/// <summary>
+			///		Number of operations in batch
+			/// </summary>
+			size_t Size() const
+			{
+				return m_entries.size();
+			}
+
+			bool Empty() const
+			{
+				return m_entries.empty();
+			}
+
+			/// <summary>
+			///		Removes all operations, keeping allocated memory for next batch
+			/// </summary>
+			void Clear()
+			{
+				m_entries.clear();
+				m_strings.clear();
+				m_data.clear();
+			}
+
+			/// <summary>
+			///		Applies all operations to subtree of specified key as single transaction.
+			///		When any operation fails, none of them is applied and exception is thrown.
+			/// </summary>
+			void Commit(const RegistryKey_ptr& key)
+			{
+				if (key == nullptr)
+				{
+					throw std::invalid_argument("Registry key cannot be nullptr");
+				}
+
+				// Strings and data are stored in growing buffers, so pointers are resolved only now
+				m_operations.resize(m_entries.size());
+
+				for (size_t i = 0; i < m_entries.size(); ++i)
+				{
+					const auto& entry = m_entries[i];
+					auto& operation = m_operations[i];
+
+					operation.type = entry.type;
+					operation.lpSubKey = m_strings.c_str() + entry.path;
+					operation.lpValueName = m_strings.c_str() + entry.name;
+					operation.dwType = entry.dwType;
+					operation.lpData = (entry.cbData != 0) ? m_data.data() + entry.data : nullptr;
+					operation.cbData = entry.cbData;
+				}
+
+				LSTATUS lStatus = key->GetBackend()->ApplyBatch(*key, m_operations.data(), static_cast<DWORD>(m_operations.size()));
+				if (lStatus != ERROR_SUCCESS)
+				{
+					auto ec = std::error_code(lStatus, std::system_category());
+
+					throw std::system_error(ec, "CommitTransaction() failed");
+				}
+			}
+
+		private:
+			struct Entry
+			{
+				BatchOperationType type;
+				// Offsets of null terminated strings within m_strings
+				size_t path;
+				size_t name;
+				DWORD dwType;
+				// Offset of data within m_data
+				size_t data;
+				DWORD cbData;
+			};
+
+			WriteBatch& Add(BatchOperationType type, std::wstring_view path, std::wstring_view name, DWORD dwType, const BYTE* pData, DWORD cbData)
+			{
+				Entry entry;
+				entry.type = type;
+				entry.path = Append(path);
+				entry.name = Append(name);
+				entry.dwType = dwType;
+				entry.data = m_data.size();
+				entry.cbData = cbData;
+
+				m_data.insert(m_data.end(), pData, pData + cbData);
+				m_entries.push_back(entry);
+
+				return *this;
+			}
+
+			size_t Append(std::wstring_view str)
+			{
+				const size_t offset = m_strings.length();
+
+				m_strings.append(str);
+				m_strings.push_back(L'\0');
+
+				return offset;
+			}
+
+		private:
+			std::vector<Entry> m_entries;
+			std::wstring m_strings;
+			std::vector<BYTE> m_data;
+			std::vector<BatchOperation> m_operations;
+		};
+	}
+}
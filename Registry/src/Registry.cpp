@@ -1,9 +1,25 @@
 #include <Registry.hpp>
 
+#if defined(_WIN32)
+#include <Win32Backend.hpp>
+#else
+#include <MemoryBackend.hpp>
+#endif
+
 namespace m4x1m1l14n
 {
 	namespace Registry
 	{
+		RegistryBackend_ptr DefaultBackend()
+		{
+#if defined(_WIN32)
+			static RegistryBackend_ptr backend = std::make_shared<Win32Backend>();
+#else
+			static RegistryBackend_ptr backend = std::make_shared<MemoryBackend>();
+#endif
+			return backend;
+		}
+
 		RegistryKey_ptr ClassesRoot(new RegistryKey(HKEY_CLASSES_ROOT));
 		RegistryKey_ptr CurrentUser(new RegistryKey(HKEY_CURRENT_USER));
 		RegistryKey_ptr LocalMachine(new RegistryKey(HKEY_LOCAL_MACHINE));
@@ -0,0 +1,1761 @@
+#if defined(_WIN32)
+#pragma comment(lib, "Registry.lib")
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <new>
+#include <cstdlib>
+#include <cassert>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <cstdio>
+#include <sstream>
+#include <algorithm>
+#include <cwchar>
+#include <memory>
+#include <cstring>
+#include <fstream>
+
+#include <Registry.hpp>
+#include <MemoryBackend.hpp>
+#include <KeyCache.hpp>
+#include <RegistryWalker.hpp>
+#include <Snapshot.hpp>
+#include <RegFile.hpp>
+#include <RegistryDiff.hpp>
+#include <WriteBatch.hpp>
+#include <WatchHub.hpp>
+#include <ConfigSchema.hpp>
+#include <PathTrie.hpp>
+#include <HiveFile.hpp>
+#include <HiveWriter.hpp>
+#include <VersionedBackend.hpp>
+
+using namespace m4x1m1l14n;
+
+// Replacements are kept out of line, otherwise GCC inlines std::free() into delete expressions and reports
+// false -Wmismatched-new-delete for pointers returned by operator new
+#if defined(__GNUC__)
+#define ALLOCATION_NOINLINE __attribute__((noinline))
+#else
+#define ALLOCATION_NOINLINE
+#endif
+
+// Counts heap allocations made by whole process
+static std::atomic<size_t> g_allocations(0);
+
+ALLOCATION_NOINLINE void* operator new(size_t size)
+{
+	++g_allocations;
+
+	void* p = std::malloc(size != 0 ? size : 1);
+	if (p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	return p;
+}
+
+ALLOCATION_NOINLINE void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+ALLOCATION_NOINLINE void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+ALLOCATION_NOINLINE void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+ALLOCATION_NOINLINE void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+ALLOCATION_NOINLINE void operator delete[](void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+/// <summary>
+///		Backend forwarding calls to another backend, counting them
+/// </summary>
+class CountingBackend final : public Registry::RegistryBackend
+{
+public:
+	explicit CountingBackend(const Registry::RegistryBackend_ptr& backend)
+		: m_backend(backend)
+		, m_calls(0)
+		, m_steps(0)
+	{
+	}
+
+	size_t Calls() const
+	{
+		return m_calls;
+	}
+
+	/// <summary>
+	///		Number of path segments resolved by OpenKey() calls, as each one costs separate lookup
+	/// </summary>
+	size_t Steps() const
+	{
+		return m_steps;
+	}
+
+	LSTATUS OpenKey(HKEY hKey, const wchar_t* lpSubKey, REGSAM samDesired, HKEY* phkResult) override
+	{
+		++m_calls;
+
+		if (lpSubKey != nullptr && *lpSubKey != L'\0')
+		{
+			m_steps += 1 + std::count(lpSubKey, lpSubKey + std::wcslen(lpSubKey), L'\\');
+		}
+
+		return m_backend->OpenKey(hKey, lpSubKey, samDesired, phkResult);
+	}
+
+	LSTATUS CreateKey(HKEY hKey, const wchar_t* lpSubKey, DWORD dwOptions, REGSAM samDesired, HKEY* phkResult) override
+	{
+		++m_calls;
+
+		return m_backend->CreateKey(hKey, lpSubKey, dwOptions, samDesired, phkResult);
+	}
+
+	LSTATUS CloseKey(HKEY hKey) override
+	{
+		++m_calls;
+
+		return m_backend->CloseKey(hKey);
+	}
+
+	LSTATUS DeleteTree(HKEY hKey, const wchar_t* lpSubKey) override
+	{
+		++m_calls;
+
+		return m_backend->DeleteTree(hKey, lpSubKey);
+	}
+
+	LSTATUS DeleteValue(HKEY hKey, const wchar_t* lpValueName) override
+	{
+		++m_calls;
+
+		return m_backend->DeleteValue(hKey, lpValueName);
+	}
+
+	LSTATUS FlushKey(HKEY hKey) override
+	{
+		++m_calls;
+
+		return m_backend->FlushKey(hKey);
+	}
+
+	LSTATUS SaveKey(HKEY hKey, const wchar_t* lpFile) override
+	{
+		++m_calls;
+
+		return m_backend->SaveKey(hKey, lpFile);
+	}
+
+	LSTATUS QueryValue(HKEY hKey, const wchar_t* lpValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) override
+	{
+		++m_calls;
+
+		return m_backend->QueryValue(hKey, lpValueName, lpType, lpData, lpcbData);
+	}
+
+	LSTATUS QueryMultipleValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize) override
+	{
+		++m_calls;
+
+		return m_backend->QueryMultipleValues(hKey, val_list, num_vals, lpValueBuf, ldwTotsize);
+	}
+
+	LSTATUS QueryValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize, LSTATUS* lpStatuses) override
+	{
+		++m_calls;
+
+		return m_backend->QueryValues(hKey, val_list, num_vals, lpValueBuf, ldwTotsize, lpStatuses);
+	}
+
+	LSTATUS SetValue(HKEY hKey, const wchar_t* lpValueName, DWORD dwType, const BYTE* lpData, DWORD cbData) override
+	{
+		++m_calls;
+
+		return m_backend->SetValue(hKey, lpValueName, dwType, lpData, cbData);
+	}
+
+	LSTATUS QueryInfoKey(HKEY hKey, LPDWORD lpcSubKeys, LPDWORD lpcchMaxSubKeyLen, LPDWORD lpcValues, LPDWORD lpcchMaxValueNameLen, LPDWORD lpcbMaxValueLen, FILETIME* lpftLastWriteTime) override
+	{
+		++m_calls;
+
+		return m_backend->QueryInfoKey(hKey, lpcSubKeys, lpcchMaxSubKeyLen, lpcValues, lpcchMaxValueNameLen, lpcbMaxValueLen, lpftLastWriteTime);
+	}
+
+	LSTATUS EnumKey(HKEY hKey, DWORD dwIndex, wchar_t* lpName, LPDWORD lpcchName) override
+	{
+		++m_calls;
+
+		return m_backend->EnumKey(hKey, dwIndex, lpName, lpcchName);
+	}
+
+	LSTATUS EnumValue(HKEY hKey, DWORD dwIndex, wchar_t* lpValueName, LPDWORD lpcchValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) override
+	{
+		++m_calls;
+
+		return m_backend->EnumValue(hKey, dwIndex, lpValueName, lpcchValueName, lpType, lpData, lpcbData);
+	}
+
+	LSTATUS NotifyChangeKeyValue(HKEY hKey, bool watchSubtree, DWORD dwNotifyFilter, HANDLE hEvent, bool asynchronous) override
+	{
+		++m_calls;
+
+		return m_backend->NotifyChangeKeyValue(hKey, watchSubtree, dwNotifyFilter, hEvent, asynchronous);
+	}
+
+	LSTATUS ApplyBatch(HKEY hKey, const Registry::BatchOperation* pOperations, DWORD cOperations) override
+	{
+		++m_calls;
+
+		return m_backend->ApplyBatch(hKey, pOperations, cOperations);
+	}
+
+private:
+	Registry::RegistryBackend_ptr m_backend;
+	size_t m_calls;
+	size_t m_steps;
+};
+
+/// <summary>
+///		GetString() as it was implemented before, querying size first and reading data into heap buffer
+/// </summary>
+std::wstring LegacyGetString(const Registry::RegistryKey_ptr& key, const std::wstring& name)
+{
+	const auto& backend = key->GetBackend();
+
+	DWORD cbData = 0;
+	DWORD dwType = 0;
+
+	LSTATUS lStatus = backend->QueryValue(*key, name.c_str(), &dwType, nullptr, &cbData);
+	if (lStatus != ERROR_SUCCESS)
+	{
+		throw std::system_error(std::error_code(lStatus, std::system_category()), "RegQueryValueEx() failed");
+	}
+
+	std::wstring value;
+
+	if (cbData)
+	{
+		auto cchData = cbData / sizeof(wchar_t) + 1;
+
+		auto data = new wchar_t[cchData];
+
+		cbData = static_cast<DWORD>((cchData - 1) * sizeof(wchar_t));
+
+		lStatus = backend->QueryValue(*key, name.c_str(), &dwType, reinterpret_cast<LPBYTE>(data), &cbData);
+		if (lStatus == ERROR_SUCCESS)
+		{
+			data[cbData / sizeof(wchar_t)] = L'\0';
+
+			value = std::wstring(data);
+		}
+
+		delete[] data;
+	}
+
+	return value;
+}
+
+template <typename __Function>
+void Measure(const char* name, const std::shared_ptr<CountingBackend>& backend, size_t iterations, const __Function& fn)
+{
+	const auto calls = backend->Calls();
+	const size_t allocations = g_allocations;
+	const auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		fn();
+	}
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+	std::cout
+		<< std::left << std::setw(40) << name
+		<< std::right << std::fixed << std::setprecision(2)
+		<< std::setw(10) << static_cast<double>(backend->Calls() - calls) / iterations << " calls/op"
+		<< std::setw(10) << static_cast<double>(g_allocations - allocations) / iterations << " allocs/op"
+		<< std::setw(12) << static_cast<double>(elapsed.count()) / iterations << " ns/op"
+		<< std::endl;
+}
+
+void BenchmarkGetString(size_t iterations)
+{
+	auto backend = std::make_shared<CountingBackend>(std::make_shared<Registry::MemoryBackend>());
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+	auto key = root->Create(L"Benchmark", Registry::DesiredAccess::AllAccess);
+
+	const std::wstring shortValue = L"c:\\Program Files\\MyCompany\\MyApplication\\log.txt";
+	const std::wstring longValue(4096, L'x');
+
+	key->SetString(L"Short", shortValue);
+	key->SetString(L"Long", longValue);
+
+	// Names are constructed upfront, so conversion of literals does not count as allocation
+	const std::wstring shortName = L"Short";
+	const std::wstring longName = L"Long";
+
+	std::wstring value;
+
+	std::cout << "GetString()" << std::endl;
+
+	Measure("  short, before", backend, iterations, [&]() { value = LegacyGetString(key, shortName); });
+	assert(value == shortValue);
+	Measure("  short, returned string", backend, iterations, [&]() { value = key->GetString(shortName); });
+	assert(value == shortValue);
+	Measure("  short, reused string", backend, iterations, [&]() { key->GetString(shortName, value); });
+	assert(value == shortValue);
+
+	Measure("  long, before", backend, iterations, [&]() { value = LegacyGetString(key, longName); });
+	assert(value == longValue);
+	Measure("  long, returned string", backend, iterations, [&]() { value = key->GetString(longName); });
+	assert(value == longValue);
+	Measure("  long, reused string", backend, iterations, [&]() { key->GetString(longName, value); });
+	assert(value == longValue);
+}
+
+void BenchmarkOpen(size_t iterations)
+{
+	auto backend = std::make_shared<CountingBackend>(std::make_shared<Registry::MemoryBackend>());
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_LOCAL_MACHINE, backend);
+
+	root->Create(L"SOFTWARE\\Vendor\\Product\\Component");
+
+	Registry::KeyCache cache(16);
+
+	std::cout << "Open()" << std::endl;
+
+	// Paths are passed as literals, as usual callers do
+	Measure("  RegistryKey::Open", backend, iterations, [&]() { root->Open(L"SOFTWARE\\Vendor\\Product\\Component"); });
+	Measure("  KeyCache::Open", backend, iterations, [&]() { cache.Open(root, L"SOFTWARE\\Vendor\\Product\\Component"); });
+}
+
+void BenchmarkTryGet(size_t iterations)
+{
+	auto backend = std::make_shared<CountingBackend>(std::make_shared<Registry::MemoryBackend>());
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+	auto key = root->Create(L"Benchmark", Registry::DesiredAccess::AllAccess);
+
+	key->SetInt32(L"Present", 42);
+
+	const std::wstring presentName = L"Present";
+	const std::wstring missingName = L"Missing";
+	const std::wstring presentPath = L"Benchmark";
+	const std::wstring missingPath = L"Missing";
+
+	LONG value = 0;
+
+	auto getOrDefault = [&](const std::wstring& name) -> LONG
+	{
+		try
+		{
+			return key->GetInt32(name);
+		}
+		catch (const std::system_error&)
+		{
+			return 0;
+		}
+	};
+
+	auto openOrNull = [&](const std::wstring& path)
+	{
+		try
+		{
+			return root->Open(path);
+		}
+		catch (const std::system_error&)
+		{
+			return Registry::RegistryKey_ptr();
+		}
+	};
+
+	std::cout << "GetInt32() vs TryGetInt32()" << std::endl;
+
+	Measure("  hit, GetInt32", backend, iterations, [&]() { value = getOrDefault(presentName); });
+	assert(value == 42);
+	Measure("  hit, HasValue + GetInt32", backend, iterations, [&]() { value = key->HasValue(presentName) ? key->GetInt32(presentName) : 0; });
+	assert(value == 42);
+	Measure("  hit, TryGetInt32", backend, iterations, [&]() { value = key->TryGetInt32(presentName).value_or(0); });
+	assert(value == 42);
+
+	Measure("  miss, GetInt32", backend, iterations, [&]() { value = getOrDefault(missingName); });
+	assert(value == 0);
+	Measure("  miss, HasValue + GetInt32", backend, iterations, [&]() { value = key->HasValue(missingName) ? key->GetInt32(missingName) : 0; });
+	assert(value == 0);
+	Measure("  miss, TryGetInt32", backend, iterations, [&]() { value = key->TryGetInt32(missingName).value_or(0); });
+	assert(value == 0);
+
+	std::cout << "Open() vs TryOpen()" << std::endl;
+
+	Measure("  hit, Open", backend, iterations, [&]() { openOrNull(presentPath); });
+	Measure("  hit, TryOpen", backend, iterations, [&]() { root->TryOpen(presentPath); });
+	Measure("  miss, Open", backend, iterations, [&]() { openOrNull(missingPath); });
+	Measure("  miss, TryOpen", backend, iterations, [&]() { root->TryOpen(missingPath); });
+}
+
+/// <summary>
+///		Reads all values the way it had to be done without EnumerateValues(),
+///		enumerating names and querying size and data of each value separately
+/// </summary>
+size_t LegacyDumpValues(const Registry::RegistryKey_ptr& key)
+{
+	const auto& backend = key->GetBackend();
+
+	size_t cbTotal = 0;
+
+	for (DWORD i = 0; ; ++i)
+	{
+		wchar_t szName[256];
+		DWORD cchName = sizeof(szName) / sizeof(szName[0]);
+
+		if (backend->EnumValue(*key, i, szName, &cchName, nullptr, nullptr, nullptr) != ERROR_SUCCESS)
+		{
+			break;
+		}
+
+		DWORD cbData = 0;
+		DWORD dwType = 0;
+
+		backend->QueryValue(*key, szName, &dwType, nullptr, &cbData);
+
+		std::vector<BYTE> data(cbData);
+
+		backend->QueryValue(*key, szName, &dwType, data.data(), &cbData);
+
+		cbTotal += cbData;
+	}
+
+	return cbTotal;
+}
+
+void BenchmarkEnumerateValues(size_t iterations)
+{
+	auto backend = std::make_shared<CountingBackend>(std::make_shared<Registry::MemoryBackend>());
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+	auto key = root->Create(L"Benchmark", Registry::DesiredAccess::AllAccess);
+
+	const size_t count = 5000;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		key->SetString(L"License" + std::to_wstring(i), L"XXXXX-XXXXX-XXXXX-" + std::to_wstring(i));
+	}
+
+	size_t cbTotal = 0;
+
+	std::cout << "EnumerateValues(), " << count << " values" << std::endl;
+
+	Measure("  names + QueryValue", backend, iterations, [&]() { cbTotal = LegacyDumpValues(key); });
+
+	const auto cbExpected = cbTotal;
+
+	Measure("  EnumerateValues", backend, iterations, [&]()
+	{
+		cbTotal = 0;
+
+		key->EnumerateValues([&](std::wstring_view, DWORD, const BYTE*, DWORD cbData)
+		{
+			cbTotal += cbData;
+
+			return true;
+		});
+	});
+
+	assert(cbTotal == cbExpected);
+}
+
+/// <summary>
+///		Creates tree of subkeys with specified number of subkeys on each level
+/// </summary>
+size_t CreateTree(const Registry::RegistryKey_ptr& key, size_t fanout, size_t depth)
+{
+	size_t count = 0;
+
+	if (depth > 0)
+	{
+		for (size_t i = 0; i < fanout; ++i)
+		{
+			auto subKey = key->Create(L"Key" + std::to_wstring(i), Registry::DesiredAccess::AllAccess);
+
+			count += 1 + CreateTree(subKey, fanout, depth - 1);
+		}
+	}
+
+	return count;
+}
+
+void BenchmarkWalk()
+{
+	auto backend = std::make_shared<Registry::MemoryBackend>();
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_LOCAL_MACHINE, backend);
+	auto software = root->Create(L"SOFTWARE", Registry::DesiredAccess::AllAccess);
+
+	const auto count = CreateTree(software, 8, 5);
+
+	std::cout << "Walk(), " << count << " keys, " << std::thread::hardware_concurrency() << " cores" << std::endl;
+
+	for (size_t threads = 1; threads <= 8; threads *= 2)
+	{
+		Registry::WalkOptions options;
+		options.threads = threads;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		auto result = Registry::Walk(software, [](const std::wstring&, const Registry::RegistryKey_ptr&, size_t)
+		{
+			return Registry::WalkAction::Continue;
+		}, options);
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+		assert(result.visited == count);
+
+		std::cout
+			<< "  " << std::left << std::setw(38) << (std::to_string(threads) + " threads")
+			<< std::right << std::fixed << std::setprecision(2)
+			<< std::setw(10) << static_cast<double>(elapsed.count()) / 1000 << " ms"
+			<< std::setw(12) << static_cast<double>(count) * 1000000 / elapsed.count() << " keys/s"
+			<< std::endl;
+	}
+}
+
+void BenchmarkSnapshot(size_t iterations)
+{
+	auto backend = std::make_shared<CountingBackend>(std::make_shared<Registry::MemoryBackend>());
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+	auto software = root->Create(L"SOFTWARE", Registry::DesiredAccess::AllAccess);
+
+	const auto count = CreateTree(software, 8, 4);
+
+	software->Open(L"Key7\\Key7\\Key7", Registry::DesiredAccess::AllAccess)->SetInt32(L"Version", 42);
+
+	Registry::SnapshotWriter(software).Save(L"RegistryBenchmark.snap");
+
+	{
+		Registry::SnapshotFile snapshot(L"RegistryBenchmark.snap");
+
+		const std::wstring path = L"Key7\\Key7\\Key7";
+		const std::wstring name = L"Version";
+
+		LONG value = 0;
+
+		std::cout << "Open() + GetInt32(), " << count << " keys" << std::endl;
+
+		Measure("  RegistryKey", backend, iterations, [&]() { value = software->Open(path)->GetInt32(name); });
+		assert(value == 42);
+		Measure("  SnapshotKey", backend, iterations, [&]() { value = snapshot.Open(path).GetInt32(name); });
+		assert(value == 42);
+	}
+
+	std::remove("RegistryBenchmark.snap");
+}
+
+void BenchmarkRegFile()
+{
+	auto backend = std::make_shared<Registry::MemoryBackend>();
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+	auto software = root->Create(L"Software", Registry::DesiredAccess::AllAccess);
+
+	const size_t count = 20000;
+	const std::vector<BYTE> blob(64, 0xAB);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto key = software->Create(L"Key" + std::to_wstring(i), Registry::DesiredAccess::AllAccess);
+
+		key->SetString(L"Name", L"Product name " + std::to_wstring(i));
+		key->SetExpandString(L"Path", L"%ProgramFiles%\\Vendor\\Product" + std::to_wstring(i));
+		key->SetInt32(L"Version", static_cast<LONG>(i));
+		key->SetInt64(L"Installed", 810012361001236);
+		backend->SetValue(*key, L"Blob", REG_BINARY, blob.data(), static_cast<DWORD>(blob.size()));
+	}
+
+	std::cout << ".reg import / export, " << count << " keys" << std::endl;
+
+	for (auto format : { Registry::RegFileFormat::Regedit5, Registry::RegFileFormat::Regedit4 })
+	{
+		const auto name = (format == Registry::RegFileFormat::Regedit5) ? std::string("version 5.00") : std::string("REGEDIT4");
+
+		std::ostringstream out;
+
+		auto start = std::chrono::steady_clock::now();
+
+		Registry::RegFileExporter(out, format).Export(software, L"HKEY_CURRENT_USER\\Software");
+
+		auto exportTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+		const auto& data = out.str();
+
+		auto target = std::make_shared<Registry::MemoryBackend>();
+
+		std::istringstream in(data);
+
+		start = std::chrono::steady_clock::now();
+
+		auto result = Registry::RegFileImporter(target).Import(in);
+
+		auto importTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+		assert(result.keys == count + 1 && result.values == count * 5);
+
+		const double mb = static_cast<double>(data.size()) / (1024 * 1024);
+
+		std::cout
+			<< "  " << std::left << std::setw(38) << ("export, " + name)
+			<< std::right << std::fixed << std::setprecision(2)
+			<< std::setw(10) << static_cast<double>(exportTime.count()) / 1000 << " ms"
+			<< std::setw(12) << mb * 1000000 / exportTime.count() << " MB/s"
+			<< std::endl;
+
+		std::cout
+			<< "  " << std::left << std::setw(38) << ("import, " + name)
+			<< std::right << std::fixed << std::setprecision(2)
+			<< std::setw(10) << static_cast<double>(importTime.count()) / 1000 << " ms"
+			<< std::setw(12) << mb * 1000000 / importTime.count() << " MB/s"
+			<< std::endl;
+	}
+}
+
+// Creates tree with same values in every key, returns number of values created
+size_t CreateValueTree(const Registry::RegistryKey_ptr& key, size_t fanout, size_t depth, size_t values)
+{
+	size_t count = values;
+
+	for (size_t i = 0; i < values; ++i)
+	{
+		key->SetString(L"Value" + std::to_wstring(i), L"Some value data " + std::to_wstring(i));
+	}
+
+	if (depth > 0)
+	{
+		for (size_t i = 0; i < fanout; ++i)
+		{
+			count += CreateValueTree(key->Create(L"Key" + std::to_wstring(i), Registry::DesiredAccess::AllAccess), fanout, depth - 1, values);
+		}
+	}
+
+	return count;
+}
+
+template <typename __First, typename __Second>
+void MeasureDiff(const char* name, const __First& first, const __Second& second, size_t expected, const Registry::DiffOptions& options = Registry::DiffOptions())
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	auto result = Registry::Diff(first, second, [](const Registry::DiffEntry&) { return true; }, options);
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+	assert(result.differences == expected);
+
+	std::cout
+		<< "  " << std::left << std::setw(38) << name
+		<< std::right << std::fixed << std::setprecision(2)
+		<< std::setw(10) << static_cast<double>(elapsed.count()) / 1000 << " ms"
+		<< std::setw(12) << result.keys << " keys"
+		<< std::setw(12) << result.skipped << " skipped"
+		<< std::endl;
+}
+
+void BenchmarkDiff()
+{
+	auto first = std::make_shared<Registry::RegistryKey>(HKEY_LOCAL_MACHINE, std::make_shared<Registry::MemoryBackend>());
+	auto second = std::make_shared<Registry::RegistryKey>(HKEY_LOCAL_MACHINE, std::make_shared<Registry::MemoryBackend>());
+
+	const auto values = CreateValueTree(first, 8, 5, 10);
+	CreateValueTree(second, 8, 5, 10);
+
+	second->Open(L"Key1\\Key2\\Key3", Registry::DesiredAccess::AllAccess)->SetString(L"Value0", L"Changed");
+	second->Open(L"Key7\\Key7\\Key7\\Key7\\Key7", Registry::DesiredAccess::AllAccess)->Delete(L"Value9");
+	second->Open(L"Key4", Registry::DesiredAccess::AllAccess)->Create(L"Added", Registry::DesiredAccess::AllAccess);
+
+	Registry::SnapshotWriter(first).Save(L"RegistryBenchmark1.snap");
+	Registry::SnapshotWriter(second).Save(L"RegistryBenchmark2.snap");
+
+	{
+		Registry::SnapshotFile firstSnapshot(L"RegistryBenchmark1.snap");
+		Registry::SnapshotFile secondSnapshot(L"RegistryBenchmark2.snap");
+
+		Registry::DiffOptions trusted;
+		trusted.trustLastWriteTime = true;
+
+		std::cout << "Diff(), " << values << " values, 3 differences" << std::endl;
+
+		MeasureDiff("RegistryKey / RegistryKey", first, second, 3);
+		MeasureDiff("RegistryKey / SnapshotKey", first, secondSnapshot.Root(), 3);
+		MeasureDiff("SnapshotKey / SnapshotKey", firstSnapshot.Root(), secondSnapshot.Root(), 3);
+		MeasureDiff("RegistryKey / own snapshot, trusted", first, firstSnapshot.Root(), 0, trusted);
+	}
+
+	std::remove("RegistryBenchmark1.snap");
+	std::remove("RegistryBenchmark2.snap");
+}
+
+template <typename __Function>
+void MeasureOps(const std::string& name, size_t ops, const char* unit, const __Function& function)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	function();
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+	std::cout
+		<< "  " << std::left << std::setw(38) << name
+		<< std::right << std::fixed << std::setprecision(2)
+		<< std::setw(10) << static_cast<double>(elapsed.count()) / 1000 << " ms"
+		<< std::setw(12) << static_cast<double>(ops) * 1000000 / elapsed.count() << " " << unit << "/s"
+		<< std::endl;
+}
+
+template <typename __Function>
+void MeasureWrites(const std::string& name, size_t writes, const __Function& function)
+{
+	MeasureOps(name, writes, "writes", function);
+}
+
+void BenchmarkWriteBatch()
+{
+	auto backend = std::make_shared<Registry::MemoryBackend>();
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+	auto key = root->Create(L"SOFTWARE\\Batch", Registry::DesiredAccess::AllAccess);
+
+	const size_t writes = 200000;
+
+	std::vector<std::wstring> names;
+
+	for (size_t i = 0; i < 100; ++i)
+	{
+		names.push_back(L"Value" + std::to_wstring(i));
+	}
+
+	// Subscriber makes every change visible, as native registry notifies watchers of each write
+	DWORD dwCookie = 0;
+	size_t notifications = 0;
+
+	backend->Subscribe(*key, true, REG_NOTIFY_CHANGE_LAST_SET, [&notifications]() { ++notifications; }, &dwCookie);
+
+	std::cout << "SetInt32() vs WriteBatch::Commit(), " << writes << " writes" << std::endl;
+
+	MeasureWrites("per-op writes", writes, [&]()
+	{
+		for (size_t i = 0; i < writes; ++i)
+		{
+			key->SetInt32(names[i % names.size()], static_cast<LONG>(i));
+		}
+	});
+
+	for (size_t size = 10; size <= 1000; size *= 10)
+	{
+		MeasureWrites("batches of " + std::to_string(size), writes, [&]()
+		{
+			Registry::WriteBatch batch;
+
+			for (size_t i = 0; i < writes; i += size)
+			{
+				batch.Clear();
+
+				for (size_t j = i; j < i + size; ++j)
+				{
+					batch.SetInt32(L"", names[j % names.size()], static_cast<LONG>(j));
+				}
+
+				batch.Commit(key);
+			}
+		});
+	}
+
+	backend->Unsubscribe(dwCookie);
+}
+
+void BenchmarkWatchHub()
+{
+	auto backend = std::make_shared<Registry::MemoryBackend>();
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+	auto parent = root->Create(L"SOFTWARE\\Watched", Registry::DesiredAccess::AllAccess);
+
+	const size_t watches = 100000;
+
+	std::vector<Registry::RegistryKey_ptr> keys;
+
+	for (size_t i = 0; i < watches; ++i)
+	{
+		keys.push_back(parent->Create(L"Key" + std::to_wstring(i), Registry::DesiredAccess::AllAccess));
+	}
+
+	auto pool = std::make_shared<Registry::ThreadPoolExecutor>(4);
+
+	std::atomic<size_t> dispatched(0);
+
+	Registry::WatchHub hub(pool);
+
+	std::cout << "WatchHub, " << watches << " watched keys, 4 dispatch threads" << std::endl;
+
+	MeasureOps("add watches", watches, "watches", [&]()
+	{
+		for (auto& key : keys)
+		{
+			hub.Add(key, [&dispatched](bool) { ++dispatched; });
+		}
+	});
+
+	// Each change is matched only against watches of changed key and its parents
+	MeasureWrites("change every key, until dispatched", watches, [&]()
+	{
+		for (size_t i = 0; i < watches; ++i)
+		{
+			keys[i]->SetInt32(L"Value", static_cast<LONG>(i));
+		}
+
+		while (dispatched < watches)
+		{
+			std::this_thread::yield();
+		}
+	});
+
+	// Bursts of changes of same key are coalesced into single dispatch
+	dispatched = 0;
+
+	MeasureWrites("10 changes of 1000 keys, coalesced", 10 * 1000, [&]()
+	{
+		for (LONG round = 0; round < 10; ++round)
+		{
+			for (size_t i = 0; i < 1000; ++i)
+			{
+				keys[i]->SetInt32(L"Value", round);
+			}
+		}
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	std::cout << "  " << dispatched << " dispatches of 10000 changes" << std::endl;
+
+	MeasureOps("remove watches", watches, "watches", [&]()
+	{
+		hub.Clear();
+	});
+}
+
+struct BenchmarkSettings
+{
+	bool enabled;
+	LONG timeout;
+	LONG retries;
+	DWORD flags;
+	long long offset;
+	unsigned long long quota;
+	std::wstring server;
+	std::wstring logPath;
+};
+
+template <>
+struct Registry::ConfigSchema<BenchmarkSettings>
+{
+	static constexpr auto schema = Registry::Schema
+	(
+		L"SOFTWARE\\Vendor\\Product",
+		Registry::Field(L"Enabled", &BenchmarkSettings::enabled, true),
+		Registry::Field(L"Timeout", &BenchmarkSettings::timeout, 30),
+		Registry::Field(L"Retries", &BenchmarkSettings::retries, 3),
+		Registry::Field(L"Flags", &BenchmarkSettings::flags),
+		Registry::Field(L"Offset", &BenchmarkSettings::offset),
+		Registry::Field(L"Quota", &BenchmarkSettings::quota),
+		Registry::Field(L"Server", &BenchmarkSettings::server, L"localhost"),
+		Registry::Field(L"LogPath", &BenchmarkSettings::logPath)
+	);
+};
+
+void BenchmarkConfigSchema(size_t iterations)
+{
+	auto backend = std::make_shared<CountingBackend>(std::make_shared<Registry::MemoryBackend>());
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+
+	BenchmarkSettings settings;
+	settings.enabled = true;
+	settings.timeout = 60;
+	settings.retries = 5;
+	settings.flags = 0x11;
+	settings.offset = -1;
+	settings.quota = 1ull << 40;
+	settings.server = L"server.example.com";
+	settings.logPath = L"c:\\Program Files\\MyCompany\\MyApplication\\log.txt";
+
+	Registry::Store(root, settings);
+
+	std::cout << "Loading struct of 8 values" << std::endl;
+
+	Measure("  hand-written Get*() calls", backend, iterations, [&]()
+	{
+		auto key = root->Open(L"SOFTWARE\\Vendor\\Product");
+
+		settings.enabled = key->GetBoolean(L"Enabled");
+		settings.timeout = key->GetInt32(L"Timeout");
+		settings.retries = key->GetInt32(L"Retries");
+		settings.flags = key->GetUInt32(L"Flags");
+		settings.offset = key->GetInt64(L"Offset");
+		settings.quota = key->GetUInt64(L"Quota");
+		settings.server = key->GetString(L"Server");
+		settings.logPath = key->GetString(L"LogPath");
+	});
+
+	Measure("  Registry::Load()", backend, iterations, [&]() { Registry::Load(root, settings); });
+	assert(settings.server == L"server.example.com");
+
+	Measure("  hand-written Set*() calls", backend, iterations, [&]()
+	{
+		auto key = root->Create(L"SOFTWARE\\Vendor\\Product", Registry::DesiredAccess::AllAccess);
+
+		key->SetBoolean(L"Enabled", settings.enabled);
+		key->SetInt32(L"Timeout", settings.timeout);
+		key->SetInt32(L"Retries", settings.retries);
+		key->SetUInt32(L"Flags", settings.flags);
+		key->SetInt64(L"Offset", settings.offset);
+		key->SetUInt64(L"Quota", settings.quota);
+		key->SetString(L"Server", settings.server);
+		key->SetString(L"LogPath", settings.logPath);
+	});
+
+	Measure("  Registry::Store()", backend, iterations, [&]() { Registry::Store(root, settings); });
+
+	// Missing values are reported by same single query, not read again one by one
+	{
+		auto key = root->Open(L"SOFTWARE\\Vendor\\Product", Registry::DesiredAccess::AllAccess);
+
+		key->Delete(L"Timeout");
+		key->Delete(L"LogPath");
+	}
+
+	std::cout << "Loading struct of 8 values, 2 of them missing" << std::endl;
+
+	Measure("  Registry::Load()", backend, iterations, [&]() { Registry::Load(root, settings); });
+	assert(settings.timeout == 30 && settings.server == L"server.example.com");
+}
+
+void BenchmarkBinary(size_t iterations)
+{
+	auto backend = std::make_shared<CountingBackend>(std::make_shared<Registry::MemoryBackend>());
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+	auto key = root->Create(L"Benchmark", Registry::DesiredAccess::AllAccess);
+
+	const std::wstring name = L"Certificate";
+
+	std::vector<std::byte> blob(1024 * 1024, std::byte(0x5A));
+
+	key->SetBinary(name, blob);
+
+	std::vector<std::byte> data;
+	std::vector<std::byte> buffer(blob.size());
+
+	std::cout << "GetBinary(), 1MB value" << std::endl;
+
+	Measure("  size probe, read, copy", backend, iterations, [&]()
+	{
+		DWORD dwType = 0;
+		DWORD cbData = 0;
+
+		backend->QueryValue(*key, name.c_str(), &dwType, nullptr, &cbData);
+
+		std::unique_ptr<BYTE[]> temp(new BYTE[cbData]);
+
+		backend->QueryValue(*key, name.c_str(), &dwType, temp.get(), &cbData);
+
+		data.assign(reinterpret_cast<const std::byte*>(temp.get()), reinterpret_cast<const std::byte*>(temp.get()) + cbData);
+	});
+
+	Measure("  returned vector", backend, iterations, [&]() { data = key->GetBinary(name); });
+	Measure("  reused vector", backend, iterations, [&]() { key->GetBinary(name, data); });
+	assert(data == blob);
+	Measure("  caller owned span", backend, iterations, [&]() { key->GetBinary(name, std::span<std::byte>(buffer)); });
+	assert(buffer == blob);
+
+	Measure("  SetBinary()", backend, iterations, [&]() { key->SetBinary(name, blob); });
+}
+
+void BenchmarkMultiString(size_t iterations)
+{
+	auto backend = std::make_shared<CountingBackend>(std::make_shared<Registry::MemoryBackend>());
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+	auto key = root->Create(L"Benchmark", Registry::DesiredAccess::AllAccess);
+
+	const std::wstring name = L"SearchPaths";
+
+	std::vector<std::wstring> paths;
+
+	for (size_t i = 0; i < 1000; ++i)
+	{
+		paths.push_back(L"C:\\Program Files\\MyCompany\\Plugins\\Plugin" + std::to_wstring(i));
+	}
+
+	key->SetMultiString(name, paths);
+
+	size_t total = 0;
+
+	Registry::MultiString value;
+	std::vector<std::wstring> strings;
+
+	std::cout << "GetMultiString(), 1000 strings" << std::endl;
+
+	Measure("  vector<wstring> per read", backend, iterations, [&]()
+	{
+		DWORD dwType = 0;
+		DWORD cbData = 0;
+
+		backend->QueryValue(*key, name.c_str(), &dwType, nullptr, &cbData);
+
+		std::wstring data(cbData / sizeof(wchar_t), L'\0');
+
+		backend->QueryValue(*key, name.c_str(), &dwType, reinterpret_cast<LPBYTE>(&data[0]), &cbData);
+
+		strings.clear();
+
+		for (size_t pos = 0; pos < data.length() && data[pos] != L'\0'; pos = data.find(L'\0', pos) + 1)
+		{
+			strings.emplace_back(data.c_str() + pos);
+		}
+
+		total += strings.size();
+	});
+
+	Measure("  returned view", backend, iterations, [&]() { total += key->GetMultiString(name).Count(); });
+
+	Measure("  reused view", backend, iterations, [&]()
+	{
+		key->GetMultiString(name, value);
+
+		for (auto path : value)
+		{
+			total += path.length();
+		}
+	});
+
+	assert(total != 0);
+
+	Measure("  SetMultiString()", backend, iterations, [&]() { key->SetMultiString(name, paths); });
+}
+
+template <typename __Function>
+void MeasureOpens(const char* name, const std::shared_ptr<CountingBackend>& backend, size_t rounds, size_t opens, const __Function& fn)
+{
+	const auto calls = backend->Calls();
+	const auto steps = backend->Steps();
+	const auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < rounds; ++i)
+	{
+		fn();
+	}
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+	const auto total = static_cast<double>(rounds * opens);
+
+	std::cout
+		<< std::left << std::setw(40) << name
+		<< std::right << std::fixed << std::setprecision(2)
+		<< std::setw(10) << static_cast<double>(backend->Calls() - calls) / total << " calls/op"
+		<< std::setw(10) << static_cast<double>(backend->Steps() - steps) / total << " steps/op"
+		<< std::setw(12) << static_cast<double>(elapsed.count()) / total << " ns/op"
+		<< std::endl;
+}
+
+void BenchmarkPathTrie(size_t rounds)
+{
+	auto backend = std::make_shared<CountingBackend>(std::make_shared<Registry::MemoryBackend>());
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_LOCAL_MACHINE, backend);
+
+	const std::wstring prefix = L"SOFTWARE\\Vendor\\Product\\Components\\Plugins\\Installed\\";
+
+	std::vector<std::wstring> paths;
+
+	for (size_t i = 0; i < 1000; ++i)
+	{
+		paths.push_back(prefix + L"Plugin" + std::to_wstring(i));
+
+		root->Create(paths.back());
+	}
+
+	std::cout << "Opening 1000 siblings 7 levels deep" << std::endl;
+
+	MeasureOpens("  RegistryKey::Open", backend, rounds, paths.size(), [&]()
+	{
+		for (const auto& path : paths)
+		{
+			root->Open(path);
+		}
+	});
+
+	MeasureOpens("  PathTrie::Open, cold", backend, rounds, paths.size(), [&]()
+	{
+		Registry::PathTrie trie(root);
+
+		for (const auto& path : paths)
+		{
+			trie.Open(path);
+		}
+	});
+
+	MeasureOpens("  PathTrie::OpenMany, cold", backend, rounds, paths.size(), [&]()
+	{
+		Registry::PathTrie trie(root);
+
+		trie.OpenMany(paths);
+	});
+
+	Registry::PathTrie trie(root);
+
+	trie.OpenMany(paths);
+
+	MeasureOpens("  PathTrie::Open, warm", backend, rounds, paths.size(), [&]()
+	{
+		for (const auto& path : paths)
+		{
+			trie.Open(path);
+		}
+	});
+}
+
+template <typename __Function>
+double MeasureSeconds(const __Function& fn)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	fn();
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BenchmarkHiveWriter(size_t keys, size_t valuesPerKey)
+{
+	auto backend = std::make_shared<CountingBackend>(std::make_shared<Registry::MemoryBackend>());
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+
+	const std::wstring text = L"c:\\Program Files\\MyCompany\\MyApplication\\log.txt";
+
+	// Keys are spread over 100 parents, values alternate between numbers and strings
+	for (size_t i = 0; i < keys; ++i)
+	{
+		auto key = root->Create(L"Group" + std::to_wstring(i % 100) + L"\\Key" + std::to_wstring(i), Registry::DesiredAccess::AllAccess);
+
+		for (size_t j = 0; j < valuesPerKey; ++j)
+		{
+			if (j % 2 == 0)
+			{
+				key->SetInt32(L"Value" + std::to_wstring(j), static_cast<LONG>(j));
+			}
+			else
+			{
+				key->SetString(L"Value" + std::to_wstring(j), text);
+			}
+		}
+	}
+
+	const size_t values = keys * valuesPerKey;
+
+	std::cout << "HiveWriter, " << keys << " keys, " << values << " values" << std::endl;
+
+	std::unique_ptr<Registry::HiveWriter> writer;
+
+	const double collect = MeasureSeconds([&]() { writer = std::make_unique<Registry::HiveWriter>(root); });
+	const double write = MeasureSeconds([&]() { writer->Save(L"RegistryBenchmark.hiv"); });
+
+	const auto megabytes = static_cast<double>(writer->Size()) / (1024 * 1024);
+
+	std::cout
+		<< std::right << std::fixed << std::setprecision(2)
+		<< "  " << std::left << std::setw(38) << "read tree and lay out" << std::right
+		<< std::setw(10) << collect * 1000 << " ms" << std::setw(12) << values / collect / 1000000 << " M values/s" << std::endl
+		<< "  " << std::left << std::setw(38) << "write hive" << std::right
+		<< std::setw(10) << write * 1000 << " ms" << std::setw(12) << megabytes / write << " MB/s, " << megabytes << " MB" << std::endl;
+
+	{
+		Registry::HiveFile hive(L"RegistryBenchmark.hiv");
+
+		const std::wstring path = L"Group7\\Key" + std::to_wstring(keys / 2 + 7);
+		const std::wstring name = L"Value0";
+
+		LONG value = -1;
+
+		Measure("  HiveKey Open() + GetInt32()", backend, 200000, [&]() { value = hive.Open(path).GetInt32(name); });
+		assert(value == 0);
+	}
+
+	std::remove("RegistryBenchmark.hiv");
+}
+
+// Reads values from specified number of threads for given time, optionally while another thread keeps writing
+template <typename __Backend>
+double MeasureReads(size_t threads, bool writing, std::chrono::milliseconds duration)
+{
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, std::make_shared<__Backend>());
+	auto key = root->Create(L"SOFTWARE\\Settings", Registry::DesiredAccess::AllAccess);
+
+	std::vector<std::wstring> names;
+
+	for (size_t i = 0; i < 16; ++i)
+	{
+		names.push_back(L"Value" + std::to_wstring(i));
+		key->SetInt32(names.back(), static_cast<LONG>(i));
+	}
+
+	std::atomic<bool> started(false);
+	std::atomic<bool> done(false);
+	std::atomic<size_t> reads(0);
+	std::vector<std::thread> readers;
+
+	for (size_t i = 0; i < threads; ++i)
+	{
+		readers.emplace_back([&, i]()
+		{
+			while (!started)
+			{
+				std::this_thread::yield();
+			}
+
+			size_t count = 0;
+			LONG value = -1;
+
+			for (size_t j = i; !done; ++j)
+			{
+				value = key->GetInt32(names[j % names.size()]);
+				++count;
+			}
+
+			assert(count == 0 || value >= 0);
+
+			reads += count;
+		});
+	}
+
+	// Writer changes configuration up to ten thousand times per second
+	std::thread writer([&]()
+	{
+		while (!started)
+		{
+			std::this_thread::yield();
+		}
+
+		for (LONG i = 0; writing && !done; ++i)
+		{
+			key->SetInt32(names[static_cast<size_t>(i) % names.size()], i % 1000);
+
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	});
+
+	const auto start = std::chrono::steady_clock::now();
+
+	started = true;
+
+	std::this_thread::sleep_for(duration);
+
+	done = true;
+
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+
+	writer.join();
+
+	return static_cast<double>(reads) / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BenchmarkReadScaling(std::chrono::milliseconds duration)
+{
+	const size_t cores = (std::max)(std::thread::hardware_concurrency(), 1U);
+
+	std::cout << "GetInt32() from concurrent threads, MemoryBackend vs VersionedBackend, millions of reads/s" << std::endl;
+
+	std::cout
+		<< "  " << std::left << std::setw(10) << "threads"
+		<< std::right << std::setw(14) << "memory" << std::setw(14) << "versioned"
+		<< std::setw(18) << "memory+writer" << std::setw(18) << "versioned+writer"
+		<< std::endl;
+
+	for (size_t threads = 1; ; threads *= 2)
+	{
+		threads = (std::min)(threads, cores);
+
+		std::cout
+			<< "  " << std::left << std::setw(10) << threads
+			<< std::right << std::fixed << std::setprecision(2)
+			<< std::setw(14) << MeasureReads<Registry::MemoryBackend>(threads, false, duration) / 1000000
+			<< std::setw(14) << MeasureReads<Registry::VersionedBackend>(threads, false, duration) / 1000000
+			<< std::setw(18) << MeasureReads<Registry::MemoryBackend>(threads, true, duration) / 1000000
+			<< std::setw(18) << MeasureReads<Registry::VersionedBackend>(threads, true, duration) / 1000000
+			<< std::endl;
+
+		if (threads == cores)
+		{
+			break;
+		}
+	}
+}
+
+/// <summary>
+///		Result of single hot path benchmark, written to JSON output for trend tracking
+/// </summary>
+struct HotPathResult
+{
+	std::string backend;
+	std::string name;
+	size_t iterations;
+	size_t repetitions;
+	double medianNanoseconds;
+	double minNanoseconds;
+	double maxNanoseconds;
+	double callsPerOperation;
+	double allocationsPerOperation;
+};
+
+/// <summary>
+///		Runs hot path benchmarks with fixed data and iteration counts, so results of two runs are comparable
+/// </summary>
+class HotPathSuite
+{
+public:
+	// Each benchmark is timed this many times, median is reported, so single preemption does not skew result
+	static constexpr size_t Repetitions = 7;
+
+	HotPathSuite(const char* backendName, const std::shared_ptr<CountingBackend>& backend, size_t iterations, std::vector<HotPathResult>& results)
+		: m_backendName(backendName)
+		, m_backend(backend)
+		, m_iterations(iterations)
+		, m_results(results)
+	{
+	}
+
+	/// <summary>
+	///		Times whole loop of calls, used for operations much longer than reading clock
+	/// </summary>
+	template <typename __Function>
+	void Measure(const char* name, size_t iterations, const __Function& fn)
+	{
+		iterations = (std::max)(iterations, static_cast<size_t>(1));
+
+		Run(name, iterations, [&](Sample& sample)
+		{
+			const auto calls = m_backend->Calls();
+			const size_t allocations = g_allocations;
+			const auto start = std::chrono::steady_clock::now();
+
+			for (size_t i = 0; i < iterations; ++i)
+			{
+				fn();
+			}
+
+			sample.elapsed += std::chrono::steady_clock::now() - start;
+			sample.calls += m_backend->Calls() - calls;
+			sample.allocations += g_allocations - allocations;
+		});
+	}
+
+	/// <summary>
+	///		Calls setup before each call, only calls itself are timed and counted
+	/// </summary>
+	template <typename __Setup, typename __Function>
+	void Measure(const char* name, size_t iterations, const __Setup& setup, const __Function& fn)
+	{
+		iterations = (std::max)(iterations, static_cast<size_t>(1));
+
+		Run(name, iterations, [&](Sample& sample)
+		{
+			for (size_t i = 0; i < iterations; ++i)
+			{
+				setup();
+
+				const auto calls = m_backend->Calls();
+				const size_t allocations = g_allocations;
+				const auto start = std::chrono::steady_clock::now();
+
+				fn();
+
+				sample.elapsed += std::chrono::steady_clock::now() - start;
+				sample.calls += m_backend->Calls() - calls;
+				sample.allocations += g_allocations - allocations;
+			}
+		});
+	}
+
+	void Run(const Registry::RegistryKey_ptr& parent)
+	{
+		auto key = parent->Create(L"HotPaths", Registry::DesiredAccess::AllAccess);
+
+		std::cout << "Hot paths, " << m_backendName << " backend" << std::endl;
+
+		MeasureKeys(key);
+		MeasureValues(key);
+		MeasureEnumerateSubKeys(key);
+		MeasureDelete(key);
+
+		key->Delete();
+	}
+
+private:
+	struct Sample
+	{
+		std::chrono::steady_clock::duration elapsed{ 0 };
+		size_t calls = 0;
+		size_t allocations = 0;
+	};
+
+	template <typename __Loop>
+	void Run(const char* name, size_t iterations, const __Loop& loop)
+	{
+		// Warm up caches and allocator before first measurement
+		{
+			Sample warmup;
+
+			loop(warmup);
+		}
+
+		Sample total;
+
+		std::vector<double> samples;
+
+		for (size_t i = 0; i < Repetitions; ++i)
+		{
+			Sample sample;
+
+			loop(sample);
+
+			const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(sample.elapsed);
+
+			samples.push_back(static_cast<double>(elapsed.count()) / iterations);
+
+			total.calls += sample.calls;
+			total.allocations += sample.allocations;
+		}
+
+		std::sort(samples.begin(), samples.end());
+
+		const auto operations = static_cast<double>(iterations * Repetitions);
+
+		HotPathResult result;
+
+		result.backend = m_backendName;
+		result.name = name;
+		result.iterations = iterations;
+		result.repetitions = Repetitions;
+		result.medianNanoseconds = samples[Repetitions / 2];
+		result.minNanoseconds = samples.front();
+		result.maxNanoseconds = samples.back();
+		result.callsPerOperation = static_cast<double>(total.calls) / operations;
+		result.allocationsPerOperation = static_cast<double>(total.allocations) / operations;
+
+		std::cout
+			<< "  " << std::left << std::setw(38) << name
+			<< std::right << std::fixed << std::setprecision(2)
+			<< std::setw(10) << result.callsPerOperation << " calls/op"
+			<< std::setw(10) << result.allocationsPerOperation << " allocs/op"
+			<< std::setw(12) << result.medianNanoseconds << " ns/op"
+			<< std::setw(12) << result.minNanoseconds << " ns/op min"
+			<< std::endl;
+
+		m_results.push_back(std::move(result));
+	}
+
+	void MeasureKeys(const Registry::RegistryKey_ptr& key)
+	{
+		const std::wstring path = L"Vendor\\Product\\Component";
+		const std::wstring missing = L"Vendor\\Product\\Missing";
+
+		key->Create(path);
+
+		Measure("Open()", m_iterations, [&]() { key->Open(path); });
+		Measure("TryOpen(), missing", m_iterations, [&]() { key->TryOpen(missing); });
+		Measure("Create(), existing", m_iterations, [&]() { key->Create(path); });
+
+		// New keys are created below single parent, which is deleted afterwards
+		{
+			auto created = key->Create(L"Created", Registry::DesiredAccess::AllAccess);
+
+			const size_t count = (m_iterations / 10) * (Repetitions + 1) + 1;
+
+			std::vector<std::wstring> names;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				names.push_back(L"Key" + std::to_wstring(i));
+			}
+
+			size_t next = 0;
+
+			Measure("Create(), new", m_iterations / 10, [&]() { created->Create(names[next++]); });
+
+			created->Delete();
+		}
+
+		Measure("HasKey()", m_iterations, [&]() { key->HasKey(path); });
+		Measure("HasKey(), missing", m_iterations, [&]() { key->HasKey(missing); });
+	}
+
+	void MeasureValues(const Registry::RegistryKey_ptr& key)
+	{
+		auto values = key->Create(L"Values", Registry::DesiredAccess::AllAccess);
+
+		// Names are constructed upfront, so conversion of literals does not count as allocation
+		const std::wstring boolean = L"Boolean";
+		const std::wstring int32 = L"Int32";
+		const std::wstring uint32 = L"UInt32";
+		const std::wstring int64 = L"Int64";
+		const std::wstring uint64 = L"UInt64";
+		const std::wstring string = L"String";
+		const std::wstring expandString = L"ExpandString";
+		const std::wstring multiString = L"MultiString";
+		const std::wstring binary = L"Binary";
+		const std::wstring missing = L"Missing";
+
+		const std::wstring text = L"c:\\Program Files\\MyCompany\\MyApplication\\log.txt";
+		const std::wstring expandText = L"%ProgramFiles%\\MyCompany\\MyApplication\\log.txt";
+		const std::vector<std::wstring> strings = { L"c:\\Windows", L"c:\\Windows\\System32", L"c:\\Program Files" };
+		const std::vector<std::byte> data(1024, std::byte{ 0x5a });
+
+		Measure("SetBoolean()", m_iterations, [&]() { values->SetBoolean(boolean, true); });
+		Measure("SetInt32()", m_iterations, [&]() { values->SetInt32(int32, -42); });
+		Measure("SetUInt32()", m_iterations, [&]() { values->SetUInt32(uint32, 42); });
+		Measure("SetInt64()", m_iterations, [&]() { values->SetInt64(int64, -42); });
+		Measure("SetUInt64()", m_iterations, [&]() { values->SetUInt64(uint64, 42); });
+		Measure("SetString()", m_iterations, [&]() { values->SetString(string, text); });
+		Measure("SetExpandString()", m_iterations, [&]() { values->SetExpandString(expandString, expandText); });
+		Measure("SetMultiString()", m_iterations, [&]() { values->SetMultiString(multiString, strings); });
+		Measure("SetBinary(), 1 KB", m_iterations, [&]() { values->SetBinary(binary, data); });
+
+		std::wstring value;
+		Registry::MultiString multiValue;
+		std::vector<std::byte> buffer(data.size());
+
+		Measure("GetBoolean()", m_iterations, [&]() { values->GetBoolean(boolean); });
+		Measure("GetInt32()", m_iterations, [&]() { values->GetInt32(int32); });
+		Measure("GetUInt32()", m_iterations, [&]() { values->GetUInt32(uint32); });
+		Measure("GetInt64()", m_iterations, [&]() { values->GetInt64(int64); });
+		Measure("GetUInt64()", m_iterations, [&]() { values->GetUInt64(uint64); });
+		Measure("GetString(), reused string", m_iterations, [&]() { values->GetString(string, value); });
+		assert(value == text);
+		Measure("GetString(), expandable", m_iterations, [&]() { values->GetString(expandString, value); });
+		assert(value == expandText);
+		Measure("GetMultiString(), reused view", m_iterations, [&]() { values->GetMultiString(multiString, multiValue); });
+		assert(multiValue.Count() == strings.size());
+		Measure("GetBinary(), 1 KB span", m_iterations, [&]() { values->GetBinary(binary, buffer); });
+
+		Measure("HasValue()", m_iterations, [&]() { values->HasValue(int32); });
+		Measure("HasValue(), missing", m_iterations, [&]() { values->HasValue(missing); });
+	}
+
+	void MeasureEnumerateSubKeys(const Registry::RegistryKey_ptr& key)
+	{
+		for (size_t fanout : { 10, 100, 1000 })
+		{
+			auto parent = key->Create(L"Fanout" + std::to_wstring(fanout), Registry::DesiredAccess::AllAccess);
+
+			CreateTree(parent, fanout, 1);
+
+			const auto name = "EnumerateSubKeys(), " + std::to_string(fanout) + " subkeys";
+
+			size_t count = 0;
+
+			Measure(name.c_str(), m_iterations * 10 / fanout, [&]()
+			{
+				parent->EnumerateSubKeys([&count](const std::wstring&) -> bool
+				{
+					++count;
+
+					return true;
+				});
+			});
+
+			assert(count % fanout == 0);
+
+			parent->Delete();
+		}
+	}
+
+	void MeasureDelete(const Registry::RegistryKey_ptr& key)
+	{
+		const std::wstring name = L"Tree";
+
+		const auto deleteTree = [&]() { key->Delete(name); };
+
+		Measure("Delete(), chain of 16 keys", m_iterations / 100, [&]()
+		{
+			auto subKey = key->Create(name, Registry::DesiredAccess::AllAccess);
+
+			for (int i = 0; i < 16; ++i)
+			{
+				subKey->SetInt32(L"Level", i);
+				subKey = subKey->Create(L"Key", Registry::DesiredAccess::AllAccess);
+			}
+		}, deleteTree);
+
+		Measure("Delete(), 4 levels of 4 subkeys", m_iterations / 100, [&]()
+		{
+			CreateTree(key->Create(name, Registry::DesiredAccess::AllAccess), 4, 4);
+		}, deleteTree);
+
+		assert(key->HasKey(name) == false);
+	}
+
+private:
+	const char* m_backendName;
+	std::shared_ptr<CountingBackend> m_backend;
+	size_t m_iterations;
+	std::vector<HotPathResult>& m_results;
+};
+
+void BenchmarkHotPaths(size_t iterations, std::vector<HotPathResult>& results)
+{
+	{
+		auto backend = std::make_shared<CountingBackend>(std::make_shared<Registry::MemoryBackend>());
+		auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+
+		HotPathSuite("memory", backend, iterations, results).Run(root);
+	}
+
+#if defined(_WIN32)
+	// Real registry is orders of magnitude slower, so fewer iterations keep run time reasonable
+	{
+		auto backend = std::make_shared<CountingBackend>(Registry::DefaultBackend());
+		auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+		auto parent = root->Create(L"SOFTWARE\\RegistryBenchmark", Registry::DesiredAccess::AllAccess);
+
+		HotPathSuite("win32", backend, iterations / 10, results).Run(parent);
+
+		parent->Delete();
+	}
+#endif
+}
+
+std::string JsonEscape(const std::string& value)
+{
+	std::string escaped;
+
+	for (auto ch : value)
+	{
+		if (ch == '"' || ch == '\\')
+		{
+			escaped += '\\';
+		}
+
+		escaped += ch;
+	}
+
+	return escaped;
+}
+
+/// <summary>
+///		Writes results as JSON array, one object per benchmark
+/// </summary>
+void WriteJson(std::ostream& stream, const std::vector<HotPathResult>& results)
+{
+	stream << "[" << std::endl;
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const auto& result = results[i];
+
+		stream
+			<< std::fixed << std::setprecision(2)
+			<< "  {"
+			<< "\"backend\": \"" << JsonEscape(result.backend) << "\", "
+			<< "\"name\": \"" << JsonEscape(result.name) << "\", "
+			<< "\"iterations\": " << result.iterations << ", "
+			<< "\"repetitions\": " << result.repetitions << ", "
+			<< "\"median_ns\": " << result.medianNanoseconds << ", "
+			<< "\"min_ns\": " << result.minNanoseconds << ", "
+			<< "\"max_ns\": " << result.maxNanoseconds << ", "
+			<< "\"calls_per_op\": " << result.callsPerOperation << ", "
+			<< "\"allocs_per_op\": " << result.allocationsPerOperation
+			<< "}" << ((i + 1 < results.size()) ? "," : "") << std::endl;
+	}
+
+	stream << "]" << std::endl;
+}
+
+/// <summary>
+///		Usage: RegistryBenchmark [--hot-paths] [--json file]
+///		--hot-paths runs only hot path suite, --json writes its results to specified file
+/// </summary>
+int main(int argc, char* argv[])
+{
+	const size_t iterations = 200000;
+
+	bool hotPathsOnly = false;
+	const char* jsonPath = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--hot-paths") == 0)
+		{
+			hotPathsOnly = true;
+		}
+		else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+		{
+			jsonPath = argv[++i];
+		}
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--hot-paths] [--json file]" << std::endl;
+
+			return 1;
+		}
+	}
+
+	if (!hotPathsOnly)
+	{
+		BenchmarkGetString(iterations);
+		BenchmarkOpen(iterations);
+		BenchmarkTryGet(iterations);
+		BenchmarkEnumerateValues(iterations / 1000);
+		BenchmarkWalk();
+		BenchmarkSnapshot(iterations);
+		BenchmarkRegFile();
+		BenchmarkDiff();
+		BenchmarkWriteBatch();
+		BenchmarkWatchHub();
+		BenchmarkConfigSchema(iterations);
+		BenchmarkBinary(2000);
+		BenchmarkMultiString(10000);
+		BenchmarkPathTrie(100);
+		BenchmarkHiveWriter(10000, 100);
+		BenchmarkReadScaling(std::chrono::milliseconds(500));
+	}
+
+	std::vector<HotPathResult> results;
+
+	BenchmarkHotPaths(iterations / 10, results);
+
+	if (jsonPath != nullptr)
+	{
+		std::ofstream stream(jsonPath);
+
+		WriteJson(stream, results);
+
+		if (!stream)
+		{
+			std::cerr << "Cannot write " << jsonPath << std::endl;
+
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -1,11 +1,88 @@
 #include "stdafx.h"
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+#include <new>
+#include <atomic>
+#include <set>
+#include <mutex>
+#include <thread>
 
 #include <Registry.hpp>
+#include <MemoryBackend.hpp>
+#include <CachedRegistryKey.hpp>
+#include <KeyCache.hpp>
+#include <RegistryWalker.hpp>
+#include <HiveFile.hpp>
+#include <Snapshot.hpp>
+#include <RegFile.hpp>
+#include <RegistryDiff.hpp>
+#include <WriteBatch.hpp>
+#include <ChangeWatch.hpp>
+#include <WatchHub.hpp>
+#include <ConfigSchema.hpp>
+#include <PathTrie.hpp>
+#include <InstrumentedBackend.hpp>
+#include <HiveWriter.hpp>
+#include <VersionedBackend.hpp>
 
 using namespace m4x1m1l14n;
 
+// Replacements are kept out of line, otherwise GCC inlines std::free() into delete expressions and reports
+// false -Wmismatched-new-delete for pointers returned by operator new
+#if defined(__GNUC__)
+#define ALLOCATION_NOINLINE __attribute__((noinline))
+#else
+#define ALLOCATION_NOINLINE
+#endif
+
+// Counts heap allocations made by whole process
+static std::atomic<size_t> g_allocations(0);
+
+ALLOCATION_NOINLINE void* operator new(size_t size)
+{
+	++g_allocations;
+
+	void* p = std::malloc(size != 0 ? size : 1);
+	if (p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	return p;
+}
+
+ALLOCATION_NOINLINE void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+ALLOCATION_NOINLINE void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+ALLOCATION_NOINLINE void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+ALLOCATION_NOINLINE void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+ALLOCATION_NOINLINE void operator delete[](void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
 #define STRINGIFY(expr) #expr
 
 #define CHECK_THROWS_AS(expression, exceptionType)		\
@@ -56,168 +133,3574 @@ std::wstring gen_random(const int len)
 
 	for (int i = 0; i < len; ++i) 
 	{
-		s += alphanum[rand() % (ARRAYSIZE(alphanum) - 1)];
+		s += alphanum[rand() % (sizeof(alphanum) / sizeof(alphanum[0]) - 1)];
 	}
 
 	return s;
 }
 
-int main()
+// Builds minimal regf hive image, so HiveFile can be tested without live registry
+class TestHive
 {
-	srand(static_cast<unsigned int>(time(nullptr)));
+public:
+	TestHive()
+		: m_bins(32, 0)
+	{
+		memcpy(m_bins.data(), "hbin", 4);
+	}
 
-	// New registry key creation from nullptr should throw
-	CHECK_THROWS_AS(Registry::RegistryKey(nullptr), std::invalid_argument&);
+	DWORD AddCell(const std::vector<BYTE>& data)
+	{
+		auto offset = static_cast<DWORD>(m_bins.size());
+		auto cbCell = (data.size() + 4 + 7) & ~static_cast<size_t>(7);
 
-	// Opening registry keys
+		m_bins.resize(offset + cbCell, 0);
 
-	// Open registry key with empty path
-	CHECK_THROWS_AS(Registry::LocalMachine->Open(L""), std::invalid_argument&);
-	// Open non-existing key
-	CHECK_THROWS_AS(Registry::LocalMachine->Open(L"NOT_EXISTING_REGISTRY_KEY"), std::system_error&);
-	// Create registry key with empty path
-	CHECK_THROWS_AS(Registry::LocalMachine->Create(L""), std::invalid_argument&);
-	// Cannot create registry key right in local
-	CHECK_THROWS_AS(Registry::LocalMachine->Create(L"CANNOT_CREATE_ON_HIVE"), std::system_error&);
+		LONG lSize = -static_cast<LONG>(cbCell);
+		memcpy(&m_bins[offset], &lSize, sizeof(lSize));
+		memcpy(&m_bins[offset + 4], data.data(), data.size());
 
+		return offset;
+	}
+
+	DWORD AddKey(const std::string& name, const std::vector<DWORD>& subKeys, const std::vector<std::string>& subKeyNames, const std::vector<DWORD>& values, const std::wstring& className = std::wstring())
 	{
-		auto key = Registry::LocalMachine->Open(L"SOFTWARE");
+		DWORD subKeyList = 0xFFFFFFFF;
+		DWORD valueList = 0xFFFFFFFF;
+		DWORD classCell = 0xFFFFFFFF;
 
-		CHECK_THROWS_AS(key->HasKey(L""), std::invalid_argument&);
-		CHECK_THROWS_AS(key->Exists(L""), std::invalid_argument&);
+		// Class name is stored without terminating null character
+		auto classData = Utf16(className);
+		classData.resize(classData.size() - 2);
 
-		assert(key->HasKey(L"KEY_THAT_DOES_NOT_EXISTS") == false);
-		assert(key->Exists(L"KEY_THAT_DOES_NOT_EXISTS") == false);
+		if (!classData.empty())
+		{
+			classCell = AddCell(classData);
+		}
 
-		CHECK_THROWS_AS(key->Create(L"CANNOT_CREATE_ACCESS_DENIED"), std::system_error&);
+		if (!subKeys.empty())
+		{
+			std::vector<BYTE> lh = { 'l', 'h', static_cast<BYTE>(subKeys.size()), 0 };
+
+			for (size_t i = 0; i < subKeys.size(); ++i)
+			{
+				DWORD dwHash = 0;
+				for (auto ch : subKeyNames[i])
+				{
+					dwHash = dwHash * 37 + static_cast<DWORD>(toupper(ch));
+				}
+
+				Append(lh, subKeys[i]);
+				Append(lh, dwHash);
+			}
+
+			subKeyList = AddCell(lh);
+		}
+
+		if (!values.empty())
+		{
+			std::vector<BYTE> list;
+
+			for (auto value : values)
+			{
+				Append(list, value);
+			}
+
+			valueList = AddCell(list);
+		}
+
+		std::vector<BYTE> nk(76, 0);
+		nk[0] = 'n';
+		nk[1] = 'k';
+		nk[2] = 0x20;
+		Put(nk, 16, 0xFFFFFFFF);
+		Put(nk, 20, static_cast<DWORD>(subKeys.size()));
+		Put(nk, 28, subKeyList);
+		Put(nk, 32, 0xFFFFFFFF);
+		Put(nk, 36, static_cast<DWORD>(values.size()));
+		Put(nk, 40, valueList);
+		Put(nk, 44, 0xFFFFFFFF);
+		Put(nk, 48, classCell);
+		nk[72] = static_cast<BYTE>(name.length());
+		nk[74] = static_cast<BYTE>(classData.size() & 0xFF);
+		nk[75] = static_cast<BYTE>(classData.size() >> 8);
+		nk.insert(nk.end(), name.begin(), name.end());
+
+		return AddCell(nk);
 	}
 
+	DWORD AddValue(const std::string& name, DWORD dwType, const std::vector<BYTE>& data)
 	{
-		auto desiredAccess = Registry::DesiredAccess::AllAccess | Registry::DesiredAccess::Notify;
-		auto subKey = Registry::CurrentUser->Create(L"OUR_TESTING_SUBKEY", desiredAccess);
+		std::vector<BYTE> vk(20, 0);
+		vk[0] = 'v';
+		vk[1] = 'k';
+		vk[2] = static_cast<BYTE>(name.length());
+		Put(vk, 12, dwType);
+		vk[16] = 0x01;
+		vk.insert(vk.end(), name.begin(), name.end());
 
-		CHECK_NO_THROW(subKey->SetExpandString(L"%ProgramFiles%\\My Company\\My Product\\Program.exe"));
-		assert(subKey->GetString() == L"%ProgramFiles%\\My Company\\My Product\\Program.exe");
+		auto cbData = static_cast<DWORD>(data.size());
 
+		if (cbData <= 4)
 		{
-			auto task = concurrency::create_task([subKey]() -> std::wstring
+			Put(vk, 4, cbData | 0x80000000);
+			memcpy(&vk[8], data.data(), data.size());
+		}
+		else if (cbData > 16344)
+		{
+			std::vector<BYTE> segments;
+
+			for (size_t pos = 0; pos < data.size(); pos += 16344)
 			{
-				std::wstring result;
+				auto end = (std::min)(data.size(), pos + 16344);
 
-				auto hChangeEvent = ::CreateEvent(nullptr, FALSE, FALSE, nullptr);
-				assert(hChangeEvent != nullptr);
+				Append(segments, AddCell(std::vector<BYTE>(data.begin() + pos, data.begin() + end)));
+			}
 
-				CHECK_NO_THROW(subKey->NotifyAsync(hChangeEvent));
+			std::vector<BYTE> db = { 'd', 'b', static_cast<BYTE>(segments.size() / 4), 0 };
+			Append(db, AddCell(segments));
 
-				DWORD dwWaitResult = ::WaitForSingleObject(hChangeEvent, INFINITE);
-				if (dwWaitResult == WAIT_OBJECT_0)
-				{
-					result = subKey->GetString(L"INVOKE_NOTIFY");
-				}
+			Put(vk, 4, cbData);
+			Put(vk, 8, AddCell(db));
+		}
+		else
+		{
+			Put(vk, 4, cbData);
+			Put(vk, 8, AddCell(data));
+		}
 
-				::CloseHandle(hChangeEvent);
+		return AddCell(vk);
+	}
 
-				return result;
-			});
+	void Save(const char* file, DWORD rootCell)
+	{
+		// Rest of bin is single free cell
+		auto used = m_bins.size();
 
-			::Sleep(1000);
+		m_bins.resize((m_bins.size() + 4095) & ~static_cast<size_t>(4095), 0);
 
-			const auto& val = gen_random(32);
+		if (used != m_bins.size())
+		{
+			Put(m_bins, used, static_cast<DWORD>(m_bins.size() - used));
+		}
 
-			CHECK_NO_THROW(subKey->SetString(L"INVOKE_NOTIFY", val));
-			
-			assert(task.get() == val);
-			CHECK_NO_THROW(subKey->Delete(L"INVOKE_NOTIFY"));
+		Put(m_bins, 8, static_cast<DWORD>(m_bins.size()));
+
+		std::vector<BYTE> base(4096, 0);
+		memcpy(base.data(), "regf", 4);
+		Put(base, 4, 1);
+		Put(base, 8, 1);
+		Put(base, 20, 1);
+		Put(base, 24, 5);
+		Put(base, 32, 1);
+		Put(base, 36, rootCell);
+		Put(base, 40, static_cast<DWORD>(m_bins.size()));
+		Put(base, 44, 1);
+
+		DWORD dwChecksum = 0;
+		for (size_t i = 0; i < 508; i += 4)
+		{
+			DWORD dw = 0;
+			memcpy(&dw, &base[i], sizeof(dw));
+			dwChecksum ^= dw;
 		}
 
-		CHECK_THROWS_AS(subKey->HasValue(L""), std::invalid_argument&);
-		assert(subKey->HasValue(L"VALUE_THAT_DOES_NOT_EXISTS") == false);
+		Put(base, 508, dwChecksum);
 
-		// Int32
-		CHECK_NO_THROW(subKey->SetInt32(L"INT32_VALUE_THAT_EXISTS", 1001236));
-		assert(subKey->HasValue(L"INT32_VALUE_THAT_EXISTS") == true);
-		assert(subKey->GetInt32(L"INT32_VALUE_THAT_EXISTS") == 1001236);
-		CHECK_NO_THROW(subKey->Delete(L"INT32_VALUE_THAT_EXISTS"));
-		assert(subKey->HasValue(L"INT32_VALUE_THAT_EXISTS") == false);
-		CHECK_NO_THROW(subKey->Delete(L"INT32_VALUE_THAT_EXISTS"));
+		std::ofstream out(file, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(base.data()), base.size());
+		out.write(reinterpret_cast<const char*>(m_bins.data()), m_bins.size());
+	}
 
-		// Int64
-		CHECK_NO_THROW(subKey->SetInt64(L"INT64_VALUE_THAT_EXISTS", 810012361001236));
-		assert(subKey->HasValue(L"INT64_VALUE_THAT_EXISTS") == true);
-		assert(subKey->GetInt64(L"INT64_VALUE_THAT_EXISTS") == 810012361001236);
-		CHECK_NO_THROW(subKey->Delete(L"INT64_VALUE_THAT_EXISTS"));
-		assert(subKey->HasValue(L"INT64_VALUE_THAT_EXISTS") == false);
-		CHECK_NO_THROW(subKey->Delete(L"INT64_VALUE_THAT_EXISTS"));
+	static std::vector<BYTE> Utf16(const std::wstring& s)
+	{
+		std::vector<BYTE> data;
 
-		// Boolean
-		CHECK_NO_THROW(subKey->SetBoolean(L"BOOLEAN_VALUE_THAT_EXISTS", true));
-		assert(subKey->HasValue(L"BOOLEAN_VALUE_THAT_EXISTS") == true);
-		assert(subKey->GetBoolean(L"BOOLEAN_VALUE_THAT_EXISTS") == true);
-		CHECK_NO_THROW(subKey->Delete(L"BOOLEAN_VALUE_THAT_EXISTS"));
-		assert(subKey->HasValue(L"BOOLEAN_VALUE_THAT_EXISTS") == false);
-		CHECK_NO_THROW(subKey->Delete(L"BOOLEAN_VALUE_THAT_EXISTS"));
+		for (auto ch : s)
+		{
+			data.push_back(static_cast<BYTE>(ch & 0xFF));
+			data.push_back(static_cast<BYTE>((ch >> 8) & 0xFF));
+		}
 
-		// String
-		CHECK_NO_THROW(subKey->SetString(L"STRING_VALUE_THAT_EXISTS", L"Value I want to store in this registry key!"));
-		assert(subKey->HasValue(L"STRING_VALUE_THAT_EXISTS") == true);
-		assert(subKey->GetString(L"STRING_VALUE_THAT_EXISTS") == L"Value I want to store in this registry key!");
-		CHECK_NO_THROW(subKey->Delete(L"STRING_VALUE_THAT_EXISTS"));
-		assert(subKey->HasValue(L"STRING_VALUE_THAT_EXISTS") == false);
-		CHECK_NO_THROW(subKey->Delete(L"STRING_VALUE_THAT_EXISTS"));
-
-		// Delete named key with values
-		{
-			auto tmpKey = subKey->Create(L"TEST1", Registry::DesiredAccess::AllAccess);
-
-			// Test default registry key values
-			CHECK_NO_THROW(tmpKey->SetInt32(-61));					assert(tmpKey->GetInt32() == -61);
-			CHECK_NO_THROW(tmpKey->SetUInt32(61));					assert(tmpKey->GetUInt32() == 61);
-			CHECK_NO_THROW(tmpKey->SetInt64(61));					assert(tmpKey->GetInt64() == 61);
-			CHECK_NO_THROW(tmpKey->SetUInt32(61));					assert(tmpKey->GetUInt64() == 61);
-			CHECK_NO_THROW(tmpKey->SetString(L"Default"));			assert(tmpKey->GetString() == L"Default");
-
-			// Boolean
-			CHECK_NO_THROW(tmpKey->SetBoolean(L"AA", true));		assert(tmpKey->GetBoolean(L"AA") == true);
-			CHECK_NO_THROW(tmpKey->SetBoolean(L"AB", false));		assert(tmpKey->GetBoolean(L"AB") == false);
-
-			// Int32
-			CHECK_NO_THROW(tmpKey->SetInt32(L"BA", 0));				assert(tmpKey->GetInt32(L"BA") == 0);
-			CHECK_NO_THROW(tmpKey->SetInt32(L"BB", 1));				assert(tmpKey->GetInt32(L"BB") == 1);
-			CHECK_NO_THROW(tmpKey->SetInt32(L"BC", -1));			assert(tmpKey->GetInt32(L"BC") == -1);
-			CHECK_NO_THROW(tmpKey->SetInt32(L"BD", MAXINT32));		assert(tmpKey->GetInt32(L"BD") == MAXINT32);
-			CHECK_NO_THROW(tmpKey->SetInt32(L"BE", MININT32));		assert(tmpKey->GetInt32(L"BE") == MININT32);
-
-			// UInt32
-			CHECK_NO_THROW(tmpKey->SetUInt32(L"CA", 0));			assert(tmpKey->GetUInt32(L"CA") == 0);
-			CHECK_NO_THROW(tmpKey->SetUInt32(L"CB", 1));			assert(tmpKey->GetUInt32(L"CB") == 1);
-			CHECK_NO_THROW(tmpKey->SetUInt32(L"CC", -1));			assert(tmpKey->GetUInt32(L"CC") == -1);
-			CHECK_NO_THROW(tmpKey->SetUInt32(L"CD", MAXUINT32));	assert(tmpKey->GetUInt32(L"CD") == MAXUINT32);
-
-			// Int64
-			CHECK_NO_THROW(tmpKey->SetInt64(L"DA", 0));				assert(tmpKey->GetInt64(L"DA") == 0);
-			CHECK_NO_THROW(tmpKey->SetInt64(L"DB", 1));				assert(tmpKey->GetInt64(L"DB") == 1);
-			CHECK_NO_THROW(tmpKey->SetInt64(L"DC", -1));			assert(tmpKey->GetInt64(L"DC") == -1);
-			CHECK_NO_THROW(tmpKey->SetInt64(L"DD", MAXINT64));		assert(tmpKey->GetInt64(L"DD") == MAXINT64);
-			CHECK_NO_THROW(tmpKey->SetInt64(L"DE", MININT64));		assert(tmpKey->GetInt64(L"DE") == MININT64);
-
-			// UInt64
-			CHECK_NO_THROW(tmpKey->SetUInt64(L"EA", 0));			assert(tmpKey->GetUInt64(L"EA") == 0);
-			CHECK_NO_THROW(tmpKey->SetUInt64(L"EB", 1));			assert(tmpKey->GetUInt64(L"EB") == 1);
-			CHECK_NO_THROW(tmpKey->SetUInt64(L"EC", -1));			assert(tmpKey->GetUInt64(L"EC") == -1);
-			CHECK_NO_THROW(tmpKey->SetUInt64(L"ED", MAXUINT64));	assert(tmpKey->GetUInt64(L"ED") == MAXUINT64);
-
-			// String
-			CHECK_NO_THROW(tmpKey->SetString(L"FA", L""));			assert(tmpKey->GetString(L"FA") == L"");
-			CHECK_NO_THROW(tmpKey->SetString(L"FB", L"A"));			assert(tmpKey->GetString(L"FB") == L"A");
-
-			const std::wstring val = L"jhihsihjo; ;oj9dn9u8y   8726yi7138ry301ccn   f  fjhiehfo2h 2 c2jhcoh293i70473[]\\;;lll[]]\\[;'.,.\\w+=;;```";
-			CHECK_NO_THROW(tmpKey->SetString(L"FC", val));			assert(tmpKey->GetString(L"FC") == val);
+		data.push_back(0);
+		data.push_back(0);
+
+		return data;
+	}
+
+	template <typename T>
+	static std::vector<BYTE> Bytes(T value)
+	{
+		std::vector<BYTE> data(sizeof(value));
+		memcpy(data.data(), &value, sizeof(value));
+
+		return data;
+	}
+
+private:
+	static void Append(std::vector<BYTE>& data, DWORD value)
+	{
+		auto bytes = Bytes(value);
+		data.insert(data.end(), bytes.begin(), bytes.end());
+	}
+
+	static void Put(std::vector<BYTE>& data, size_t offset, DWORD value)
+	{
+		memcpy(&data[offset], &value, sizeof(value));
+	}
+
+private:
+	std::vector<BYTE> m_bins;
+};
+
+void TestHiveFile()
+{
+	CHECK_THROWS_AS(Registry::HiveFile(L""), std::invalid_argument&);
+	CHECK_THROWS_AS(Registry::HiveFile(L"NOT_EXISTING_HIVE_FILE.hiv"), std::system_error&);
+
+	const std::wstring big(10000, L'B');
+
+	{
+		TestHive image;
+
+		auto vendor = image.AddKey("Vendor", {}, {}, { image.AddValue("Name", REG_SZ, TestHive::Utf16(L"Vendor name")) });
+
+		auto software = image.AddKey("Software", { vendor }, { "Vendor" },
+		{
+			image.AddValue("Dword", REG_DWORD, TestHive::Bytes<DWORD>(0xFFFFFFFF)),
+			image.AddValue("Qword", REG_QWORD, TestHive::Bytes<long long>(810012361001236)),
+			image.AddValue("Enabled", REG_DWORD, TestHive::Bytes<DWORD>(1)),
+			image.AddValue("String", REG_SZ, TestHive::Utf16(L"Value stored in hive")),
+			image.AddValue("Expand", REG_EXPAND_SZ, TestHive::Utf16(L"%ProgramFiles%\\My Company")),
+			image.AddValue("Tiny", REG_SZ, TestHive::Utf16(L"A")),
+			image.AddValue("Big", REG_SZ, TestHive::Utf16(big))
+		});
+
+		auto system = image.AddKey("System", {}, {}, {});
+
+		auto root = image.AddKey("ROOT", { software, system }, { "Software", "System" }, { image.AddValue("", REG_SZ, TestHive::Utf16(L"Default")) });
+
+		image.Save("RegistryTest.hiv", root);
+	}
+
+	{
+		Registry::HiveFile hive(L"RegistryTest.hiv");
+
+		assert(hive.Root().GetName() == L"ROOT");
+		assert(hive.Root().GetString() == L"Default");
+
+		assert(hive.HasKey(L"Software") == true);
+		assert(hive.HasKey(L"SOFTWARE\\vendor") == true);
+		assert(hive.HasKey(L"KEY_THAT_DOES_NOT_EXISTS") == false);
+		assert(hive.HasKey(L"Software\\KEY_THAT_DOES_NOT_EXISTS") == false);
+
+		CHECK_THROWS_AS(hive.HasKey(L""), std::invalid_argument&);
+		CHECK_THROWS_AS(hive.Open(L""), std::invalid_argument&);
+		CHECK_THROWS_AS(hive.Open(L"KEY_THAT_DOES_NOT_EXISTS"), std::system_error&);
+
+		auto key = hive.Open(L"software");
+
+		CHECK_THROWS_AS(key.HasValue(L""), std::invalid_argument&);
+		assert(key.HasValue(L"string") == true);
+		assert(key.HasValue(L"VALUE_THAT_DOES_NOT_EXISTS") == false);
+
+		assert(key.GetInt32(L"Dword") == -1);
+		assert(key.GetUInt32(L"Dword") == 0xFFFFFFFF);
+		assert(key.GetInt64(L"Qword") == 810012361001236);
+		assert(key.GetBoolean(L"Enabled") == true);
+		assert(key.GetString(L"String") == L"Value stored in hive");
+		assert(key.GetString(L"Expand") == L"%ProgramFiles%\\My Company");
+		assert(key.GetString(L"Tiny") == L"A");
+		assert(key.GetString(L"Big") == big);
+		assert(key.Open(L"Vendor").GetString(L"Name") == L"Vendor name");
+
+		CHECK_THROWS_AS(key.GetInt32(L"Qword"), std::system_error&);
+		CHECK_THROWS_AS(key.GetInt32(L"VALUE_THAT_DOES_NOT_EXISTS"), std::system_error&);
+		CHECK_THROWS_AS(key.GetString(L"Dword"), std::runtime_error&);
+
+		std::vector<std::wstring> subKeys;
+
+		hive.Root().EnumerateSubKeys([&subKeys](const std::wstring& name) -> bool
+		{
+			subKeys.push_back(name);
+
+			return true;
+		});
+
+		assert(subKeys.size() == 2 && subKeys[0] == L"Software" && subKeys[1] == L"System");
+	}
+
+	std::remove("RegistryTest.hiv");
+}
+
+void TestSnapshot()
+{
+	CHECK_THROWS_AS(Registry::SnapshotWriter(Registry::RegistryKey_ptr()), std::invalid_argument&);
+	CHECK_THROWS_AS(Registry::SnapshotFile(L"NOT_EXISTING_SNAPSHOT_FILE.snap"), std::system_error&);
+
+	auto backend = std::make_shared<Registry::MemoryBackend>();
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+
+	{
+		auto key = root->Create(L"Software\\Vendor\\Product", Registry::DesiredAccess::AllAccess);
+
+		key->SetString(L"Name", L"Product name");
+		key->SetExpandString(L"Path", L"%ProgramFiles%\\Vendor");
+		key->SetInt32(L"Dword", -1);
+		key->SetInt64(L"Qword", 810012361001236);
+		key->SetBoolean(L"Enabled", true);
+		key->SetString(L"", L"Default");
+
+		for (int i = 0; i < 100; i++)
+		{
+			auto name = L"Value" + std::to_wstring(i);
+
+			key->SetInt32(name, i);
+			key->Create(L"Sub" + std::to_wstring(i), Registry::DesiredAccess::AllAccess)->SetInt32(name, i);
 		}
+	}
 
-		CHECK_NO_THROW(subKey->Delete(L"TEST1"));
+	Registry::SnapshotWriter(root->Open(L"Software")).Save(L"RegistryTest.snap");
 
-		CHECK_NO_THROW(subKey->Delete());
+	{
+		Registry::SnapshotFile snapshot(L"RegistryTest.snap");
+
+		assert(snapshot.KeyCount() == 103);
+		assert(snapshot.ValueCount() == 206);
+
+		assert(snapshot.HasKey(L"Vendor") == true);
+		assert(snapshot.HasKey(L"VENDOR\\product\\SUB99") == true);
+		assert(snapshot.HasKey(L"Vendor\\Product\\Sub100") == false);
+		assert(snapshot.HasKey(L"KEY_THAT_DOES_NOT_EXISTS") == false);
+
+		CHECK_THROWS_AS(snapshot.HasKey(L""), std::invalid_argument&);
+		CHECK_THROWS_AS(snapshot.Open(L""), std::invalid_argument&);
+		CHECK_THROWS_AS(snapshot.Open(L"KEY_THAT_DOES_NOT_EXISTS"), std::system_error&);
+
+		auto key = snapshot.Open(L"Vendor\\Product");
+
+		assert(key.GetName() == L"Product");
+		assert(key.GetString() == L"Default");
+		assert(key.GetString(L"name") == L"Product name");
+		assert(key.GetString(L"Path") == L"%ProgramFiles%\\Vendor");
+		assert(key.GetInt32(L"Dword") == -1);
+		assert(key.GetUInt32(L"Dword") == 0xFFFFFFFF);
+		assert(key.GetInt64(L"Qword") == 810012361001236);
+		assert(key.GetBoolean(L"Enabled") == true);
+
+		CHECK_THROWS_AS(key.HasValue(L""), std::invalid_argument&);
+		assert(key.HasValue(L"VALUE_THAT_DOES_NOT_EXISTS") == false);
+
+		CHECK_THROWS_AS(key.GetInt32(L"Qword"), std::runtime_error&);
+		CHECK_THROWS_AS(key.GetInt32(L"Name"), std::runtime_error&);
+		CHECK_THROWS_AS(key.GetInt64(L"Dword"), std::runtime_error&);
+		CHECK_THROWS_AS(key.GetInt32(L"VALUE_THAT_DOES_NOT_EXISTS"), std::system_error&);
+		CHECK_THROWS_AS(key.GetInt64(L"VALUE_THAT_DOES_NOT_EXISTS"), std::system_error&);
+		CHECK_THROWS_AS(key.GetString(L"Dword"), std::runtime_error&);
+
+		for (int i = 0; i < 100; i++)
+		{
+			auto name = L"Value" + std::to_wstring(i);
+
+			assert(key.GetInt32(name) == i);
+			assert(key.Open(L"Sub" + std::to_wstring(i)).GetInt32(name) == i);
+		}
+
+		// Lookups neither allocate memory nor touch backend
+		const size_t allocations = g_allocations;
+
+		for (int i = 0; i < 100; i++)
+		{
+			assert(key.HasValue(L"Value50") == true);
+			assert(key.HasKey(L"Sub50") == true);
+			assert(key.HasKey(L"Sub500") == false);
+		}
+
+		assert(g_allocations == allocations);
+
+		size_t subKeys = 0;
+		size_t values = 0;
+
+		key.EnumerateSubKeys([&subKeys](const std::wstring& name) -> bool
+		{
+			assert(name.compare(0, 3, L"Sub") == 0);
+
+			return ++subKeys < 10;
+		});
+
+		key.EnumerateValues([&values](std::wstring_view name, DWORD dwType, const BYTE* pData, DWORD cbData) -> bool
+		{
+			if (name == L"Dword")
+			{
+				assert(dwType == REG_DWORD && cbData == sizeof(DWORD) && *reinterpret_cast<const DWORD*>(pData) == 0xFFFFFFFF);
+			}
+
+			++values;
+
+			return true;
+		});
+
+		assert(subKeys == 10);
+		assert(values == 106);
+	}
+
+	// Export of offline hive
+	{
+		TestHive image;
+
+		auto vendor = image.AddKey("Vendor", {}, {}, { image.AddValue("Name", REG_SZ, TestHive::Utf16(L"Vendor name")) });
+		auto root = image.AddKey("ROOT", { vendor }, { "Vendor" }, { image.AddValue("", REG_SZ, TestHive::Utf16(L"Default")) });
+
+		image.Save("RegistryTest.hiv", root);
+	}
+
+	{
+		Registry::HiveFile hive(L"RegistryTest.hiv");
+
+		Registry::SnapshotWriter(hive.Root()).Save(L"RegistryTest.snap");
+	}
+
+	{
+		Registry::SnapshotFile snapshot(L"RegistryTest.snap");
+
+		assert(snapshot.Root().GetName() == L"ROOT");
+		assert(snapshot.Root().GetString() == L"Default");
+		assert(snapshot.Open(L"vendor").GetString(L"NAME") == L"Vendor name");
+	}
+
+	std::remove("RegistryTest.hiv");
+	std::remove("RegistryTest.snap");
+
+	{
+		std::ofstream out("RegistryTest.snap", std::ios::binary);
+
+		out << "NOT A SNAPSHOT FILE, JUST SOME GARBAGE";
+	}
+
+	CHECK_THROWS_AS(Registry::SnapshotFile(L"RegistryTest.snap"), std::system_error&);
+
+	std::remove("RegistryTest.snap");
+}
+
+// Formats bytes as hex list of .reg file, wrapped to multiple lines
+static std::wstring RegHex(const std::vector<BYTE>& data)
+{
+	static const wchar_t digits[] = L"0123456789abcdef";
+
+	std::wstring hex;
+
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		hex += digits[data[i] >> 4];
+		hex += digits[data[i] & 0xF];
+
+		if (i + 1 < data.size())
+		{
+			hex += (i % 16 == 15) ? L",\\\r\n  " : L",";
+		}
+	}
+
+	return hex;
+}
+
+// Encodes .reg file text as UTF-16LE with byte order mark
+static std::string RegFileBytes(const std::wstring& text)
+{
+	std::string bytes = "\xFF\xFE";
+
+	for (auto ch : text)
+	{
+		bytes += static_cast<char>(ch & 0xFF);
+		bytes += static_cast<char>((ch >> 8) & 0xFF);
+	}
+
+	return bytes;
+}
+
+void TestRegFile()
+{
+	auto backend = std::make_shared<Registry::MemoryBackend>();
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+
+	CHECK_THROWS_AS(Registry::RegFileImporter(nullptr), std::invalid_argument&);
+
+	Registry::RegFileImporter importer(backend);
+
+	CHECK_THROWS_AS(importer.Import(L""), std::invalid_argument&);
+	CHECK_THROWS_AS(importer.Import(L"NOT_EXISTING_REG_FILE.reg"), std::runtime_error&);
+
+	const std::wstring text =
+		L"Windows Registry Editor Version 5.00\r\n"
+		L"\r\n"
+		L"; Comment\r\n"
+		L"[HKEY_CURRENT_USER\\Software\\Vendor]\r\n"
+		L"@=\"Default\"\r\n"
+		L"\"Name\"=\"Quoted \\\"name\\\" in C:\\\\Path\"\r\n"
+		L"\"Dword\"=dword:ffffffff\r\n"
+		L"\"Qword\"=hex(b):" + RegHex(TestHive::Bytes<long long>(810012361001236)) + L"\r\n"
+		L"\"Expand\"=hex(2):" + RegHex(TestHive::Utf16(L"%ProgramFiles%\\Vendor")) + L"\r\n"
+		L"\"Binary\"=hex:01,02,03\r\n"
+		L"\"Multi\"=hex(7):61,00,00,00,62,00,00,00,00,00\r\n"
+		L"\"Deleted\"=\"Value\"\r\n"
+		L"\"Deleted\"=-\r\n"
+		L"\r\n"
+		L"[HKEY_CURRENT_USER\\Software\\Vendor\\Sub]\r\n"
+		L"\"Unicode\"=\"\u017Elu\u0165ou\u010Dk\u00FD\"\r\n"
+		L"\r\n"
+		L"[HKCU\\Software\\Removed]\r\n"
+		L"\r\n"
+		L"[-HKEY_CURRENT_USER\\Software\\Removed]\r\n"
+		L"\"Ignored\"=\"Value\"\r\n";
+
+	{
+		std::istringstream in(RegFileBytes(text));
+
+		auto result = importer.Import(in);
+
+		assert(result.keys == 3);
+		assert(result.values == 9);
+		assert(result.deleted == 2);
+	}
+
+	{
+		auto key = root->Open(L"Software\\Vendor");
+
+		assert(key->GetString() == L"Default");
+		assert(key->GetString(L"Name") == L"Quoted \"name\" in C:\\Path");
+		assert(key->GetUInt32(L"Dword") == 0xFFFFFFFF);
+		assert(key->GetInt64(L"Qword") == 810012361001236);
+		assert(key->GetString(L"Expand") == L"%ProgramFiles%\\Vendor");
+		assert(key->HasValue(L"Deleted") == false);
+		assert(key->Open(L"Sub")->GetString(L"Unicode") == L"\u017Elu\u0165ou\u010Dk\u00FD");
+		assert(root->HasKey(L"Software\\Removed") == false);
+
+		key->EnumerateValues([](std::wstring_view name, DWORD dwType, const BYTE* pData, DWORD cbData) -> bool
+		{
+			if (name == L"Binary")
+			{
+				assert(dwType == REG_BINARY && cbData == 3 && pData[2] == 3);
+			}
+			else if (name == L"Multi")
+			{
+				assert(dwType == REG_MULTI_SZ && cbData == 5 * sizeof(wchar_t));
+				assert(std::wstring(reinterpret_cast<const wchar_t*>(pData), 5) == std::wstring(L"a\0b\0\0", 5));
+			}
+
+			return true;
+		});
 	}
 
+	// REGEDIT4 files are 8 bit, UTF-8 or ANSI
+	{
+		std::istringstream in(
+			"REGEDIT4\n"
+			"\n"
+			"[HKEY_CURRENT_USER\\Software\\Regedit4]\n"
+			"\"Utf8\"=\"\xC5\xBElu\xC5\xA5ou\xC4\x8Dk\xC3\xBD\"\n"
+			"\"Ansi\"=\"caf\xE9\"\n"
+			"\"Expand\"=hex(2):25,54,45,4d,50,25,00\n");
+
+		auto result = importer.Import(in);
+
+		assert(result.keys == 1 && result.values == 3);
+
+		auto key = root->Open(L"Software\\Regedit4");
+
+		assert(key->GetString(L"Utf8") == L"\u017Elu\u0165ou\u010Dk\u00FD");
+		assert(key->GetString(L"Ansi") == L"caf\u00E9");
+		assert(key->GetString(L"Expand") == L"%TEMP%");
+	}
+
+	// Syntax errors
+	{
+		auto import = [&importer](const std::wstring& text)
+		{
+			std::istringstream in(RegFileBytes(text));
+
+			importer.Import(in);
+		};
+
+		CHECK_THROWS_AS(import(L""), std::runtime_error&);
+		CHECK_THROWS_AS(import(L"Windows Registry Editor Version 4.00\r\n"), std::runtime_error&);
+		CHECK_THROWS_AS(import(L"REGEDIT4\r\n\"Name\"=\"Value\"\r\n"), std::runtime_error&);
+		CHECK_THROWS_AS(import(L"REGEDIT4\r\n[HKEY_NOT_EXISTING_ROOT\\Software]\r\n"), std::runtime_error&);
+		CHECK_THROWS_AS(import(L"REGEDIT4\r\n[-HKEY_CURRENT_USER]\r\n"), std::runtime_error&);
+		CHECK_THROWS_AS(import(L"REGEDIT4\r\n[HKEY_CURRENT_USER\\Software\r\n"), std::runtime_error&);
+		CHECK_THROWS_AS(import(L"REGEDIT4\r\n[HKEY_CURRENT_USER\\Software]\r\n\"Name\"=bogus\r\n"), std::runtime_error&);
+		CHECK_THROWS_AS(import(L"REGEDIT4\r\n[HKEY_CURRENT_USER\\Software]\r\n\"Name\"=\"Value\r\n"), std::runtime_error&);
+		CHECK_THROWS_AS(import(L"REGEDIT4\r\n[HKEY_CURRENT_USER\\Software]\r\n\"Name\"=dword:123456789\r\n"), std::runtime_error&);
+		CHECK_THROWS_AS(import(L"REGEDIT4\r\n[HKEY_CURRENT_USER\\Software]\r\n\"Name\"=hex:0g\r\n"), std::runtime_error&);
+		CHECK_THROWS_AS(import(L"REGEDIT4\r\n[HKEY_CURRENT_USER\\Software]\r\n\"Name\"=hex:01,\\\r\n"), std::runtime_error&);
+	}
+
+	// Export and import of exported file gives same registry content
+	for (auto format : { Registry::RegFileFormat::Regedit5, Registry::RegFileFormat::Regedit4 })
+	{
+		std::ostringstream out;
+
+		{
+			Registry::RegFileExporter exporter(out, format);
+
+			CHECK_THROWS_AS(exporter.Export(nullptr, L"HKEY_CURRENT_USER\\Software\\Vendor"), std::invalid_argument&);
+			CHECK_THROWS_AS(exporter.Export(root, L""), std::invalid_argument&);
+
+			exporter.Export(root->Open(L"Software\\Vendor"), L"HKEY_CURRENT_USER\\Software\\Vendor");
+		}
+
+		auto copyBackend = std::make_shared<Registry::MemoryBackend>();
+		auto copyRoot = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, copyBackend);
+
+		std::istringstream in(out.str());
+
+		auto result = Registry::RegFileImporter(copyBackend).Import(in);
+
+		assert(result.keys == 2 && result.values == 8 && result.deleted == 0);
+
+		std::ostringstream copy;
+
+		Registry::RegFileExporter(copy, format).Export(copyRoot->Open(L"Software\\Vendor"), L"HKEY_CURRENT_USER\\Software\\Vendor");
+
+		assert(copy.str() == out.str());
+
+		if (format == Registry::RegFileFormat::Regedit4)
+		{
+			const auto& exported = out.str();
+
+			assert(exported.find("[HKEY_CURRENT_USER\\Software\\Vendor\\Sub]\r\n") != std::string::npos);
+			assert(exported.find("@=\"Default\"\r\n") != std::string::npos);
+			assert(exported.find("\"Name\"=\"Quoted \\\"name\\\" in C:\\\\Path\"\r\n") != std::string::npos);
+			assert(exported.find("\"Dword\"=dword:ffffffff\r\n") != std::string::npos);
+			assert(exported.find("\"Binary\"=hex:01,02,03\r\n") != std::string::npos);
+			assert(exported.find("\"Multi\"=hex(7):61,00,62,00,00\r\n") != std::string::npos);
+
+			size_t begin = 0;
+
+			for (size_t end = exported.find('\n'); end != std::string::npos; end = exported.find('\n', begin))
+			{
+				assert(end - begin <= 80);
+
+				begin = end + 1;
+			}
+		}
+	}
+
+	// File larger than read chunk
+	{
+		std::wstring large = L"Windows Registry Editor Version 5.00\r\n\r\n";
+
+		for (int i = 0; i < 2000; i++)
+		{
+			large += L"[HKEY_CURRENT_USER\\Software\\Large\\Key" + std::to_wstring(i) + L"]\r\n";
+			large += L"\"Value\"=dword:" + std::to_wstring(i) + L"\r\n\r\n";
+		}
+
+		std::istringstream in(RegFileBytes(large));
+
+		auto result = importer.Import(in);
+
+		assert(result.keys == 2000 && result.values == 2000);
+		assert(root->Open(L"Software\\Large\\Key1999")->GetUInt32(L"Value") == 0x1999);
+	}
+}
+
+void TestValues(const Registry::RegistryKey_ptr& subKey)
+{
+	CHECK_THROWS_AS(subKey->HasValue(L""), std::invalid_argument&);
+	assert(subKey->HasValue(L"VALUE_THAT_DOES_NOT_EXISTS") == false);
+
+	// Int32
+	CHECK_NO_THROW(subKey->SetInt32(L"INT32_VALUE_THAT_EXISTS", 1001236));
+	assert(subKey->HasValue(L"INT32_VALUE_THAT_EXISTS") == true);
+	assert(subKey->GetInt32(L"INT32_VALUE_THAT_EXISTS") == 1001236);
+	CHECK_NO_THROW(subKey->Delete(L"INT32_VALUE_THAT_EXISTS"));
+	assert(subKey->HasValue(L"INT32_VALUE_THAT_EXISTS") == false);
+	CHECK_NO_THROW(subKey->Delete(L"INT32_VALUE_THAT_EXISTS"));
+
+	// Int64
+	CHECK_NO_THROW(subKey->SetInt64(L"INT64_VALUE_THAT_EXISTS", 810012361001236));
+	assert(subKey->HasValue(L"INT64_VALUE_THAT_EXISTS") == true);
+	assert(subKey->GetInt64(L"INT64_VALUE_THAT_EXISTS") == 810012361001236);
+	CHECK_NO_THROW(subKey->Delete(L"INT64_VALUE_THAT_EXISTS"));
+	assert(subKey->HasValue(L"INT64_VALUE_THAT_EXISTS") == false);
+	CHECK_NO_THROW(subKey->Delete(L"INT64_VALUE_THAT_EXISTS"));
+
+	// Boolean
+	CHECK_NO_THROW(subKey->SetBoolean(L"BOOLEAN_VALUE_THAT_EXISTS", true));
+	assert(subKey->HasValue(L"BOOLEAN_VALUE_THAT_EXISTS") == true);
+	assert(subKey->GetBoolean(L"BOOLEAN_VALUE_THAT_EXISTS") == true);
+	CHECK_NO_THROW(subKey->Delete(L"BOOLEAN_VALUE_THAT_EXISTS"));
+	assert(subKey->HasValue(L"BOOLEAN_VALUE_THAT_EXISTS") == false);
+	CHECK_NO_THROW(subKey->Delete(L"BOOLEAN_VALUE_THAT_EXISTS"));
+
+	// String
+	CHECK_NO_THROW(subKey->SetString(L"STRING_VALUE_THAT_EXISTS", L"Value I want to store in this registry key!"));
+	assert(subKey->HasValue(L"STRING_VALUE_THAT_EXISTS") == true);
+	assert(subKey->GetString(L"STRING_VALUE_THAT_EXISTS") == L"Value I want to store in this registry key!");
+	CHECK_NO_THROW(subKey->Delete(L"STRING_VALUE_THAT_EXISTS"));
+	assert(subKey->HasValue(L"STRING_VALUE_THAT_EXISTS") == false);
+	CHECK_NO_THROW(subKey->Delete(L"STRING_VALUE_THAT_EXISTS"));
+
+	// Delete named key with values
+	{
+		auto tmpKey = subKey->Create(L"TEST1", Registry::DesiredAccess::AllAccess);
+
+		// Test default registry key values
+		CHECK_NO_THROW(tmpKey->SetInt32(-61));					assert(tmpKey->GetInt32() == -61);
+		CHECK_NO_THROW(tmpKey->SetUInt32(61));					assert(tmpKey->GetUInt32() == 61);
+		CHECK_NO_THROW(tmpKey->SetInt64(61));					assert(tmpKey->GetInt64() == 61);
+		CHECK_NO_THROW(tmpKey->SetUInt32(61));					assert(tmpKey->GetUInt64() == 61);
+		CHECK_NO_THROW(tmpKey->SetString(L"Default"));			assert(tmpKey->GetString() == L"Default");
+
+		// Boolean
+		CHECK_NO_THROW(tmpKey->SetBoolean(L"AA", true));		assert(tmpKey->GetBoolean(L"AA") == true);
+		CHECK_NO_THROW(tmpKey->SetBoolean(L"AB", false));		assert(tmpKey->GetBoolean(L"AB") == false);
+
+		// Int32
+		CHECK_NO_THROW(tmpKey->SetInt32(L"BA", 0));				assert(tmpKey->GetInt32(L"BA") == 0);
+		CHECK_NO_THROW(tmpKey->SetInt32(L"BB", 1));				assert(tmpKey->GetInt32(L"BB") == 1);
+		CHECK_NO_THROW(tmpKey->SetInt32(L"BC", -1));			assert(tmpKey->GetInt32(L"BC") == -1);
+		CHECK_NO_THROW(tmpKey->SetInt32(L"BD", INT32_MAX));		assert(tmpKey->GetInt32(L"BD") == INT32_MAX);
+		CHECK_NO_THROW(tmpKey->SetInt32(L"BE", INT32_MIN));		assert(tmpKey->GetInt32(L"BE") == INT32_MIN);
+
+		// UInt32
+		CHECK_NO_THROW(tmpKey->SetUInt32(L"CA", 0));			assert(tmpKey->GetUInt32(L"CA") == 0);
+		CHECK_NO_THROW(tmpKey->SetUInt32(L"CB", 1));			assert(tmpKey->GetUInt32(L"CB") == 1);
+		CHECK_NO_THROW(tmpKey->SetUInt32(L"CC", -1));			assert(tmpKey->GetUInt32(L"CC") == -1);
+		CHECK_NO_THROW(tmpKey->SetUInt32(L"CD", UINT32_MAX));	assert(tmpKey->GetUInt32(L"CD") == UINT32_MAX);
+
+		// Int64
+		CHECK_NO_THROW(tmpKey->SetInt64(L"DA", 0));				assert(tmpKey->GetInt64(L"DA") == 0);
+		CHECK_NO_THROW(tmpKey->SetInt64(L"DB", 1));				assert(tmpKey->GetInt64(L"DB") == 1);
+		CHECK_NO_THROW(tmpKey->SetInt64(L"DC", -1));			assert(tmpKey->GetInt64(L"DC") == -1);
+		CHECK_NO_THROW(tmpKey->SetInt64(L"DD", INT64_MAX));		assert(tmpKey->GetInt64(L"DD") == INT64_MAX);
+		CHECK_NO_THROW(tmpKey->SetInt64(L"DE", INT64_MIN));		assert(tmpKey->GetInt64(L"DE") == INT64_MIN);
+
+		// UInt64
+		CHECK_NO_THROW(tmpKey->SetUInt64(L"EA", 0));			assert(tmpKey->GetUInt64(L"EA") == 0);
+		CHECK_NO_THROW(tmpKey->SetUInt64(L"EB", 1));			assert(tmpKey->GetUInt64(L"EB") == 1);
+		CHECK_NO_THROW(tmpKey->SetUInt64(L"EC", -1));			assert(tmpKey->GetUInt64(L"EC") == -1);
+		CHECK_NO_THROW(tmpKey->SetUInt64(L"ED", UINT64_MAX));	assert(tmpKey->GetUInt64(L"ED") == UINT64_MAX);
+
+		// String
+		CHECK_NO_THROW(tmpKey->SetString(L"FA", L""));			assert(tmpKey->GetString(L"FA") == L"");
+		CHECK_NO_THROW(tmpKey->SetString(L"FB", L"A"));			assert(tmpKey->GetString(L"FB") == L"A");
+
+		const std::wstring val = L"jhihsihjo; ;oj9dn9u8y   8726yi7138ry301ccn   f  fjhiehfo2h 2 c2jhcoh293i70473[]\\;;lll[]]\\[;'.,.\\\u00E1\u00FD\u00E1\u00FD\u00EDw\u00FD\u017E\u017E+=\u00E9\u00ED\u00E1\u00FD\u00FD\u017E;;```";
+		CHECK_NO_THROW(tmpKey->SetString(L"FC", val));			assert(tmpKey->GetString(L"FC") == val);
+
+		// String read into reused buffer, longer than internal stack buffer
+		const std::wstring longVal(1000, L'x');
+		CHECK_NO_THROW(tmpKey->SetString(L"FD", longVal));		assert(tmpKey->GetString(L"FD") == longVal);
+
+		std::wstring buffer;
+		CHECK_NO_THROW(tmpKey->GetString(L"FD", buffer));		assert(buffer == longVal);
+		CHECK_NO_THROW(tmpKey->GetString(L"FB", buffer));		assert(buffer == L"A");
+		CHECK_NO_THROW(tmpKey->GetString(L"FC", buffer));		assert(buffer == val);
+		CHECK_THROWS_AS(tmpKey->GetString(L"BA", buffer), std::runtime_error&);
+
+		// Batch read
+		Registry::RegistryValues values;
+
+		CHECK_NO_THROW(tmpKey->GetValues({ L"AA", L"BE", L"CD", L"DE", L"FA", L"FC" }, values));
+		assert(values.Count() == 6);
+		assert(values.GetBoolean(0) == true);
+		assert(values.GetInt32(1) == INT32_MIN);
+		assert(values.GetUInt32(2) == UINT32_MAX);
+		assert(values.GetInt64(3) == INT64_MIN);
+		assert(values.GetString(4) == L"");
+		assert(values.GetString(5) == val);
+		CHECK_THROWS_AS(values.GetInt32(3), std::system_error&);
+		CHECK_THROWS_AS(values.GetString(0), std::runtime_error&);
+		CHECK_THROWS_AS(values.GetStatus(6), std::out_of_range&);
+
+		// Missing value does not fail whole batch
+		CHECK_NO_THROW(tmpKey->GetValues({ L"BD", L"VALUE_THAT_DOES_NOT_EXISTS", L"FB" }, values));
+		assert(values.Count() == 3);
+		assert(values.GetInt32(0) == INT32_MAX);
+		assert(values.GetStatus(1) == ERROR_FILE_NOT_FOUND);
+		assert(values.HasValue(1) == false);
+		CHECK_THROWS_AS(values.GetInt32(1), std::system_error&);
+		assert(values.GetString(2) == L"A");
+
+		// Exception-free reads
+		std::error_code ec;
+
+		assert(tmpKey->TryGetInt32(L"BC", ec) == -1);			assert(!ec);
+		assert(tmpKey->TryGetUInt64(L"ED") == UINT64_MAX);
+		assert(tmpKey->TryGetBoolean(L"AA") == true);
+		assert(tmpKey->TryGetString(L"FC") == val);
+		assert(!tmpKey->TryGetInt32(L"VALUE_THAT_DOES_NOT_EXISTS", ec));
+		assert(ec.value() == ERROR_FILE_NOT_FOUND);
+		assert(!tmpKey->TryGetInt32(L"DA", ec));				assert(ec.value() == ERROR_MORE_DATA);
+		assert(!tmpKey->TryGetString(L"BA", ec));				assert(ec.value() == ERROR_UNSUPPORTED_TYPE);
+		assert(!tmpKey->TryGetBoolean(L"FB", ec));				assert(ec.value() == ERROR_UNSUPPORTED_TYPE);
+		assert(tmpKey->TryGetString(L"FD", buffer, ec));		assert(buffer == longVal);
+		assert(!tmpKey->TryGetString(L"VALUE_THAT_DOES_NOT_EXISTS", buffer, ec));
+		assert(buffer.empty());
+
+		// Value enumeration
+		size_t count = 0;
+		bool hasDefault = false;
+
+		CHECK_NO_THROW(tmpKey->EnumerateValues([&](std::wstring_view name, DWORD dwType, const BYTE* pData, DWORD cbData) -> bool
+		{
+			++count;
+
+			if (name.empty())
+			{
+				hasDefault = true;
+			}
+			else if (name == L"BC")
+			{
+				LONG lData = 0;
+
+				assert(dwType == REG_DWORD && cbData == sizeof(lData));
+				std::memcpy(&lData, pData, cbData);
+				assert(lData == -1);
+			}
+			else if (name == L"FC")
+			{
+				assert(dwType == REG_SZ);
+				assert(std::wstring(reinterpret_cast<const wchar_t*>(pData), cbData / sizeof(wchar_t)).c_str() == val);
+			}
+			else if (name == L"FA")
+			{
+				assert(dwType == REG_SZ);
+			}
+
+			return true;
+		}));
+
+		// Default value and 24 named values
+		assert(count == 25);
+		assert(hasDefault);
+
+		count = 0;
+
+		CHECK_NO_THROW(tmpKey->EnumerateValues([&](std::wstring_view, DWORD, const BYTE*, DWORD) -> bool
+		{
+			return ++count < 3;
+		}));
+
+		assert(count == 3);
+	}
+
+	CHECK_NO_THROW(subKey->Delete(L"TEST1"));
+
+	// Exception-free open
+	{
+		std::error_code ec;
+
+		assert(subKey->TryOpen(L"TEST1", Registry::DesiredAccess::Read, ec) == nullptr);
+		assert(ec.value() == ERROR_FILE_NOT_FOUND);
+		assert(subKey->TryOpen(L"", Registry::DesiredAccess::Read, ec) == nullptr);
+		assert(ec.value() == ERROR_INVALID_PARAMETER);
+
+		CHECK_NO_THROW(subKey->Create(L"TEST1"));
+		assert(subKey->TryOpen(L"TEST1", Registry::DesiredAccess::Read, ec) != nullptr);
+		assert(!ec);
+		CHECK_NO_THROW(subKey->Delete(L"TEST1"));
+	}
+}
+
+void TestMemoryBackend()
+{
+	auto backend = std::make_shared<Registry::MemoryBackend>();
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+
+	CHECK_THROWS_AS(Registry::RegistryKey(HKEY_CURRENT_USER, nullptr), std::invalid_argument&);
+
+	CHECK_THROWS_AS(root->Open(L""), std::invalid_argument&);
+	CHECK_THROWS_AS(root->Open(L"NOT_EXISTING_REGISTRY_KEY"), std::system_error&);
+	CHECK_THROWS_AS(root->Create(L""), std::invalid_argument&);
+
+	try
+	{
+		root->Open(L"NOT_EXISTING_REGISTRY_KEY");
+		assert(0);
+	}
+	catch (const std::system_error& e)
+	{
+		assert(e.code().value() == ERROR_FILE_NOT_FOUND);
+	}
+
+	{
+		auto subKey = root->Create(L"OUR_TESTING_SUBKEY\\Nested", Registry::DesiredAccess::AllAccess);
+
+		assert(root->HasKey(L"OUR_TESTING_SUBKEY") == true);
+		assert(root->HasKey(L"our_testing_subkey\\NESTED") == true);
+		assert(root->HasKey(L"OUR_TESTING_SUBKEY\\KEY_THAT_DOES_NOT_EXISTS") == false);
+
+		{
+			auto key = root->Open(L"OUR_TESTING_SUBKEY");
+
+			CHECK_THROWS_AS(key->Create(L"CANNOT_CREATE_ACCESS_DENIED"), std::system_error&);
+			CHECK_THROWS_AS(key->SetInt32(L"CANNOT_SET_ACCESS_DENIED", 1), std::system_error&);
+
+			std::vector<std::wstring> subKeys;
+
+			key->EnumerateSubKeys([&subKeys](const std::wstring& name) -> bool
+			{
+				subKeys.push_back(name);
+
+				return true;
+			});
+
+			assert(subKeys.size() == 1 && subKeys[0] == L"Nested");
+		}
+
+		CHECK_NO_THROW(subKey->SetExpandString(L"%ProgramFiles%\\My Company\\My Product\\Program.exe"));
+		assert(subKey->GetString() == L"%ProgramFiles%\\My Company\\My Product\\Program.exe");
+
+		TestValues(subKey);
+
+		CHECK_NO_THROW(root->Delete(L"OUR_TESTING_SUBKEY"));
+		assert(root->HasKey(L"OUR_TESTING_SUBKEY") == false);
+
+		// Handles to deleted keys cannot be used anymore
+		CHECK_THROWS_AS(subKey->GetString(), std::system_error&);
+	}
+
+	// Enumerating values allocates single buffer, regardless of number of values
+	{
+		auto key = root->Create(L"OUR_TESTING_SUBKEY", Registry::DesiredAccess::AllAccess);
+
+		for (int i = 0; i < 1000; ++i)
+		{
+			key->SetString(L"Value" + std::to_wstring(i), std::wstring(i % 50, L'x'));
+		}
+
+		size_t count = 0;
+		size_t cbTotal = 0;
+
+		const size_t allocations = g_allocations;
+
+		key->EnumerateValues([&](std::wstring_view, DWORD, const BYTE*, DWORD cbData) -> bool
+		{
+			++count;
+			cbTotal += cbData;
+
+			return true;
+		});
+
+		assert(g_allocations == allocations + 1);
+		assert(count == 1000);
+		assert(cbTotal == 20 * 49 * 25 * sizeof(wchar_t));
+
+		CHECK_NO_THROW(root->Delete(L"OUR_TESTING_SUBKEY"));
+	}
+
+	// Callbacks run without holding any lock, so they can change registry and unsubscribe themselves
+	{
+		auto key = root->Create(L"OUR_TESTING_SUBKEY", Registry::DesiredAccess::AllAccess);
+
+		size_t calls = 0;
+		size_t otherCalls = 0;
+		DWORD dwCookie = 0;
+		DWORD dwOtherCookie = 0;
+
+		assert(backend->Subscribe(*key, false, REG_NOTIFY_CHANGE_LAST_SET, [&]()
+		{
+			++calls;
+
+			if (calls == 2)
+			{
+				assert(backend->Unsubscribe(dwCookie) == ERROR_SUCCESS);
+			}
+
+			// Change made by callback is reported again, to this callback too while it is subscribed
+			key->SetInt32(L"Echo", static_cast<LONG>(calls));
+		}, &dwCookie) == ERROR_SUCCESS);
+
+		assert(backend->Subscribe(*key, false, REG_NOTIFY_CHANGE_LAST_SET, [&otherCalls]() { ++otherCalls; }, &dwOtherCookie) == ERROR_SUCCESS);
+
+		key->SetInt32(L"Value", 1);
+
+		assert(calls == 2);
+		assert(otherCalls == 3);
+		assert(key->GetInt32(L"Echo") == 2);
+
+		key->SetInt32(L"Value", 2);
+
+		assert(calls == 2);
+		assert(otherCalls == 4);
+		assert(backend->Unsubscribe(dwCookie) == ERROR_INVALID_PARAMETER);
+		assert(backend->Unsubscribe(dwOtherCookie) == ERROR_SUCCESS);
+
+		// Unsubscribe() waits for callback running on other thread
+		std::atomic<bool> entered(false);
+		std::atomic<bool> release(false);
+		std::atomic<bool> finished(false);
+
+		assert(backend->Subscribe(*key, false, REG_NOTIFY_CHANGE_LAST_SET, [&]()
+		{
+			entered = true;
+
+			while (!release)
+			{
+				std::this_thread::yield();
+			}
+
+			finished = true;
+		}, &dwCookie) == ERROR_SUCCESS);
+
+		std::thread writer([&key]() { key->SetInt32(L"Value", 3); });
+
+		while (!entered)
+		{
+			std::this_thread::yield();
+		}
+
+		std::thread releaser([&release]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+			release = true;
+		});
+
+		assert(backend->Unsubscribe(dwCookie) == ERROR_SUCCESS);
+		assert(finished == true);
+
+		writer.join();
+		releaser.join();
+
+		CHECK_NO_THROW(root->Delete(L"OUR_TESTING_SUBKEY"));
+	}
+
+	// Each backend instance holds its own registry
+	auto other = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, std::make_shared<Registry::MemoryBackend>());
+
+	root->Create(L"OUR_TESTING_SUBKEY");
+	assert(root->HasKey(L"OUR_TESTING_SUBKEY") == true);
+	assert(other->HasKey(L"OUR_TESTING_SUBKEY") == false);
+	CHECK_NO_THROW(root->Delete(L"OUR_TESTING_SUBKEY"));
+}
+
+// Forwards to memory backend, but reads multiple values as Windows registry does, by default RegistryBackend::QueryValues()
+class MultipleValuesBackend : public Registry::RegistryBackend
+{
+public:
+	explicit MultipleValuesBackend(const Registry::RegistryBackend_ptr& backend)
+		: m_backend(backend)
+	{
+	}
+
+	// Makes RegQueryMultipleValues() fail as if data exceeded its limit
+	void SetTransferTooLong(bool tooLong)
+	{
+		m_tooLong = tooLong;
+	}
+
+	size_t MultipleValuesCalls() const
+	{
+		return m_calls;
+	}
+
+	LSTATUS OpenKey(HKEY hKey, const wchar_t* lpSubKey, REGSAM samDesired, HKEY* phkResult) override
+	{
+		return m_backend->OpenKey(hKey, lpSubKey, samDesired, phkResult);
+	}
+
+	LSTATUS CreateKey(HKEY hKey, const wchar_t* lpSubKey, DWORD dwOptions, REGSAM samDesired, HKEY* phkResult) override
+	{
+		return m_backend->CreateKey(hKey, lpSubKey, dwOptions, samDesired, phkResult);
+	}
+
+	LSTATUS CloseKey(HKEY hKey) override
+	{
+		return m_backend->CloseKey(hKey);
+	}
+
+	LSTATUS DeleteTree(HKEY hKey, const wchar_t* lpSubKey) override
+	{
+		return m_backend->DeleteTree(hKey, lpSubKey);
+	}
+
+	LSTATUS DeleteValue(HKEY hKey, const wchar_t* lpValueName) override
+	{
+		return m_backend->DeleteValue(hKey, lpValueName);
+	}
+
+	LSTATUS FlushKey(HKEY hKey) override
+	{
+		return m_backend->FlushKey(hKey);
+	}
+
+	LSTATUS SaveKey(HKEY hKey, const wchar_t* lpFile) override
+	{
+		return m_backend->SaveKey(hKey, lpFile);
+	}
+
+	LSTATUS QueryValue(HKEY hKey, const wchar_t* lpValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) override
+	{
+		return m_backend->QueryValue(hKey, lpValueName, lpType, lpData, lpcbData);
+	}
+
+	LSTATUS QueryMultipleValues(HKEY hKey, PVALENTW val_list, DWORD num_vals, LPBYTE lpValueBuf, LPDWORD ldwTotsize) override
+	{
+		++m_calls;
+
+		if (m_tooLong)
+		{
+			return ERROR_TRANSFER_TOO_LONG;
+		}
+
+		return m_backend->QueryMultipleValues(hKey, val_list, num_vals, lpValueBuf, ldwTotsize);
+	}
+
+	LSTATUS SetValue(HKEY hKey, const wchar_t* lpValueName, DWORD dwType, const BYTE* lpData, DWORD cbData) override
+	{
+		return m_backend->SetValue(hKey, lpValueName, dwType, lpData, cbData);
+	}
+
+	LSTATUS QueryInfoKey(HKEY hKey, LPDWORD lpcSubKeys, LPDWORD lpcchMaxSubKeyLen, LPDWORD lpcValues, LPDWORD lpcchMaxValueNameLen, LPDWORD lpcbMaxValueLen, FILETIME* lpftLastWriteTime) override
+	{
+		return m_backend->QueryInfoKey(hKey, lpcSubKeys, lpcchMaxSubKeyLen, lpcValues, lpcchMaxValueNameLen, lpcbMaxValueLen, lpftLastWriteTime);
+	}
+
+	LSTATUS EnumKey(HKEY hKey, DWORD dwIndex, wchar_t* lpName, LPDWORD lpcchName) override
+	{
+		return m_backend->EnumKey(hKey, dwIndex, lpName, lpcchName);
+	}
+
+	LSTATUS EnumValue(HKEY hKey, DWORD dwIndex, wchar_t* lpValueName, LPDWORD lpcchValueName, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData) override
+	{
+		return m_backend->EnumValue(hKey, dwIndex, lpValueName, lpcchValueName, lpType, lpData, lpcbData);
+	}
+
+	LSTATUS NotifyChangeKeyValue(HKEY hKey, bool watchSubtree, DWORD dwNotifyFilter, HANDLE hEvent, bool asynchronous) override
+	{
+		return m_backend->NotifyChangeKeyValue(hKey, watchSubtree, dwNotifyFilter, hEvent, asynchronous);
+	}
+
+	LSTATUS ApplyBatch(HKEY hKey, const Registry::BatchOperation* pOperations, DWORD cOperations) override
+	{
+		return m_backend->ApplyBatch(hKey, pOperations, cOperations);
+	}
+
+private:
+	Registry::RegistryBackend_ptr m_backend;
+	bool m_tooLong = false;
+	size_t m_calls = 0;
+};
+
+void TestQueryValues()
+{
+	auto backend = std::make_shared<MultipleValuesBackend>(std::make_shared<Registry::MemoryBackend>());
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+	auto key = root->Create(L"OUR_TESTING_SUBKEY", Registry::DesiredAccess::AllAccess);
+
+	key->SetInt32(L"Timeout", 30);
+	key->SetString(L"FileName", std::wstring(300, L'x'));
+	key->SetInt64(L"Size", INT64_MAX);
+
+	Registry::RegistryValues values;
+
+	// All values exist, read by single call after size is known
+	key->GetValues({ L"Timeout", L"FileName", L"Size" }, values);
+	assert(backend->MultipleValuesCalls() == 2);
+	assert(values.GetInt32(0) == 30);
+	assert(values.GetString(1) == std::wstring(300, L'x'));
+	assert(values.GetInt64(2) == INT64_MAX);
+
+	// Missing values are found out and the rest is still read together
+	const std::vector<std::wstring_view> names = { L"Severity", L"Timeout", L"Missing", L"Size" };
+
+	key->GetValues(names, values);
+	assert(values.Count() == 4);
+	assert(values.GetStatus(0) == ERROR_FILE_NOT_FOUND && values.GetType(0) == REG_NONE);
+	assert(values.GetInt32(1) == 30);
+	assert(values.GetStatus(2) == ERROR_FILE_NOT_FOUND);
+	assert(values.GetInt64(3) == INT64_MAX);
+
+	// Data too large for single call are read one by one
+	backend->SetTransferTooLong(true);
+
+	key->SetString(L"FileName", std::wstring(5000, L'y'));
+
+	key->GetValues({ L"FileName", L"Missing", L"Timeout" }, values);
+	assert(values.GetString(0) == std::wstring(5000, L'y'));
+	assert(values.GetStatus(1) == ERROR_FILE_NOT_FOUND);
+	assert(values.GetInt32(2) == 30);
+
+	backend->SetTransferTooLong(false);
+
+	// Key which cannot be read still fails whole call
+	root->Delete(L"OUR_TESTING_SUBKEY");
+
+	CHECK_THROWS_AS(key->GetValues({ L"Timeout" }, values), std::system_error&);
+}
+
+void TestCachedRegistryKey()
+{
+	auto backend = std::make_shared<Registry::MemoryBackend>();
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+
+	auto writer = root->Create(L"OUR_TESTING_SUBKEY", Registry::DesiredAccess::AllAccess);
+
+	writer->SetString(L"Name", L"first");
+	writer->SetInt32(L"Count", 1);
+	writer->SetInt64(L"Big", INT64_MAX);
+
+	CHECK_THROWS_AS(Registry::CachedRegistryKey(nullptr), std::invalid_argument&);
+
+	{
+		Registry::CachedRegistryKey cache(root->Open(L"OUR_TESTING_SUBKEY"));
+
+		assert(cache.GetString(L"Name") == L"first");
+		assert(cache.GetString(L"Name") == L"first");
+		assert(cache.GetInt32(L"Count") == 1);
+		assert(cache.GetInt64(L"Big") == INT64_MAX);
+		assert(cache.HasValue(L"Missing") == false);
+
+		// Same errors as RegistryKey reports
+		CHECK_THROWS_AS(cache.GetInt32(L"Big"), std::system_error&);
+		CHECK_THROWS_AS(cache.GetString(L"Count"), std::runtime_error&);
+		CHECK_THROWS_AS(cache.GetInt32(L"Missing"), std::system_error&);
+
+		// Changes made through other handle invalidate cached values
+		writer->SetString(L"Name", L"second, which does not fit into small buffer");
+		writer->SetInt32(L"Count", 2);
+		writer->SetBoolean(L"Missing", true);
+
+		assert(cache.GetString(L"Name") == L"second, which does not fit into small buffer");
+		assert(cache.GetInt32(L"Count") == 2);
+		assert(cache.HasValue(L"Missing") == true);
+		assert(cache.GetBoolean(L"Missing") == true);
+
+		writer->Delete(L"Count");
+
+		CHECK_THROWS_AS(cache.GetInt32(L"Count"), std::system_error&);
+	}
+
+	CHECK_NO_THROW(root->Delete(L"OUR_TESTING_SUBKEY"));
+}
+
+void TestKeyCache()
+{
+	auto backend = std::make_shared<Registry::MemoryBackend>();
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_LOCAL_MACHINE, backend);
+
+	root->Create(L"SOFTWARE\\Vendor\\Product\\Component");
+	root->Create(L"SOFTWARE\\Vendor\\Other");
+
+	CHECK_THROWS_AS(Registry::KeyCache(0), std::invalid_argument&);
+
+	Registry::KeyCache cache(2);
+
+	CHECK_THROWS_AS(cache.Open(nullptr, L"SOFTWARE"), std::invalid_argument&);
+	CHECK_THROWS_AS(cache.Open(root, L""), std::invalid_argument&);
+	CHECK_THROWS_AS(cache.Open(root, L"NOT_EXISTING_REGISTRY_KEY"), std::system_error&);
+	assert(cache.Size() == 0);
+
+	assert(Registry::KeyCache::Normalize(L"\\Software\\\\vendor\\") == L"SOFTWARE\\VENDOR");
+
+	auto component = cache.Open(root, L"SOFTWARE\\Vendor\\Product\\Component");
+
+	// Same key differing only in case and separators is served from cache
+	assert(cache.Open(root, L"software\\vendor\\product\\component\\") == component);
+	assert(cache.Open(root, L"SOFTWARE\\Vendor\\Product\\Component") == component);
+	assert(cache.Hits() == 2);
+	assert(cache.Misses() == 2);
+
+	// Hit does not allocate, path passed as literal or view is not copied into temporary string
+	{
+		const size_t allocations = g_allocations;
+
+		assert(cache.Open(root, L"SOFTWARE\\Vendor\\Product\\Component") == component);
+		assert(cache.Open(root, std::wstring_view(L"software\\vendor\\product\\component")) == component);
+		assert(g_allocations == allocations);
+	}
+
+	// Different access rights use different handle
+	auto writable = cache.Create(root, L"SOFTWARE\\Vendor\\Product\\Component", Registry::DesiredAccess::AllAccess);
+	assert(writable != component);
+	CHECK_NO_THROW(writable->SetInt32(L"Severity", 3));
+	assert(component->GetInt32(L"Severity") == 3);
+	assert(cache.Size() == 2);
+
+	// Least recently used key is released when capacity is exceeded
+	std::weak_ptr<Registry::RegistryKey> weakWritable = writable;
+	writable.reset();
+
+	assert(cache.Open(root, L"SOFTWARE\\Vendor\\Product\\Component") == component);
+	cache.Open(root, L"SOFTWARE\\Vendor\\Other");
+
+	assert(cache.Size() == 2);
+	assert(cache.Evictions() == 1);
+	assert(weakWritable.expired());
+	assert(cache.Open(root, L"SOFTWARE\\Vendor\\Product\\Component") == component);
+
+	cache.Invalidate(root, L"SOFTWARE\\VENDOR\\PRODUCT\\COMPONENT");
+	assert(cache.Size() == 1);
+	assert(cache.Open(root, L"SOFTWARE\\Vendor\\Product\\Component") != component);
+
+	cache.Clear();
+	assert(cache.Size() == 0);
+}
+
+/// <summary>
+///		Backend without any keys or values, remembering last name it was called with
+/// </summary>
+class NameRecordingBackend final : public Registry::RegistryBackend
+{
+public:
+	const wchar_t* LastName() const
+	{
+		return m_lastName;
+	}
+
+	LSTATUS OpenKey(HKEY, const wchar_t* lpSubKey, REGSAM, HKEY*) override
+	{
+		return Record(lpSubKey, ERROR_FILE_NOT_FOUND);
+	}
+
+	LSTATUS CreateKey(HKEY, const wchar_t* lpSubKey, DWORD, REGSAM, HKEY*) override
+	{
+		return Record(lpSubKey, ERROR_ACCESS_DENIED);
+	}
+
+	LSTATUS CloseKey(HKEY) override
+	{
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS DeleteTree(HKEY, const wchar_t* lpSubKey) override
+	{
+		return Record(lpSubKey, ERROR_FILE_NOT_FOUND);
+	}
+
+	LSTATUS DeleteValue(HKEY, const wchar_t* lpValueName) override
+	{
+		return Record(lpValueName, ERROR_FILE_NOT_FOUND);
+	}
+
+	LSTATUS FlushKey(HKEY) override
+	{
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS SaveKey(HKEY, const wchar_t* lpFile) override
+	{
+		return Record(lpFile, ERROR_NOT_SUPPORTED);
+	}
+
+	LSTATUS QueryValue(HKEY, const wchar_t* lpValueName, LPDWORD, LPBYTE, LPDWORD) override
+	{
+		return Record(lpValueName, ERROR_FILE_NOT_FOUND);
+	}
+
+	LSTATUS QueryMultipleValues(HKEY, PVALENTW, DWORD, LPBYTE, LPDWORD) override
+	{
+		return ERROR_FILE_NOT_FOUND;
+	}
+
+	LSTATUS SetValue(HKEY, const wchar_t* lpValueName, DWORD, const BYTE*, DWORD) override
+	{
+		return Record(lpValueName, ERROR_SUCCESS);
+	}
+
+	LSTATUS QueryInfoKey(HKEY, LPDWORD, LPDWORD, LPDWORD, LPDWORD, LPDWORD, FILETIME*) override
+	{
+		return ERROR_NOT_SUPPORTED;
+	}
+
+	LSTATUS EnumKey(HKEY, DWORD, wchar_t*, LPDWORD) override
+	{
+		return ERROR_NO_MORE_ITEMS;
+	}
+
+	LSTATUS EnumValue(HKEY, DWORD, wchar_t*, LPDWORD, LPDWORD, LPBYTE, LPDWORD) override
+	{
+		return ERROR_NO_MORE_ITEMS;
+	}
+
+	LSTATUS NotifyChangeKeyValue(HKEY, bool, DWORD, HANDLE, bool) override
+	{
+		return ERROR_NOT_SUPPORTED;
+	}
+
+	LSTATUS ApplyBatch(HKEY, const Registry::BatchOperation*, DWORD) override
+	{
+		return ERROR_NOT_SUPPORTED;
+	}
+
+private:
+	LSTATUS Record(const wchar_t* name, LSTATUS lStatus)
+	{
+		const size_t capacity = sizeof(m_lastName) / sizeof(m_lastName[0]);
+
+		wcsncpy(m_lastName, (name != nullptr) ? name : L"", capacity - 1);
+		m_lastName[capacity - 1] = L'\0';
+
+		return lStatus;
+	}
+
+private:
+	wchar_t m_lastName[512] = {};
+};
+
+void TestStringRef()
+{
+	auto backend = std::make_shared<NameRecordingBackend>();
+	auto key = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+
+	const std::wstring path = L"SOFTWARE\\Vendor\\Product";
+	const std::wstring_view view = path;
+	const std::wstring longName(300, L'x');
+
+	std::error_code ec;
+
+	// Literals, strings and views are passed to backend without heap allocation
+	const size_t allocations = g_allocations;
+
+	assert(key->HasValue(L"Severity") == false);
+	assert(wcscmp(backend->LastName(), L"Severity") == 0);
+
+	assert(key->HasValue(path) == false);
+	assert(wcscmp(backend->LastName(), path.c_str()) == 0);
+
+	assert(key->TryOpen(view.substr(0, 8), Registry::DesiredAccess::Read, ec) == nullptr);
+	assert(wcscmp(backend->LastName(), L"SOFTWARE") == 0);
+	assert(ec.value() == ERROR_FILE_NOT_FOUND);
+
+	assert(!key->TryGetInt32(view.substr(9, 6), ec));
+	assert(wcscmp(backend->LastName(), L"Vendor") == 0);
+
+	key->SetString(view.substr(16), view.substr(0, 8));
+	assert(wcscmp(backend->LastName(), L"Product") == 0);
+
+	assert(g_allocations == allocations);
+
+	// Views longer than inline buffer are still terminated correctly
+	assert(key->HasValue(std::wstring_view(longName).substr(0, 200)) == false);
+	assert(std::wstring(backend->LastName()) == std::wstring(200, L'x'));
+
+	CHECK_THROWS_AS(key->HasValue(std::wstring_view()), std::invalid_argument&);
+}
+
+void TestWalk()
+{
+	auto backend = std::make_shared<Registry::MemoryBackend>();
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_LOCAL_MACHINE, backend);
+
+	// Three levels of four subkeys each
+	std::set<std::wstring> expected;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			for (int k = 0; k < 4; ++k)
+			{
+				auto path = std::to_wstring(i) + L"\\" + std::to_wstring(j) + L"\\" + std::to_wstring(k);
+
+				root->Create(path);
+
+				expected.insert(path);
+				expected.insert(path.substr(0, 3));
+				expected.insert(path.substr(0, 1));
+			}
+		}
+	}
+
+	std::mutex mutex;
+	std::set<std::wstring> visited;
+
+	auto collect = [&](const std::wstring& path, const Registry::RegistryKey_ptr& key, size_t depth)
+	{
+		assert(key != nullptr);
+		assert(depth == static_cast<size_t>(std::count(path.begin(), path.end(), L'\\') + 1));
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		visited.insert(path);
+
+		return Registry::WalkAction::Continue;
+	};
+
+	Registry::WalkOptions options;
+	options.threads = 4;
+
+	auto result = Registry::Walk(root, collect, options);
+	assert(result.visited == expected.size());
+	assert(result.errors == 0);
+	assert(result.stopped == false);
+	assert(visited == expected);
+
+	// Depth limit
+	visited.clear();
+	options.maxDepth = 2;
+
+	result = Registry::Walk(root, collect, options);
+	assert(result.visited == 4 + 16);
+	assert(visited.count(L"3\\3") == 1);
+	assert(visited.count(L"3\\3\\3") == 0);
+
+	options.maxDepth = 0;
+	assert(Registry::Walk(root, collect, options).visited == 0);
+
+	// Pruning
+	options.maxDepth = std::numeric_limits<size_t>::max();
+
+	result = Registry::Walk(root, [](const std::wstring& path, const Registry::RegistryKey_ptr&, size_t)
+	{
+		return (path == L"0") ? Registry::WalkAction::Skip : Registry::WalkAction::Continue;
+	}, options);
+
+	assert(result.visited == expected.size() - 20);
+
+	// Cancellation
+	std::atomic<size_t> calls(0);
+
+	result = Registry::Walk(root, [&](const std::wstring&, const Registry::RegistryKey_ptr&, size_t)
+	{
+		return (++calls == 5) ? Registry::WalkAction::Stop : Registry::WalkAction::Continue;
+	}, options);
+
+	assert(result.stopped == true);
+	assert(result.visited < expected.size());
+
+	// Exception thrown by visitor stops walk
+	CHECK_THROWS_AS(Registry::Walk(root, [](const std::wstring&, const Registry::RegistryKey_ptr&, size_t) -> Registry::WalkAction
+	{
+		throw std::runtime_error("Visitor failed");
+	}, options), std::runtime_error&);
+
+	CHECK_THROWS_AS(Registry::Walk(nullptr, collect, options), std::invalid_argument&);
+	CHECK_THROWS_AS(Registry::Walk(root, nullptr, options), std::invalid_argument&);
+}
+
+// Fills key with tree compared by TestDiff
+static void FillDiffTree(const Registry::RegistryKey_ptr& root)
+{
+	for (int i = 0; i < 10; i++)
+	{
+		auto key = root->Create(L"Key" + std::to_wstring(i), Registry::DesiredAccess::AllAccess);
+
+		key->SetString(L"", L"Key " + std::to_wstring(i));
+		key->SetInt32(L"Index", i);
+
+		for (int j = 0; j < 10; j++)
+		{
+			key->Create(L"Sub" + std::to_wstring(j), Registry::DesiredAccess::AllAccess)->SetInt64(L"Value", i * 10 + j);
+		}
+	}
+}
+
+// Collects differences as "action path:name" strings
+static std::vector<std::wstring> g_differences;
+
+static bool CollectDifference(const Registry::DiffEntry& entry)
+{
+	static const wchar_t* actions[] = { L"+key ", L"-key ", L"+value ", L"-value ", L"*value " };
+
+	g_differences.push_back(actions[static_cast<int>(entry.action)] + std::wstring(entry.path) + L":" + std::wstring(entry.name));
+
+	return true;
+}
+
+void TestDiff()
+{
+	auto first = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, std::make_shared<Registry::MemoryBackend>());
+	auto second = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, std::make_shared<Registry::MemoryBackend>());
+
+	FillDiffTree(first);
+	FillDiffTree(second);
+
+	CHECK_THROWS_AS(Registry::Diff(first, Registry::RegistryKey_ptr(), CollectDifference), std::invalid_argument&);
+
+	auto result = Registry::Diff(first, second, CollectDifference);
+
+	assert(result.keys == 111);
+	assert(result.differences == 0);
+	assert(g_differences.empty());
+
+	// Names are compared case insensitive and trailing null characters of strings are ignored
+	second->Open(L"Key0", Registry::DesiredAccess::AllAccess)->Delete(L"Sub0");
+	second->Open(L"Key0", Registry::DesiredAccess::AllAccess)->Create(L"SUB0", Registry::DesiredAccess::AllAccess)->SetInt64(L"VALUE", 0);
+
+	{
+		const wchar_t terminated[] = L"Key 1";
+
+		auto key = second->Open(L"Key1", Registry::DesiredAccess::AllAccess);
+
+		assert(key->GetBackend()->SetValue(*key, nullptr, REG_SZ, reinterpret_cast<const BYTE*>(terminated), sizeof(terminated)) == ERROR_SUCCESS);
+	}
+
+	result = Registry::Diff(first, second, CollectDifference);
+
+	assert(result.differences == 0);
+
+	second->Open(L"Key2", Registry::DesiredAccess::AllAccess)->SetInt32(L"Index", 20);
+	second->Open(L"Key3", Registry::DesiredAccess::AllAccess)->SetString(L"Index", L"3");
+	second->Open(L"Key4", Registry::DesiredAccess::AllAccess)->Delete(L"Index");
+	second->Open(L"Key5\\Sub5", Registry::DesiredAccess::AllAccess)->SetString(L"Added", L"Added");
+	second->Open(L"Key6", Registry::DesiredAccess::AllAccess)->Delete(L"Sub6");
+	second->Create(L"Key10\\Sub0\\Sub1", Registry::DesiredAccess::AllAccess);
+
+	result = Registry::Diff(first, second, CollectDifference);
+
+	std::sort(g_differences.begin(), g_differences.end());
+
+	const std::vector<std::wstring> expected =
+	{
+		L"*value Key2:Index",
+		L"*value Key3:Index",
+		L"+key Key10:",
+		L"+value Key5\\Sub5:Added",
+		L"-key Key6\\Sub6:",
+		L"-value Key4:Index"
+	};
+
+	assert(g_differences == expected);
+	assert(result.differences == 6);
+	assert(result.stopped == false);
+
+	g_differences.clear();
+
+	// Changed value carries both old and new data
+	Registry::Diff(first->Open(L"Key2"), second->Open(L"Key2"), [](const Registry::DiffEntry& entry) -> bool
+	{
+		assert(entry.action == Registry::DiffAction::ValueChanged && entry.path.empty() && entry.name == L"Index");
+		assert(entry.oldType == REG_DWORD && entry.cbOldData == sizeof(DWORD) && *reinterpret_cast<const DWORD*>(entry.pOldData) == 2);
+		assert(entry.newType == REG_DWORD && entry.cbNewData == sizeof(DWORD) && *reinterpret_cast<const DWORD*>(entry.pNewData) == 20);
+
+		return true;
+	});
+
+	// Callback stops comparison
+	result = Registry::Diff(first, second, [](const Registry::DiffEntry&) -> bool
+	{
+		return false;
+	});
+
+	assert(result.differences == 1 && result.stopped == true);
+
+	// Subkeys deeper than maxDepth are not compared
+	Registry::DiffOptions options;
+	options.maxDepth = 1;
+
+	result = Registry::Diff(first, second, CollectDifference, options);
+
+	assert(result.keys == 11);
+	assert(result.differences == 4);
+
+	g_differences.clear();
+
+	// Snapshots skip identical subtrees by their digests
+	Registry::SnapshotWriter(first).Save(L"RegistryTest1.snap");
+	Registry::SnapshotWriter(second).Save(L"RegistryTest2.snap");
+
+	{
+		Registry::SnapshotFile firstSnapshot(L"RegistryTest1.snap");
+		Registry::SnapshotFile secondSnapshot(L"RegistryTest2.snap");
+
+		result = Registry::Diff(firstSnapshot.Root(), secondSnapshot.Root(), CollectDifference);
+
+		std::sort(g_differences.begin(), g_differences.end());
+
+		assert(g_differences == expected);
+		assert(result.skipped > 0);
+		assert(result.keys < 111);
+
+		g_differences.clear();
+
+		result = Registry::Diff(firstSnapshot.Root(), firstSnapshot.Root(), CollectDifference);
+
+		assert(result.keys == 1 && result.skipped == 1 && result.differences == 0);
+
+		// Live tree against snapshot
+		result = Registry::Diff(first, secondSnapshot.Root(), CollectDifference);
+
+		std::sort(g_differences.begin(), g_differences.end());
+
+		assert(g_differences == expected);
+
+		g_differences.clear();
+
+		// Trusted last write times skip comparison of values of unchanged keys
+		options = Registry::DiffOptions();
+		options.trustLastWriteTime = true;
+
+		result = Registry::Diff(first, firstSnapshot.Root(), CollectDifference, options);
+
+		assert(result.differences == 0);
+		assert(result.skipped == result.keys);
+
+		first->Open(L"Key9\\Sub9", Registry::DesiredAccess::AllAccess)->SetInt64(L"Value", 0);
+
+		result = Registry::Diff(first, firstSnapshot.Root(), CollectDifference, options);
+
+		assert(result.differences == 1);
+		assert(g_differences.size() == 1 && g_differences[0] == L"*value Key9\\Sub9:Value");
+
+		g_differences.clear();
+	}
+
+	std::remove("RegistryTest1.snap");
+	std::remove("RegistryTest2.snap");
+
+	// Offline hive against live tree
+	{
+		TestHive image;
+
+		auto vendor = image.AddKey("Vendor", {}, {}, { image.AddValue("Name", REG_SZ, TestHive::Utf16(L"Vendor name")) });
+		auto root = image.AddKey("ROOT", { vendor }, { "Vendor" }, { image.AddValue("", REG_SZ, TestHive::Utf16(L"Default")) });
+
+		image.Save("RegistryTest.hiv", root);
+	}
+
+	{
+		Registry::HiveFile hive(L"RegistryTest.hiv");
+
+		auto key = second->Create(L"Hive\\Vendor", Registry::DesiredAccess::AllAccess);
+
+		key->SetString(L"Name", L"Other name");
+		second->Open(L"Hive", Registry::DesiredAccess::AllAccess)->SetString(L"", L"Default");
+
+		result = Registry::Diff(hive.Root(), second->Open(L"Hive"), CollectDifference);
+
+		assert(result.keys == 2);
+		assert(g_differences.size() == 1 && g_differences[0] == L"*value Vendor:Name");
+
+		g_differences.clear();
+	}
+
+	std::remove("RegistryTest.hiv");
+}
+
+// Collects names of values in enumeration order
+static std::vector<std::wstring> ValueNames(const Registry::RegistryKey_ptr& key)
+{
+	std::vector<std::wstring> names;
+
+	key->EnumerateValues([&names](std::wstring_view name, DWORD, const BYTE*, DWORD) -> bool
+	{
+		names.emplace_back(name);
+
+		return true;
+	});
+
+	return names;
+}
+
+void TestWriteBatch()
+{
+	auto backend = std::make_shared<Registry::MemoryBackend>();
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+	auto key = root->Create(L"Software\\Batch", Registry::DesiredAccess::AllAccess);
+
+	key->SetString(L"Existing", L"Value");
+	key->SetInt32(L"Obsolete", 1);
+	key->SetInt32(L"Last", 2);
+	key->Create(L"Old\\Nested", Registry::DesiredAccess::AllAccess);
+
+	CHECK_THROWS_AS(Registry::WriteBatch().Commit(nullptr), std::invalid_argument&);
+	CHECK_THROWS_AS(Registry::WriteBatch().SetValue(L"", L"Name", REG_BINARY, nullptr, 1), std::invalid_argument&);
+	CHECK_THROWS_AS(Registry::WriteBatch().DeleteKey(L"").Commit(key), std::system_error&);
+	CHECK_THROWS_AS(Registry::WriteBatch().SetInt32(L"", L"Name", 1).Commit(root->Open(L"Software\\Batch")), std::system_error&);
+
+	size_t notifications = 0;
+	DWORD dwCookie = 0;
+
+	assert(backend->Subscribe(*key, true, REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET, [&notifications]() { ++notifications; }, &dwCookie) == ERROR_SUCCESS);
+
+	Registry::WriteBatch batch;
+
+	batch
+		.CreateKey(L"New\\Sub")
+		.SetString(L"New\\Sub", L"Name", L"Value")
+		.SetInt32(L"", L"Existing", 42)
+		.SetInt64(L"new", L"Qword", 1234567890123)
+		.SetBoolean(L"", L"Enabled", true)
+		.DeleteValue(L"", L"Obsolete")
+		.DeleteKey(L"Old");
+
+	assert(batch.Size() == 7);
+
+	CHECK_NO_THROW(batch.Commit(key));
+
+	// Whole batch is reported as single change
+	assert(notifications == 1);
+
+	assert(key->GetInt32(L"Existing") == 42);
+	assert(key->Open(L"New\\Sub")->GetString(L"Name") == L"Value");
+	assert(key->Open(L"New")->GetInt64(L"Qword") == 1234567890123);
+	assert(key->GetBoolean(L"Enabled") == true);
+	assert(key->HasValue(L"Obsolete") == false);
+	assert(key->HasKey(L"Old") == false);
+
+	// Failing operation reverts whole batch, including order of values
+	const auto names = ValueNames(key);
+
+	batch.Clear();
+	assert(batch.Empty());
+
+	batch
+		.SetString(L"", L"Existing", L"Changed")
+		.SetString(L"", L"Added", L"Added")
+		.CreateKey(L"Created\\Deep")
+		.SetInt32(L"Created\\Deep", L"Value", 1)
+		.DeleteValue(L"", L"Existing")
+		.DeleteKey(L"New")
+		.DeleteValue(L"", L"Enabled")
+		.SetString(L"Missing", L"Name", L"Value");
+
+	CHECK_THROWS_AS(batch.Commit(key), std::system_error&);
+
+	assert(notifications == 1);
+	assert(ValueNames(key) == names);
+	assert(key->GetInt32(L"Existing") == 42);
+	assert(key->GetBoolean(L"Enabled") == true);
+	assert(key->HasValue(L"Added") == false);
+	assert(key->HasKey(L"Created") == false);
+	assert(key->Open(L"New\\Sub")->GetString(L"Name") == L"Value");
+
+	assert(backend->Unsubscribe(dwCookie) == ERROR_SUCCESS);
+
+	// Readers never observe partially applied batch
+	std::atomic<bool> done(false);
+
+	std::thread writer([&key, &done]()
+	{
+		Registry::WriteBatch batch;
+
+		for (LONG i = 0; i < 1000; i++)
+		{
+			batch.Clear();
+			batch.SetInt32(L"", L"First", i).SetInt32(L"", L"Second", i).Commit(key);
+		}
+
+		done = true;
+	});
+
+	Registry::RegistryValues values;
+
+	while (!done)
+	{
+		key->GetValues({ L"First", L"Second" }, values);
+
+		assert(values.GetStatus(0) == values.GetStatus(1));
+		assert(values.GetStatus(0) != ERROR_SUCCESS || values.GetInt32(0) == values.GetInt32(1));
+	}
+
+	writer.join();
+
+	assert(key->GetInt32(L"First") == 999 && key->GetInt32(L"Second") == 999);
+}
+
+// Coroutine started immediately and never awaited, destroys itself when finished
+struct DetachedTask
+{
+	struct promise_type
+	{
+		DetachedTask get_return_object() { return DetachedTask(); }
+		std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+		std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+// Coroutine started immediately and destroyed by its caller, which may do so while coroutine is suspended
+struct OwnedTask
+{
+	struct promise_type
+	{
+		OwnedTask get_return_object() { return OwnedTask{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+		std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+		std::suspend_always final_suspend() noexcept { return std::suspend_always(); }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+// Executor running posted tasks only when asked to, so test controls when coroutines resume
+class QueueExecutor final : public Registry::Executor
+{
+public:
+	void Post(Task task) override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_tasks.push_back(std::move(task));
+	}
+
+	size_t RunAll()
+	{
+		std::vector<Task> tasks;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			tasks.swap(m_tasks);
+		}
+
+		for (auto& task : tasks)
+		{
+			task();
+		}
+
+		return tasks.size();
+	}
+
+private:
+	std::mutex m_mutex;
+	std::vector<Task> m_tasks;
+};
+
+static DetachedTask CountChanges(Registry::ChangeWatch& watch, size_t& changes, bool& finished)
+{
+	for (;;)
+	{
+		bool changed = co_await watch.Changed();
+		if (!changed)
+		{
+			break;
+		}
+
+		++changes;
+	}
+
+	finished = true;
+}
+
+static DetachedTask AwaitChange(Registry::RegistryKey_ptr key, bool watchSubtree, Registry::Executor_ptr executor, std::atomic<size_t>& changes)
+{
+	bool changed = co_await Registry::Changed(key, watchSubtree, Registry::NotifyFilter::ChangeName | Registry::NotifyFilter::ChangeLastSet, executor);
+	if (changed)
+	{
+		++changes;
+	}
+}
+
+static OwnedTask AwaitWatch(Registry::ChangeWatch& watch, size_t& changes)
+{
+	bool changed = co_await watch.Changed();
+	if (changed)
+	{
+		++changes;
+	}
+}
+
+static OwnedTask AwaitSingleChange(Registry::RegistryKey_ptr key, Registry::Executor_ptr executor, size_t& changes)
+{
+	bool changed = co_await Registry::Changed(key, false, Registry::NotifyFilter::ChangeLastSet, executor);
+	if (changed)
+	{
+		++changes;
+	}
+}
+
+void TestChangeWatch()
+{
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, std::make_shared<Registry::MemoryBackend>());
+	auto key = root->Create(L"Software\\Watched", Registry::DesiredAccess::AllAccess);
+	auto executor = std::make_shared<QueueExecutor>();
+
+	CHECK_THROWS_AS(Registry::ChangeWatch(Registry::ChangeNotifier_ptr(), executor), std::invalid_argument&);
+	CHECK_THROWS_AS(Registry::ChangeWatch(key, false, Registry::NotifyFilter::ChangeLastSet, nullptr), std::invalid_argument&);
+	CHECK_THROWS_AS(Registry::Changed(nullptr), std::invalid_argument&);
+
+	{
+		Registry::ChangeWatch watch(key, false, Registry::NotifyFilter::ChangeLastSet, executor);
+
+		size_t changes = 0;
+		bool finished = false;
+
+		CountChanges(watch, changes, finished);
+
+		assert(changes == 0);
+
+		// Coroutine is resumed on executor, not on thread which made the change
+		key->SetInt32(L"Value", 1);
+
+		assert(changes == 0);
+		assert(executor->RunAll() == 1);
+		assert(changes == 1);
+
+		// Changes reported before coroutine resumes are coalesced
+		key->SetInt32(L"Value", 2);
+		key->SetInt32(L"Value", 3);
+
+		assert(executor->RunAll() == 1);
+		assert(changes == 2);
+
+		// Changes of subkeys are not watched
+		key->Create(L"Sub", Registry::DesiredAccess::AllAccess)->SetInt32(L"Value", 1);
+
+		assert(executor->RunAll() == 0);
+
+		// Stopped watch resumes coroutine with false result
+		watch.Stop();
+
+		assert(executor->RunAll() == 1);
+		assert(changes == 2 && finished == true);
+	}
+
+	// Change made before coroutine awaits is not missed
+	{
+		size_t changes = 0;
+		bool finished = false;
+
+		{
+			Registry::ChangeWatch watch(key, false, Registry::NotifyFilter::ChangeLastSet, executor);
+
+			key->SetInt32(L"Value", 4);
+
+			CountChanges(watch, changes, finished);
+
+			assert(changes == 1);
+			assert(executor->RunAll() == 0);
+		}
+
+		// Destroyed watch resumes coroutine too
+		assert(executor->RunAll() == 1);
+		assert(finished == true);
+	}
+
+	// Coroutine destroyed while suspended is not resumed by change nor by stopped watch
+	{
+		Registry::ChangeWatch watch(key, false, Registry::NotifyFilter::ChangeLastSet, executor);
+
+		size_t changes = 0;
+
+		auto task = AwaitWatch(watch, changes);
+
+		assert(!task.handle.done());
+
+		task.handle.destroy();
+
+		key->SetInt32(L"Value", 5);
+		watch.Stop();
+
+		assert(executor->RunAll() == 0);
+
+		// Watch can be awaited by other coroutine
+		Registry::ChangeWatch other(key, false, Registry::NotifyFilter::ChangeLastSet, executor);
+
+		auto next = AwaitWatch(other, changes);
+
+		key->SetInt32(L"Value", 6);
+
+		assert(executor->RunAll() == 1);
+		assert(changes == 1 && next.handle.done());
+
+		next.handle.destroy();
+	}
+
+	// Destroyed coroutine destroys watch it awaited, stopping of that watch does not resume it
+	{
+		size_t changes = 0;
+
+		auto task = AwaitSingleChange(key, executor, changes);
+
+		task.handle.destroy();
+
+		key->SetInt32(L"Value", 7);
+
+		assert(executor->RunAll() == 0);
+		assert(changes == 0);
+	}
+
+	// Single change, including changes of subkeys
+	{
+		std::atomic<size_t> changes(0);
+
+		AwaitChange(key, true, executor, changes);
+
+		key->Open(L"Sub", Registry::DesiredAccess::AllAccess)->Delete(L"Value");
+
+		assert(executor->RunAll() == 1);
+		assert(changes == 1);
+	}
+
+	// Many keys watched by coroutines sharing two threads
+	{
+		auto pool = std::make_shared<Registry::ThreadPoolExecutor>(2);
+
+		std::atomic<size_t> changes(0);
+
+		std::vector<Registry::RegistryKey_ptr> keys;
+
+		for (int i = 0; i < 100; i++)
+		{
+			keys.push_back(key->Create(L"Key" + std::to_wstring(i), Registry::DesiredAccess::AllAccess));
+
+			AwaitChange(keys.back(), false, pool, changes);
+		}
+
+		for (auto& watched : keys)
+		{
+			watched->SetString(L"Value", L"Changed");
+		}
+
+		for (int i = 0; i < 1000 && changes < keys.size(); i++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		assert(changes == keys.size());
+	}
+}
+
+void TestWatchHub()
+{
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, std::make_shared<Registry::MemoryBackend>());
+	auto key = root->Create(L"Software\\Hub", Registry::DesiredAccess::AllAccess);
+	auto executor = std::make_shared<QueueExecutor>();
+
+	CHECK_THROWS_AS(Registry::WatchHub(nullptr), std::invalid_argument&);
+
+	{
+		Registry::WatchHub hub(executor);
+
+		CHECK_THROWS_AS(hub.Add(Registry::ChangeNotifier_ptr(), [](bool) {}), std::invalid_argument&);
+		CHECK_THROWS_AS(hub.Add(key, Registry::WatchHub::Callback()), std::invalid_argument&);
+		CHECK_THROWS_AS(hub.Add(Registry::RegistryKey_ptr(), [](bool) {}), std::invalid_argument&);
+
+		assert(hub.Size() == 0);
+		assert(hub.Remove(1) == false);
+
+		std::vector<Registry::RegistryKey_ptr> keys;
+		std::vector<Registry::WatchHub::WatchId> ids;
+		std::vector<size_t> changes(1000);
+
+		for (size_t i = 0; i < changes.size(); i++)
+		{
+			keys.push_back(key->Create(L"Key" + std::to_wstring(i), Registry::DesiredAccess::AllAccess));
+
+			ids.push_back(hub.Add(keys.back(), [&changes, i](bool rearmed)
+			{
+				assert(rearmed == true);
+
+				++changes[i];
+			}));
+		}
+
+		assert(hub.Size() == keys.size());
+
+		// Burst of changes of each key is dispatched once
+		for (auto& watched : keys)
+		{
+			watched->SetInt32(L"Value", 1);
+			watched->SetInt32(L"Value", 2);
+		}
+
+		assert(executor->RunAll() == keys.size());
+		assert(std::all_of(changes.begin(), changes.end(), [](size_t count) { return count == 1; }));
+
+		// Only changed keys are dispatched
+		keys[10]->SetInt32(L"Value", 3);
+
+		assert(executor->RunAll() == 1);
+		assert(changes[10] == 2 && changes[11] == 1);
+
+		// Removed watch is not invoked, even when its dispatch is already posted
+		keys[20]->SetInt32(L"Value", 3);
+
+		assert(hub.Remove(ids[20]) == true);
+		assert(hub.Remove(ids[20]) == false);
+		assert(hub.Size() == keys.size() - 1);
+
+		assert(executor->RunAll() == 1);
+		assert(changes[20] == 1);
+
+		keys[20]->SetInt32(L"Value", 4);
+
+		assert(executor->RunAll() == 0);
+	}
+
+	// Destroyed hub removes its watches
+	key->Open(L"Key0", Registry::DesiredAccess::AllAccess)->SetInt32(L"Value", 5);
+
+	assert(executor->RunAll() == 0);
+
+	// Change made while callback runs is dispatched again
+	{
+		Registry::WatchHub hub(executor);
+
+		size_t calls = 0;
+
+		hub.Add(key, [&key, &calls](bool)
+		{
+			if (++calls == 1)
+			{
+				key->SetInt32(L"Value", 2);
+			}
+		});
+
+		key->SetInt32(L"Value", 1);
+
+		assert(executor->RunAll() == 1);
+		assert(calls == 1);
+		assert(executor->RunAll() == 1);
+		assert(calls == 2);
+		assert(executor->RunAll() == 0);
+	}
+
+	// Callback removing its own watch
+	{
+		Registry::WatchHub hub(executor);
+
+		Registry::WatchHub::WatchId id = 0;
+		size_t calls = 0;
+
+		id = hub.Add(key, [&hub, &id, &calls](bool)
+		{
+			++calls;
+
+			assert(hub.Remove(id) == true);
+		});
+
+		key->SetInt32(L"Value", 3);
+
+		assert(executor->RunAll() == 1);
+		assert(calls == 1 && hub.Size() == 0);
+
+		key->SetInt32(L"Value", 4);
+
+		assert(executor->RunAll() == 0);
+	}
+
+	// Subtree watch and deleted key
+	{
+		Registry::WatchHub hub(executor);
+
+		auto deep = key->Create(L"Tree\\Deep", Registry::DesiredAccess::AllAccess);
+		auto doomed = key->Create(L"Doomed", Registry::DesiredAccess::AllAccess);
+
+		size_t changes = 0;
+		size_t deleted = 0;
+
+		hub.Add(key->Open(L"Tree", Registry::DesiredAccess::AllAccess), [&changes](bool) { ++changes; }, true);
+		hub.Add(doomed, [&deleted](bool) { ++deleted; });
+
+		deep->SetInt32(L"Value", 1);
+
+		assert(executor->RunAll() == 1);
+		assert(changes == 1 && deleted == 0);
+
+		key->Delete(L"Doomed");
+
+		assert(executor->RunAll() == 1);
+		assert(changes == 1 && deleted == 1);
+	}
+
+	// Thousands of keys watched by hub sharing four threads, changed concurrently
+	{
+		auto pool = std::make_shared<Registry::ThreadPoolExecutor>(4);
+		auto parent = key->Create(L"Stress", Registry::DesiredAccess::AllAccess);
+
+		std::vector<Registry::RegistryKey_ptr> keys;
+		std::vector<std::atomic<size_t>> changes(10000);
+
+		Registry::WatchHub hub(pool);
+
+		for (size_t i = 0; i < changes.size(); i++)
+		{
+			keys.push_back(parent->Create(L"Key" + std::to_wstring(i), Registry::DesiredAccess::AllAccess));
+
+			hub.Add(keys.back(), [&changes, i](bool) { ++changes[i]; });
+		}
+
+		std::vector<std::thread> writers;
+
+		for (size_t t = 0; t < 4; t++)
+		{
+			writers.emplace_back([&keys, t]()
+			{
+				for (size_t i = t; i < keys.size(); i += 4)
+				{
+					keys[i]->SetInt32(L"Value", static_cast<LONG>(i));
+				}
+			});
+		}
+
+		for (auto& writer : writers)
+		{
+			writer.join();
+		}
+
+		auto dispatched = [&changes]()
+		{
+			return std::all_of(changes.begin(), changes.end(), [](const std::atomic<size_t>& count) { return count == 1; });
+		};
+
+		for (int i = 0; i < 1000 && !dispatched(); i++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		assert(dispatched());
+
+		hub.Clear();
+
+		assert(hub.Size() == 0);
+	}
+}
+
+struct ServiceSettings
+{
+	bool enabled;
+	LONG timeout;
+	DWORD retries;
+	long long offset;
+	unsigned long long quota;
+	unsigned short port;
+	std::wstring server;
+};
+
+struct WindowSettings
+{
+	LONG width;
+	LONG height;
+};
+
+struct CounterSettings
+{
+	long delta;
+	unsigned long limit;
+};
+
+template <>
+struct Registry::ConfigSchema<ServiceSettings>
+{
+	static constexpr auto schema = Registry::Schema
+	(
+		L"Software\\Service",
+		Registry::Field(L"Enabled", &ServiceSettings::enabled, true),
+		Registry::Field(L"Timeout", &ServiceSettings::timeout, 30),
+		Registry::Field(L"Retries", &ServiceSettings::retries, 3u),
+		Registry::Field(L"Offset", &ServiceSettings::offset, -1ll),
+		Registry::Field(L"Quota", &ServiceSettings::quota),
+		Registry::Field(L"Port", &ServiceSettings::port, static_cast<unsigned short>(8080)),
+		Registry::Field(L"Server", &ServiceSettings::server, L"localhost")
+	);
+};
+
+template <>
+struct Registry::ConfigSchema<WindowSettings>
+{
+	static constexpr auto schema = Registry::Schema
+	(
+		L"",
+		Registry::Field(L"Width", &WindowSettings::width, 640),
+		Registry::Field(L"Height", &WindowSettings::height, 480)
+	);
+};
+
+template <>
+struct Registry::ConfigSchema<CounterSettings>
+{
+	static constexpr auto schema = Registry::Schema
+	(
+		L"Counter",
+		Registry::Field(L"Delta", &CounterSettings::delta, -1l),
+		Registry::Field(L"Limit", &CounterSettings::limit, 100ul)
+	);
+};
+
+// Names are validated at compile time
+static_assert(Registry::ConfigSchema<ServiceSettings>::schema.IsValid());
+static_assert(Registry::ConfigSchema<ServiceSettings>::schema.Size() == 7);
+static_assert(!Registry::Schema(L"", Registry::Field(L"Width", &WindowSettings::width), Registry::Field(L"WIDTH", &WindowSettings::height)).IsValid());
+static_assert(!Registry::Schema(L"", Registry::Field(L"", &WindowSettings::width)).IsValid());
+static_assert(Registry::ConfigSchema<WindowSettings>::schema.GetNames()[1] == L"Height");
+
+void TestConfigSchema()
+{
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, std::make_shared<Registry::MemoryBackend>());
+
+	CHECK_THROWS_AS(Registry::Load<ServiceSettings>(nullptr), std::invalid_argument&);
+
+	// Missing key loads defaults
+	{
+		auto settings = Registry::Load<ServiceSettings>(root);
+
+		assert(settings.enabled == true);
+		assert(settings.timeout == 30);
+		assert(settings.retries == 3);
+		assert(settings.offset == -1);
+		assert(settings.quota == 0);
+		assert(settings.port == 8080);
+		assert(settings.server == L"localhost");
+	}
+
+	// Stored struct creates key and is loaded back
+	{
+		ServiceSettings settings;
+		settings.enabled = false;
+		settings.timeout = -5;
+		settings.retries = 0xFFFFFFFF;
+		settings.offset = -1234567890123ll;
+		settings.quota = 0xFFFFFFFFFFFFull;
+		settings.port = 443;
+		settings.server = L"example.com";
+
+		CHECK_NO_THROW(Registry::Store(root, settings));
+
+		auto key = root->Open(L"Software\\Service");
+
+		assert(key->GetBoolean(L"Enabled") == false);
+		assert(key->GetInt32(L"Timeout") == -5);
+		assert(key->GetUInt32(L"Retries") == 0xFFFFFFFF);
+		assert(key->GetInt64(L"Offset") == -1234567890123ll);
+		assert(key->GetUInt64(L"Quota") == 0xFFFFFFFFFFFFull);
+		assert(key->GetUInt32(L"Port") == 443);
+		assert(key->GetString(L"Server") == L"example.com");
+
+		auto loaded = Registry::Load<ServiceSettings>(root);
+
+		assert(loaded.enabled == settings.enabled);
+		assert(loaded.timeout == settings.timeout);
+		assert(loaded.retries == settings.retries);
+		assert(loaded.offset == settings.offset);
+		assert(loaded.quota == settings.quota);
+		assert(loaded.port == settings.port);
+		assert(loaded.server == settings.server);
+	}
+
+	// Missing values are set to defaults, others are kept
+	{
+		auto key = root->Open(L"Software\\Service", Registry::DesiredAccess::AllAccess);
+
+		key->Delete(L"Timeout");
+		key->Delete(L"Server");
+
+		ServiceSettings settings;
+
+		Registry::Load(root, settings);
+
+		assert(settings.timeout == 30);
+		assert(settings.server == L"localhost");
+		assert(settings.port == 443);
+		assert(settings.enabled == false);
+
+		// Value of wrong type is not silently replaced by default
+		key->SetString(L"Enabled", L"yes");
+
+		CHECK_THROWS_AS(Registry::Load(root, settings), std::runtime_error&);
+	}
+
+	// Schema with empty path reads values of key itself
+	{
+		auto key = root->Create(L"Software\\Window", Registry::DesiredAccess::AllAccess);
+
+		key->SetInt32(L"Width", 1024);
+
+		auto settings = Registry::Load<WindowSettings>(key);
+
+		assert(settings.width == 1024);
+		assert(settings.height == 480);
+
+		settings.height = 768;
+
+		Registry::Store(key, settings);
+
+		assert(key->GetInt32(L"Height") == 768);
+	}
+
+	// long is stored as REG_DWORD on all platforms, as it is on Windows
+	{
+		CounterSettings settings;
+		settings.delta = -7;
+		settings.limit = 0xFFFFFFFFul;
+
+		Registry::Store(root, settings);
+
+		auto key = root->Open(L"Counter");
+
+		Registry::RegistryValues values;
+
+		key->GetValues({ L"Delta", L"Limit" }, values);
+		assert(values.GetType(0) == REG_DWORD && values.GetType(1) == REG_DWORD);
+
+		auto loaded = Registry::Load<CounterSettings>(root);
+
+		assert(loaded.delta == -7 && loaded.limit == 0xFFFFFFFFul);
+
+		if constexpr (sizeof(long) > sizeof(LONG))
+		{
+			settings.delta = static_cast<long>(INT32_MAX) + 1;
+
+			CHECK_THROWS_AS(Registry::Store(root, settings), std::out_of_range&);
+			assert(key->GetInt32(L"Delta") == -7);
+		}
+	}
+}
+
+void TestBinary()
+{
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, std::make_shared<Registry::MemoryBackend>());
+	auto key = root->Create(L"Software\\Binary", Registry::DesiredAccess::AllAccess);
+
+	std::vector<std::byte> blob(1024 * 1024);
+
+	for (size_t i = 0; i < blob.size(); ++i)
+	{
+		blob[i] = static_cast<std::byte>(i * 7);
+	}
+
+	CHECK_NO_THROW(key->SetBinary(L"Blob", blob));
+	assert(key->GetBinary(L"Blob") == blob);
+
+	// Caller owned buffer
+	{
+		std::vector<std::byte> buffer(blob.size() + 16);
+
+		assert(key->GetBinary(L"Blob", std::span<std::byte>(buffer)) == blob.size());
+		assert(std::equal(blob.begin(), blob.end(), buffer.begin()));
+
+		// Too small buffer reports size needed
+		assert(key->GetBinary(L"Blob", std::span<std::byte>(buffer.data(), 16)) == blob.size());
+		assert(key->GetBinary(L"Blob", std::span<std::byte>()) == blob.size());
+	}
+
+	// Reused vector is read by single query without allocating memory
+	{
+		std::vector<std::byte> data;
+
+		key->GetBinary(L"Blob", data);
+		assert(data == blob);
+
+		const size_t allocations = g_allocations;
+
+		key->GetBinary(L"Blob", data);
+		assert(data == blob);
+
+		assert(g_allocations == allocations);
+
+		// Vector is resized to size of value in both directions
+		const std::byte small[] = { std::byte(1), std::byte(2), std::byte(3) };
+
+		key->SetBinary(L"Blob", small);
+		key->GetBinary(L"Blob", data);
+
+		assert(data.size() == 3 && data[2] == std::byte(3));
+
+		key->SetBinary(L"Blob", blob);
+		key->GetBinary(L"Blob", data);
+
+		assert(data == blob);
+
+		// Vector is cleared on failure
+		CHECK_THROWS_AS(key->GetBinary(L"Missing", data), std::system_error&);
+		assert(data.empty());
+	}
+
+	// Empty value
+	CHECK_NO_THROW(key->SetBinary(L"Empty", std::span<const std::byte>()));
+	assert(key->GetBinary(L"Empty").empty());
+	assert(key->GetBinary(L"Empty", std::span<std::byte>()) == 0);
+
+	// Only REG_BINARY values are read
+	key->SetString(L"String", L"Text");
+
+	CHECK_THROWS_AS(key->GetBinary(L"String"), std::runtime_error&);
+	CHECK_THROWS_AS(key->GetBinary(L"Missing"), std::system_error&);
+
+	// Batched binary value
+	Registry::WriteBatch batch;
+
+	batch.SetBinary(L"", L"Batched", std::span<const std::byte>(blob.data(), 100));
+	batch.Commit(key);
+
+	assert(key->GetBinary(L"Batched").size() == 100);
+}
+
+// Strings are iterated lazily by standard forward iterator
+static_assert(std::forward_iterator<Registry::MultiString::Iterator>);
+
+void TestMultiString()
+{
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, std::make_shared<Registry::MemoryBackend>());
+	auto key = root->Create(L"Software\\MultiString", Registry::DesiredAccess::AllAccess);
+
+	const std::vector<std::wstring> paths = { L"C:\\Windows", L"C:\\Windows\\System32", L"D:\\Tools" };
+
+	CHECK_NO_THROW(key->SetMultiString(L"Paths", paths));
+
+	{
+		auto value = key->GetMultiString(L"Paths");
+
+		assert(value.Count() == 3);
+		assert(std::equal(value.begin(), value.end(), paths.begin(), paths.end()));
+
+		// Data are stored as sequence of null terminated strings ended by another null character
+		DWORD dwType = REG_NONE;
+		DWORD cbData = 0;
+
+		assert(key->GetBackend()->QueryValue(*key, L"Paths", &dwType, nullptr, &cbData) == ERROR_SUCCESS);
+		assert(dwType == REG_MULTI_SZ);
+		assert(cbData == (10 + 1 + 19 + 1 + 8 + 1 + 1) * sizeof(wchar_t));
+
+		// Any range of strings, including other multi string value
+		key->SetMultiString(L"Copy", value);
+
+		assert(key->GetMultiString(L"Copy").Count() == 3);
+	}
+
+	key->SetMultiString(L"List", { L"First", L"Second" });
+
+	{
+		auto value = key->GetMultiString(L"List");
+		auto it = value.begin();
+
+		assert(*it == L"First" && it->length() == 5);
+		assert(*(++it) == L"Second");
+		assert(++it == value.end());
+	}
+
+	// Empty list
+	key->SetMultiString(L"Empty", std::vector<std::wstring>());
+
+	assert(key->GetMultiString(L"Empty").Empty());
+	assert(key->GetMultiString(L"Empty").Count() == 0);
+
+	// Thousands of strings are read into single buffer, reused buffer is not allocated again
+	{
+		std::vector<std::wstring> entries;
+
+		for (int i = 0; i < 5000; ++i)
+		{
+			entries.push_back(L"Entry" + std::to_wstring(i));
+		}
+
+		key->SetMultiString(L"Large", entries);
+
+		Registry::MultiString value;
+
+		key->GetMultiString(L"Large", value);
+
+		const size_t allocations = g_allocations;
+
+		key->GetMultiString(L"Large", value);
+
+		size_t count = 0;
+
+		for (auto entry : value)
+		{
+			assert(entry == entries[count]);
+
+			++count;
+		}
+
+		assert(g_allocations == allocations);
+		assert(count == entries.size());
+
+		// Shorter value reuses same buffer
+		key->GetMultiString(L"Paths", value);
+
+		assert(value.Count() == 3);
+	}
+
+	// Data without terminators written by other tools
+	{
+		const wchar_t data[] = { L'a', L'\0', L'b', L'c' };
+
+		key->GetBackend()->SetValue(*key, L"Raw", REG_MULTI_SZ, reinterpret_cast<const BYTE*>(data), sizeof(data));
+
+		auto value = key->GetMultiString(L"Raw");
+		auto it = value.begin();
+
+		assert(*it == L"a");
+		assert(*(++it) == L"bc");
+		assert(++it == value.end());
+	}
+
+	CHECK_THROWS_AS(key->SetMultiString(L"Invalid", { L"First", L"" }), std::invalid_argument&);
+	CHECK_THROWS_AS(key->SetMultiString(L"Invalid", { std::wstring_view(L"A\0B", 3) }), std::invalid_argument&);
+	assert(key->HasValue(L"Invalid") == false);
+
+	key->SetString(L"String", L"Text");
+
+	CHECK_THROWS_AS(key->GetMultiString(L"String"), std::runtime_error&);
+	CHECK_THROWS_AS(key->GetMultiString(L"Missing"), std::system_error&);
+}
+
+// Counts path segments resolved by opening of keys, as each one costs separate lookup
+class OpenStepsBackend final : public MultipleValuesBackend
+{
+public:
+	explicit OpenStepsBackend(const Registry::RegistryBackend_ptr& backend)
+		: MultipleValuesBackend(backend)
+	{
+	}
+
+	size_t Steps() const
+	{
+		return m_steps;
+	}
+
+	LSTATUS OpenKey(HKEY hKey, const wchar_t* lpSubKey, REGSAM samDesired, HKEY* phkResult) override
+	{
+		if (lpSubKey != nullptr && *lpSubKey != L'\0')
+		{
+			m_steps += 1 + std::count(lpSubKey, lpSubKey + std::wcslen(lpSubKey), L'\\');
+		}
+
+		return MultipleValuesBackend::OpenKey(hKey, lpSubKey, samDesired, phkResult);
+	}
+
+private:
+	size_t m_steps = 0;
+};
+
+void TestPathTrie()
+{
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_LOCAL_MACHINE, std::make_shared<Registry::MemoryBackend>());
+
+	for (int i = 0; i < 10; ++i)
+	{
+		root->Create(L"SYSTEM\\CurrentControlSet\\Services\\Service" + std::to_wstring(i) + L"\\Parameters");
+	}
+
+	CHECK_THROWS_AS(Registry::PathTrie(nullptr), std::invalid_argument&);
+
+	Registry::PathTrie trie(root);
+
+	CHECK_THROWS_AS(trie.Open(L""), std::invalid_argument&);
+	CHECK_THROWS_AS(trie.Open(L"\\"), std::system_error&);
+	CHECK_THROWS_AS(trie.Open(L"SYSTEM\\NOT_EXISTING_REGISTRY_KEY"), std::system_error&);
+
+	// Missing key is not kept, its existing parent is
+	{
+		std::error_code ec;
+
+		assert(trie.TryOpen(L"SYSTEM\\CurrentControlSet\\NOT_EXISTING_REGISTRY_KEY", ec) == nullptr);
+		assert(ec.value() == ERROR_FILE_NOT_FOUND);
+		assert(trie.Size() == 2);
+
+		trie.Clear();
+
+		assert(trie.Size() == 0);
+	}
+
+	// Key is opened together with its parent, siblings are opened relative to that parent
+	auto service = trie.Open(L"SYSTEM\\CurrentControlSet\\Services\\Service0");
+
+	assert(service->HasKey(L"Parameters"));
+	assert(trie.Size() == 2);
+
+	for (int i = 1; i < 10; ++i)
+	{
+		trie.Open(L"SYSTEM\\CurrentControlSet\\Services\\Service" + std::to_wstring(i));
+	}
+
+	assert(trie.Size() == 11);
+
+	const size_t misses = trie.Misses();
+
+	// Kept keys are returned, regardless of case and separators
+	assert(trie.Open(L"system\\currentcontrolset\\services\\service0\\") == service);
+	assert(trie.Open(L"SYSTEM\\CurrentControlSet\\Services") != nullptr);
+	assert(trie.Misses() == misses);
+	assert(trie.Hits() == 2);
+
+	// Subkeys of kept keys are opened relative to them
+	auto parameters = trie.Open(L"SYSTEM\\CurrentControlSet\\Services\\Service3\\Parameters");
+
+	assert(parameters != nullptr);
+	assert(trie.Size() == 12);
+
+	// Bulk open, missing keys are reported as nullptr
+	{
+		const std::vector<std::wstring> paths =
+		{
+			L"SYSTEM\\CurrentControlSet\\Services\\Service4\\Parameters",
+			L"SYSTEM\\CurrentControlSet\\Services\\NOT_EXISTING_REGISTRY_KEY",
+			L"SYSTEM\\CurrentControlSet\\Services\\Service5\\Parameters",
+			L"SYSTEM\\CurrentControlSet\\Services\\Service3\\Parameters"
+		};
+
+		auto keys = trie.OpenMany(paths);
+
+		assert(keys.size() == paths.size());
+		assert(keys[0] != nullptr && keys[1] == nullptr && keys[2] != nullptr);
+		assert(keys[3] == parameters);
+	}
+
+	// Invalidated subtree is opened again
+	{
+		root->Open(L"SYSTEM\\CurrentControlSet\\Services", Registry::DesiredAccess::AllAccess)->Delete(L"Service3");
+		root->Create(L"SYSTEM\\CurrentControlSet\\Services\\Service3\\Parameters", Registry::DesiredAccess::AllAccess)->SetInt32(L"Start", 2);
+
+		trie.Invalidate(L"system\\currentcontrolset\\services\\service3");
+
+		assert(trie.Open(L"SYSTEM\\CurrentControlSet\\Services\\Service3\\Parameters")->GetInt32(L"Start") == 2);
+	}
+
+	// Prefix shared by bulk opened paths is resolved once, paths below prefix which cannot be opened are not tried
+	{
+		auto backend = std::make_shared<OpenStepsBackend>(std::make_shared<Registry::MemoryBackend>());
+		auto counted = std::make_shared<Registry::RegistryKey>(HKEY_LOCAL_MACHINE, backend);
+
+		counted->Create(L"A\\B\\X\\Y");
+		counted->Create(L"A\\B\\Z\\W");
+
+		const size_t steps = backend->Steps();
+
+		Registry::PathTrie bulk(counted);
+
+		const std::vector<std::wstring> paths =
+		{
+			L"A\\B\\Z\\W",
+			L"A\\NOT_EXISTING_REGISTRY_KEY\\X",
+			L"A\\B\\X\\Y",
+			L"A\\NOT_EXISTING_REGISTRY_KEY\\Y",
+			L""
+		};
+
+		auto keys = bulk.OpenMany(paths);
+
+		assert(keys[0] != nullptr && keys[2] != nullptr);
+		assert(keys[1] == nullptr && keys[3] == nullptr && keys[4] == nullptr);
+		// A, A\B, then X, Y, Z, W relative to A\B, and missing key relative to A
+		assert(backend->Steps() - steps == 7);
+		assert(bulk.Open(L"A\\B") != nullptr);
+		assert(bulk.Size() == 6);
+	}
+
+	// Number of kept keys is bounded by capacity
+	{
+		CHECK_THROWS_AS(Registry::PathTrie(root, Registry::DesiredAccess::Read, 0), std::invalid_argument&);
+
+		Registry::PathTrie bounded(root, Registry::DesiredAccess::Read, 4);
+
+		assert(bounded.Capacity() == 4);
+
+		for (int i = 0; i < 10; ++i)
+		{
+			assert(bounded.Open(L"SYSTEM\\CurrentControlSet\\Services\\Service" + std::to_wstring(i) + L"\\Parameters") != nullptr);
+			assert(bounded.Size() <= bounded.Capacity());
+		}
+
+		assert(bounded.Size() != 0);
+
+		bounded.Clear();
+
+		assert(bounded.Size() == 0);
+		assert(bounded.Open(L"SYSTEM\\CurrentControlSet\\Services\\Service0\\Parameters") != nullptr);
+	}
+}
+
+// Fails opening of keys with status chosen by test
+class OpenStatusBackend final : public MultipleValuesBackend
+{
+public:
+	explicit OpenStatusBackend(const Registry::RegistryBackend_ptr& backend)
+		: MultipleValuesBackend(backend)
+	{
+	}
+
+	void SetOpenStatus(LSTATUS lStatus)
+	{
+		m_status = lStatus;
+	}
+
+	LSTATUS OpenKey(HKEY, const wchar_t*, REGSAM, HKEY*) override
+	{
+		return m_status;
+	}
+
+private:
+	LSTATUS m_status = ERROR_FILE_NOT_FOUND;
+};
+
+// Disabled instrumentation only forwards calls, without any counters
+static_assert(Registry::InstrumentedBackend::Enabled || sizeof(Registry::InstrumentedBackend) <= sizeof(MultipleValuesBackend));
+
+void TestInstrumentedBackend()
+{
+	// Buckets are ordered and each value lies within limit of its bucket
+	for (ULONGLONG value : { 0ull, 1ull, 15ull, 16ull, 17ull, 31ull, 32ull, 1000ull, 123456789ull, 1ull << 40, ~0ull })
+	{
+		const auto index = Registry::LatencyHistogram::BucketIndex(value);
+
+		assert(index < Registry::LatencyHistogram::BucketCount);
+		assert(index == Registry::LatencyHistogram::BucketCount - 1 || value <= Registry::LatencyHistogram::BucketLimit(index));
+		assert(index == 0 || value > Registry::LatencyHistogram::BucketLimit(index - 1));
+	}
+
+	CHECK_THROWS_AS(Registry::InstrumentedBackend(nullptr), std::invalid_argument&);
+
+	auto backend = std::make_shared<Registry::InstrumentedBackend>(std::make_shared<Registry::MemoryBackend>());
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_LOCAL_MACHINE, backend);
+
+	auto key = root->Create(L"SOFTWARE\\Vendor\\Product", Registry::DesiredAccess::AllAccess);
+
+	key->SetInt32(L"Int", 7);
+	key->SetString(L"String", L"Text");
+	key->Create(L"First");
+	key->Create(L"Second");
+
+	assert(key->GetInt32(L"Int") == 7);
+	assert(key->GetString(L"String") == L"Text");
+	assert(key->TryGetInt32(L"Missing").has_value() == false);
+	assert(root->TryOpen(L"SOFTWARE\\NOT_EXISTING_REGISTRY_KEY") == nullptr);
+
+	size_t subKeys = 0;
+
+	key->EnumerateSubKeys([&subKeys](const std::wstring&) -> bool
+	{
+		++subKeys;
+
+		return true;
+	});
+
+	assert(subKeys == 2);
+
+	key->Flush();
+
+	const auto snapshot = backend->GetSnapshot();
+
+	if constexpr (Registry::InstrumentedBackend::Enabled)
+	{
+		const auto& create = snapshot[Registry::BackendOperation::CreateKey];
+
+		assert(create.calls == 3);
+		assert(create.errors == 0);
+		assert(create.statuses.empty());
+
+		const auto& open = snapshot[Registry::BackendOperation::OpenKey];
+
+		assert(open.calls == 1);
+		assert(open.errors == 1);
+		assert(open.GetStatusCount(ERROR_FILE_NOT_FOUND) == 1);
+
+		const auto& set = snapshot[Registry::BackendOperation::SetValue];
+
+		assert(set.calls == 2);
+		assert(set.bytes == sizeof(DWORD) + 4 * sizeof(wchar_t));
+
+		const auto& query = snapshot[Registry::BackendOperation::QueryValue];
+
+		assert(query.calls >= 3);
+		assert(query.errors == 1);
+		assert(query.GetStatusCount(ERROR_FILE_NOT_FOUND) == 1);
+		assert(query.bytes >= sizeof(DWORD) + 4 * sizeof(wchar_t));
+
+		assert(snapshot[Registry::BackendOperation::QueryInfoKey].calls == 1);
+		assert(snapshot[Registry::BackendOperation::EnumKey].calls == 2);
+		assert(snapshot[Registry::BackendOperation::FlushKey].calls == 1);
+
+		// Every call lands in histogram, percentiles are monotonic
+		ULONGLONG recorded = 0;
+
+		for (auto count : query.histogram)
+		{
+			recorded += count;
+		}
+
+		assert(recorded == query.calls);
+		assert(query.GetPercentile(0.5) <= query.GetPercentile(0.99));
+		assert(query.GetPercentile(0.99) <= query.GetPercentile(1.0));
+
+		CHECK_THROWS_AS(query.GetPercentile(1.5), std::invalid_argument&);
+	}
+	else
+	{
+		assert(snapshot[Registry::BackendOperation::QueryValue].calls == 0);
+	}
+
+	assert(snapshot[Registry::BackendOperation::SaveKey].calls == 0);
+	assert(snapshot[Registry::BackendOperation::SaveKey].GetPercentile(0.99) == 0);
+
+	// Errors of failing backend are counted by status
+	{
+		auto failing = std::make_shared<Registry::InstrumentedBackend>(std::make_shared<NameRecordingBackend>());
+		auto failingRoot = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, failing);
+
+		for (int i = 0; i < 4; ++i)
+		{
+			assert(failingRoot->TryOpen(L"SOFTWARE") == nullptr);
+		}
+
+		CHECK_THROWS_AS(failingRoot->Create(L"SOFTWARE"), std::system_error&);
+
+		const auto failed = failing->GetSnapshot();
+
+		if constexpr (Registry::InstrumentedBackend::Enabled)
+		{
+			assert(failed[Registry::BackendOperation::OpenKey].errors == 4);
+			assert(failed[Registry::BackendOperation::OpenKey].GetStatusCount(ERROR_FILE_NOT_FOUND) == 4);
+			assert(failed[Registry::BackendOperation::CreateKey].GetStatusCount(ERROR_ACCESS_DENIED) == 1);
+		}
+
+		failing->Reset();
+
+		assert(failing->GetSnapshot()[Registry::BackendOperation::OpenKey].calls == 0);
+	}
+
+	// Statuses beyond those counted separately are counted together, apart from successful calls
+	{
+		auto statuses = std::make_shared<OpenStatusBackend>(std::make_shared<Registry::MemoryBackend>());
+		auto instrumented = std::make_shared<Registry::InstrumentedBackend>(statuses);
+		auto statusesRoot = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, instrumented);
+
+		const LSTATUS failures[] = { ERROR_FILE_NOT_FOUND, ERROR_ACCESS_DENIED, ERROR_INVALID_HANDLE, ERROR_NOT_ENOUGH_MEMORY, ERROR_NOT_SUPPORTED,
+			ERROR_INVALID_PARAMETER, ERROR_BADDB, ERROR_CANT_READ, ERROR_KEY_DELETED, ERROR_TRANSFER_TOO_LONG };
+
+		for (auto lStatus : failures)
+		{
+			std::error_code ec;
+
+			statuses->SetOpenStatus(lStatus);
+
+			assert(statusesRoot->TryOpen(L"SOFTWARE", Registry::DesiredAccess::Read, ec) == nullptr);
+			assert(ec.value() == lStatus);
+		}
+
+		const auto counted = instrumented->GetSnapshot();
+		const auto& open = counted[Registry::BackendOperation::OpenKey];
+
+		if constexpr (Registry::InstrumentedBackend::Enabled)
+		{
+			assert(open.calls == 10 && open.errors == 10);
+			assert(open.statuses.size() == 8);
+			assert(open.otherStatuses == 2);
+			assert(open.GetStatusCount(ERROR_SUCCESS) == 0);
+			assert(open.GetStatusCount(ERROR_FILE_NOT_FOUND) == 1);
+			assert(open.GetStatusCount(ERROR_TRANSFER_TOO_LONG) == 0);
+		}
+		else
+		{
+			assert(open.calls == 0 && open.statuses.empty() && open.otherStatuses == 0);
+		}
+	}
+
+	// Concurrent callers are all counted
+	{
+		backend->Reset();
+
+		std::vector<std::thread> threads;
+
+		for (int t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([key]()
+			{
+				for (int i = 0; i < 1000; ++i)
+				{
+					key->GetInt32(L"Int");
+				}
+			});
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		if constexpr (Registry::InstrumentedBackend::Enabled)
+		{
+			assert(backend->GetSnapshot()[Registry::BackendOperation::QueryValue].calls == 4000);
+		}
+	}
+}
+
+void TestHiveWriter()
+{
+	CHECK_THROWS_AS(Registry::HiveWriter(Registry::RegistryKey_ptr()), std::invalid_argument&);
+
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, std::make_shared<Registry::MemoryBackend>());
+
+	const std::wstring big(20000, L'B');
+	const std::vector<std::byte> binary(3000, std::byte{ 0xA5 });
+
+	{
+		auto key = root->Create(L"Software\\Vendor\\Product", Registry::DesiredAccess::AllAccess);
+
+		key->SetString(L"Name", L"Product name");
+		key->SetExpandString(L"Path", L"%ProgramFiles%\\Vendor");
+		key->SetInt32(L"Dword", -1);
+		key->SetInt64(L"Qword", 810012361001236);
+		key->SetString(L"Tiny", L"A");
+		key->SetString(L"Big", big);
+		key->SetBinary(L"Binary", binary);
+		key->SetMultiString(L"Paths", { L"c:\\Windows", L"c:\\Program Files" });
+		key->SetString(L"", L"Default");
+		key->SetString(L"N\u00e4me \u0416", L"Unicode name");
+
+		root->Create(L"Software\\Vendor\\\u041f\u0440\u043e\u0434\u0443\u043a\u0442");
+		root->Create(L"System");
+	}
+
+	// More subkeys than single lh list holds
+	{
+		auto many = root->Create(L"Many", Registry::DesiredAccess::AllAccess);
+
+		for (int i = 0; i < 1200; ++i)
+		{
+			many->Create(L"Key" + std::to_wstring(i), Registry::DesiredAccess::AllAccess)->SetInt32(L"Index", i);
+		}
+	}
+
+	Registry::HiveWriter writer(root);
+
+	assert(writer.KeyCount() == 1207);
+	assert(writer.ValueCount() == 1210);
+	assert(writer.Size() % 4096 == 0);
+
+	writer.Save(L"RegistryTest.hiv");
+
+	{
+		std::ifstream in("RegistryTest.hiv", std::ios::binary);
+		std::vector<char> image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+		assert(image.size() == writer.Size());
+
+		// Base block checksum and cells filling every bin exactly
+		DWORD dwChecksum = 0;
+
+		for (size_t i = 0; i < 508; i += 4)
+		{
+			DWORD dw = 0;
+			std::memcpy(&dw, &image[i], 4);
+			dwChecksum ^= dw;
+		}
+
+		DWORD dwStored = 0;
+		std::memcpy(&dwStored, &image[508], 4);
+
+		assert(dwChecksum == dwStored);
+
+		for (size_t bin = 4096; bin < image.size(); )
+		{
+			assert(std::memcmp(&image[bin], "hbin", 4) == 0);
+
+			DWORD cbBin = 0;
+			std::memcpy(&cbBin, &image[bin + 8], 4);
+
+			size_t cell = bin + 32;
+
+			while (cell < bin + cbBin)
+			{
+				LONG lSize = 0;
+				std::memcpy(&lSize, &image[cell], 4);
+
+				assert(lSize != 0 && std::abs(lSize) % 8 == 0);
+
+				cell += std::abs(lSize);
+			}
+
+			assert(cell == bin + cbBin);
+
+			bin += cbBin;
+		}
+	}
+
+	{
+		Registry::HiveFile hive(L"RegistryTest.hiv");
+
+		assert(hive.Root().GetName() == L"ROOT");
+
+		auto key = hive.Open(L"software\\vendor\\product");
+
+		assert(key.GetString(L"Big") == big);
+		assert(key.GetString() == L"Default");
+		assert(key.GetInt32(L"Dword") == -1);
+		assert(key.GetString(L"N\u00e4me \u0416") == L"Unicode name");
+		assert(hive.HasKey(L"Software\\Vendor\\\u041f\u0440\u043e\u0434\u0443\u043a\u0442"));
+		assert(hive.Open(L"Many\\Key1199").GetInt32(L"Index") == 1199);
+		assert(hive.Open(L"Many").GetSubKeyCount() == 1200);
+
+		auto result = Registry::Diff(root, hive.Root(), CollectDifference);
+
+		assert(result.differences == 0);
+		assert(g_differences.empty());
+
+		// Written from hive again, keeping names, order and last write times
+		Registry::HiveWriter(hive.Root()).Save(L"RegistryTest2.hiv");
+	}
+
+	{
+		std::ifstream first("RegistryTest.hiv", std::ios::binary);
+		std::ifstream second("RegistryTest2.hiv", std::ios::binary);
+
+		assert(std::equal(std::istreambuf_iterator<char>(first), std::istreambuf_iterator<char>(), std::istreambuf_iterator<char>(second)));
+	}
+
+	std::remove("RegistryTest.hiv");
+	std::remove("RegistryTest2.hiv");
+}
+
+void TestHiveCompaction()
+{
+	// Hive with cells left behind by deleted values scattered between keys
+	TestHive builder;
+
+	std::vector<DWORD> subKeys;
+	std::vector<std::string> names;
+
+	for (int i = 0; i < 50; ++i)
+	{
+		builder.AddCell(std::vector<BYTE>(200, 0xCC));
+
+		auto index = builder.AddValue("Index", REG_DWORD, TestHive::Bytes<DWORD>(i));
+		auto name = builder.AddValue("Name", REG_SZ, TestHive::Utf16(L"Key " + std::to_wstring(i)));
+
+		names.push_back("Key" + std::to_string(i));
+		subKeys.push_back(builder.AddKey(names.back(), {}, {}, { index, name }));
+	}
+
+	builder.Save("RegistryTest.hiv", builder.AddKey("ROOT", subKeys, names, { builder.AddValue("Version", REG_DWORD, TestHive::Bytes<DWORD>(7)) }));
+
+	{
+		Registry::HiveFile hive(L"RegistryTest.hiv");
+
+		auto statistics = hive.GetStatistics();
+
+		assert(statistics.fileSize == 4096 + 24576);
+		assert(statistics.keys == 51);
+		assert(statistics.values == 101);
+		assert(statistics.unusedBytes == 50 * 208);
+		assert(statistics.freeBytes > 0);
+		assert(statistics.pagesPerLookup >= 1.0);
+	}
+
+	CHECK_THROWS_AS(Registry::CompactHive(L"RegistryTest.hiv", L"RegistryTest.hiv"), std::invalid_argument&);
+
+	auto compaction = Registry::CompactHive(L"RegistryTest.hiv", L"RegistryTest2.hiv");
+
+	assert(compaction.after.keys == compaction.before.keys);
+	assert(compaction.after.values == compaction.before.values);
+	assert(compaction.after.unusedBytes == 0);
+	assert(compaction.after.fileSize < compaction.before.fileSize);
+	assert(compaction.after.pagesPerLookup < compaction.before.pagesPerLookup);
+
+	{
+		Registry::HiveFile source(L"RegistryTest.hiv");
+		Registry::HiveFile compacted(L"RegistryTest2.hiv");
+
+		auto result = Registry::Diff(source.Root(), compacted.Root(), CollectDifference);
+
+		assert(result.differences == 0);
+		assert(g_differences.empty());
+
+		assert(compacted.Open(L"Key17").GetString(L"Name") == L"Key 17");
+
+		// Keys without security descriptor get default one
+		assert(source.Root().GetSecurityDescriptor().empty());
+		assert(!compacted.Root().GetSecurityDescriptor().empty());
+	}
+
+	// Compacted hive is already compact, security descriptors are kept
+	auto again = Registry::CompactHive(L"RegistryTest2.hiv", L"RegistryTest3.hiv");
+
+	assert(again.after.fileSize == again.before.fileSize);
+	assert(again.after.freeBytes == again.before.freeBytes);
+
+	{
+		std::ifstream first("RegistryTest2.hiv", std::ios::binary);
+		std::ifstream second("RegistryTest3.hiv", std::ios::binary);
+
+		assert(std::equal(std::istreambuf_iterator<char>(first), std::istreambuf_iterator<char>(), std::istreambuf_iterator<char>(second)));
+	}
+
+	// Class names of keys are kept, some system keys store data in them
+	{
+		TestHive image;
+
+		auto jd = image.AddKey("JD", {}, {}, {}, L"6b5a8c1d");
+		auto skew = image.AddKey("Skew1", {}, {}, {}, L"f1e2d3c4");
+		auto plain = image.AddKey("Plain", {}, {}, { image.AddValue("Name", REG_SZ, TestHive::Utf16(L"Value")) });
+		auto lsa = image.AddKey("Lsa", { jd, plain, skew }, { "JD", "Plain", "Skew1" }, {}, L"Lsa class");
+
+		image.Save("RegistryTest.hiv", image.AddKey("ROOT", { lsa }, { "Lsa" }, {}));
+	}
+
+	Registry::CompactHive(L"RegistryTest.hiv", L"RegistryTest2.hiv");
+
+	{
+		Registry::HiveFile source(L"RegistryTest.hiv");
+		Registry::HiveFile compacted(L"RegistryTest2.hiv");
+
+		for (const auto& path : { L"Lsa", L"Lsa\\JD", L"Lsa\\Skew1", L"Lsa\\Plain" })
+		{
+			assert(compacted.Open(path).GetClass() == source.Open(path).GetClass());
+		}
+
+		assert(compacted.Open(L"Lsa\\JD").GetClass() == L"6b5a8c1d");
+		assert(compacted.Open(L"Lsa").GetClass() == L"Lsa class");
+		assert(compacted.Open(L"Lsa\\Plain").GetClass().empty());
+		assert(compacted.Root().GetClass().empty());
+		assert(compacted.Open(L"Lsa\\Plain").GetString(L"Name") == L"Value");
+	}
+
+	std::remove("RegistryTest.hiv");
+	std::remove("RegistryTest2.hiv");
+	std::remove("RegistryTest3.hiv");
+}
+
+void TestVersionedBackend()
+{
+	auto backend = std::make_shared<Registry::VersionedBackend>();
+	auto root = std::make_shared<Registry::RegistryKey>(HKEY_CURRENT_USER, backend);
+
+	CHECK_THROWS_AS(root->Open(L"NOT_EXISTING_REGISTRY_KEY"), std::system_error&);
+
+	{
+		auto subKey = root->Create(L"OUR_TESTING_SUBKEY\\Nested", Registry::DesiredAccess::AllAccess);
+
+		assert(root->HasKey(L"OUR_TESTING_SUBKEY") == true);
+		assert(root->HasKey(L"our_testing_subkey\\NESTED") == true);
+		assert(root->HasKey(L"OUR_TESTING_SUBKEY\\KEY_THAT_DOES_NOT_EXISTS") == false);
+
+		{
+			auto key = root->Open(L"OUR_TESTING_SUBKEY");
+
+			CHECK_THROWS_AS(key->Create(L"CANNOT_CREATE_ACCESS_DENIED"), std::system_error&);
+			CHECK_THROWS_AS(key->SetInt32(L"CANNOT_SET_ACCESS_DENIED", 1), std::system_error&);
+		}
+
+		TestValues(subKey);
+
+		CHECK_NO_THROW(root->Delete(L"OUR_TESTING_SUBKEY"));
+		assert(root->HasKey(L"OUR_TESTING_SUBKEY") == false);
+
+		// Handle does not refer to key created again on same path
+		root->Create(L"OUR_TESTING_SUBKEY\\Nested");
+		CHECK_THROWS_AS(subKey->GetString(), std::system_error&);
+		CHECK_NO_THROW(root->Delete(L"OUR_TESTING_SUBKEY"));
+	}
+
+	// Handles see changes made after they were opened, subkeys and values enumerate in creation order
+	{
+		auto key = root->Create(L"OUR_TESTING_SUBKEY", Registry::DesiredAccess::AllAccess);
+		auto reader = root->Open(L"OUR_TESTING_SUBKEY", Registry::DesiredAccess::Read);
+
+		for (const auto& name : { L"Zulu", L"alpha", L"Mike" })
+		{
+			key->Create(name);
+			key->SetString(name, name);
+		}
+
+		key->SetString(L"ALPHA", L"Changed");
+		key->Delete(L"Zulu");
+
+		std::vector<std::wstring> subKeys;
+
+		reader->EnumerateSubKeys([&subKeys](const std::wstring& name) -> bool
+		{
+			subKeys.push_back(name);
+
+			return true;
+		});
+
+		assert((subKeys == std::vector<std::wstring>{ L"Zulu", L"alpha", L"Mike" }));
+		assert((ValueNames(reader) == std::vector<std::wstring>{ L"Mike", L"alpha" }));
+		assert(reader->GetString(L"Alpha") == L"Changed");
+
+		CHECK_NO_THROW(root->Delete(L"OUR_TESTING_SUBKEY"));
+	}
+
+	// Failing batch publishes nothing
+	{
+		auto key = root->Create(L"OUR_TESTING_SUBKEY", Registry::DesiredAccess::AllAccess);
+
+		key->SetInt32(L"Existing", 1);
+
+		Registry::WriteBatch batch;
+
+		batch
+			.SetInt32(L"", L"Existing", 2)
+			.CreateKey(L"Created")
+			.SetString(L"Missing", L"Name", L"Value");
+
+		CHECK_THROWS_AS(batch.Commit(key), std::system_error&);
+
+		assert(key->GetInt32(L"Existing") == 1);
+		assert(key->HasKey(L"Created") == false);
+
+		CHECK_NO_THROW(root->Delete(L"OUR_TESTING_SUBKEY"));
+	}
+
+	// Synchronous notification wakes up on write from other thread
+	{
+		auto key = root->Create(L"OUR_TESTING_SUBKEY", Registry::DesiredAccess::AllAccess | Registry::DesiredAccess::Notify);
+
+		std::thread writer([&root]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+			root->Open(L"OUR_TESTING_SUBKEY", Registry::DesiredAccess::AllAccess)->SetInt32(L"Changed", 1);
+		});
+
+		CHECK_NO_THROW(key->Notify(false, Registry::NotifyFilter::ChangeLastSet));
+		assert(key->GetInt32(L"Changed") == 1);
+
+		writer.join();
+
+		CHECK_NO_THROW(root->Delete(L"OUR_TESTING_SUBKEY"));
+	}
+
+	// Readers running concurrently with writers see whole batches only, and never older state than they saw before
+	{
+		auto key = root->Create(L"OUR_TESTING_SUBKEY", Registry::DesiredAccess::AllAccess);
+
+		key->SetInt32(L"First", -1);
+		key->SetInt32(L"Second", -1);
+
+		std::atomic<bool> done(false);
+		std::vector<std::thread> readers;
+
+		for (int i = 0; i < 4; ++i)
+		{
+			readers.emplace_back([&key, &done]()
+			{
+				Registry::RegistryValues values;
+				LONG last = -1;
+
+				while (!done)
+				{
+					key->GetValues({ L"First", L"Second" }, values);
+
+					const LONG first = values.GetInt32(0);
+
+					assert(first == values.GetInt32(1));
+					assert(first >= last);
+
+					last = first;
+
+					// Key being created and deleted by other writer either exists, or not
+					key->HasKey(L"Churn\\Nested");
+				}
+			});
+		}
+
+		std::thread churn([&key, &done]()
+		{
+			while (!done)
+			{
+				key->Create(L"Churn\\Nested", Registry::DesiredAccess::AllAccess)->SetInt32(L"Value", 1);
+				key->Delete(L"Churn");
+			}
+		});
+
+		Registry::WriteBatch batch;
+
+		for (LONG i = 0; i < 1000; i++)
+		{
+			batch.Clear();
+			batch.SetInt32(L"", L"First", i).SetInt32(L"", L"Second", i).Commit(key);
+		}
+
+		done = true;
+
+		for (auto& reader : readers)
+		{
+			reader.join();
+		}
+
+		churn.join();
+
+		assert(key->GetInt32(L"First") == 999 && key->GetInt32(L"Second") == 999);
+
+		CHECK_NO_THROW(root->Delete(L"OUR_TESTING_SUBKEY"));
+	}
+}
+
+int main()
+{
+	srand(static_cast<unsigned int>(time(nullptr)));
+
+	// New registry key creation from nullptr should throw
+	CHECK_THROWS_AS(Registry::RegistryKey(nullptr), std::invalid_argument&);
+
+#if defined(_WIN32)
+	// Opening registry keys
+
+	// Open registry key with empty path
+	CHECK_THROWS_AS(Registry::LocalMachine->Open(L""), std::invalid_argument&);
+	// Open non-existing key
+	CHECK_THROWS_AS(Registry::LocalMachine->Open(L"NOT_EXISTING_REGISTRY_KEY"), std::system_error&);
+	// Create registry key with empty path
+	CHECK_THROWS_AS(Registry::LocalMachine->Create(L""), std::invalid_argument&);
+	// Cannot create registry key right in local
+	CHECK_THROWS_AS(Registry::LocalMachine->Create(L"CANNOT_CREATE_ON_HIVE"), std::system_error&);
+
+	{
+		auto key = Registry::LocalMachine->Open(L"SOFTWARE");
+
+		CHECK_THROWS_AS(key->HasKey(L""), std::invalid_argument&);
+		CHECK_THROWS_AS(key->Exists(L""), std::invalid_argument&);
+
+		assert(key->HasKey(L"KEY_THAT_DOES_NOT_EXISTS") == false);
+		assert(key->Exists(L"KEY_THAT_DOES_NOT_EXISTS") == false);
+
+		CHECK_THROWS_AS(key->Create(L"CANNOT_CREATE_ACCESS_DENIED"), std::system_error&);
+	}
+
+	{
+		auto desiredAccess = Registry::DesiredAccess::AllAccess | Registry::DesiredAccess::Notify;
+		auto subKey = Registry::CurrentUser->Create(L"OUR_TESTING_SUBKEY", desiredAccess);
+
+		CHECK_NO_THROW(subKey->SetExpandString(L"%ProgramFiles%\\My Company\\My Product\\Program.exe"));
+		assert(subKey->GetString() == L"%ProgramFiles%\\My Company\\My Product\\Program.exe");
+
+		{
+			auto task = concurrency::create_task([subKey]() -> std::wstring
+			{
+				std::wstring result;
+
+				auto hChangeEvent = ::CreateEvent(nullptr, FALSE, FALSE, nullptr);
+				assert(hChangeEvent != nullptr);
+
+				CHECK_NO_THROW(subKey->NotifyAsync(hChangeEvent));
+
+				DWORD dwWaitResult = ::WaitForSingleObject(hChangeEvent, INFINITE);
+				if (dwWaitResult == WAIT_OBJECT_0)
+				{
+					result = subKey->GetString(L"INVOKE_NOTIFY");
+				}
+
+				::CloseHandle(hChangeEvent);
+
+				return result;
+			});
+
+			::Sleep(1000);
+
+			const auto& val = gen_random(32);
+
+			CHECK_NO_THROW(subKey->SetString(L"INVOKE_NOTIFY", val));
+			
+			assert(task.get() == val);
+			CHECK_NO_THROW(subKey->Delete(L"INVOKE_NOTIFY"));
+		}
+
+		TestValues(subKey);
+
+		CHECK_NO_THROW(subKey->Delete());
+	}
+#endif
+
+	TestStringRef();
+	TestMemoryBackend();
+	TestQueryValues();
+	TestCachedRegistryKey();
+	TestKeyCache();
+	TestWalk();
+
+	TestHiveFile();
+	TestSnapshot();
+	TestRegFile();
+	TestDiff();
+	TestWriteBatch();
+	TestChangeWatch();
+	TestWatchHub();
+	TestConfigSchema();
+	TestBinary();
+	TestMultiString();
+	TestPathTrie();
+	TestInstrumentedBackend();
+	TestHiveWriter();
+	TestHiveCompaction();
+	TestVersionedBackend();
+
 	return 0;
 }
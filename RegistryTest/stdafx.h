@@ -5,6 +5,7 @@
 
 #pragma once
 
+#if defined(_WIN32)
 #pragma comment(lib, "Registry.lib")
 
 #include "targetver.h"
@@ -12,7 +13,9 @@
 #include <ppl.h>
 #include <ppltasks.h>
 
-#include <stdio.h>
 #include <tchar.h>
+#endif
+
+#include <stdio.h>
 
 #include <Registry.hpp>